@@ -1,6 +1,6 @@
 /*
 
-This is an implementation of the AES algorithm, specifically ECB, CTR and CBC mode.
+This is an implementation of the AES algorithm, specifically ECB, CTR, CBC and XTS mode.
 Block size can be chosen in aes.h - available choices are AES128, AES192, AES256.
 
 The implementation is verified against the test vectors in:
@@ -95,7 +95,7 @@ static const uint8_t sbox[256] = {
   0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
   0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16 };
 
-#if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1)
+#if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1) || (defined(XTS) && XTS == 1)
 static const uint8_t rsbox[256] = {
   0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb,
   0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87, 0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb,
@@ -335,7 +335,7 @@ static uint8_t Multiply(uint8_t x, uint8_t y)
 
 #endif
 
-#if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1)
+#if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1) || (defined(XTS) && XTS == 1)
 /*
 static uint8_t getSBoxInvert(uint8_t num)
 {
@@ -407,7 +407,7 @@ static void InvShiftRows(state_t* state)
   (*state)[2][3] = (*state)[3][3];
   (*state)[3][3] = temp;
 }
-#endif // #if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1)
+#endif // #if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1) || (defined(XTS) && XTS == 1)
 
 // Cipher is the main function that encrypts the PlainText.
 static void Cipher(state_t* state, const uint8_t* RoundKey)
@@ -435,7 +435,7 @@ static void Cipher(state_t* state, const uint8_t* RoundKey)
   AddRoundKey(Nr, state, RoundKey);
 }
 
-#if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1)
+#if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1) || (defined(XTS) && XTS == 1)
 static void InvCipher(state_t* state, const uint8_t* RoundKey)
 {
   uint8_t round = 0;
@@ -459,7 +459,7 @@ static void InvCipher(state_t* state, const uint8_t* RoundKey)
   }
 
 }
-#endif // #if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1)
+#endif // #if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1) || (defined(XTS) && XTS == 1)
 
 /*****************************************************************************/
 /* Public functions:                                                         */
@@ -568,5 +568,120 @@ void AES_CTR_xcrypt_buffer(struct AES_ctx* ctx, uint8_t* buf, size_t length)
   }
 }
 
+/* Add a block count to a 128 bit big endian counter */
+static void CtrAdd(uint8_t* ctr, uint64_t n)
+{
+  int bi;
+  unsigned int sum;
+  for (bi = (AES_BLOCKLEN - 1); (bi >= 0) && (n != 0); --bi)
+  {
+    sum = ctr[bi] + (unsigned int)(n & 0xff);
+    ctr[bi] = (uint8_t)sum;
+    n = (n >> 8) + (sum >> 8);
+  }
+}
+
+void AES_CTR_xcrypt(const struct AES_ctx* ctx, const uint8_t* in, uint8_t* out, size_t length, uint64_t block_offset)
+{
+  uint8_t counter[AES_BLOCKLEN];
+  uint8_t buffer[AES_BLOCKLEN];
+  size_t i;
+  size_t bi;
+  size_t n;
+
+  memcpy(counter, ctx->Iv, AES_BLOCKLEN);
+  CtrAdd(counter, block_offset);
+  for (i = 0; i < length; i += AES_BLOCKLEN)
+  {
+    memcpy(buffer, counter, AES_BLOCKLEN);
+    Cipher((state_t*)buffer, ctx->RoundKey);
+    CtrAdd(counter, 1);
+
+    n = ((length - i) < AES_BLOCKLEN) ? (length - i) : AES_BLOCKLEN;
+    for (bi = 0; bi < n; ++bi)
+    {
+      out[i + bi] = in[i + bi] ^ buffer[bi];
+    }
+  }
+}
+
 #endif // #if defined(CTR) && (CTR == 1)
 
+
+
+#if defined(XTS) && (XTS == 1)
+
+void AES_XTS_init_ctx(struct AES_xts_ctx* ctx, const uint8_t* key)
+{
+  KeyExpansion(ctx->data.RoundKey, key);
+  KeyExpansion(ctx->tweak.RoundKey, key + AES_KEYLEN);
+}
+
+/* T = E(K2, sector number as 128 bit little endian value) */
+static void XtsInitTweak(const struct AES_xts_ctx* ctx, uint8_t* T, uint64_t sector)
+{
+  uint8_t i;
+  for (i = 0; i < AES_BLOCKLEN; ++i)
+  {
+    T[i] = (i < 8) ? (uint8_t)(sector >> (8 * i)) : 0;
+  }
+  Cipher((state_t*)T, ctx->tweak.RoundKey);
+}
+
+/* T = T * alpha in GF(2^128), little endian byte order per IEEE 1619 */
+static void XtsNextTweak(uint8_t* T)
+{
+  uint8_t i;
+  uint8_t carry = T[AES_BLOCKLEN - 1] >> 7;
+  for (i = (AES_BLOCKLEN - 1); i > 0; --i)
+  {
+    T[i] = (uint8_t)((T[i] << 1) | (T[i - 1] >> 7));
+  }
+  T[0] = (uint8_t)(T[0] << 1);
+  if (carry)
+  {
+    T[0] ^= 0x87;
+  }
+}
+
+static void XorWithTweak(uint8_t* buf, const uint8_t* T)
+{
+  uint8_t i;
+  for (i = 0; i < AES_BLOCKLEN; ++i)
+  {
+    buf[i] ^= T[i];
+  }
+}
+
+void AES_XTS_encrypt_sector(const struct AES_xts_ctx* ctx, uint8_t* buf, size_t length, uint64_t sector)
+{
+  uint8_t T[AES_BLOCKLEN];
+  size_t i;
+  XtsInitTweak(ctx, T, sector);
+  for (i = 0; i < length; i += AES_BLOCKLEN)
+  {
+    XorWithTweak(buf, T);
+    Cipher((state_t*)buf, ctx->data.RoundKey);
+    XorWithTweak(buf, T);
+    XtsNextTweak(T);
+    buf += AES_BLOCKLEN;
+  }
+}
+
+void AES_XTS_decrypt_sector(const struct AES_xts_ctx* ctx, uint8_t* buf, size_t length, uint64_t sector)
+{
+  uint8_t T[AES_BLOCKLEN];
+  size_t i;
+  XtsInitTweak(ctx, T, sector);
+  for (i = 0; i < length; i += AES_BLOCKLEN)
+  {
+    XorWithTweak(buf, T);
+    InvCipher((state_t*)buf, ctx->data.RoundKey);
+    XorWithTweak(buf, T);
+    XtsNextTweak(T);
+    buf += AES_BLOCKLEN;
+  }
+}
+
+#endif // #if defined(XTS) && (XTS == 1)
+
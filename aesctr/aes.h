@@ -12,7 +12,8 @@ extern "C" {
 //
 // CBC enables AES encryption in CBC-mode of operation.
 // CTR enables encryption in counter-mode.
-// ECB enables the basic ECB 16-byte block algorithm. All can be enabled simultaneously.
+// ECB enables the basic ECB 16-byte block algorithm.
+// XTS enables the IEEE 1619 XTS tweakable mode for sector/disk encryption. All can be enabled simultaneously.
 
 // The #ifndef-guard allows it to be configured before #include'ing or at compile time.
 #ifndef CBC
@@ -27,6 +28,10 @@ extern "C" {
   #define CTR 1
 #endif
 
+#ifndef XTS
+  #define XTS 1
+#endif
+
 
 //#define AES128 1
 //#define AES192 1
@@ -89,8 +94,35 @@ void AES_CBC_decrypt_buffer(struct AES_ctx* ctx, uint8_t* buf, size_t length);
 //        no IV should ever be reused with the same key 
 void AES_CTR_xcrypt_buffer(struct AES_ctx* ctx, uint8_t* buf, size_t length);
 
+// Stateless variant: the context is only read, never modified, so one ctx can be shared by any
+// number of threads. The counter used for the first block is the ctx IV plus block_offset, which
+// lets a caller start anywhere in the stream (byte position / AES_BLOCKLEN). in and out may point
+// to the same buffer for in-place use, or to different buffers (e.g. read-only mmap'd input).
+void AES_CTR_xcrypt(const struct AES_ctx* ctx, const uint8_t* in, uint8_t* out, size_t length, uint64_t block_offset);
+
 #endif // #if defined(CTR) && (CTR == 1)
 
+
+#if defined(XTS) && (XTS == 1)
+
+// XTS uses two independent AES keys: one for the data and one to encrypt the tweak.
+// The key passed to AES_XTS_init_ctx is 2 * AES_KEYLEN bytes, data key first (XTS-AES-256 with AES256).
+struct AES_xts_ctx
+{
+  struct AES_ctx data;
+  struct AES_ctx tweak;
+};
+
+void AES_XTS_init_ctx(struct AES_xts_ctx* ctx, const uint8_t* key);
+
+// Encrypts/decrypts one data unit (sector) in place. The sector number is the tweak, so any
+// sector can be processed independently of the others and from any thread sharing the ctx.
+// buffer size MUST be a multiple of AES_BLOCKLEN (512 and 4096 byte sectors are typical)
+void AES_XTS_encrypt_sector(const struct AES_xts_ctx* ctx, uint8_t* buf, size_t length, uint64_t sector);
+void AES_XTS_decrypt_sector(const struct AES_xts_ctx* ctx, uint8_t* buf, size_t length, uint64_t sector);
+
+#endif // #if defined(XTS) && (XTS == 1)
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,3 +1,5 @@
+#define _GNU_SOURCE // splice, F_SETPIPE_SZ
+
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
@@ -6,11 +8,26 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/stat.h>
 
+#ifdef __linux__
+#include <sys/socket.h>
+#include <linux/if_alg.h>
+#ifndef SOL_ALG
+#define SOL_ALG 279
+#endif
+#endif
+
 #include "aes.h"
+#include "sha2.h"
 
 #define BUFFLEN 1024
+#define MAXTHREADS 64
+#define XTS_BATCH 64 // sectors per read/write in XTS mode
+#define CTR_CHUNK 65536 // bytes per read/write per thread in the threaded CTR engine
+#define AFALG_CHUNK 65536 // bytes per AF_ALG request, also the pipe size
 
 int g_debug = 0;
 
@@ -27,13 +44,63 @@ char g_keyfile[BUFFLEN];
 int g_keyfile_specified = 0;
 uint8_t g_key[32];
 uint8_t g_iv[16];
+uint8_t g_xts_key[64];
+int g_xts = 0;
 
 int g_urandom_fd;
 
+typedef enum {
+    DIGEST_NONE,
+    DIGEST_IN, // plaintext is the input file (encrypting)
+    DIGEST_OUT // plaintext is the output file (decrypting)
+} digest_side;
+
+digest_side g_digest = DIGEST_NONE;
+int g_digest_bits = 512;
+char g_digestfile[BUFFLEN];
+int g_digestfile_specified = 0;
+int g_digestfile_fd = -1;
+
+unsigned int g_sectorsize = 4096;
+uint64_t g_first_sector = 0;
+uint64_t g_sector_count = 0; // 0 = through end of input
+int g_count_specified = 0;
+int g_inplace = 0;
+unsigned int g_threads = 1;
+
+typedef struct {
+    pthread_t thread;
+    struct AES_xts_ctx *ctx;
+    int decrypt;
+    uint64_t first;
+    uint64_t count;
+} xts_work_area;
+
+typedef struct {
+    pthread_t thread;
+    struct AES_ctx *ctx;
+    int in_fd;
+    int out_fd;
+    uint64_t first;
+    uint64_t len;
+} ctr_work_area;
+
+typedef enum {
+    ENGINE_USER, // single threaded tiny-AES, the only engine that can digest
+    ENGINE_THREADED, // tiny-AES split across g_threads with pread/pwrite
+    ENGINE_AFALG // Linux kernel crypto via AF_ALG sockets and splice
+} engine_type;
+
+const char *g_engine_names[] = { "user", "threaded", "afalg" };
+engine_type g_engine = ENGINE_USER;
+
 typedef enum {
     MODE_NONE,
     MODE_PROCESS,
-    MODE_GENERATE
+    MODE_GENERATE,
+    MODE_XTS_ENCRYPT,
+    MODE_XTS_DECRYPT,
+    MODE_BENCHMARK
 } operational_mode;
 
 operational_mode g_mode = MODE_NONE;
@@ -46,7 +113,20 @@ struct option g_options[] = {
     { "key", required_argument, NULL, 'k' },
     { "process", no_argument, NULL, 'p' },
     { "generate", no_argument, NULL, 'g' },
+    { "xtsencrypt", no_argument, NULL, 'e' },
+    { "xtsdecrypt", no_argument, NULL, 'd' },
     { "overwrite", no_argument, NULL, 'w' },
+    { "digest", required_argument, NULL, 1002 },
+    { "sha", required_argument, NULL, 1003 },
+    { "digestfile", required_argument, NULL, 1004 },
+    { "xts", no_argument, NULL, 1005 },
+    { "sectorsize", required_argument, NULL, 1006 },
+    { "first", required_argument, NULL, 1007 },
+    { "count", required_argument, NULL, 1008 },
+    { "inplace", no_argument, NULL, 1009 },
+    { "threads", required_argument, NULL, 't' },
+    { "engine", required_argument, NULL, 1010 },
+    { "benchmark", no_argument, NULL, 'b' },
     { NULL, 0, NULL, 0 }
 };
 
@@ -93,6 +173,37 @@ void load_key()
     }
 }
 
+void load_xts_key()
+{
+    if (g_keyfile_specified == 0) {
+        fprintf(stderr, "aesctr: this operation requires that you specify a key file.\n");
+        exit(EXIT_FAILURE);
+    }
+    int key_fd;
+    int res;
+    key_fd = open(g_keyfile, O_RDONLY);
+    if (key_fd < 0) {
+        fprintf(stderr, "aesctr: unable to open key file: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    res = read(key_fd, g_xts_key, 64);
+    if (res < 0) {
+        fprintf(stderr, "aesctr: unable to read key file: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (res != 64) {
+        fprintf(stderr, "aesctr: key file is too short for XTS mode (generate one with -g --xts)\n");
+        exit(EXIT_FAILURE);
+    }
+    close(key_fd);
+    if (g_debug > 0) {
+        printf("load_xts_key: loaded data key");
+        print_hex(g_xts_key, 32);
+        printf("load_xts_key: loaded tweak key");
+        print_hex(g_xts_key + 32, 32);
+    }
+}
+
 void prepare_outfile()
 {
     int res;
@@ -125,6 +236,35 @@ void prepare_outfile()
     }
 }
 
+void prepare_digestfile()
+{
+    int res;
+
+    // settle the digest file up front so a refusal doesn't come after the whole input is processed
+    struct stat l_digestfile_stat;
+    res = stat(g_digestfile, &l_digestfile_stat);
+    if (res == 0) {
+        if (g_outfile_overwrite == 0) {
+            fprintf(stderr, "aesctr: digest file already exists (use -w or --overwrite to write to it anyway)\n");
+            exit(EXIT_FAILURE);
+        } else {
+            printf("aesctr: overwriting existing digest file %s\n", g_digestfile);
+        }
+    } else if ((res < 0) && (errno == ENOENT)) {
+        // this is what we want
+    } else {
+        fprintf(stderr, "aesctr: unable to stat digest file to check its existence: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (g_debug) printf("prepare_digestfile: opening and truncating digest file\n");
+    g_digestfile_fd = open(g_digestfile, O_RDWR | O_TRUNC | O_CREAT, (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
+    if (g_digestfile_fd < 0) {
+        fprintf(stderr, "aesctr: error opening digest file: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
 void prepare_infile()
 {
     int res;
@@ -154,17 +294,68 @@ void get_random(uint8_t *a_buffer, size_t a_len)
     }
 }
 
-void do_process()
+void write_digest(uint8_t *a_digest, size_t a_len)
 {
-    uint8_t l_buff[4096];
+    // emit in the same format as sha256sum/sha512sum so the line can be checked with -c
+    char l_line[BUFFLEN + SHA512_DIGEST_SIZE * 2 + 4];
+    int l_pos = 0;
+    int i;
+    int res;
+
+    for (i = 0; i < a_len; ++i)
+        l_pos += sprintf(l_line + l_pos, "%02x", a_digest[i]);
+    l_pos += sprintf(l_line + l_pos, "  %s\n", (g_digest == DIGEST_IN) ? g_infile : g_outfile);
+
+    if (g_digestfile_specified == 0) {
+        printf("%s", l_line);
+        return;
+    }
+
+    res = write(g_digestfile_fd, l_line, l_pos);
+    if (res < 0) {
+        fprintf(stderr, "aesctr: unable to write to digest file: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    close(g_digestfile_fd);
+    printf("aesctr: wrote SHA-%d digest of plaintext to %s\n", g_digest_bits, g_digestfile);
+}
+
+ssize_t read_full(int a_fd, uint8_t *a_buffer, size_t a_len)
+{
+    // keep reading until the buffer is full or EOF so the counter offset stays block aligned
+    ssize_t res;
+    size_t l_total = 0;
+    while (l_total < a_len) {
+        res = read(a_fd, a_buffer + l_total, a_len - l_total);
+        if (res < 0)
+            return res;
+        if (res == 0)
+            break;
+        l_total += res;
+    }
+    return l_total;
+}
+
+void engine_user(int a_in_fd, int a_out_fd)
+{
+    uint8_t l_in[4096];
+    uint8_t l_out[4096];
+    uint64_t l_block = 0;
     int res;
 
     struct AES_ctx l_ctx;
     AES_init_ctx_iv(&l_ctx, g_key, g_iv);
 
-    printf("aesctr: processing input file into output file...\n");
+    // the digest rides along with the cipher pass so the plaintext is only read once
+    sha256_ctx l_sha256;
+    sha512_ctx l_sha512;
+    if (g_digest_bits == 256)
+        sha256_init(&l_sha256);
+    else
+        sha512_init(&l_sha512);
+
     do {
-        res = read(g_infile_fd, l_buff, 4096);
+        res = read_full(a_in_fd, l_in, 4096);
         if (res == 0) {
             // EOF
             continue;
@@ -173,18 +364,463 @@ void do_process()
             fprintf(stderr, "aesctr: unable to read from input file: %s\n", strerror(errno));
             exit(EXIT_FAILURE);
         }
-        AES_CTR_xcrypt_buffer(&l_ctx, l_buff, res);
-        res = write(g_outfile_fd, l_buff, res);
+        AES_CTR_xcrypt(&l_ctx, l_in, l_out, res, l_block);
+        l_block += 4096 / AES_BLOCKLEN;
+        if (g_digest != DIGEST_NONE) {
+            uint8_t *l_plain = (g_digest == DIGEST_IN) ? l_in : l_out;
+            if (g_digest_bits == 256)
+                sha256_update(&l_sha256, l_plain, res);
+            else
+                sha512_update(&l_sha512, l_plain, res);
+        }
+        res = write(a_out_fd, l_out, res);
         if (res < 0) {
             fprintf(stderr, "aesctr: unable to write to output file: %s\n", strerror(errno));
             exit(EXIT_FAILURE);
         }
     } while (res != 0);
 
+    if (g_digest != DIGEST_NONE) {
+        uint8_t l_digest[SHA512_DIGEST_SIZE];
+        if (g_digest_bits == 256) {
+            sha256_final(&l_sha256, l_digest);
+            write_digest(l_digest, SHA256_DIGEST_SIZE);
+        } else {
+            sha512_final(&l_sha512, l_digest);
+            write_digest(l_digest, SHA512_DIGEST_SIZE);
+        }
+    }
+}
+
+void *ctr_tf(void *a_arg)
+{
+    ctr_work_area *a_cwa = (ctr_work_area *)a_arg;
+    uint8_t *l_buff = malloc(CTR_CHUNK);
+    uint64_t l_pos = a_cwa->first;
+    uint64_t l_end = a_cwa->first + a_cwa->len;
+    size_t l_len;
+    ssize_t res;
+
+    if (l_buff == NULL) {
+        fprintf(stderr, "aesctr: unable to allocate buffer\n");
+        exit(EXIT_FAILURE);
+    }
+    while (l_pos < l_end) {
+        l_len = ((l_end - l_pos) < CTR_CHUNK) ? (l_end - l_pos) : CTR_CHUNK;
+        res = pread(a_cwa->in_fd, l_buff, l_len, l_pos);
+        if (res != l_len) {
+            fprintf(stderr, "aesctr: unable to read from input file: %s\n", (res < 0) ? strerror(errno) : "short read");
+            exit(EXIT_FAILURE);
+        }
+        // every share starts on a block boundary, so the counter is simply position / block size
+        AES_CTR_xcrypt(a_cwa->ctx, l_buff, l_buff, l_len, l_pos / AES_BLOCKLEN);
+        res = pwrite(a_cwa->out_fd, l_buff, l_len, l_pos);
+        if (res != l_len) {
+            fprintf(stderr, "aesctr: unable to write to output file: %s\n", (res < 0) ? strerror(errno) : "short write");
+            exit(EXIT_FAILURE);
+        }
+        l_pos += l_len;
+    }
+    free(l_buff);
+    return NULL;
+}
+
+int engine_threaded(int a_in_fd, int a_out_fd)
+{
+    struct stat l_infile_stat;
+    struct AES_ctx l_ctx;
+    ctr_work_area l_cwa[MAXTHREADS];
+    unsigned int i;
+    int res;
+
+    res = fstat(a_in_fd, &l_infile_stat);
+    if ((res < 0) || (!S_ISREG(l_infile_stat.st_mode))) {
+        fprintf(stderr, "aesctr: threaded engine requires a regular input file\n");
+        return -1;
+    }
+    AES_init_ctx_iv(&l_ctx, g_key, g_iv);
+
+    // one shared, read-only context; the file is cut into block aligned shares
+    uint64_t l_size = l_infile_stat.st_size;
+    uint64_t l_share = ((l_size / g_threads) + AES_BLOCKLEN - 1) & ~(uint64_t)(AES_BLOCKLEN - 1);
+    uint64_t l_next = 0;
+    for (i = 0; i < g_threads; ++i) {
+        l_cwa[i].ctx = &l_ctx;
+        l_cwa[i].in_fd = a_in_fd;
+        l_cwa[i].out_fd = a_out_fd;
+        l_cwa[i].first = l_next;
+        l_cwa[i].len = ((i == g_threads - 1) || (l_next + l_share > l_size)) ? (l_size - l_next) : l_share;
+        l_next += l_cwa[i].len;
+        res = pthread_create(&l_cwa[i].thread, NULL, ctr_tf, &l_cwa[i]);
+        if (res != 0) {
+            fprintf(stderr, "aesctr: problems creating thread: %s\n", strerror(res));
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < g_threads; ++i)
+        pthread_join(l_cwa[i].thread, NULL);
+    return 0;
+}
+
+#ifdef __linux__
+
+int afalg_set_iv(int a_op_fd, uint64_t a_block)
+{
+    // announce an encrypt operation whose counter starts a_block blocks into the stream
+    char l_cbuf[CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(struct af_alg_iv) + AES_BLOCKLEN)];
+    struct msghdr l_msg;
+    struct cmsghdr *l_cmsg;
+    struct af_alg_iv *l_iv;
+    int i;
+
+    memset(l_cbuf, 0, sizeof(l_cbuf));
+    memset(&l_msg, 0, sizeof(l_msg));
+    l_msg.msg_control = l_cbuf;
+    l_msg.msg_controllen = sizeof(l_cbuf);
+
+    l_cmsg = CMSG_FIRSTHDR(&l_msg);
+    l_cmsg->cmsg_level = SOL_ALG;
+    l_cmsg->cmsg_type = ALG_SET_OP;
+    l_cmsg->cmsg_len = CMSG_LEN(sizeof(uint32_t));
+    *(uint32_t *)CMSG_DATA(l_cmsg) = ALG_OP_ENCRYPT;
+
+    l_cmsg = CMSG_NXTHDR(&l_msg, l_cmsg);
+    l_cmsg->cmsg_level = SOL_ALG;
+    l_cmsg->cmsg_type = ALG_SET_IV;
+    l_cmsg->cmsg_len = CMSG_LEN(sizeof(struct af_alg_iv) + AES_BLOCKLEN);
+    l_iv = (struct af_alg_iv *)CMSG_DATA(l_cmsg);
+    l_iv->ivlen = AES_BLOCKLEN;
+    memcpy(l_iv->iv, g_iv, AES_BLOCKLEN);
+    for (i = AES_BLOCKLEN - 1; (i >= 0) && (a_block != 0); --i) {
+        unsigned int l_sum = l_iv->iv[i] + (unsigned int)(a_block & 0xff);
+        l_iv->iv[i] = (uint8_t)l_sum;
+        a_block = (a_block >> 8) + (l_sum >> 8);
+    }
+
+    return sendmsg(a_op_fd, &l_msg, MSG_MORE);
+}
+
+int splice_all(int a_from_fd, int a_to_fd, size_t a_len, unsigned int a_flags)
+{
+    ssize_t res;
+    while (a_len > 0) {
+        res = splice(a_from_fd, NULL, a_to_fd, NULL, a_len, a_flags);
+        if (res <= 0)
+            return -1;
+        a_len -= res;
+    }
+    return 0;
+}
+
+int engine_afalg(int a_in_fd, int a_out_fd)
+{
+    struct sockaddr_alg l_sa;
+    int l_tfm_fd;
+    int l_op_fd;
+    int l_in_pipe[2];
+    int l_out_pipe[2];
+    uint64_t l_block = 0;
+    size_t l_len;
+    ssize_t res;
+
+    l_tfm_fd = socket(AF_ALG, SOCK_SEQPACKET, 0);
+    if (l_tfm_fd < 0) {
+        fprintf(stderr, "aesctr: AF_ALG engine unavailable: %s\n", strerror(errno));
+        return -1;
+    }
+    memset(&l_sa, 0, sizeof(l_sa));
+    l_sa.salg_family = AF_ALG;
+    strcpy((char *)l_sa.salg_type, "skcipher");
+    strcpy((char *)l_sa.salg_name, "ctr(aes)");
+    if (bind(l_tfm_fd, (struct sockaddr *)&l_sa, sizeof(l_sa)) < 0) {
+        fprintf(stderr, "aesctr: AF_ALG engine unavailable, kernel has no ctr(aes): %s\n", strerror(errno));
+        close(l_tfm_fd);
+        return -1;
+    }
+    if (setsockopt(l_tfm_fd, SOL_ALG, ALG_SET_KEY, g_key, 32) < 0) {
+        fprintf(stderr, "aesctr: AF_ALG engine unable to set key: %s\n", strerror(errno));
+        close(l_tfm_fd);
+        return -1;
+    }
+    l_op_fd = accept(l_tfm_fd, NULL, 0);
+    if (l_op_fd < 0) {
+        fprintf(stderr, "aesctr: AF_ALG engine unable to open operation socket: %s\n", strerror(errno));
+        close(l_tfm_fd);
+        return -1;
+    }
+    if ((pipe(l_in_pipe) < 0) || (pipe(l_out_pipe) < 0)) {
+        fprintf(stderr, "aesctr: AF_ALG engine unable to create pipes: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    fcntl(l_in_pipe[1], F_SETPIPE_SZ, AFALG_CHUNK);
+    fcntl(l_out_pipe[1], F_SETPIPE_SZ, AFALG_CHUNK);
+
+    // file -> pipe -> ctr(aes) -> pipe -> file; the data pages never visit user space
+    for (;;) {
+        l_len = 0;
+        while (l_len < AFALG_CHUNK) {
+            res = splice(a_in_fd, NULL, l_in_pipe[1], NULL, AFALG_CHUNK - l_len, SPLICE_F_MOVE);
+            if (res < 0) {
+                fprintf(stderr, "aesctr: unable to splice from input file: %s\n", strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+            if (res == 0)
+                break;
+            l_len += res;
+        }
+        if (l_len == 0)
+            break;
+        if (afalg_set_iv(l_op_fd, l_block) < 0) {
+            fprintf(stderr, "aesctr: AF_ALG engine unable to set IV: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        if (splice_all(l_in_pipe[0], l_op_fd, l_len, SPLICE_F_MOVE | SPLICE_F_MORE) < 0) {
+            fprintf(stderr, "aesctr: unable to splice into AF_ALG socket: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        // an empty send without MSG_MORE closes the request so the kernel processes it
+        if (send(l_op_fd, NULL, 0, 0) < 0) {
+            fprintf(stderr, "aesctr: unable to finish AF_ALG request: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        if (splice_all(l_op_fd, l_out_pipe[1], l_len, SPLICE_F_MOVE) < 0) {
+            fprintf(stderr, "aesctr: unable to splice from AF_ALG socket: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        if (splice_all(l_out_pipe[0], a_out_fd, l_len, SPLICE_F_MOVE) < 0) {
+            fprintf(stderr, "aesctr: unable to splice to output file: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        l_block += l_len / AES_BLOCKLEN;
+        if (l_len < AFALG_CHUNK)
+            break;
+    }
+
+    close(l_in_pipe[0]);
+    close(l_in_pipe[1]);
+    close(l_out_pipe[0]);
+    close(l_out_pipe[1]);
+    close(l_op_fd);
+    close(l_tfm_fd);
+    return 0;
+}
+
+#else
+
+int engine_afalg(int a_in_fd, int a_out_fd)
+{
+    fprintf(stderr, "aesctr: AF_ALG engine is only available on Linux\n");
+    return -1;
+}
+
+#endif // __linux__
+
+int run_engine(engine_type a_engine, int a_in_fd, int a_out_fd)
+{
+    switch (a_engine) {
+        case ENGINE_USER:
+            engine_user(a_in_fd, a_out_fd);
+            return 0;
+        case ENGINE_THREADED:
+            return engine_threaded(a_in_fd, a_out_fd);
+        case ENGINE_AFALG:
+            return engine_afalg(a_in_fd, a_out_fd);
+    }
+    return -1;
+}
+
+void do_process()
+{
+    printf("aesctr: processing input file into output file using %s engine...\n", g_engine_names[g_engine]);
+    if (run_engine(g_engine, g_infile_fd, g_outfile_fd) < 0)
+        exit(EXIT_FAILURE);
+
+    close(g_infile_fd);
+    close(g_outfile_fd);
+}
+
+void file_sha256(int a_fd, uint8_t *a_digest)
+{
+    uint8_t l_buff[4096];
+    sha256_ctx l_ctx;
+    ssize_t res;
+
+    sha256_init(&l_ctx);
+    lseek(a_fd, 0, SEEK_SET);
+    while ((res = read(a_fd, l_buff, sizeof(l_buff))) > 0)
+        sha256_update(&l_ctx, l_buff, res);
+    sha256_final(&l_ctx, a_digest);
+}
+
+void do_benchmark()
+{
+    engine_type l_engine;
+    struct timespec l_start, l_end;
+    struct stat l_infile_stat;
+    uint8_t l_digest[SHA256_DIGEST_SIZE];
+    uint8_t l_first_digest[SHA256_DIGEST_SIZE];
+    int l_have_first = 0;
+    int l_out_fd;
+    int res;
+
+    fstat(g_infile_fd, &l_infile_stat);
+    printf("aesctr: benchmarking %lld bytes with %u thread(s) for the threaded engine\n", (long long)l_infile_stat.st_size, g_threads);
+
+    for (l_engine = ENGINE_USER; l_engine <= ENGINE_AFALG; ++l_engine) {
+        lseek(g_infile_fd, 0, SEEK_SET);
+        if (g_outfile_specified) {
+            l_out_fd = g_outfile_fd;
+            lseek(l_out_fd, 0, SEEK_SET);
+            res = ftruncate(l_out_fd, 0);
+        } else {
+            l_out_fd = open("/dev/null", O_WRONLY);
+        }
+        if (l_out_fd < 0) {
+            fprintf(stderr, "aesctr: unable to open benchmark output: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &l_start);
+        res = run_engine(l_engine, g_infile_fd, l_out_fd);
+        clock_gettime(CLOCK_MONOTONIC, &l_end);
+        if (res < 0) {
+            printf("aesctr: engine %-8s: unavailable\n", g_engine_names[l_engine]);
+            if (!g_outfile_specified)
+                close(l_out_fd);
+            continue;
+        }
+        double l_secs = (l_end.tv_sec - l_start.tv_sec) + (l_end.tv_nsec - l_start.tv_nsec) / 1e9;
+        printf("aesctr: engine %-8s: %9.2f MB/s (%.3f seconds)", g_engine_names[l_engine], (l_infile_stat.st_size / 1048576.0) / l_secs, l_secs);
+        if (g_outfile_specified) {
+            // check that every engine produced the same ciphertext
+            file_sha256(l_out_fd, l_digest);
+            if (l_have_first == 0) {
+                memcpy(l_first_digest, l_digest, SHA256_DIGEST_SIZE);
+                l_have_first = 1;
+            }
+            printf(" output %s", (memcmp(l_digest, l_first_digest, SHA256_DIGEST_SIZE) == 0) ? "matches" : "MISMATCH");
+        } else {
+            close(l_out_fd);
+        }
+        printf("\n");
+    }
+
+    close(g_infile_fd);
+    if (g_outfile_specified)
+        close(g_outfile_fd);
+}
+
+void *xts_tf(void *a_arg)
+{
+    xts_work_area *a_xwa = (xts_work_area *)a_arg;
+    size_t l_bufflen = (size_t)g_sectorsize * XTS_BATCH;
+    uint8_t *l_buff = malloc(l_bufflen);
+    uint64_t l_sector = a_xwa->first;
+    uint64_t l_end = a_xwa->first + a_xwa->count;
+    uint64_t l_batch;
+    uint64_t i;
+    ssize_t res;
+
+    if (l_buff == NULL) {
+        fprintf(stderr, "aesctr: unable to allocate sector buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // every sector carries its own tweak, so each thread can seek straight to its share of the range
+    while (l_sector < l_end) {
+        l_batch = l_end - l_sector;
+        if (l_batch > XTS_BATCH)
+            l_batch = XTS_BATCH;
+        res = pread(g_infile_fd, l_buff, l_batch * g_sectorsize, l_sector * g_sectorsize);
+        if (res != l_batch * g_sectorsize) {
+            fprintf(stderr, "aesctr: unable to read sectors from input file: %s\n", (res < 0) ? strerror(errno) : "short read");
+            exit(EXIT_FAILURE);
+        }
+        for (i = 0; i < l_batch; ++i) {
+            if (a_xwa->decrypt)
+                AES_XTS_decrypt_sector(a_xwa->ctx, l_buff + i * g_sectorsize, g_sectorsize, l_sector + i);
+            else
+                AES_XTS_encrypt_sector(a_xwa->ctx, l_buff + i * g_sectorsize, g_sectorsize, l_sector + i);
+        }
+        res = pwrite(g_outfile_fd, l_buff, l_batch * g_sectorsize, l_sector * g_sectorsize);
+        if (res != l_batch * g_sectorsize) {
+            fprintf(stderr, "aesctr: unable to write sectors to output file: %s\n", (res < 0) ? strerror(errno) : "short write");
+            exit(EXIT_FAILURE);
+        }
+        l_sector += l_batch;
+    }
+
+    free(l_buff);
+    return NULL;
+}
+
+void do_xts(int a_decrypt)
+{
+    int res;
+    unsigned int i;
+    struct stat l_infile_stat;
+    struct AES_xts_ctx l_ctx;
+    xts_work_area l_xwa[MAXTHREADS];
+
+    res = fstat(g_infile_fd, &l_infile_stat);
+    if (res < 0) {
+        fprintf(stderr, "aesctr: error calling stat on input file: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (l_infile_stat.st_size % g_sectorsize != 0) {
+        fprintf(stderr, "aesctr: input file size is not a multiple of the %u byte sector size\n", g_sectorsize);
+        exit(EXIT_FAILURE);
+    }
+    uint64_t l_total = l_infile_stat.st_size / g_sectorsize;
+    if (g_first_sector > l_total) {
+        fprintf(stderr, "aesctr: first sector is beyond the end of the input file\n");
+        exit(EXIT_FAILURE);
+    }
+    if (g_count_specified == 0)
+        g_sector_count = l_total - g_first_sector;
+    if (g_first_sector + g_sector_count > l_total) {
+        fprintf(stderr, "aesctr: sector range extends beyond the end of the input file\n");
+        exit(EXIT_FAILURE);
+    }
+    if (g_sector_count < g_threads)
+        g_threads = (g_sector_count > 0) ? g_sector_count : 1;
+
+    AES_XTS_init_ctx(&l_ctx, g_xts_key);
+
+    printf("aesctr: %s sectors %llu-%llu (%u bytes each) using %u thread(s)...\n", a_decrypt ? "decrypting" : "encrypting",
+        (unsigned long long)g_first_sector, (unsigned long long)(g_first_sector + g_sector_count - 1), g_sectorsize, g_threads);
+
+    uint64_t l_share = g_sector_count / g_threads;
+    uint64_t l_next = g_first_sector;
+    for (i = 0; i < g_threads; ++i) {
+        l_xwa[i].ctx = &l_ctx;
+        l_xwa[i].decrypt = a_decrypt;
+        l_xwa[i].first = l_next;
+        l_xwa[i].count = (i == g_threads - 1) ? (g_first_sector + g_sector_count - l_next) : l_share;
+        l_next += l_xwa[i].count;
+        res = pthread_create(&l_xwa[i].thread, NULL, xts_tf, &l_xwa[i]);
+        if (res != 0) {
+            fprintf(stderr, "aesctr: problems creating thread: %s\n", strerror(res));
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < g_threads; ++i)
+        pthread_join(l_xwa[i].thread, NULL);
+
     close(g_infile_fd);
     close(g_outfile_fd);
 }
 
+void prepare_inplace_outfile()
+{
+    // in place mode rewrites a range of an existing image, so never truncate it
+    if (g_debug) printf("prepare_inplace_outfile: opening output file for in place update\n");
+    g_outfile_fd = open(g_outfile, O_RDWR | O_CREAT, (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
+    if (g_outfile_fd < 0) {
+        fprintf(stderr, "aesctr: error opening output file: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
 void do_generate()
 {
     // write 32 random bytes to g_keyfile
@@ -211,6 +847,21 @@ void do_generate()
         fprintf(stderr, "aesctr: error opening key file for writing: %s\n", strerror(errno));
         exit(EXIT_FAILURE);
     }
+    if (g_xts) {
+        // XTS keys are two independent AES256 keys (data, tweak) and no IV
+        get_random(g_xts_key, 64);
+        res = write(key_fd, g_xts_key, 64);
+        if (res < 0) {
+            fprintf(stderr, "aesctr: unable to write to key file: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        if (g_debug > 0) {
+            printf("do_generate: generated XTS key");
+            print_hex(g_xts_key, 64);
+        }
+        close(key_fd);
+        return;
+    }
     get_random(g_key, 32);
     res = write(key_fd, g_key, 32);
     if (res < 0) {
@@ -237,7 +888,7 @@ int main(int argc, char **argv)
     unsigned int i;
     int res; // result variable for UNIX reads
     int opt;
-    while ((opt = getopt_long(argc, argv, "i:o:k:pg?w", g_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "i:o:k:pgedbt:?w", g_options, NULL)) != -1) {
         switch (opt) {
             case 1001:
             {
@@ -267,6 +918,33 @@ int main(int argc, char **argv)
                 g_outfile_overwrite = 1;
             }
             break;
+            case 1002:
+            {
+                if (strcmp(optarg, "in") == 0) {
+                    g_digest = DIGEST_IN;
+                } else if (strcmp(optarg, "out") == 0) {
+                    g_digest = DIGEST_OUT;
+                } else {
+                    fprintf(stderr, "aesctr: --digest must be either in or out.\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            break;
+            case 1003:
+            {
+                g_digest_bits = atoi(optarg);
+                if ((g_digest_bits != 256) && (g_digest_bits != 512)) {
+                    fprintf(stderr, "aesctr: --sha must be either 256 or 512.\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            break;
+            case 1004:
+            {
+                strcpy(g_digestfile, optarg);
+                g_digestfile_specified = 1;
+            }
+            break;
             case 'p':
             {
                 if (g_mode != MODE_NONE) {
@@ -285,6 +963,85 @@ int main(int argc, char **argv)
                 g_mode = MODE_GENERATE;
             }
             break;
+            case 'e':
+            {
+                if (g_mode != MODE_NONE) {
+                    fprintf(stderr, "aesctr: please select only one operational mode.\n");
+                    exit(EXIT_FAILURE);
+                }
+                g_mode = MODE_XTS_ENCRYPT;
+            }
+            break;
+            case 'd':
+            {
+                if (g_mode != MODE_NONE) {
+                    fprintf(stderr, "aesctr: please select only one operational mode.\n");
+                    exit(EXIT_FAILURE);
+                }
+                g_mode = MODE_XTS_DECRYPT;
+            }
+            break;
+            case 't':
+            {
+                g_threads = atoi(optarg);
+                if ((g_threads < 1) || (g_threads > MAXTHREADS)) {
+                    fprintf(stderr, "aesctr: threads must be between 1 and %d.\n", MAXTHREADS);
+                    exit(EXIT_FAILURE);
+                }
+            }
+            break;
+            case 1005:
+            {
+                g_xts = 1;
+            }
+            break;
+            case 1006:
+            {
+                g_sectorsize = atoi(optarg);
+                if ((g_sectorsize != 512) && (g_sectorsize != 4096)) {
+                    fprintf(stderr, "aesctr: --sectorsize must be either 512 or 4096.\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            break;
+            case 1007:
+            {
+                g_first_sector = strtoull(optarg, NULL, 10);
+            }
+            break;
+            case 1008:
+            {
+                g_sector_count = strtoull(optarg, NULL, 10);
+                g_count_specified = 1;
+            }
+            break;
+            case 1009:
+            {
+                g_inplace = 1;
+            }
+            break;
+            case 1010:
+            {
+                for (i = ENGINE_USER; i <= ENGINE_AFALG; ++i) {
+                    if (strcmp(optarg, g_engine_names[i]) == 0)
+                        break;
+                }
+                if (i > ENGINE_AFALG) {
+                    fprintf(stderr, "aesctr: --engine must be one of user, threaded or afalg.\n");
+                    exit(EXIT_FAILURE);
+                }
+                g_engine = i;
+            }
+            break;
+            case 'b':
+            {
+                if (g_mode != MODE_NONE) {
+                    fprintf(stderr, "aesctr: please select only one operational mode.\n");
+                    exit(EXIT_FAILURE);
+                }
+                g_mode = MODE_BENCHMARK;
+            }
+            break;
             case '?':
             {
                 printf("AES256 CTR Mode file encryptor\n");
@@ -293,6 +1050,24 @@ int main(int argc, char **argv)
                 printf("  -o (--out) <name> specify output file\n");
                 printf("  -k (--key) <name> specify full name of key file to use\n");
                 printf("  -w (--overwrite) force overwrite of existing output file or key file\n");
+                printf("     (--digest) <in/out> compute SHA-2 digest of the plaintext while processing\n");
+                printf("       in = plaintext is the input file (encrypting)\n");
+                printf("       out = plaintext is the output file (decrypting)\n");
+                printf("     (--sha) <256/512> digest width, default 512\n");
+                printf("     (--digestfile) <name> write digest to sidecar file instead of stdout\n");
+                printf("     (--engine) <user/threaded/afalg> CTR engine for -p, default user\n");
+                printf("       user = tiny-AES, single thread (required for --digest)\n");
+                printf("       threaded = tiny-AES split across -t threads\n");
+                printf("       afalg = Linux kernel crypto API, zero-copy via splice\n");
+                printf("XTS sector mode options\n");
+                printf("     (--xts) with -g, create a 64 byte XTS-AES-256 key (data key + tweak key)\n");
+                printf("     (--sectorsize) <512/4096> sector size, default 4096\n");
+                printf("     (--first) <n> first sector to process, default 0\n");
+                printf("     (--count) <n> number of sectors to process, default through end of input\n");
+                printf("       --first and --count need --inplace, a new output image would lose the other sectors\n");
+                printf("     (--inplace) update the sector range of an existing output image without truncating it\n");
+                printf("       (input and output may name the same file)\n");
+                printf("  -t (--threads) <n> number of threads to use, default 1\n");
                 printf("     (--debug) use debug mode\n");
                 printf("  -? (--help) this screen\n");
                 printf("operational modes (select only one)\n");
@@ -300,9 +1075,18 @@ int main(int argc, char **argv)
                 printf("  -g (--generate) create random AES256 key\n");
                 printf("       write random key to file specified by -k or --key\n");
                 printf("       WARNING - use key only once or security will be compromised\n");
+                printf("  -b (--benchmark) time every CTR engine on the input file\n");
+                printf("       output goes to -o if given (and is compared between engines), otherwise /dev/null\n");
+                printf("  -e (--xtsencrypt) encrypt sectors of in->out with XTS key\n");
+                printf("  -d (--xtsdecrypt) decrypt sectors of in->out with XTS key\n");
                 printf("examples\n");
                 printf("  aesctr -gk <keyfile>  Generate new key and save to <keyfile>\n");
                 printf("  aesctr -p -i <infile> -o <outfile> -k <keyfile>  Process in->out\n");
+                printf("  aesctr -p -i <plain> -o <cipher> -k <keyfile> --digest in --digestfile <plain>.sha512\n");
+                printf("  aesctr -b -i <infile> -k <keyfile> -t 4  Compare engine throughput on this host\n");
+                printf("  aesctr -e -i <image> -o <image.xts> -k <xtskey> -t 8  Encrypt disk image\n");
+                printf("  aesctr -e -i <new> -o <image.xts> -k <xtskey> --inplace --first 100 --count 8\n");
+                printf("       Re-encrypt sectors 100-107 of an encrypted image from the same offsets in <new>\n");
                 exit(EXIT_SUCCESS);
             }
             break;
@@ -352,7 +1136,20 @@ int main(int argc, char **argv)
                 fprintf(stderr, "aesctr: this function requires that you specify an output file.\n");
                 exit(EXIT_FAILURE);
             }
+            if ((g_digest != DIGEST_NONE) && (g_engine != ENGINE_USER)) {
+                fprintf(stderr, "aesctr: --digest requires the user engine.\n");
+                exit(EXIT_FAILURE);
+            }
+            if ((g_digest != DIGEST_NONE) && g_digestfile_specified) {
+                if ((strcmp(g_digestfile, g_outfile) == 0) || (strcmp(g_digestfile, g_infile) == 0)) {
+                    fprintf(stderr, "aesctr: the digest file must differ from the input and output files.\n");
+                    exit(EXIT_FAILURE);
+                }
+                prepare_digestfile();
+            }
             prepare_outfile();
+            if (g_digest != DIGEST_NONE)
+                printf("aesctr: computing SHA-%d digest of plaintext (%s side)\n", g_digest_bits, (g_digest == DIGEST_IN) ? "input" : "output");
             do_process();
         }
         break;
@@ -367,6 +1164,47 @@ int main(int argc, char **argv)
             printf("aesctr: WARNING - do not use this key more than once or security will be compromised.\n");
         }
         break;
+        case MODE_BENCHMARK:
+        {
+            printf("aesctr: selected benchmark mode.\n");
+            load_key();
+            if (g_infile_specified == 0) {
+                fprintf(stderr, "aesctr: this function requires that you specify an input file.\n");
+                exit(EXIT_FAILURE);
+            }
+            prepare_infile();
+            if (g_outfile_specified)
+                prepare_outfile();
+            g_digest = DIGEST_NONE;
+            do_benchmark();
+        }
+        break;
+        case MODE_XTS_ENCRYPT:
+        case MODE_XTS_DECRYPT:
+        {
+            printf("aesctr: selected XTS %s mode.\n", (g_mode == MODE_XTS_DECRYPT) ? "decrypt" : "encrypt");
+            load_xts_key();
+            if (g_infile_specified == 0) {
+                fprintf(stderr, "aesctr: this function requires that you specify an input file.\n");
+                exit(EXIT_FAILURE);
+            }
+            prepare_infile();
+            if (g_outfile_specified == 0) {
+                fprintf(stderr, "aesctr: this function requires that you specify an output file.\n");
+                exit(EXIT_FAILURE);
+            }
+            // a fresh output image would hold only the chosen sectors and lose everything around them
+            if ((g_inplace == 0) && ((g_first_sector != 0) || (g_count_specified > 0))) {
+                fprintf(stderr, "aesctr: --first and --count update part of an existing image, use them with --inplace.\n");
+                exit(EXIT_FAILURE);
+            }
+            if (g_inplace)
+                prepare_inplace_outfile();
+            else
+                prepare_outfile();
+            do_xts(g_mode == MODE_XTS_DECRYPT);
+        }
+        break;
         default:
         {
             printf("I don't know what to do!\n");
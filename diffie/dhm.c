@@ -108,7 +108,8 @@ const char *dhm_error_string[] = {
 	"value error",
 	"general unspecified error",
 	"unrecognized packet type",
-	"packet hash check failure"
+	"packet hash check failure",
+	"unknown packet hash algorithm"
 }; ///< List of standard DHM error strings correlated to integer DHM error codes.
 
 const uint16_t dhm_alice_packtype = 0xc1a5; ///< Packet type stamp for Alice packet. Stored in the packet in network byte order
@@ -137,6 +138,43 @@ static void right_justify(size_t a_size, size_t a_offset, char *a_buff)
 	}
 }
 
+/**
+ * @brief Computes a packet hash with the selected algorithm
+ * The hash covers everything from the hashalg field to the end of the packet,
+ * so the algorithm identifier itself can't be altered in transit.
+ *
+ * @param[in] a_hashalg Packet hash algorithm, one of dhm_hashalg_t
+ * @param[in] a_data Pointer to the hashalg field of the packet
+ * @param[in] a_size Number of bytes to hash
+ * @param[out] a_digest Buffer of SHASIZE bytes to receive the hash
+ * @return standard DHM error enumeration dhm_error_t
+ */
+
+static dhm_error_t packet_hash(uint8_t a_hashalg, const uint8_t *a_data, size_t a_size, uint8_t *a_digest)
+{
+	switch (a_hashalg) {
+		case DHM_HASH_SHA224:
+			{
+				sha224_ctx l_ctx;
+				sha224_init(&l_ctx);
+				sha224_update(&l_ctx, a_data, a_size);
+				sha224_final(&l_ctx, a_digest);
+			}
+			break;
+		case DHM_HASH_SHA512_224:
+			{
+				sha512_224_ctx l_ctx;
+				sha512_224_init(&l_ctx);
+				sha512_224_update(&l_ctx, a_data, a_size);
+				sha512_224_final(&l_ctx, a_digest);
+			}
+			break;
+		default:
+			return DHM_ERR_HASHALG;
+	}
+	return DHM_ERR_NONE;
+}
+
 /**
  * @brief Returns a char pointer to an existing error string
  * Works in exactly the same way as the strerror(errno) function works in the standard library
@@ -184,6 +222,28 @@ dhm_error_t dhm_init_session(dhm_session_t *a_session, int a_debug)
 		return DHM_ERR_READURANDOM;
 	}
 
+	a_session->hashalg = DHM_HASH_SHA224;
+
+	return DHM_ERR_NONE;
+}
+
+/**
+ * @brief Select the packet hash algorithm
+ * Sets the algorithm the client stamps into its Alice packet. The server
+ * always answers with the algorithm the Alice packet used, so this only
+ * needs to be called on the client side, after dhm_init_session.
+ *
+ * @param[in] a_session Pointer to already-initialized session data structure.
+ * @param[in] a_hashalg Packet hash algorithm, one of dhm_hashalg_t
+ * @return standard DHM error enumeration dhm_error_t
+ */
+
+dhm_error_t dhm_set_hashalg(dhm_session_t *a_session, dhm_hashalg_t a_hashalg)
+{
+	if ((a_hashalg != DHM_HASH_SHA224) && (a_hashalg != DHM_HASH_SHA512_224)) {
+		return DHM_ERR_HASHALG;
+	}
+	a_session->hashalg = a_hashalg;
 	return DHM_ERR_NONE;
 }
 
@@ -228,7 +288,8 @@ dhm_error_t dhm_get_alice(dhm_session_t *a_session, dhm_alice_t *a_alice, dhm_pr
 	// set type
 	a_alice->packtype = htons(dhm_alice_packtype);
 	
-	// copy our session GUID into Alice packet
+	// stamp the hash algorithm and copy our session GUID into Alice packet
+	a_alice->hashalg = a_session->hashalg;
 	memcpy(a_alice->guid, a_session->guid, GUIDSIZE);
 	
 	if (a_debug) {
@@ -330,11 +391,11 @@ dhm_error_t dhm_get_alice(dhm_session_t *a_session, dhm_alice_t *a_alice, dhm_pr
 	// set packet hash
 	size_t l_hstart = sizeof(a_alice->packtype) + SHASIZE;
 	size_t l_hsize = sizeof(dhm_alice_t) - l_hstart;
-	sha224_ctx l_ctx;
-	sha224_init(&l_ctx);
-	// guid is first field after packet type and hash
-	sha224_update(&l_ctx, (const uint8_t *)a_alice->guid, l_hsize);
-	sha224_final(&l_ctx, a_alice->hash);
+	// hashalg is first field after packet type and hash
+	dhm_error_t l_err = packet_hash(a_alice->hashalg, &a_alice->hashalg, l_hsize, a_alice->hash);
+	if (l_err != DHM_ERR_NONE) {
+		return l_err;
+	}
 	if (a_debug) {
 		printf("dhm_get_alice: packet hash: ");
 		for (i = 0; i < SHASIZE; ++i) {
@@ -372,10 +433,10 @@ dhm_error_t dhm_get_bob(dhm_session_t *a_session, dhm_alice_t *a_alice, dhm_bob_
 	uint8_t l_digest[SHASIZE];
 	size_t l_hstart = sizeof(a_alice->packtype) + SHASIZE;
 	size_t l_hsize = sizeof(dhm_alice_t) - l_hstart;
-	sha224_ctx l_ctx;
-	sha224_init(&l_ctx);
-	sha224_update(&l_ctx, (const uint8_t *)a_alice->guid, l_hsize);
-	sha224_final(&l_ctx, l_digest);
+	dhm_error_t l_err = packet_hash(a_alice->hashalg, &a_alice->hashalg, l_hsize, l_digest);
+	if (l_err != DHM_ERR_NONE) {
+		return l_err;
+	}
 	if (memcmp(l_digest, a_alice->hash, SHASIZE) != 0) {
 		return DHM_ERR_HASH_FAILURE;
 	}
@@ -395,6 +456,8 @@ dhm_error_t dhm_get_bob(dhm_session_t *a_session, dhm_alice_t *a_alice, dhm_bob_
 	
 	// copy our session GUID from Alice packet into Bob packet AND set as session GUID
 	memcpy(a_session->guid, a_alice->guid, GUIDSIZE);
+	a_session->hashalg = a_alice->hashalg;
+	a_bob->hashalg = a_alice->hashalg; // answer with the client's hash algorithm
 	memcpy(a_bob->guid, a_alice->guid, GUIDSIZE);
 	
 	if (a_debug) {
@@ -474,11 +537,11 @@ dhm_error_t dhm_get_bob(dhm_session_t *a_session, dhm_alice_t *a_alice, dhm_bob_
 	// set packet hash
 	l_hstart = sizeof(a_bob->packtype) + SHASIZE;
 	l_hsize = sizeof(dhm_bob_t) - l_hstart;
-	sha224_ctx l_ctx_b;
-	sha224_init(&l_ctx_b);
-	// guid is first field after packet type and hash
-	sha224_update(&l_ctx_b, (const uint8_t *)a_bob->guid, l_hsize);
-	sha224_final(&l_ctx_b, a_bob->hash);
+	// hashalg is first field after packet type and hash
+	l_err = packet_hash(a_bob->hashalg, &a_bob->hashalg, l_hsize, a_bob->hash);
+	if (l_err != DHM_ERR_NONE) {
+		return l_err;
+	}
 	if (a_debug) {
 		printf("dhm_get_bob: packet hash: ");
 		for (i = 0; i < SHASIZE; ++i) {
@@ -512,10 +575,14 @@ dhm_error_t dhm_alice_secret (dhm_session_t *a_session, dhm_alice_t *a_alice, dh
 	uint8_t l_digest[SHASIZE];
 	size_t l_hstart = sizeof(a_bob->packtype) + SHASIZE;
 	size_t l_hsize = sizeof(dhm_bob_t) - l_hstart;
-	sha224_ctx l_ctx;
-	sha224_init(&l_ctx);
-	sha224_update(&l_ctx, (const uint8_t *)a_bob->guid, l_hsize);
-	sha224_final(&l_ctx, l_digest);
+	// the server must answer with the algorithm we asked for
+	if (a_bob->hashalg != a_alice->hashalg) {
+		return DHM_ERR_HASHALG;
+	}
+	dhm_error_t l_err = packet_hash(a_bob->hashalg, &a_bob->hashalg, l_hsize, l_digest);
+	if (l_err != DHM_ERR_NONE) {
+		return l_err;
+	}
 	if (memcmp(l_digest, a_bob->hash, SHASIZE) != 0) {
 		return DHM_ERR_HASH_FAILURE;
 	}
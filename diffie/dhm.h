@@ -105,8 +105,6 @@
 extern "C" {
 #endif
 
-#pragma pack(1)
-
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
@@ -118,13 +116,29 @@ extern "C" {
 
 #include "sha2.h"
 
+// packets go on the wire as-is, so pack them; pushed after the includes so
+// system and sha2 structures keep their normal layout in every file
+#pragma pack(push, 1)
+
 #define PUBBITS 2176 ///< bit width of public modulus
 #define PUBSIZE 272 ///< size of public modulus in bytes
 #define PRIVBITS 368 ///< bit width of private exponent(s)
 #define PRIVSIZE 46 ///< size of private exponent(s) in bytes
 
 #define GUIDSIZE 12 ///< size of unique session ID token
-#define SHASIZE 28 ///< size of a SHA2-224 hash
+#define SHASIZE 28 ///< size of a packet hash, SHA2-224 and SHA2-512/224 are both 28 bytes
+
+/**
+ * @enum dhm_hashalg_t
+ * @brief Packet hash algorithm identifiers, stamped into the hashalg field of Alice and Bob packets.
+ * Both algorithms produce a SHASIZE digest. SHA2-512/224 runs on the 64 bit SHA2-512 core and is
+ * the faster choice on 64 bit machines; SHA2-224 is the default.
+ */
+
+typedef enum {
+	DHM_HASH_SHA224 = 1, ///< SHA2-224, built on the 32 bit SHA2-256 core
+	DHM_HASH_SHA512_224 = 2 ///< SHA2-512/224, built on the 64 bit SHA2-512 core
+} dhm_hashalg_t;
 
 /**
  * @struct dhm_session_t
@@ -137,6 +151,7 @@ typedef struct {
 	int urandom_fd; ///< File descriptor of open /dev/urandom device, used for reading cryptographically random bytes
 	uint8_t guid[GUIDSIZE]; ///< Unique global user identification used to identify the session, this gets stamped into packets
 	uint8_t s[PUBSIZE]; ///< Space for the computed secret, after "Alice" and "Bob" have exchanged packets
+	uint8_t hashalg; ///< Packet hash algorithm (dhm_hashalg_t) used for Alice packets, set with dhm_set_hashalg
 } dhm_session_t;
 
 /**
@@ -147,6 +162,7 @@ typedef struct {
 typedef struct {
 	uint16_t packtype; ///< Packet type stamp, so receiver can identify this as an Alice packet
 	uint8_t hash[SHASIZE]; ///< SHA2 hash of everything subsequent to this field
+	uint8_t hashalg; ///< Algorithm used for the hash field (dhm_hashalg_t), chosen by the client
 	uint8_t guid[GUIDSIZE]; ///< GUID, copied from the GUID established in dhm_session_t
 	uint16_t g; ///< Generator primitive, randomly chosen to be either 3 or 5
 	uint8_t p[PUBSIZE]; ///< Public key, which is a gigantic prime number
@@ -161,6 +177,7 @@ typedef struct {
 typedef struct {
 	uint16_t packtype; ///< Packet typ stamp, so receiver can identify this as a Bob packet
 	uint8_t hash[SHASIZE]; ///< SHA2 hash of everything subsequent to this field
+	uint8_t hashalg; ///< Algorithm used for the hash field, always the one the Alice packet used
 	uint8_t guid[GUIDSIZE]; ///< GUID, copied from the Alice packet received previously
 	uint8_t B[PUBSIZE]; ///< Result of modular exponentiation of generator with private exponent and public modulus
 } dhm_bob_t;
@@ -188,16 +205,20 @@ typedef enum {
 	DHM_ERR_VALUE, ///< Generic value error
 	DHM_ERR_GENERAL, ///< General unspecified error
 	DHM_ERR_WRONG_PACKTYPE, ///< Received an unexpected packet type
-	DHM_ERR_HASH_FAILURE ///< Hash mismatch error
+	DHM_ERR_HASH_FAILURE, ///< Hash mismatch error
+	DHM_ERR_HASHALG ///< Unknown or mismatched packet hash algorithm
 } dhm_error_t;
 
 const char *dhm_strerror     (dhm_error_t a_errno);
 dhm_error_t dhm_init_session (dhm_session_t *a_session, int a_debug);
 dhm_error_t dhm_end_session  (dhm_session_t *a_session, int a_debug);
+dhm_error_t dhm_set_hashalg  (dhm_session_t *a_session, dhm_hashalg_t a_hashalg);
 dhm_error_t dhm_get_alice    (dhm_session_t *a_session, dhm_alice_t *a_alice, dhm_private_t *a_alice_private, int a_debug);
 dhm_error_t dhm_get_bob      (dhm_session_t *a_session, dhm_alice_t *a_alice, dhm_bob_t *a_bob, dhm_private_t *a_bob_private, int a_debug);
 dhm_error_t dhm_alice_secret (dhm_session_t *a_session, dhm_alice_t *a_alice, dhm_bob_t *a_bob, dhm_private_t *a_alice_private, int a_debug);
 
+#pragma pack(pop)
+
 #ifdef __cplusplus
 }
 #endif
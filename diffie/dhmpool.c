@@ -0,0 +1,250 @@
+/**
+ *
+ * Diffie/Hellman/Merkle Implementation
+ * 2025/Nov/11 - Revision 0.80 alpha
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file dhmpool.c
+ * @brief Client-side pool of pre-established secure channels
+ *
+ * See dhmpool.h for an overview.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "dhmpool.h"
+
+static void deadline_after(struct timespec *a_ts, int a_ms)
+{
+	clock_gettime(CLOCK_REALTIME, a_ts);
+	a_ts->tv_sec += a_ms / 1000;
+	a_ts->tv_nsec += (long)(a_ms % 1000) * 1000000;
+	if (a_ts->tv_nsec >= 1000000000) {
+		a_ts->tv_sec++;
+		a_ts->tv_nsec -= 1000000000;
+	}
+}
+
+/**
+ * @brief Filler thread: keeps the pool topped up to its target size
+ * Each pass reserves one slot under the lock, does the connect and DHM
+ * exchange without holding it, then publishes the channel as idle.
+ */
+
+static void *filler_tf(void *a_arg)
+{
+	dhmpool_t *l_pool = (dhmpool_t *)a_arg;
+	struct timespec l_ts;
+
+	pthread_mutex_lock(&l_pool->lock);
+	while (!l_pool->stop) {
+		if (l_pool->open >= l_pool->size) {
+			pthread_cond_wait(&l_pool->need, &l_pool->lock);
+			continue;
+		}
+		l_pool->open++; // reserve the slot so other fillers don't overshoot
+		pthread_mutex_unlock(&l_pool->lock);
+
+		outer_channel_t *l_chan = malloc(sizeof(outer_channel_t));
+		int res = -1;
+		if (l_chan != NULL)
+			res = outer_client_open(l_chan, l_pool->host, l_pool->port, l_pool->hashalg, l_pool->debug);
+
+		pthread_mutex_lock(&l_pool->lock);
+		if (res == 0) {
+			l_pool->idle[l_pool->idle_count++] = l_chan;
+			l_pool->stats.handshakes++;
+			pthread_cond_signal(&l_pool->available);
+		} else {
+			free(l_chan);
+			l_pool->open--;
+			l_pool->stats.failures++;
+			// server down or refusing: back off instead of spinning, but wake early on destroy
+			deadline_after(&l_ts, DHMPOOL_RETRY_MS);
+			if (!l_pool->stop)
+				pthread_cond_timedwait(&l_pool->need, &l_pool->lock, &l_ts);
+		}
+	}
+	pthread_mutex_unlock(&l_pool->lock);
+	return NULL;
+}
+
+/**
+ * @brief Create a pool and start filling it in the background
+ *
+ * @param[in] a_pool Pool structure. It is the responsibility of the caller to allocate memory for this structure.
+ * @param[in] a_host Server address in dotted IP format
+ * @param[in] a_port Server port
+ * @param[in] a_size Number of channels to keep open, 1 to DHMPOOL_MAXSIZE
+ * @param[in] a_hashalg DHM packet hash algorithm for the handshakes
+ * @param[in] a_debug Set this flag to 1 if you want to print debugging information.
+ * @return 0 on success, -1 on bad arguments or if no filler thread could be started
+ */
+
+int dhmpool_init(dhmpool_t *a_pool, const char *a_host, uint16_t a_port, int a_size, dhm_hashalg_t a_hashalg, int a_debug)
+{
+	int i;
+
+	if ((a_size < 1) || (a_size > DHMPOOL_MAXSIZE) || (strlen(a_host) >= sizeof(a_pool->host)))
+		return -1;
+	memset(a_pool, 0, sizeof(dhmpool_t));
+	strcpy(a_pool->host, a_host);
+	a_pool->port = a_port;
+	a_pool->hashalg = a_hashalg;
+	a_pool->debug = a_debug;
+	a_pool->size = a_size;
+	pthread_mutex_init(&a_pool->lock, NULL);
+	pthread_cond_init(&a_pool->available, NULL);
+	pthread_cond_init(&a_pool->need, NULL);
+
+	int l_fillers = (a_size < DHMPOOL_MAXFILLERS) ? a_size : DHMPOOL_MAXFILLERS;
+	for (i = 0; i < l_fillers; ++i) {
+		if (pthread_create(&a_pool->fillers[a_pool->filler_count], NULL, filler_tf, a_pool) != 0) {
+			fprintf(stderr, "dhmpool_init: can't create filler thread: %s\n", strerror(errno));
+			break;
+		}
+		a_pool->filler_count++;
+	}
+	if (a_pool->filler_count == 0) {
+		pthread_mutex_destroy(&a_pool->lock);
+		pthread_cond_destroy(&a_pool->available);
+		pthread_cond_destroy(&a_pool->need);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Borrow a ready channel
+ *
+ * @param[in] a_pool Pool to borrow from
+ * @param[in] a_timeout_ms How long to wait for a channel if none is idle, -1 to wait forever
+ * @return a keyed channel, or NULL on timeout or if the pool is being destroyed
+ */
+
+outer_channel_t *dhmpool_acquire(dhmpool_t *a_pool, int a_timeout_ms)
+{
+	outer_channel_t *l_chan = NULL;
+	struct timespec l_ts;
+	int res = 0;
+
+	if (a_timeout_ms >= 0)
+		deadline_after(&l_ts, a_timeout_ms);
+	pthread_mutex_lock(&a_pool->lock);
+	if (a_pool->idle_count == 0)
+		a_pool->stats.waits++;
+	while ((a_pool->idle_count == 0) && (!a_pool->stop) && (res != ETIMEDOUT)) {
+		if (a_timeout_ms >= 0)
+			res = pthread_cond_timedwait(&a_pool->available, &a_pool->lock, &l_ts);
+		else
+			pthread_cond_wait(&a_pool->available, &a_pool->lock);
+	}
+	if ((a_pool->idle_count > 0) && (!a_pool->stop)) {
+		l_chan = a_pool->idle[--a_pool->idle_count];
+		a_pool->stats.acquires++;
+	} else {
+		a_pool->stats.timeouts++;
+	}
+	pthread_mutex_unlock(&a_pool->lock);
+	return l_chan;
+}
+
+/**
+ * @brief Return a borrowed channel
+ *
+ * @param[in] a_pool Pool the channel came from
+ * @param[in] a_chan Channel from dhmpool_acquire
+ * @param[in] a_broken Set to 1 if the channel saw an error; it is closed and replaced
+ */
+
+void dhmpool_release(dhmpool_t *a_pool, outer_channel_t *a_chan, int a_broken)
+{
+	pthread_mutex_lock(&a_pool->lock);
+	if (a_broken || a_pool->stop) {
+		if (a_broken)
+			a_pool->stats.broken++;
+		a_pool->open--;
+		pthread_cond_signal(&a_pool->need);
+		pthread_mutex_unlock(&a_pool->lock);
+		outer_channel_close(a_chan);
+		free(a_chan);
+		return;
+	}
+	a_pool->idle[a_pool->idle_count++] = a_chan;
+	pthread_cond_signal(&a_pool->available);
+	pthread_mutex_unlock(&a_pool->lock);
+}
+
+/**
+ * @brief Snapshot the pool's counters
+ *
+ * @param[in] a_pool Pool to query
+ * @param[out] a_stats Receives the counters
+ * @param[out] a_idle Receives the number of idle channels, may be NULL
+ * @param[out] a_open Receives the number of open or opening channels, may be NULL
+ */
+
+void dhmpool_get_stats(dhmpool_t *a_pool, dhmpool_stats_t *a_stats, int *a_idle, int *a_open)
+{
+	pthread_mutex_lock(&a_pool->lock);
+	memcpy(a_stats, &a_pool->stats, sizeof(dhmpool_stats_t));
+	if (a_idle != NULL)
+		*a_idle = a_pool->idle_count;
+	if (a_open != NULL)
+		*a_open = a_pool->open;
+	pthread_mutex_unlock(&a_pool->lock);
+}
+
+/**
+ * @brief Stop the fillers and close every idle channel
+ * All borrowed channels should be released first.
+ *
+ * @param[in] a_pool Pool to tear down. It is the responsibility of the caller to free memory for this structure.
+ */
+
+void dhmpool_destroy(dhmpool_t *a_pool)
+{
+	int i;
+
+	pthread_mutex_lock(&a_pool->lock);
+	a_pool->stop = 1;
+	pthread_cond_broadcast(&a_pool->need);
+	pthread_cond_broadcast(&a_pool->available);
+	pthread_mutex_unlock(&a_pool->lock);
+	for (i = 0; i < a_pool->filler_count; ++i)
+		pthread_join(a_pool->fillers[i], NULL);
+	for (i = 0; i < a_pool->idle_count; ++i) {
+		outer_channel_close(a_pool->idle[i]);
+		free(a_pool->idle[i]);
+	}
+	a_pool->idle_count = 0;
+	pthread_mutex_destroy(&a_pool->lock);
+	pthread_cond_destroy(&a_pool->available);
+	pthread_cond_destroy(&a_pool->need);
+}
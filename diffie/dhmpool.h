@@ -0,0 +1,117 @@
+/**
+ *
+ * Diffie/Hellman/Merkle Implementation
+ * 2025/Nov/11 - Revision 0.80 alpha
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file dhmpool.h
+ * @brief Client-side pool of pre-established secure channels
+ *
+ * A request-heavy client should not pay connect + Alice/Bob + teardown on
+ * every call. A dhmpool_t keeps up to a fixed number of keyed channels open
+ * to one server. Background filler threads do the connects and handshakes;
+ * callers just borrow a ready channel with dhmpool_acquire, send a request
+ * with outer_write_aes, read the reply, and hand the channel back with
+ * dhmpool_release. The CTR offsets and MAC counters simply keep going on
+ * the next request, so a pooled request costs one network round trip.
+ *
+ * A channel that saw an error must be released with a_broken set; it is
+ * closed and a filler replaces it.
+ *
+ * Usage:
+ *
+ * dhmpool_t l_pool;
+ * dhmpool_init(&l_pool, "127.0.0.1", 9734, 4, DHM_HASH_SHA224, 0);
+ * outer_channel_t *l_chan = dhmpool_acquire(&l_pool, 5000);
+ * ... outer_write_aes / outer_read_packet / outer_open_aes on l_chan ...
+ * dhmpool_release(&l_pool, l_chan, 0);
+ * dhmpool_destroy(&l_pool);
+ *
+ * Link with -lpthread.
+ */
+
+#ifndef DHMPOOL_H
+#define DHMPOOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+
+#include "outer.h"
+
+#define DHMPOOL_MAXSIZE 256 ///< largest number of channels a pool will hold open
+#define DHMPOOL_MAXFILLERS 4 ///< most background handshakes a pool runs at once
+#define DHMPOOL_RETRY_MS 1000 ///< how long a filler backs off after a failed connect or handshake
+
+/**
+ * @struct dhmpool_stats_t
+ * @brief Counters kept by the pool, read with dhmpool_get_stats.
+ */
+
+typedef struct {
+	uint64_t handshakes; ///< channels successfully opened
+	uint64_t failures; ///< connects or handshakes that failed
+	uint64_t acquires; ///< channels handed out
+	uint64_t waits; ///< acquires that had to wait for a filler
+	uint64_t timeouts; ///< acquires that gave up
+	uint64_t broken; ///< channels released as broken and replaced
+} dhmpool_stats_t;
+
+/**
+ * @struct dhmpool_t
+ * @brief A pool of keyed channels to one server. Treat as opaque.
+ */
+
+typedef struct {
+	char host[64]; ///< server address in dotted IP format
+	uint16_t port;
+	dhm_hashalg_t hashalg;
+	int debug;
+	int size; ///< number of channels to keep open
+	int open; ///< channels idle, borrowed, or being opened by a filler
+	int idle_count;
+	outer_channel_t *idle[DHMPOOL_MAXSIZE]; ///< ready channels, used as a stack so the warmest goes out first
+	int stop; ///< set by dhmpool_destroy
+	int filler_count;
+	pthread_t fillers[DHMPOOL_MAXFILLERS];
+	pthread_mutex_t lock;
+	pthread_cond_t available; ///< signalled when a channel goes idle
+	pthread_cond_t need; ///< signalled when the pool drops below size
+	dhmpool_stats_t stats;
+} dhmpool_t;
+
+int              dhmpool_init      (dhmpool_t *a_pool, const char *a_host, uint16_t a_port, int a_size, dhm_hashalg_t a_hashalg, int a_debug);
+outer_channel_t *dhmpool_acquire   (dhmpool_t *a_pool, int a_timeout_ms);
+void             dhmpool_release   (dhmpool_t *a_pool, outer_channel_t *a_chan, int a_broken);
+void             dhmpool_get_stats (dhmpool_t *a_pool, dhmpool_stats_t *a_stats, int *a_idle, int *a_open);
+void             dhmpool_destroy   (dhmpool_t *a_pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DHMPOOL_H
@@ -0,0 +1,260 @@
+/**
+ *
+ * Diffie/Hellman/Merkle Implementation
+ * 2025/Nov/11 - Revision 0.80 alpha
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file hsqueue.c
+ * @brief Bounded queue of server-side DHM exchanges with admission control
+ *
+ * See hsqueue.h for an overview.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "hsqueue.h"
+
+#define AVG_WEIGHT 0.125 ///< weight of the newest sample in the moving average of exchange times
+
+/**
+ * @brief Hand a finished job back, by callback or by waking its waiter
+ */
+
+static void job_finish(hsqueue_t *a_queue, hsqueue_job_t *a_job)
+{
+	if (a_job->complete != NULL) {
+		a_job->complete(a_job);
+		return;
+	}
+	pthread_mutex_lock(&a_queue->lock);
+	a_job->done = 1;
+	pthread_cond_signal(a_job->finished);
+	pthread_mutex_unlock(&a_queue->lock);
+}
+
+static void *worker_tf(void *a_arg)
+{
+	hsqueue_t *l_queue = (hsqueue_t *)a_arg;
+	struct timespec l_start, l_end;
+	hsqueue_job_t *l_job;
+
+	pthread_mutex_lock(&l_queue->lock);
+	while (1) {
+		while ((l_queue->head == NULL) && (!l_queue->stop))
+			pthread_cond_wait(&l_queue->work, &l_queue->lock);
+		if (l_queue->stop)
+			break;
+		l_job = l_queue->head;
+		l_queue->head = l_job->next;
+		if (l_queue->head == NULL)
+			l_queue->tail = NULL;
+		l_queue->stats.depth--;
+		l_queue->running++;
+		pthread_mutex_unlock(&l_queue->lock);
+
+		clock_gettime(CLOCK_MONOTONIC, &l_start);
+		l_job->result = (outer_server_bob(l_job->chan, &l_job->alice, &l_job->bob, l_queue->debug) == 0) ? HSQUEUE_OK : HSQUEUE_FAILED;
+		clock_gettime(CLOCK_MONOTONIC, &l_end);
+		double l_ms = (l_end.tv_sec - l_start.tv_sec) * 1000.0 + (l_end.tv_nsec - l_start.tv_nsec) / 1000000.0;
+
+		pthread_mutex_lock(&l_queue->lock);
+		l_queue->running--;
+		if (l_job->result == HSQUEUE_OK)
+			l_queue->stats.completed++;
+		else
+			l_queue->stats.failed++;
+		l_queue->avg_ms = (l_queue->avg_ms == 0) ? l_ms : (l_queue->avg_ms + AVG_WEIGHT * (l_ms - l_queue->avg_ms));
+		pthread_mutex_unlock(&l_queue->lock);
+		job_finish(l_queue, l_job);
+		pthread_mutex_lock(&l_queue->lock);
+	}
+	pthread_mutex_unlock(&l_queue->lock);
+	return NULL;
+}
+
+/**
+ * @brief Create a queue and start its workers
+ *
+ * @param[in] a_queue Queue structure. It is the responsibility of the caller to allocate memory for this structure.
+ * @param[in] a_workers Number of worker threads, 1 to HSQUEUE_MAXWORKERS; about one per core is right
+ * @param[in] a_hwm High-water mark: how many exchanges may wait for a busy worker before new ones are turned away, 0 for none
+ * @param[in] a_debug Set this flag to 1 if you want to print debugging information.
+ * @return 0 on success, -1 on bad arguments or if no worker could be started
+ */
+
+int hsqueue_init(hsqueue_t *a_queue, int a_workers, int a_hwm, int a_debug)
+{
+	int i;
+
+	if ((a_workers < 1) || (a_workers > HSQUEUE_MAXWORKERS) || (a_hwm < 0))
+		return -1;
+	memset(a_queue, 0, sizeof(hsqueue_t));
+	a_queue->hwm = a_hwm;
+	a_queue->debug = a_debug;
+	pthread_mutex_init(&a_queue->lock, NULL);
+	pthread_cond_init(&a_queue->work, NULL);
+	for (i = 0; i < a_workers; ++i) {
+		if (pthread_create(&a_queue->threads[a_queue->workers], NULL, worker_tf, a_queue) != 0) {
+			fprintf(stderr, "hsqueue_init: can't create worker thread: %s\n", strerror(errno));
+			break;
+		}
+		a_queue->workers++;
+	}
+	if (a_queue->workers == 0) {
+		pthread_mutex_destroy(&a_queue->lock);
+		pthread_cond_destroy(&a_queue->work);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Queue an exchange, or turn it away if the queue is at its high-water mark
+ *
+ * @param[in] a_queue Queue to submit to
+ * @param[in] a_job Job with alice, chan, complete and arg filled in. Must stay valid until complete is called.
+ * @param[out] a_retry_ms If turned away, receives how long the client should wait before trying again
+ * @return HSQUEUE_OK if queued, HSQUEUE_BUSY if turned away, HSQUEUE_FAILED if the queue is shutting down
+ */
+
+int hsqueue_submit(hsqueue_t *a_queue, hsqueue_job_t *a_job, unsigned int *a_retry_ms)
+{
+	pthread_mutex_lock(&a_queue->lock);
+	if (a_queue->stop) {
+		pthread_mutex_unlock(&a_queue->lock);
+		return HSQUEUE_FAILED;
+	}
+	if (a_queue->stats.depth + a_queue->running >= a_queue->workers + a_queue->hwm) {
+		// about how long until the workers have worked through enough of the queue for a new job to get in
+		double l_ms = ((a_queue->stats.depth + a_queue->running - a_queue->workers - a_queue->hwm) / a_queue->workers + 1) * a_queue->avg_ms;
+		if (l_ms < HSQUEUE_MIN_RETRY_MS)
+			l_ms = HSQUEUE_MIN_RETRY_MS;
+		if (l_ms > HSQUEUE_MAX_RETRY_MS)
+			l_ms = HSQUEUE_MAX_RETRY_MS;
+		*a_retry_ms = (unsigned int)l_ms;
+		a_queue->stats.rejected++;
+		pthread_mutex_unlock(&a_queue->lock);
+		return HSQUEUE_BUSY;
+	}
+	a_job->next = NULL;
+	a_job->done = 0;
+	if (a_queue->tail != NULL)
+		a_queue->tail->next = a_job;
+	else
+		a_queue->head = a_job;
+	a_queue->tail = a_job;
+	a_queue->stats.submitted++;
+	if (++a_queue->stats.depth > a_queue->stats.peak_depth)
+		a_queue->stats.peak_depth = a_queue->stats.depth;
+	pthread_cond_signal(&a_queue->work);
+	pthread_mutex_unlock(&a_queue->lock);
+	return HSQUEUE_OK;
+}
+
+/**
+ * @brief Run an exchange on a worker and wait for it
+ *
+ * @param[in] a_queue Queue to submit to
+ * @param[in] a_chan Channel to key
+ * @param[in] a_alice Received Alice packet
+ * @param[out] a_bob Receives the Bob packet to send back
+ * @param[out] a_retry_ms If turned away, receives how long the client should wait before trying again
+ * @return HSQUEUE_OK, HSQUEUE_BUSY, or HSQUEUE_FAILED
+ */
+
+int hsqueue_run(hsqueue_t *a_queue, outer_channel_t *a_chan, const dhm_alice_t *a_alice, dhm_bob_t *a_bob, unsigned int *a_retry_ms)
+{
+	hsqueue_job_t l_job;
+	pthread_cond_t l_finished;
+	int res;
+
+	memset(&l_job, 0, sizeof(hsqueue_job_t));
+	memcpy(&l_job.alice, a_alice, sizeof(dhm_alice_t));
+	l_job.chan = a_chan;
+	pthread_cond_init(&l_finished, NULL);
+	l_job.finished = &l_finished;
+	res = hsqueue_submit(a_queue, &l_job, a_retry_ms);
+	if (res == HSQUEUE_OK) {
+		pthread_mutex_lock(&a_queue->lock);
+		while (!l_job.done)
+			pthread_cond_wait(&l_finished, &a_queue->lock);
+		pthread_mutex_unlock(&a_queue->lock);
+		res = l_job.result;
+		if (res == HSQUEUE_OK)
+			memcpy(a_bob, &l_job.bob, sizeof(dhm_bob_t));
+	}
+	pthread_cond_destroy(&l_finished);
+	memset(&l_job.alice, 0, sizeof(dhm_alice_t));
+	return res;
+}
+
+/**
+ * @brief Snapshot the queue's counters
+ *
+ * @param[in] a_queue Queue to query
+ * @param[out] a_stats Receives the counters
+ */
+
+void hsqueue_get_stats(hsqueue_t *a_queue, hsqueue_stats_t *a_stats)
+{
+	pthread_mutex_lock(&a_queue->lock);
+	memcpy(a_stats, &a_queue->stats, sizeof(hsqueue_stats_t));
+	a_stats->avg_ms = (unsigned int)(a_queue->avg_ms + 0.5);
+	pthread_mutex_unlock(&a_queue->lock);
+}
+
+/**
+ * @brief Stop the workers; jobs still waiting finish as HSQUEUE_FAILED
+ * Callers blocked in hsqueue_run must not outlive the queue, so only
+ * destroy it once nothing else can submit.
+ *
+ * @param[in] a_queue Queue to tear down. It is the responsibility of the caller to free memory for this structure.
+ */
+
+void hsqueue_destroy(hsqueue_t *a_queue)
+{
+	hsqueue_job_t *l_job;
+	int i;
+
+	pthread_mutex_lock(&a_queue->lock);
+	a_queue->stop = 1;
+	pthread_cond_broadcast(&a_queue->work);
+	pthread_mutex_unlock(&a_queue->lock);
+	for (i = 0; i < a_queue->workers; ++i)
+		pthread_join(a_queue->threads[i], NULL);
+	while ((l_job = a_queue->head) != NULL) {
+		a_queue->head = l_job->next;
+		a_queue->stats.depth--;
+		l_job->result = HSQUEUE_FAILED;
+		job_finish(a_queue, l_job);
+	}
+	a_queue->tail = NULL;
+	pthread_mutex_destroy(&a_queue->lock);
+	pthread_cond_destroy(&a_queue->work);
+}
@@ -0,0 +1,132 @@
+/**
+ *
+ * Diffie/Hellman/Merkle Implementation
+ * 2025/Nov/11 - Revision 0.80 alpha
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file hsqueue.h
+ * @brief Bounded queue of server-side DHM exchanges with admission control
+ *
+ * Working out a Bob packet is by far the most expensive thing the server
+ * does. Rather than let every connection run its own exponentiations, and
+ * slow every one of them down when too many arrive at once, the server hands
+ * Alice packets to a small, fixed set of worker threads through a queue.
+ *
+ * The queue has a high-water mark. A handshake that would go over it is
+ * turned away at once with a hint of how long to wait, worked out from how
+ * many are queued ahead and how long recent handshakes have taken; the
+ * server passes this on to the client in a busy packet. Clients that get in
+ * are served at full speed, and the ones that don't find out right away
+ * instead of waiting in a queue that may never drain.
+ *
+ * hsqueue_run queues an exchange and waits for it, for callers with a thread
+ * to spare; hsqueue_submit queues one and calls back from the worker when it
+ * is done, for callers that can't block.
+ *
+ * Link with -lpthread.
+ */
+
+#ifndef HSQUEUE_H
+#define HSQUEUE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+
+#include "outer.h"
+
+#define HSQUEUE_MAXWORKERS 64 ///< most worker threads a queue will run
+#define HSQUEUE_MIN_RETRY_MS 50 ///< shortest retry delay handed out
+#define HSQUEUE_MAX_RETRY_MS 5000 ///< longest retry delay handed out
+
+#define HSQUEUE_OK 0 ///< channel keyed, Bob packet ready
+#define HSQUEUE_FAILED -1 ///< the exchange itself failed
+#define HSQUEUE_BUSY 1 ///< turned away at the high-water mark, nothing was done
+
+/**
+ * @struct hsqueue_job_t
+ * @brief One exchange to perform. Callers fill in alice, chan and, for hsqueue_submit, complete and arg.
+ */
+
+typedef struct hsqueue_job_s {
+	struct hsqueue_job_s *next;
+	dhm_alice_t alice; ///< Alice packet, copied so the caller's buffer can be reused
+	outer_channel_t *chan; ///< channel the worker keys
+	dhm_bob_t bob; ///< filled in by the worker
+	int result; ///< HSQUEUE_OK or HSQUEUE_FAILED once done
+	void (*complete)(struct hsqueue_job_s *a_job); ///< called on the worker thread when done, NULL for hsqueue_run
+	void *arg; ///< for the caller's use
+	int done; ///< set under the queue lock by the worker, for hsqueue_run
+	pthread_cond_t *finished; ///< signalled with done, for hsqueue_run
+} hsqueue_job_t;
+
+/**
+ * @struct hsqueue_stats_t
+ * @brief Counters kept by the queue, read with hsqueue_get_stats.
+ */
+
+typedef struct {
+	uint64_t submitted; ///< exchanges let in
+	uint64_t completed; ///< exchanges that produced a Bob packet
+	uint64_t failed; ///< exchanges that didn't
+	uint64_t rejected; ///< exchanges turned away at the high-water mark
+	int depth; ///< exchanges waiting for a worker right now
+	int peak_depth; ///< most exchanges ever waiting at once
+	unsigned int avg_ms; ///< recent average time for one exchange
+} hsqueue_stats_t;
+
+/**
+ * @struct hsqueue_t
+ * @brief A handshake queue and its workers. Treat as opaque.
+ */
+
+typedef struct {
+	int workers;
+	int hwm; ///< exchanges allowed to wait while every worker is busy; one more is turned away
+	int running; ///< exchanges a worker is on right now
+	int debug;
+	int stop; ///< set by hsqueue_destroy
+	hsqueue_job_t *head;
+	hsqueue_job_t *tail;
+	double avg_ms; ///< moving average of exchange times
+	pthread_t threads[HSQUEUE_MAXWORKERS];
+	pthread_mutex_t lock;
+	pthread_cond_t work; ///< signalled when a job is queued
+	hsqueue_stats_t stats;
+} hsqueue_t;
+
+int  hsqueue_init      (hsqueue_t *a_queue, int a_workers, int a_hwm, int a_debug);
+int  hsqueue_submit    (hsqueue_t *a_queue, hsqueue_job_t *a_job, unsigned int *a_retry_ms);
+int  hsqueue_run       (hsqueue_t *a_queue, outer_channel_t *a_chan, const dhm_alice_t *a_alice, dhm_bob_t *a_bob, unsigned int *a_retry_ms);
+void hsqueue_get_stats (hsqueue_t *a_queue, hsqueue_stats_t *a_stats);
+void hsqueue_destroy   (hsqueue_t *a_queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HSQUEUE_H
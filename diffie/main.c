@@ -51,33 +51,29 @@
 #include <errno.h>
 #include <stdint.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
-
-#pragma pack(1)
+#include <sys/time.h>
+#include <poll.h>
+#include <time.h>
 
 #include "dhm.h"
 #include "aes.h"
+#include "outer.h"
+#include "dhmpool.h"
+#include "timerwheel.h"
+#include "hsqueue.h"
 
 #define BUFFLEN 1024
-
-/* outer protocol stuff */
-
-const uint16_t outer_current_version = 0x0101;
-const uint16_t outer_packtype_dieplease = 0xd4d2; // request the server terminate
-const uint16_t outer_packtype_textecho = 0xd4d3;
-const uint16_t outer_packtype_alice = 0xd4d4; // packet contains an Alice packet
-const uint16_t outer_packtype_bob = 0xd4d5; // packet contains a Bob packet
-const uint16_t outer_packtype_aes = 0xd4d6; // packet contains AES256/CTR encrypted data
-
-typedef struct {
-	uint16_t version;
-	uint16_t packtype;
-	uint16_t size; // size of payload
-	uint32_t sequence; // monotonically incrementing packet counter
-} outer_packet_header_t;
+#define SERVER_TICK_MS 10 // server: resolution of connection deadlines
+#define UDP_MAXPAYLOAD (GUIDSIZE + BUFFLEN + 128 + OUTER_MACSIZE) // largest datagram payload either end sends in UDP mode
+#define UDP_RTO_MS 500 // UDP client: first retransmission timeout, doubled on every retry
+#define UDP_TRIES 5 // UDP client: transmissions before giving up on a request
+#define UDP_SESSIONS 1024 // UDP server: slots in the GUID keyed session cache, a power of 2
+#define UDP_SESSION_TTL 60 // UDP server: seconds an idle session is protected from eviction
 
 /* getopt */
 
@@ -91,6 +87,17 @@ struct option g_options[] = {
 	{ "greeting", required_argument, NULL, 'g' },
 	{ "reqsd", no_argument, NULL, 'x' },
 	{ "encrypt", no_argument, NULL, 'e' },
+	{ "hash", required_argument, NULL, 'a' },
+	{ "udp", no_argument, NULL, 'u' },
+	{ "shm", no_argument, NULL, 'm' },
+	{ "hstimeout", required_argument, NULL, 't' },
+	{ "idle", required_argument, NULL, 'i' },
+	{ "cookie", no_argument, NULL, 'y' },
+	{ "workers", required_argument, NULL, 'w' },
+	{ "hwm", required_argument, NULL, 'q' },
+	{ "pool", required_argument, NULL, 'l' },
+	{ "requests", required_argument, NULL, 'r' },
+	{ "rekey", required_argument, NULL, 'k' },
 	{ NULL, 0, NULL, 0 }
 };
 
@@ -104,537 +111,1030 @@ uint16_t g_port = 9734;
 char g_greeting[BUFFLEN];
 int g_reqsd = 0;
 int g_encrypt = 0;
+dhm_hashalg_t g_hashalg = DHM_HASH_SHA224; // packet hash algorithm the client asks for
+int g_pool = 0; // client: size of the session pool, 0 for a single one-shot connection
+int g_requests = 100; // client: number of requests to send through the pool
+uint64_t g_rekey = 0; // client and server: ratchet the session keys after this many bytes, 0 to never rekey
+int g_udp = 0; // client and server: one datagram per packet instead of a TCP connection
+int g_shm = 0; // client and server: same host only, packets go through shared memory instead of TCP
+char g_shm_name[64]; // rendezvous name for --shm, derived from the port
+unsigned int g_handshake_ms = 10000; // server: time a new connection gets to deliver its first packet, 0 for no limit
+unsigned int g_idle_ms = 300000; // server: time a connection may sit between packets, 0 for no limit
+int g_cookie = 0; // server: make clients echo a cookie before spending an exponentiation on their Alice
+outer_cookie_t g_cookies; // server: secret the cookies are made with
+int g_workers = 0; // server: threads computing Bob packets, 0 for one per online CPU
+int g_hwm = 32; // server: handshakes allowed to wait for a busy worker before clients are told to come back later
+
+int g_server_sockfd = -1;
+volatile int g_server_shutdown = 0;
+timerwheel_t g_server_wheel; // connection deadlines, running only if a timeout is set
+int g_server_wheel_running = 0;
+hsqueue_t g_hsqueue; // Alice packets waiting for a worker to compute Bob
+
+// one server connection: its channel, plus the deadline that hangs up on it if it stalls
+typedef struct {
+	outer_channel_t chan;
+	uint32_t addr; // client's IPv4 address in network byte order, 0 for a same-host shared memory client
+	timerwheel_timer_t deadline;
+	volatile int expired; // set on the wheel thread when the deadline fires
+} server_conn_t;
+
+// UDP server session, found by GUID; holds everything needed to answer retransmissions without redoing work
+typedef struct {
+	int used;
+	uint8_t guid[GUIDSIZE];
+	uint8_t alice_hash[SHASIZE]; // tells a retransmitted Alice from a new one that happens to land in this slot
+	struct sockaddr_in peer; // where the Alice came from
+	time_t last_used;
+	outer_channel_t chan; // keys only, fd stays -1
+	dhm_bob_t bob; // resent as is if the client retransmits its Alice
+	int pending; // Bob is still being worked out on a handshake worker
+	uint32_t reply_seq; // outer sequence number of the request the cached reply answers
+	size_t reply_len; // 0 until the first AES request has been answered
+	uint8_t reply[UDP_MAXPAYLOAD];
+} udp_session_t;
 
-/* AES stuff */
+udp_session_t *g_udp_sessions = NULL;
+pthread_mutex_t g_udp_lock = PTHREAD_MUTEX_INITIALIZER; // session cache is shared by the receive loop and the handshake workers
 
-struct AES_ctx g_aes_client_ctx;
-struct AES_ctx g_aes_server_ctx; // separate contexes because they will have different internal counters
-uint8_t g_aes_key[32]; // same key for both of them
-uint8_t g_aes_client_iv[16];
-uint8_t g_aes_server_iv[16]; // separate nonces for client and server
+// UDP handshake handed to a worker; the job comes first so the completion callback can get back to the rest
+typedef struct {
+	hsqueue_job_t job;
+	outer_channel_t chan; // keyed by the worker, copied into the session when done
+	int fd;
+	struct sockaddr_in peer;
+	uint32_t seq; // outer sequence number of the Alice datagram, echoed on Bob
+} udp_handshake_t;
 
-int write_packet(int a_sockfd, uint16_t a_packtype, void *a_data, size_t a_size)
+long elapsed_us(struct timeval *a_start, struct timeval *a_end)
 {
-	static uint32_t s_sequence = 1;
-	int i;
-	
-	// allocate space for packet header + packet data
-	uint8_t *l_pack = NULL;
-	size_t l_pack_size = sizeof(outer_packet_header_t) + a_size;
-	l_pack = malloc(l_pack_size);
-	if (l_pack == NULL) {
-		fprintf(stderr, "write_packet: can't allocate space for packet\n");
-		exit(EXIT_FAILURE);
-	}
-	// fill in outer packet header
-	outer_packet_header_t l_header;
-	l_header.size = htons(a_size);
-	l_header.packtype = htons(a_packtype);
-	l_header.version = htons(outer_current_version);
-	l_header.sequence = htonl(s_sequence++);
-	
-	// assemble packet
-	memcpy(l_pack, &l_header, sizeof(outer_packet_header_t));
-	memcpy(l_pack + sizeof(outer_packet_header_t), a_data, a_size);
-	
-	if (g_showpacks) {
-		// show the packet if the showpacks flag is on
-		printf("write_packet: sending packet to fd %d\n", a_sockfd);
-		printf("  version: %04X\n", ntohs(l_header.version));
-		printf("  packtype: %04X\n", ntohs(l_header.packtype));
-		printf("  sequence: %d\n", ntohl(l_header.sequence));
-		printf("  data: (size: %d)", ntohs(l_header.size));
-		for (i = 0; i < a_size; ++i) {
-			if (i % 32 == 0)
-				printf("\n");
-			printf("%02X ", l_pack[i + sizeof(outer_packet_header_t)]);
-		}
-		printf("\n");
-	}
-	
-	int writelen;
-	writelen = write(a_sockfd, l_pack, l_pack_size);
-	free(l_pack);
-	return writelen;
+	return (a_end->tv_sec - a_start->tv_sec) * 1000000 + (a_end->tv_usec - a_start->tv_usec);
 }
 
-int read_packet(int a_sockfd, outer_packet_header_t **a_header, uint8_t **a_data)
+void print_channel_keys(const char *a_who, outer_channel_t *a_chan, int a_server)
 {
-	// reads packet, returns a header block and a data packet which the user will be responsible for freeing
-	// in case of error, returns -1 and internally frees any data structures it allocated.
-	
-	int readlen = 0;
 	int i;
+	// tx is the server direction on the server end, rx on the client end
+	outer_direction_t *l_server_dir = a_server ? &a_chan->tx : &a_chan->rx;
+	outer_direction_t *l_client_dir = a_server ? &a_chan->rx : &a_chan->tx;
 
-	outer_packet_header_t *l_header = NULL;
-	l_header = malloc(sizeof(outer_packet_header_t));
-	if (l_header == NULL) {
-		fprintf(stderr, "read_packet: can't allocate header\n");
-		return -1;
-	}
-	// read in the header
-	readlen = read(a_sockfd, l_header, sizeof(outer_packet_header_t));
-	if (readlen != sizeof(outer_packet_header_t)) {
-		fprintf(stderr, "read_packet: failure reading packet header, expected %ld bytes, got %d\n", sizeof(outer_packet_header_t), readlen);
-		free(l_header);
-		return -1;
-	}
-	// allocate buffer for actual packet based on size field of header
-	uint8_t *l_data = NULL;
-	l_data = malloc(ntohs(l_header->size));
-	if (l_data == NULL) {
-		fprintf(stderr, "read_packet: can't allocate space for packet data\n");
-		free(l_header);
-		return -1;
-	}
-	// read in packet data
-	readlen = read(a_sockfd, l_data, ntohs(l_header->size));
-	if (readlen != ntohs(l_header->size)) {
-		fprintf(stderr, "read_packet: failure to read packet data, expected %d bytes, got %d\n", l_header->size, readlen);
-		free(l_header);
-		free(l_data);
-		return -1;
-	}
-	if (g_showpacks) {
-		// show the packet if the showpacks flag is on
-		printf("read_packet: read packet from fd %d\n", a_sockfd);
-		printf("  version: %04X\n", ntohs(l_header->version));
-		printf("  packtype: %04X\n", ntohs(l_header->packtype));
-		printf("  sequence: %d\n", ntohl(l_header->sequence));
-		printf("  data: (size: %d)", ntohs(l_header->size));
-		for (i = 0; i < ntohs(l_header->size); ++i) {
-			if (i % 32 == 0)
-				printf("\n");
-			printf("%02X ", l_data[i]);
-		}
-		printf("\n");
-	}
-
-	*a_header = l_header;
-	*a_data = l_data;
-	// user is responsible for freeing these now
-	return 0;
+	// called right after keying, so both directions still hold the shared key
+	printf("%s: secret (AES256 key): ", a_who);
+	for (i = 0; i < 32; ++i)
+		printf("%02X", l_server_dir->key[i]);
+	printf("\n");
+	printf("%s: server (IV/nonce)  : ", a_who);
+	for (i = 0; i < 16; ++i)
+		printf("%02X", l_server_dir->iv[i]);
+	printf("\n");
+	printf("%s: client (IV/nonce)  : ", a_who);
+	for (i = 0; i < 16; ++i)
+		printf("%02X", l_client_dir->iv[i]);
+	printf("\n");
 }
 
-void client_action_encrypt(int sockfd)
+int client_exchange(outer_channel_t *a_chan, uint8_t *a_reply, size_t a_reply_size)
 {
-	int i;
-	// prepare Alice packet and send it to the server
-	dhm_error_t dhm_result;
-
-	dhm_session_t *l_alice_session = NULL;
-	l_alice_session = malloc(sizeof(dhm_session_t));
-	if (l_alice_session == NULL) {
-		fprintf(stderr, "unable to allocate memory for DHM session.\n");
-		exit(EXIT_FAILURE);
-	}
-	printf("client: calling dhm_init_session for Alice session...\n");
-	dhm_result = dhm_init_session(l_alice_session, 1);
-	if (dhm_result != DHM_ERR_NONE) {
-		fprintf(stderr, "unable to dhm_init_session: %s\n", dhm_strerror(dhm_result));
-		exit(EXIT_FAILURE);
-	}
-	
-	dhm_alice_t *l_alice = NULL;
-	l_alice = malloc(sizeof(dhm_alice_t));
-	if (l_alice == NULL) {
-		fprintf(stderr, "unable to allocate memory for Alice packet.\n");
-		exit(EXIT_FAILURE);
-	}
-	dhm_private_t *l_alice_private = NULL;
-	l_alice_private = malloc(sizeof(dhm_private_t));
-	if (l_alice_private == NULL) {
-		fprintf(stderr, "unable to allocate memory for Alice private key.\n");
-		exit(EXIT_FAILURE);
-	}
-	printf("client: calling dhm_get_alice...\n");
-	dhm_result = dhm_get_alice(l_alice_session, l_alice, l_alice_private, g_debug);
-	if (dhm_result != DHM_ERR_NONE) {
-		fprintf(stderr, "unable to dhm_get_alice: %s\n", dhm_strerror(dhm_result));
-		exit(EXIT_FAILURE);
-	}
-	int writelen;
-	writelen = write_packet(sockfd, outer_packtype_alice, l_alice, sizeof(dhm_alice_t));
-	if (writelen == 0) {
-		fprintf(stderr, "client: EOF detected, exiting\n");
-		close(sockfd);
-		return;
-	} else if (writelen < 0) {
-		// problems writing, fatal error
-		fprintf(stderr, "client: can't write_packet: %s\n", strerror(errno));
-		close(sockfd);
-		return;
-	} else if (writelen != (sizeof(dhm_alice_t) + sizeof(outer_packet_header_t))) {
-		fprintf(stderr, "client: problems writing Alice packet, wrote %d bytes, expected to write %lu.\n", writelen, (sizeof(dhm_alice_t) + sizeof(outer_packet_header_t)));
-		exit(EXIT_FAILURE);
-	}
-	printf("client: write %d byte Alice packet to server.\n", writelen);
-	// wait for Bob packet to come back
+	// send our greeting over a keyed channel and wait for the encrypted reply
+	// returns -1 if anything goes wrong, in which case the channel should not be reused
 	outer_packet_header_t *l_read_header = NULL;
 	uint8_t *l_read_packet = NULL;
-	int read_packet_return = read_packet(sockfd, &l_read_header, &l_read_packet);
-	if (read_packet_return < 0) {
-		fprintf(stderr, "client: error reading reply packet\n");
-		close(sockfd);
-		return;
-	}
-	printf("client: received packet type %04X, sequence %d from server.\n", ntohs(l_read_header->packtype), ntohl(l_read_header->sequence));
-	// make sure it's a Bob packet
-	if (ntohs(l_read_header->packtype) != outer_packtype_bob) {
-		fprintf(stderr, "client: expecting Bob packet, error!\n");
-		exit(EXIT_FAILURE);
+
+	outer_set_rekey(a_chan, g_rekey, 0);
+	int writelen = outer_write_aes(a_chan, (uint8_t *)g_greeting, strlen(g_greeting) + 1);
+	if (writelen < 0) {
+		fprintf(stderr, "client: can't write AES packet: %s\n", strerror(errno));
+		return -1;
 	}
-	// l_read_packet should contain a Bob packet now
-	printf("client: calling dhm_alice_secret\n");
-	dhm_alice_secret(l_alice_session, l_alice, (dhm_bob_t *)l_read_packet, l_alice_private, g_debug);
-	printf("client: secret (AES256 key): ");
-	for (i = 0; i < 32; ++i) {
-		printf("%02X", l_alice_session->s[i]);
-		g_aes_key[i] = l_alice_session->s[i];
+	while (1) {
+		if (outer_read_packet(a_chan, &l_read_header, &l_read_packet) < 0) {
+			fprintf(stderr, "client: error reading reply packet\n");
+			return -1;
+		}
+		if (ntohs(l_read_header->packtype) != outer_packtype_rekey)
+			break;
+		// server has ratcheted its keys in answer to ours, follow along and keep waiting for the reply
+		if (outer_recv_rekey(a_chan, l_read_packet, ntohs(l_read_header->size)) < 0) {
+			fprintf(stderr, "client: bad rekey packet from server!\n");
+			free(l_read_header);
+			free(l_read_packet);
+			return -1;
+		}
+		if (g_debug)
+			printf("client: session keys ratcheted to epoch %u\n", a_chan->rx.epoch);
+		free(l_read_header);
+		free(l_read_packet);
 	}
-	printf("\n");
-	printf("client: server (IV/nonce)  : ");
-	for (i = 32; i < 48; ++i) {
-		printf("%02X", l_alice_session->s[i]);
-		g_aes_server_iv[i - 32] = l_alice_session->s[i];
+	if (ntohs(l_read_header->packtype) != outer_packtype_aes) {
+		fprintf(stderr, "client: expecting AES packet, error!\n");
+		free(l_read_header);
+		free(l_read_packet);
+		return -1;
 	}
-	printf("\n");
-	printf("client: client (IV/nonce)  : ");
-	for (i = 48; i < 64; ++i) {
-		printf("%02X", l_alice_session->s[i]);
-		g_aes_client_iv[i - 48] = l_alice_session->s[i];
+	// authenticate and decrypt the payload
+	size_t l_plain_len = ntohs(l_read_header->size);
+	if (outer_open_aes(a_chan, l_read_packet, &l_plain_len) < 0) {
+		fprintf(stderr, "client: AES packet failed authentication, discarding!\n");
+		free(l_read_header);
+		free(l_read_packet);
+		return -1;
 	}
-	printf("\n");
-
-	// clean up
+	if (l_plain_len >= a_reply_size)
+		l_plain_len = a_reply_size - 1;
+	memcpy(a_reply, l_read_packet, l_plain_len);
+	a_reply[l_plain_len] = 0;
 	free(l_read_header);
 	free(l_read_packet);
-	printf("client: calling dhm_end_session for Alice session...\n");
-	dhm_result = dhm_end_session(l_alice_session, 1);
-	if (dhm_result != DHM_ERR_NONE) {
-		fprintf(stderr, "unable to dhm_end_session: %s\n", dhm_strerror(dhm_result));
-		exit(EXIT_FAILURE);
-	}
-	free(l_alice);
-	free(l_alice_private);
-	free(l_alice_session);
-
-	AES_init_ctx_iv(&g_aes_server_ctx, g_aes_key, g_aes_server_iv);
-	AES_init_ctx_iv(&g_aes_client_ctx, g_aes_key, g_aes_client_iv);
-	
-	// encrypt our greeting and send it
-	size_t l_greeting_len = strlen(g_greeting) + 1;
-	AES_CTR_xcrypt_buffer(&g_aes_client_ctx, (uint8_t *)g_greeting, l_greeting_len);
+	return l_plain_len;
+}
 
-	// send encrypted message and wait for reply
-	writelen = write_packet(sockfd, outer_packtype_aes, g_greeting, l_greeting_len);
-	if (writelen == 0) {
-		fprintf(stderr, "client: EOF detected, exiting\n");
-		close(sockfd);
-		return;
-	} else if (writelen < 0) {
-		// problems writing, fatal error
-		fprintf(stderr, "client: can't write_packet: %s\n", strerror(errno));
-		close(sockfd);
+void client_action_encrypt(outer_channel_t *a_chan, dhm_session_t *a_alice_session, dhm_alice_t *a_alice, dhm_private_t *a_alice_private)
+{
+	// send our already prepared Alice packet to the server and key the channel from the reply
+	printf("client: sending Alice packet, calling dhm_alice_secret on reply...\n");
+	if (outer_client_handshake(a_chan, a_alice_session, a_alice, a_alice_private, g_debug) < 0) {
+		fprintf(stderr, "client: DHM exchange with server failed\n");
 		return;
 	}
-	printf("client: write %d byte AES packet to server.\n", writelen);
-	
-	l_read_header = NULL;
-	l_read_packet = NULL;
-	read_packet_return = read_packet(sockfd, &l_read_header, &l_read_packet);
-	if (read_packet_return < 0) {
-		fprintf(stderr, "client: error reading reply packet\n");
-		close(sockfd);
+	print_channel_keys("client", a_chan, 0);
+
+	// send encrypted message and wait for reply
+	uint8_t l_reply[BUFFLEN];
+	int l_reply_len = client_exchange(a_chan, l_reply, BUFFLEN);
+	if (l_reply_len < 0)
 		return;
-	}
-	printf("client: received packet type %04X, sequence %d from server.\n", ntohs(l_read_header->packtype), ntohl(l_read_header->sequence));
-	// make sure we received an aes packet
-	if (ntohs(l_read_header->packtype) != outer_packtype_aes) {
-		fprintf(stderr, "client: expecting AES packet, error!\n");
-		exit(EXIT_FAILURE);
-	}
-	// decrypt the payload
-	AES_CTR_xcrypt_buffer(&g_aes_server_ctx, (uint8_t *)l_read_packet, ntohs(l_read_header->size));
-	printf("client: read string: (size=%d) %s\n", ntohs(l_read_header->size), l_read_packet);
-	free(l_read_header);
-	free(l_read_packet);
-	close(sockfd);
+	printf("client: read string: (size=%d) %s\n", l_reply_len, l_reply);
 }
 
-void client_action(int sockfd)
+void client_action(outer_channel_t *a_chan, dhm_session_t *a_alice_session, dhm_alice_t *a_alice, dhm_private_t *a_alice_private)
 {
-	// read and write via sockfd
+	// read and write via a connected channel, closed on return
 	int writelen;
 	// are we requesting a shutdown?
 	if (g_reqsd > 0) {
-		writelen = write_packet(sockfd, outer_packtype_dieplease, g_greeting, strlen(g_greeting) + 1);
-		if (writelen == 0) {
-			fprintf(stderr, "client: EOF detected on reqsd write, exiting\n");
-			close(sockfd);
-			return;
-		} else if (writelen < 0) {
+		writelen = outer_write_packet(a_chan, outer_packtype_dieplease, g_greeting, strlen(g_greeting) + 1);
+		if (writelen < 0) {
 			// problems writing, fatal error
 			fprintf(stderr, "client: reqsd write: can't write_packet: %s\n", strerror(errno));
-			close(sockfd);
+			outer_channel_close(a_chan);
 			return;
 		}
-		close(sockfd);
+		outer_channel_close(a_chan);
 		printf("client: sent termination packet to server.\n");
 		return;
 	}
 	// are we encrypting?
 	if (g_encrypt > 0) {
-		client_action_encrypt(sockfd);
-		close(sockfd);
+		client_action_encrypt(a_chan, a_alice_session, a_alice, a_alice_private);
+		outer_channel_close(a_chan);
 		return;
 	}
 	// write the trailing zero in our string for convenience
-	writelen = write_packet(sockfd, outer_packtype_textecho, g_greeting, strlen(g_greeting) + 1);
-	if (writelen == 0) {
-		fprintf(stderr, "client: EOF detected, exiting\n");
-		close(sockfd);
-		return;
-	} else if (writelen < 0) {
+	writelen = outer_write_packet(a_chan, outer_packtype_textecho, g_greeting, strlen(g_greeting) + 1);
+	if (writelen < 0) {
 		// problems writing, fatal error
 		fprintf(stderr, "client: can't write_packet: %s\n", strerror(errno));
-		close(sockfd);
+		outer_channel_close(a_chan);
 		return;
 	}
 	printf("client: write %d byte packet to server.\n", writelen);
 	
 	outer_packet_header_t *l_read_header = NULL;
 	uint8_t *l_read_packet = NULL;
-	int read_packet_return = read_packet(sockfd, &l_read_header, &l_read_packet);
+	int read_packet_return = outer_read_packet(a_chan, &l_read_header, &l_read_packet);
 	if (read_packet_return < 0) {
 		fprintf(stderr, "client: error reading reply packet\n");
-		close(sockfd);
+		outer_channel_close(a_chan);
 		return;
 	}
 	printf("client: received packet type %04X, sequence %d from server.\n", ntohs(l_read_header->packtype), ntohl(l_read_header->sequence));
 	printf("client: read string: (size=%d) %s\n", ntohs(l_read_header->size), l_read_packet);
 	free(l_read_header);
 	free(l_read_packet);
-	close(sockfd);
+	outer_channel_close(a_chan);
+}
+
+void mode_client_pool()
+{
+	// keep g_pool keyed connections open and push g_requests requests through them
+	dhmpool_t l_pool;
+	dhmpool_stats_t l_stats;
+	struct timeval l_start, l_end;
+	long l_us, l_min = -1, l_max = 0, l_total = 0;
+	int l_ok = 0;
+	int i;
+	uint32_t l_last_epoch = 0;
+	uint8_t l_reply[BUFFLEN];
+
+	printf("client: opening a pool of %d secure sessions to %s on port %d\n", g_pool, g_host, g_port);
+	if (dhmpool_init(&l_pool, g_host, g_port, g_pool, g_hashalg, g_debug) < 0) {
+		fprintf(stderr, "client: unable to create session pool\n");
+		exit(EXIT_FAILURE);
+	}
+	// let the fillers warm the pool up so we time requests, not handshakes
+	int l_idle = 0;
+	gettimeofday(&l_start, NULL);
+	do {
+		usleep(10000);
+		dhmpool_get_stats(&l_pool, &l_stats, &l_idle, NULL);
+		gettimeofday(&l_end, NULL);
+	} while ((l_idle < g_pool) && (elapsed_us(&l_start, &l_end) < 30000000));
+	printf("client: %d of %d sessions ready after %ld ms\n", l_idle, g_pool, elapsed_us(&l_start, &l_end) / 1000);
+	for (i = 0; i < g_requests; ++i) {
+		gettimeofday(&l_start, NULL);
+		outer_channel_t *l_chan = dhmpool_acquire(&l_pool, 30000);
+		if (l_chan == NULL) {
+			fprintf(stderr, "client: timed out waiting for a pooled session\n");
+			break;
+		}
+		int l_reply_len = client_exchange(l_chan, l_reply, BUFFLEN);
+		l_last_epoch = l_chan->tx.epoch;
+		dhmpool_release(&l_pool, l_chan, (l_reply_len < 0));
+		gettimeofday(&l_end, NULL);
+		if (l_reply_len < 0)
+			continue;
+		if (i == 0)
+			printf("client: read string: (size=%d) %s\n", l_reply_len, l_reply);
+		l_us = elapsed_us(&l_start, &l_end);
+		l_total += l_us;
+		if ((l_min < 0) || (l_us < l_min))
+			l_min = l_us;
+		if (l_us > l_max)
+			l_max = l_us;
+		++l_ok;
+	}
+	dhmpool_get_stats(&l_pool, &l_stats, NULL, NULL);
+	dhmpool_destroy(&l_pool);
+	printf("client: %d of %d requests OK", l_ok, g_requests);
+	if (l_ok > 0)
+		printf(", latency min %ld us avg %ld us max %ld us", l_min, l_total / l_ok, l_max);
+	printf("\n");
+	if (g_rekey > 0)
+		printf("client: last session used was at key epoch %u\n", l_last_epoch);
+	printf("client: pool handshakes %llu failures %llu acquires %llu waits %llu broken %llu\n",
+		(unsigned long long)l_stats.handshakes, (unsigned long long)l_stats.failures, (unsigned long long)l_stats.acquires,
+		(unsigned long long)l_stats.waits, (unsigned long long)l_stats.broken);
+}
+
+ssize_t udp_transact(int a_fd, uint32_t a_seq, uint16_t a_packtype, const void *a_data, size_t a_size, uint16_t *a_reply_type, uint8_t *a_reply, size_t a_reply_size)
+{
+	// send one datagram and wait for the answer to it, retransmitting the same bytes with a doubling timeout
+	// replies are matched on the outer sequence number, which the server echoes back; their type goes in a_reply_type
+	outer_packet_header_t l_header;
+	struct pollfd l_pfd;
+	struct timeval l_start, l_now;
+	int l_rto = UDP_RTO_MS;
+	long l_left;
+	int l_try;
+	ssize_t l_len;
+
+	l_pfd.fd = a_fd;
+	l_pfd.events = POLLIN;
+	for (l_try = 0; l_try < UDP_TRIES; ++l_try, l_rto *= 2) {
+		if (outer_send_datagram(a_fd, NULL, a_seq, a_packtype, a_data, a_size) < 0) {
+			fprintf(stderr, "client: can't send datagram: %s\n", strerror(errno));
+			return -1;
+		}
+		gettimeofday(&l_start, NULL);
+		l_left = l_rto;
+		while (l_left > 0) {
+			int res = poll(&l_pfd, 1, l_left);
+			if ((res < 0) && (errno != EINTR)) {
+				fprintf(stderr, "client: can't poll: %s\n", strerror(errno));
+				return -1;
+			}
+			if (res > 0) {
+				l_len = outer_recv_datagram(a_fd, NULL, &l_header, a_reply, a_reply_size);
+				if ((l_len >= 0) && (ntohl(l_header.sequence) == a_seq)) {
+					*a_reply_type = ntohs(l_header.packtype);
+					return l_len;
+				}
+				// a refused port, a malformed datagram or a late duplicate of an earlier reply: keep waiting
+			}
+			gettimeofday(&l_now, NULL);
+			l_left = l_rto - elapsed_us(&l_start, &l_now) / 1000;
+		}
+		if (l_try + 1 < UDP_TRIES)
+			printf("client: no reply after %d ms, retransmitting\n", l_rto);
+	}
+	fprintf(stderr, "client: no reply from server after %d tries\n", UDP_TRIES);
+	return -1;
+}
+
+void mode_client_udp()
+{
+	// Alice and Bob are one datagram each, then the request and reply are one datagram each
+	int sockfd;
+	struct sockaddr_in l_address;
+	struct timeval l_start, l_end;
+	outer_channel_t l_chan;
+	uint8_t l_buff[UDP_MAXPAYLOAD + 1];
+	uint8_t l_reply[UDP_MAXPAYLOAD + 1];
+	ssize_t l_len;
+	uint16_t l_reply_type;
+	dhm_session_t l_alice_session;
+	dhm_alice_t l_alice;
+	dhm_private_t l_alice_private;
+	dhm_error_t dhm_result;
+
+	printf("sending datagrams to: %s on port %d\n", g_host, g_port);
+	memset(&l_address, 0, sizeof(l_address));
+	l_address.sin_family = AF_INET;
+	l_address.sin_port = htons(g_port);
+	if (inet_aton(g_host, &l_address.sin_addr) == 0) {
+		fprintf(stderr, "client: bad server address %s\n", g_host);
+		exit(EXIT_FAILURE);
+	}
+	sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sockfd < 0) {
+		fprintf(stderr, "client: can't create socket: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	// a connected datagram socket only hears from the server, and reports ICMP port unreachable
+	if (connect(sockfd, (struct sockaddr *)&l_address, sizeof(l_address)) < 0) {
+		fprintf(stderr, "client: can't connect: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	outer_channel_init(&l_chan, sockfd);
+
+	// are we requesting a shutdown? there is no reply to wait for, so send it once
+	if (g_reqsd > 0) {
+		if (outer_send_datagram(sockfd, NULL, 1, outer_packtype_dieplease, g_greeting, strlen(g_greeting) + 1) < 0)
+			fprintf(stderr, "client: reqsd write: can't send datagram: %s\n", strerror(errno));
+		else
+			printf("client: sent termination datagram to server.\n");
+		outer_channel_close(&l_chan);
+		return;
+	}
+	if (g_encrypt == 0) {
+		l_len = udp_transact(sockfd, 1, outer_packtype_textecho, g_greeting, strlen(g_greeting) + 1, &l_reply_type, l_reply, UDP_MAXPAYLOAD);
+		if ((l_len >= 0) && (l_reply_type == outer_packtype_textecho)) {
+			l_reply[l_len] = 0;
+			printf("client: read string: (size=%ld) %s\n", (long)l_len, l_reply);
+		}
+		outer_channel_close(&l_chan);
+		return;
+	}
+
+	gettimeofday(&l_start, NULL);
+	printf("client: calling dhm_get_alice...\n");
+	if (outer_prepare_alice(g_hashalg, &l_alice_session, &l_alice, &l_alice_private, g_debug) < 0)
+		exit(EXIT_FAILURE);
+	printf("client: sending Alice datagram, calling dhm_alice_secret on reply...\n");
+	// keep sending Alice until Bob comes back; a cookie or a busy reply each cost another round trip
+	// every attempt gets its own sequence number so a late reply to an earlier one can't be mistaken for Bob
+	uint32_t l_seq = 0;
+	size_t l_alice_len = sizeof(dhm_alice_t);
+	int l_round;
+	memcpy(l_reply, &l_alice, sizeof(dhm_alice_t));
+	for (l_round = 0; l_round < OUTER_HANDSHAKE_ROUNDS; ++l_round) {
+		l_len = udp_transact(sockfd, ++l_seq, outer_packtype_alice, l_reply, l_alice_len, &l_reply_type, l_buff, UDP_MAXPAYLOAD);
+		if ((l_len == OUTER_COOKIESIZE) && (l_reply_type == outer_packtype_cookie)) {
+			// server wants proof we can hear it before it does any work: send Alice again with the cookie on the end
+			printf("client: got a cookie, sending Alice again with it\n");
+			memcpy(l_reply + sizeof(dhm_alice_t), l_buff, OUTER_COOKIESIZE);
+			l_alice_len = sizeof(dhm_alice_t) + OUTER_COOKIESIZE;
+		} else if ((l_len == sizeof(uint32_t)) && (l_reply_type == outer_packtype_busy)) {
+			// server is shedding load and kept nothing of ours; come back when it says
+			uint32_t l_retry_ms = ntohl(*(uint32_t *)l_buff);
+			if (l_retry_ms > OUTER_BUSY_MAX_MS)
+				l_retry_ms = OUTER_BUSY_MAX_MS;
+			printf("client: server busy, sending Alice again in %u ms\n", l_retry_ms);
+			usleep(l_retry_ms * 1000);
+		} else {
+			break;
+		}
+	}
+	if ((l_len != sizeof(dhm_bob_t)) || (l_reply_type != outer_packtype_bob)) {
+		fprintf(stderr, "client: DHM exchange with server failed\n");
+		memset(&l_alice_private, 0, sizeof(dhm_private_t));
+		dhm_end_session(&l_alice_session, g_debug);
+		outer_channel_close(&l_chan);
+		return;
+	}
+	dhm_result = dhm_alice_secret(&l_alice_session, &l_alice, (dhm_bob_t *)l_buff, &l_alice_private, g_debug);
+	memset(&l_alice_private, 0, sizeof(dhm_private_t));
+	if (dhm_result != DHM_ERR_NONE) {
+		fprintf(stderr, "client: unable to dhm_alice_secret: %s\n", dhm_strerror(dhm_result));
+		dhm_end_session(&l_alice_session, g_debug);
+		outer_channel_close(&l_chan);
+		return;
+	}
+	outer_channel_keys(&l_chan, l_alice_session.s, 0);
+	dhm_end_session(&l_alice_session, g_debug);
+	memset(l_alice_session.s, 0, sizeof(l_alice_session.s));
+	gettimeofday(&l_end, NULL);
+	printf("client: secure session established after %ld ms\n", elapsed_us(&l_start, &l_end) / 1000);
+	print_channel_keys("client", &l_chan, 0);
+
+	// AES datagrams lead with the session GUID so the server can find our keys
+	// the request is sealed once, so a retransmission is byte for byte the same datagram
+	memcpy(l_buff, l_alice.guid, GUIDSIZE);
+	size_t l_sealed = outer_seal_aes(&l_chan, (uint8_t *)g_greeting, strlen(g_greeting) + 1, l_buff + GUIDSIZE);
+	l_len = udp_transact(sockfd, ++l_seq, outer_packtype_aes, l_buff, GUIDSIZE + l_sealed, &l_reply_type, l_reply, UDP_MAXPAYLOAD);
+	if ((l_len < GUIDSIZE) || (l_reply_type != outer_packtype_aes) || (memcmp(l_reply, l_alice.guid, GUIDSIZE) != 0)) {
+		fprintf(stderr, "client: no usable reply from server\n");
+		outer_channel_close(&l_chan);
+		return;
+	}
+	size_t l_plain_len = l_len - GUIDSIZE;
+	if (outer_open_aes(&l_chan, l_reply + GUIDSIZE, &l_plain_len) < 0) {
+		fprintf(stderr, "client: AES datagram failed authentication, discarding!\n");
+		outer_channel_close(&l_chan);
+		return;
+	}
+	l_reply[GUIDSIZE + l_plain_len] = 0;
+	printf("client: read string: (size=%lu) %s\n", l_plain_len, l_reply + GUIDSIZE);
+	outer_channel_close(&l_chan);
+}
+
+void mode_client_shm()
+{
+	// same host: the connect is a local rendezvous, so there is nothing to overlap Alice with
+	outer_channel_t l_chan;
+	dhm_session_t l_alice_session;
+	dhm_alice_t l_alice;
+	dhm_private_t l_alice_private;
+
+	printf("attaching to shared memory server %s\n", g_shm_name);
+	if (outer_shm_connect(g_shm_name, &l_chan) < 0)
+		exit(EXIT_FAILURE);
+	printf("client: shared memory rings mapped.\n");
+	if ((g_encrypt > 0) && (g_reqsd == 0)) {
+		printf("client: calling dhm_get_alice...\n");
+		if (outer_prepare_alice(g_hashalg, &l_alice_session, &l_alice, &l_alice_private, g_debug) < 0)
+			exit(EXIT_FAILURE);
+	}
+	client_action(&l_chan, &l_alice_session, &l_alice, &l_alice_private);
 }
 
 void mode_client()
 {
+	if (g_udp > 0) {
+		mode_client_udp();
+		return;
+	}
+	if (g_shm > 0) {
+		mode_client_shm();
+		return;
+	}
+	if ((g_pool > 0) && (g_encrypt > 0) && (g_reqsd == 0)) {
+		mode_client_pool();
+		return;
+	}
 	printf("attempting to connect to: %s on port %d\n", g_host, g_port);
 	int sockfd;
-	int len;
-	struct sockaddr_in address;
-	int res;
+	struct timeval l_start, l_ready, l_end;
 
-	// create a socket for the client
-	sockfd = socket(AF_INET, SOCK_STREAM, 0);
+	// Alice packet is only needed if we are going to encrypt
+	dhm_session_t l_alice_session;
+	dhm_alice_t l_alice;
+	dhm_private_t l_alice_private;
+	int l_need_alice = ((g_encrypt > 0) && (g_reqsd == 0));
 
-	// name the socket as agreed with the server
-	address.sin_family = AF_INET;
-	address.sin_addr.s_addr = inet_addr(g_host);
-	address.sin_port = htons(g_port);
-	len = sizeof(address);
+	// start a non-blocking connect so the handshake with the server happens while we generate Alice
+	gettimeofday(&l_start, NULL);
+	if (outer_connect_start(g_host, g_port, &sockfd) < 0)
+		exit(EXIT_FAILURE);
 
-	// connect our socket to the server's socket
-	res = connect(sockfd, (struct sockaddr *)&address, len);
-	if (res < 0) {
-		fprintf(stderr, "client: can't connect to %s: %s\n", g_host, strerror(errno));
+	if (l_need_alice) {
+		printf("client: calling dhm_get_alice...\n");
+		if (outer_prepare_alice(g_hashalg, &l_alice_session, &l_alice, &l_alice_private, g_debug) < 0)
+			exit(EXIT_FAILURE);
+	}
+	gettimeofday(&l_ready, NULL);
+	if (l_need_alice)
+		printf("client: Alice packet ready after %ld ms\n", elapsed_us(&l_start, &l_ready) / 1000);
+
+	// now wait for the connect to finish, if it hasn't already
+	if (outer_connect_finish(sockfd) < 0) {
+		fprintf(stderr, "client: can't connect to %s\n", g_host);
+		memset(&l_alice_private, 0, sizeof(dhm_private_t));
 		exit(EXIT_FAILURE);
 	}
+	gettimeofday(&l_end, NULL);
 
-	printf("client: connected.\n");
-	client_action(sockfd);
+	// a connect that completed while Alice was being generated shows up as a wait of 0 ms
+	if (l_need_alice)
+		printf("client: connected, waited %ld ms for the connect after Alice was ready.\n", elapsed_us(&l_ready, &l_end) / 1000);
+	else
+		printf("client: connected after %ld ms.\n", elapsed_us(&l_start, &l_end) / 1000);
+	outer_channel_t l_chan;
+	outer_channel_init(&l_chan, sockfd);
+	client_action(&l_chan, &l_alice_session, &l_alice, &l_alice_private);
 }
 
-int server_action(int client_sockfd)
+int server_alice_size_ok(size_t a_size)
 {
-	int i;
-	// read and write to client on client_sockfd
+	// an Alice packet may have a cookie from an earlier round on the end
+	return ((a_size == sizeof(dhm_alice_t)) || (a_size == sizeof(dhm_alice_t) + OUTER_COOKIESIZE));
+}
+
+int server_needs_cookie(uint32_t a_addr, const uint8_t *a_alice, size_t a_size)
+{
+	// with --cookie, an Alice packet only gets an exponentiation if it echoes a valid cookie for its sender
+	if (g_cookie == 0)
+		return 0;
+	if (a_size != sizeof(dhm_alice_t) + OUTER_COOKIESIZE)
+		return 1;
+	return (outer_cookie_check(&g_cookies, a_addr, (const dhm_alice_t *)a_alice, a_alice + sizeof(dhm_alice_t)) < 0);
+}
+
+void server_conn_expired(void *a_arg)
+{
+	// runs on the wheel thread: wake up the connection's blocked read or write, server_action then sees EOF
+	server_conn_t *l_conn = (server_conn_t *)a_arg;
+	l_conn->expired = 1;
+	shutdown(l_conn->chan.fd, SHUT_RDWR);
+}
+
+void server_conn_deadline(server_conn_t *a_conn, unsigned int a_ms)
+{
+	// (re)arm the connection's deadline a_ms from now, or cancel it if a_ms is 0
+	if (!g_server_wheel_running)
+		return;
+	if (a_ms > 0)
+		timerwheel_arm(&g_server_wheel, &a_conn->deadline, a_ms, server_conn_expired, a_conn);
+	else
+		timerwheel_cancel(&g_server_wheel, &a_conn->deadline);
+}
+
+int server_action(server_conn_t *a_conn)
+{
+	// serve packets on one connection until the client hangs up
+	// a client can do one DHM exchange and then send any number of AES packets on the same connection
+	// returns -1 if the client asked the server to terminate
+	outer_channel_t *l_chan = &a_conn->chan;
 	outer_packet_header_t *l_read_header = NULL;
 	uint8_t *l_read_packet = NULL;
-	int read_packet_return = read_packet(client_sockfd, &l_read_header, &l_read_packet);
-	if (read_packet_return < 0) {
-		fprintf(stderr, "server: error reading incoming packet\n");
-		close(client_sockfd);
-		return 0;
-	}
-	// check if we received termination request
-	if (ntohs(l_read_header->packtype) == outer_packtype_dieplease) {
-		printf("server: received termination packet\n");
-		printf("server: termination message: %s\n", l_read_packet);
+	char l_buff[BUFFLEN + 128];
+	int writelen;
+
+	while (outer_read_packet(l_chan, &l_read_header, &l_read_packet) == 0) {
+		uint16_t l_packtype = ntohs(l_read_header->packtype);
+		size_t l_size = ntohs(l_read_header->size);
+		if (g_debug)
+			printf("server: received packet type %04X, sequence %d from client.\n", l_packtype, ntohl(l_read_header->sequence));
+
+		if (l_packtype == outer_packtype_dieplease) {
+			// check if we received termination request
+			l_read_packet[l_size] = 0;
+			printf("server: received termination packet\n");
+			printf("server: termination message: %s\n", l_read_packet);
+			free(l_read_header);
+			free(l_read_packet);
+			return -1;
+		} else if (l_packtype == outer_packtype_textecho) {
+			l_read_packet[l_size] = 0;
+			printf("server: read string: (size=%lu) %s\n", l_size, l_read_packet);
+			// prepare reply message and echo the string back
+			snprintf(l_buff, sizeof(l_buff), "greetings from the server\nmy greeting: %s\nyou sent: %s", g_greeting, l_read_packet);
+			writelen = outer_write_packet(l_chan, outer_packtype_textecho, l_buff, strlen(l_buff) + 1);
+			if (writelen < 0) {
+				// problems writing, nonfatal error that will recycle the connection
+				fprintf(stderr, "server: can't write_packet: %s\n", strerror(errno));
+				break;
+			}
+			printf("server: write %d byte packet back to client.\n", writelen);
+		} else if (l_packtype == outer_packtype_alice) {
+			// handle Alice packet
+			if ((l_chan->keyed) || (!server_alice_size_ok(l_size))) {
+				fprintf(stderr, "server: unexpected Alice packet, hanging up\n");
+				break;
+			}
+			if (server_needs_cookie(a_conn->addr, l_read_packet, l_size)) {
+				// cheap answer first: no exponentiation until the client echoes this back
+				uint8_t l_cookie[OUTER_COOKIESIZE];
+				outer_cookie_make(&g_cookies, a_conn->addr, (dhm_alice_t *)l_read_packet, l_cookie);
+				if (outer_write_packet(l_chan, outer_packtype_cookie, l_cookie, OUTER_COOKIESIZE) < 0) {
+					fprintf(stderr, "server: can't write_packet: %s\n", strerror(errno));
+					break;
+				}
+				if (g_debug)
+					printf("server: sent cookie to client.\n");
+			} else {
+				dhm_bob_t l_bob;
+				unsigned int l_retry_ms = 0;
+				int res = hsqueue_run(&g_hsqueue, l_chan, (dhm_alice_t *)l_read_packet, &l_bob, &l_retry_ms);
+				if (res == HSQUEUE_BUSY) {
+					// shed load: turning the client away costs nothing, it comes back when the queue has drained
+					uint32_t l_retry = htonl(l_retry_ms);
+					if (outer_write_packet(l_chan, outer_packtype_busy, &l_retry, sizeof(l_retry)) < 0) {
+						fprintf(stderr, "server: can't write_packet: %s\n", strerror(errno));
+						break;
+					}
+					if (g_debug)
+						printf("server: handshake queue full, told client to retry in %u ms\n", l_retry_ms);
+				} else if (res != HSQUEUE_OK) {
+					fprintf(stderr, "server: DHM exchange with client failed, hanging up\n");
+					break;
+				} else if (outer_write_packet(l_chan, outer_packtype_bob, &l_bob, sizeof(dhm_bob_t)) != (sizeof(dhm_bob_t) + sizeof(outer_packet_header_t))) {
+					fprintf(stderr, "server: problems writing Bob packet, hanging up\n");
+					break;
+				} else {
+					printf("server: wrote Bob packet to client.\n");
+					outer_set_rekey(l_chan, g_rekey, 0);
+					if (g_debug)
+						print_channel_keys("server", l_chan, 1);
+				}
+			}
+		} else if (l_packtype == outer_packtype_aes) {
+			if (!l_chan->keyed) {
+				fprintf(stderr, "server: AES packet before DHM exchange, hanging up\n");
+				break;
+			}
+			// authenticate and decrypt the payload
+			if (outer_open_aes(l_chan, l_read_packet, &l_size) < 0) {
+				fprintf(stderr, "server: AES packet failed authentication, hanging up\n");
+				break;
+			}
+			l_read_packet[l_size] = 0;
+			if (g_debug)
+				printf("server: read string: (size=%lu) %s\n", l_size, l_read_packet);
+			snprintf(l_buff, sizeof(l_buff), "greetings from the server\nmy greeting: %s\nyou sent: %s", g_greeting, l_read_packet);
+			// echo the string back, encrypted and authenticated this time
+			writelen = outer_write_aes(l_chan, (uint8_t *)l_buff, strlen(l_buff) + 1);
+			if (writelen < 0) {
+				fprintf(stderr, "server: can't write_packet: %s\n", strerror(errno));
+				break;
+			}
+		} else if (l_packtype == outer_packtype_rekey) {
+			// client ratcheted its keys; follow, and ratchet ours too
+			if ((!l_chan->keyed) || (outer_recv_rekey(l_chan, l_read_packet, l_size) < 0)) {
+				fprintf(stderr, "server: bad rekey packet, hanging up\n");
+				break;
+			}
+			if (g_debug)
+				printf("server: session keys ratcheted to epoch %u\n", l_chan->rx.epoch);
+		} else {
+			fprintf(stderr, "server: unknown packet type %04X, hanging up\n", l_packtype);
+			break;
+		}
 		free(l_read_header);
 		free(l_read_packet);
-		close(client_sockfd);
-		return -1;
+		l_read_header = NULL;
+		l_read_packet = NULL;
+		// first packet dealt with, from now on the client only has to keep the connection busy
+		server_conn_deadline(a_conn, g_idle_ms);
 	}
-	printf("server: received packet type %04X, sequence %d from client.\n", ntohs(l_read_header->packtype), ntohl(l_read_header->sequence));
-	
-	if (ntohs(l_read_header->packtype) == outer_packtype_textecho) {
-		printf("server: read string: (size=%d) %s\n", ntohs(l_read_header->size), l_read_packet);
-		// prepare reply message
-		char l_buff[BUFFLEN];
-		sprintf(l_buff, "greetings from the server\nmy greeting: %s\nyou sent: %s", g_greeting, l_read_packet);
-		free(l_read_header); // don't need these anymore
-		free(l_read_packet);
+	free(l_read_header);
+	free(l_read_packet);
+	return 0;
+}
 
-		// echo the string back
-		int writelen;
-		writelen = write_packet(client_sockfd, outer_packtype_textecho, l_buff, strlen(l_buff) + 1);
-		if (writelen == 0) {
-			fprintf(stderr, "server: EOF detected, hanging up\n");
-			close(client_sockfd);
-			return 0;
-		} else if (writelen < 0) {
-			// problems reading, nonfatal error that will recycle the server
-			fprintf(stderr, "server: can't write_packet: %s\n", strerror(errno));
-			close(client_sockfd);
-			return 0;
-		}
-		printf("server: write %d byte packet back to client.\n", writelen);
+void *server_conn_tf(void *a_arg)
+{
+	// one thread per connection, so pooled clients can hold several connections open at once
+	server_conn_t *l_conn = (server_conn_t *)a_arg;
+	if (server_action(l_conn) < 0) {
+		printf("server: gracefully shutting down...\n");
+		g_server_shutdown = 1;
+		shutdown(g_server_sockfd, SHUT_RDWR); // wakes up accept() in mode_server
+	}
+	server_conn_deadline(l_conn, 0);
+	if (l_conn->expired)
+		printf("server: connection timed out, hung up\n");
+	outer_channel_close(&l_conn->chan);
+	free(l_conn);
+	return NULL;
+}
 
-		close(client_sockfd);
-		return 0;
-	} else if (ntohs(l_read_header->packtype) == outer_packtype_alice) {
-		// handle Alice packet
-		dhm_error_t dhm_result;
-		dhm_session_t *l_bob_session = NULL;
-		l_bob_session = malloc(sizeof(dhm_session_t));
-		if (l_bob_session == NULL) {
-			fprintf(stderr, "unable to allocate memory for DHM Bob session.\n");
-			exit(EXIT_FAILURE);
-		}
-		printf("server: calling dhm_init_session for Bob session...\n");
-		dhm_result = dhm_init_session(l_bob_session, 1);
-		if (dhm_result != DHM_ERR_NONE) {
-			fprintf(stderr, "unable to dhm_init_session: %s\n", dhm_strerror(dhm_result));
-			exit(EXIT_FAILURE);
-		}
-		dhm_bob_t *l_bob = NULL;
-		l_bob = malloc(sizeof(dhm_bob_t));
-		if (l_bob == NULL) {
-			fprintf(stderr, "unable to allocate memory for Bob packet.\n");
-			exit(EXIT_FAILURE);
+server_conn_t *server_new_conn()
+{
+	server_conn_t *l_conn = malloc(sizeof(server_conn_t));
+	if (l_conn == NULL) {
+		fprintf(stderr, "server: can't allocate connection\n");
+		return NULL;
+	}
+	l_conn->expired = 0;
+	l_conn->addr = 0;
+	timerwheel_timer_init(&l_conn->deadline);
+	return l_conn;
+}
+
+void server_start_conn(server_conn_t *a_conn, pthread_attr_t *a_attr)
+{
+	// give the new connection its handshake deadline and a thread of its own
+	pthread_t l_thread;
+
+	server_conn_deadline(a_conn, g_handshake_ms);
+	if (pthread_create(&l_thread, a_attr, server_conn_tf, a_conn) != 0) {
+		fprintf(stderr, "server: can't create connection thread: %s\n", strerror(errno));
+		server_conn_deadline(a_conn, 0);
+		outer_channel_close(&a_conn->chan);
+		free(a_conn);
+	}
+}
+
+void server_start_wheel()
+{
+	// connection threads are detached and may outlive the accept loop, so the wheel is left running until exit
+	if ((g_handshake_ms == 0) && (g_idle_ms == 0))
+		return;
+	if (timerwheel_init(&g_server_wheel, SERVER_TICK_MS) < 0)
+		exit(EXIT_FAILURE);
+	g_server_wheel_running = 1;
+}
+
+void server_report_stats()
+{
+	hsqueue_stats_t l_stats;
+
+	hsqueue_get_stats(&g_hsqueue, &l_stats);
+	printf("server: handshakes: %llu done, %llu failed, %llu turned away busy; queue limit %d waiting on %d workers, peak %d, avg %u ms\n",
+		(unsigned long long)l_stats.completed, (unsigned long long)l_stats.failed, (unsigned long long)l_stats.rejected,
+		g_hwm, g_workers, l_stats.peak_depth, l_stats.avg_ms);
+	if (g_server_wheel_running)
+		printf("server: %llu connections timed out\n", (unsigned long long)timerwheel_fired(&g_server_wheel));
+}
+
+uint32_t udp_session_slot(const uint8_t *a_guid)
+{
+	// GUIDs come straight from /dev/urandom, so any four bytes of one make a good hash
+	uint32_t l_slot;
+	memcpy(&l_slot, a_guid, sizeof(l_slot));
+	return l_slot & (UDP_SESSIONS - 1);
+}
+
+void udp_handshake_done(hsqueue_job_t *a_job)
+{
+	// runs on a handshake worker: publish the session and send Bob, unless another client took the slot meanwhile
+	udp_handshake_t *l_hs = (udp_handshake_t *)a_job;
+
+	pthread_mutex_lock(&g_udp_lock);
+	udp_session_t *l_sess = &g_udp_sessions[udp_session_slot(a_job->alice.guid)];
+	if ((l_sess->pending) && (memcmp(l_sess->guid, a_job->alice.guid, GUIDSIZE) == 0) && (memcmp(l_sess->alice_hash, a_job->alice.hash, SHASIZE) == 0)) {
+		if (a_job->result == HSQUEUE_OK) {
+			memcpy(&l_sess->chan, &l_hs->chan, sizeof(outer_channel_t));
+			memcpy(&l_sess->bob, &a_job->bob, sizeof(dhm_bob_t));
+			l_sess->pending = 0;
+			if (outer_send_datagram(l_hs->fd, &l_hs->peer, l_hs->seq, outer_packtype_bob, &l_sess->bob, sizeof(dhm_bob_t)) < 0)
+				fprintf(stderr, "server: can't send datagram: %s\n", strerror(errno));
+			printf("server: sent Bob datagram to %s:%d.\n", inet_ntoa(l_hs->peer.sin_addr), ntohs(l_hs->peer.sin_port));
+			if (g_debug)
+				print_channel_keys("server", &l_sess->chan, 1);
+		} else {
+			fprintf(stderr, "server: DHM exchange with client failed, dropping\n");
+			memset(l_sess, 0, sizeof(udp_session_t));
+			outer_channel_init(&l_sess->chan, -1);
 		}
-		dhm_private_t *l_bob_private = NULL;
-		l_bob_private = malloc(sizeof(dhm_private_t));
-		if (l_bob_private == NULL) {
-			fprintf(stderr, "unable to allocate memory for Bob private key.\n");
-			exit(EXIT_FAILURE);
+	}
+	pthread_mutex_unlock(&g_udp_lock);
+	memset(&l_hs->chan, 0, sizeof(outer_channel_t)); // keys were copied, or aren't wanted
+	free(l_hs);
+}
+
+int udp_server_datagram(int a_fd, struct sockaddr_in *a_from, outer_packet_header_t *a_header, uint8_t *a_data, size_t a_size)
+{
+	// answer one datagram; replies carry the request's outer sequence number so the client can match them up
+	// returns -1 if the client asked the server to terminate
+	uint16_t l_packtype = ntohs(a_header->packtype);
+	uint32_t l_seq = ntohl(a_header->sequence);
+	time_t l_now = time(NULL);
+	udp_session_t *l_sess;
+	char l_buff[BUFFLEN + 128];
+
+	if (g_debug)
+		printf("server: received datagram type %04X, sequence %d from %s:%d.\n", l_packtype, l_seq, inet_ntoa(a_from->sin_addr), ntohs(a_from->sin_port));
+	if (l_packtype == outer_packtype_dieplease) {
+		a_data[a_size] = 0;
+		printf("server: received termination packet\n");
+		printf("server: termination message: %s\n", a_data);
+		return -1;
+	} else if (l_packtype == outer_packtype_textecho) {
+		a_data[a_size] = 0;
+		printf("server: read string: (size=%lu) %s\n", a_size, a_data);
+		snprintf(l_buff, sizeof(l_buff), "greetings from the server\nmy greeting: %s\nyou sent: %s", g_greeting, a_data);
+		if (outer_send_datagram(a_fd, a_from, l_seq, outer_packtype_textecho, l_buff, strlen(l_buff) + 1) < 0)
+			fprintf(stderr, "server: can't send datagram: %s\n", strerror(errno));
+	} else if (l_packtype == outer_packtype_alice) {
+		if (!server_alice_size_ok(a_size)) {
+			fprintf(stderr, "server: malformed Alice datagram, dropping\n");
+			return 0;
 		}
-		printf("server: calling dhm_get_bob...\n");
-		dhm_result = dhm_get_bob(l_bob_session, (dhm_alice_t *)l_read_packet, l_bob, l_bob_private, g_debug);
-		if (dhm_result != DHM_ERR_NONE) {
-			fprintf(stderr, "unable to dhm_get_bob: %s\n", dhm_strerror(dhm_result));
-			exit(EXIT_FAILURE);
+		dhm_alice_t *l_alice = (dhm_alice_t *)a_data;
+		l_sess = &g_udp_sessions[udp_session_slot(l_alice->guid)];
+		if ((l_sess->used) && (memcmp(l_sess->guid, l_alice->guid, GUIDSIZE) == 0) && (memcmp(l_sess->alice_hash, l_alice->hash, SHASIZE) == 0)
+			&& (l_sess->peer.sin_addr.s_addr == a_from->sin_addr.s_addr) && (l_sess->peer.sin_port == a_from->sin_port)) {
+			// the client retransmitted because our Bob got lost; resend it rather than redo the exponentiation
+			l_sess->last_used = l_now;
+			if (l_sess->pending) {
+				if (g_debug)
+					printf("server: duplicate Alice datagram, Bob is on its way\n");
+				return 0;
+			}
+			if (g_debug)
+				printf("server: duplicate Alice datagram, resending Bob\n");
+			outer_send_datagram(a_fd, a_from, l_seq, outer_packtype_bob, &l_sess->bob, sizeof(dhm_bob_t));
+			return 0;
 		}
-		printf("server: secret (AES256 key): ");
-		for (i = 0; i < 32; ++i) {
-			printf("%02X", l_bob_session->s[i]);
-			g_aes_key[i] = l_bob_session->s[i];
+		if (server_needs_cookie(a_from->sin_addr.s_addr, a_data, a_size)) {
+			// stateless: nothing is kept, the cookie itself proves we issued it when it comes back
+			uint8_t l_cookie[OUTER_COOKIESIZE];
+			outer_cookie_make(&g_cookies, a_from->sin_addr.s_addr, l_alice, l_cookie);
+			outer_send_datagram(a_fd, a_from, l_seq, outer_packtype_cookie, l_cookie, OUTER_COOKIESIZE);
+			if (g_debug)
+				printf("server: sent cookie to %s:%d.\n", inet_ntoa(a_from->sin_addr), ntohs(a_from->sin_port));
+			return 0;
 		}
-		printf("\n");
-		printf("server: server (IV/nonce)  : ");
-		for (i = 32; i < 48; ++i) {
-			printf("%02X", l_bob_session->s[i]);
-			g_aes_server_iv[i - 32] = l_bob_session->s[i];
+		// hand the exponentiations to a worker so this loop keeps answering, unless they're all backed up
+		udp_handshake_t *l_hs = malloc(sizeof(udp_handshake_t));
+		if (l_hs == NULL) {
+			fprintf(stderr, "server: can't allocate handshake\n");
+			return 0;
 		}
-		printf("\n");
-		printf("server: client (IV/nonce)  : ");
-		for (i = 48; i < 64; ++i) {
-			printf("%02X", l_bob_session->s[i]);
-			g_aes_client_iv[i - 48] = l_bob_session->s[i];
+		memset(l_hs, 0, sizeof(udp_handshake_t));
+		memcpy(&l_hs->job.alice, l_alice, sizeof(dhm_alice_t));
+		outer_channel_init(&l_hs->chan, -1);
+		l_hs->job.chan = &l_hs->chan;
+		l_hs->job.complete = udp_handshake_done;
+		l_hs->fd = a_fd;
+		memcpy(&l_hs->peer, a_from, sizeof(struct sockaddr_in));
+		l_hs->seq = l_seq;
+		unsigned int l_retry_ms = 0;
+		int res = hsqueue_submit(&g_hsqueue, &l_hs->job, &l_retry_ms);
+		if (res != HSQUEUE_OK) {
+			free(l_hs);
+			if (res == HSQUEUE_BUSY) {
+				uint32_t l_retry = htonl(l_retry_ms);
+				outer_send_datagram(a_fd, a_from, l_seq, outer_packtype_busy, &l_retry, sizeof(l_retry));
+				if (g_debug)
+					printf("server: handshake queue full, told %s:%d to retry in %u ms\n", inet_ntoa(a_from->sin_addr), ntohs(a_from->sin_port), l_retry_ms);
+			}
+			return 0;
 		}
-		printf("\n");
-		// write Bob packet back to client
-		int writelen;
-		writelen = write_packet(client_sockfd, outer_packtype_bob, l_bob, sizeof(dhm_bob_t));
-		if (writelen == 0) {
-			fprintf(stderr, "server: EOF detected, exiting\n");
-			close(client_sockfd);
+		// new session: direct mapped, so it takes over its slot from whatever was there
+		// the worker can't publish before we let go of g_udp_lock, so the slot is ready for it
+		if ((l_sess->used) && (l_now - l_sess->last_used < UDP_SESSION_TTL))
+			printf("server: session cache collision, evicting a live session\n");
+		outer_channel_close(&l_sess->chan);
+		memset(l_sess, 0, sizeof(udp_session_t));
+		outer_channel_init(&l_sess->chan, -1);
+		l_sess->used = 1;
+		l_sess->pending = 1;
+		memcpy(l_sess->guid, l_alice->guid, GUIDSIZE);
+		memcpy(l_sess->alice_hash, l_alice->hash, SHASIZE);
+		memcpy(&l_sess->peer, a_from, sizeof(struct sockaddr_in));
+		l_sess->last_used = l_now;
+	} else if (l_packtype == outer_packtype_aes) {
+		if (a_size < GUIDSIZE)
 			return 0;
-		} else if (writelen < 0) {
-			// problems writing, fatal error
-			fprintf(stderr, "client: can't write_packet: %s\n", strerror(errno));
-			close(client_sockfd);
+		l_sess = &g_udp_sessions[udp_session_slot(a_data)];
+		if ((!l_sess->used) || (l_sess->pending) || (memcmp(l_sess->guid, a_data, GUIDSIZE) != 0)) {
+			fprintf(stderr, "server: AES datagram for unknown session, dropping\n");
 			return 0;
-		} else if (writelen != (sizeof(dhm_bob_t) + sizeof(outer_packet_header_t))) {
-			fprintf(stderr, "server: problems writing Bob packet, wrote %d bytes, expected to write %lu.\n", writelen, (sizeof(dhm_bob_t) + sizeof(outer_packet_header_t)));
-			exit(EXIT_FAILURE);
-		}
-		printf("server: wrote %d byte Bob packet to client.\n", writelen);
-		// clean up and seed the AES mechanism
-		free(l_read_header); // don't need these anymore
-		free(l_read_packet);
-		printf("server: calling dhm_end_session for Bob session...\n");
-		dhm_result = dhm_end_session(l_bob_session, 1);
-		if (dhm_result != DHM_ERR_NONE) {
-			fprintf(stderr, "unable to dhm_end_session: %s\n", dhm_strerror(dhm_result));
-			exit(EXIT_FAILURE);
 		}
-		free(l_bob);
-		free(l_bob_private);
-		free(l_bob_session);
-		
-		AES_init_ctx_iv(&g_aes_server_ctx, g_aes_key, g_aes_server_iv);
-		AES_init_ctx_iv(&g_aes_client_ctx, g_aes_key, g_aes_client_iv);
-
-		l_read_header = NULL;
-		l_read_packet = NULL;
-		read_packet_return = read_packet(client_sockfd, &l_read_header, &l_read_packet);
-		if (read_packet_return < 0) {
-			fprintf(stderr, "server: error reading encryption packet\n");
-			close(client_sockfd);
+		l_sess->last_used = l_now;
+		if ((l_sess->reply_len > 0) && (l_seq == l_sess->reply_seq)) {
+			// our reply got lost; the request can't be opened twice, so resend the sealed reply we kept
+			if (g_debug)
+				printf("server: duplicate AES datagram, resending reply\n");
+			outer_send_datagram(a_fd, a_from, l_seq, outer_packtype_aes, l_sess->reply, l_sess->reply_len);
 			return 0;
 		}
-		printf("server: received packet type %04X, sequence %d from client.\n", ntohs(l_read_header->packtype), ntohl(l_read_header->sequence));
-		if (ntohs(l_read_header->packtype) != outer_packtype_aes) {
-			fprintf(stderr, "server: expecting AES packet, error!\n");
-			close(client_sockfd);
+		size_t l_size = a_size - GUIDSIZE;
+		if (outer_open_aes(&l_sess->chan, a_data + GUIDSIZE, &l_size) < 0) {
+			fprintf(stderr, "server: AES datagram failed authentication, dropping\n");
 			return 0;
 		}
-		// decrypt the payload
-		AES_CTR_xcrypt_buffer(&g_aes_client_ctx, (uint8_t *)l_read_packet, ntohs(l_read_header->size));
-		printf("server: read string: (size=%d) %s\n", ntohs(l_read_header->size), l_read_packet);
-		// prepare reply message
-		char l_buff[BUFFLEN];
-		sprintf(l_buff, "greetings from the server\nmy greeting: %s\nyou sent: %s", g_greeting, l_read_packet);
-		free(l_read_header); // don't need these anymore
-		free(l_read_packet);
+		a_data[GUIDSIZE + l_size] = 0;
+		if (g_debug)
+			printf("server: read string: (size=%lu) %s\n", l_size, a_data + GUIDSIZE);
+		snprintf(l_buff, sizeof(l_buff), "greetings from the server\nmy greeting: %s\nyou sent: %s", g_greeting, a_data + GUIDSIZE);
+		memcpy(l_sess->reply, l_sess->guid, GUIDSIZE);
+		l_sess->reply_len = GUIDSIZE + outer_seal_aes(&l_sess->chan, (uint8_t *)l_buff, strlen(l_buff) + 1, l_sess->reply + GUIDSIZE);
+		l_sess->reply_seq = l_seq;
+		if (outer_send_datagram(a_fd, a_from, l_seq, outer_packtype_aes, l_sess->reply, l_sess->reply_len) < 0)
+			fprintf(stderr, "server: can't send datagram: %s\n", strerror(errno));
+	} else {
+		fprintf(stderr, "server: unknown datagram type %04X, dropping\n", l_packtype);
+	}
+	return 0;
+}
 
-		size_t l_buff_len = strlen(l_buff) + 1;
-		AES_CTR_xcrypt_buffer(&g_aes_server_ctx, (uint8_t *)l_buff, l_buff_len);
-		
-		// echo the string back, encrypted this time
-		writelen = write_packet(client_sockfd, outer_packtype_aes, l_buff, l_buff_len);
-		if (writelen == 0) {
-			fprintf(stderr, "server: EOF detected, hanging up\n");
-			close(client_sockfd);
-			return 0;
-		} else if (writelen < 0) {
-			// problems reading, nonfatal error that will recycle the server
-			fprintf(stderr, "server: can't write_packet: %s\n", strerror(errno));
-			close(client_sockfd);
-			return 0;
+void mode_server_udp()
+{
+	// a single loop answers every client; there is no connection to accept or hold open,
+	// and all per-session state lives in a fixed size cache keyed by GUID
+	printf("establishing a UDP server on port %d\n", g_port);
+
+	int sockfd;
+	int i;
+	struct sockaddr_in server_address;
+	struct sockaddr_in client_address;
+	outer_packet_header_t l_header;
+	uint8_t l_data[UDP_MAXPAYLOAD + 1]; // room to zero terminate strings
+	ssize_t l_len;
+
+	g_udp_sessions = calloc(UDP_SESSIONS, sizeof(udp_session_t));
+	if (g_udp_sessions == NULL) {
+		fprintf(stderr, "server: unable to allocate memory for session cache.\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < UDP_SESSIONS; ++i)
+		outer_channel_init(&g_udp_sessions[i].chan, -1);
+	sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+	server_address.sin_family = AF_INET;
+	server_address.sin_addr.s_addr = htonl(INADDR_ANY);
+	server_address.sin_port = htons(g_port);
+	int reuse = 1;
+	if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, (char *)&reuse, sizeof(reuse)) < 0) {
+		fprintf(stderr, "server: can't setsockopt: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	if (bind(sockfd, (struct sockaddr *)&server_address, sizeof(server_address)) < 0) {
+		fprintf(stderr, "server: can't bind: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	printf("server: ***** waiting for datagrams *****\n");
+	while (1) {
+		l_len = outer_recv_datagram(sockfd, &client_address, &l_header, l_data, UDP_MAXPAYLOAD);
+		if (l_len < 0)
+			continue; // malformed or truncated, nothing to answer
+		pthread_mutex_lock(&g_udp_lock);
+		int res = udp_server_datagram(sockfd, &client_address, &l_header, l_data, l_len);
+		pthread_mutex_unlock(&g_udp_lock);
+		if (res < 0)
+			break;
+	}
+	printf("server: gracefully shutting down...\n");
+	server_report_stats();
+	hsqueue_destroy(&g_hsqueue); // finish off handshakes in flight before the sessions go away
+	for (i = 0; i < UDP_SESSIONS; ++i)
+		outer_channel_close(&g_udp_sessions[i].chan);
+	free(g_udp_sessions);
+	g_udp_sessions = NULL;
+	close(sockfd);
+}
+
+void mode_server_shm()
+{
+	// same as the TCP server, but peers attach over a local Unix socket and get shared memory rings
+	pthread_attr_t l_attr;
+	server_conn_t *l_conn;
+
+	printf("establishing a shared memory server at %s\n", g_shm_name);
+	g_server_sockfd = outer_shm_listen(g_shm_name);
+	if (g_server_sockfd < 0)
+		exit(EXIT_FAILURE);
+	server_start_wheel();
+	pthread_attr_init(&l_attr);
+	pthread_attr_setdetachstate(&l_attr, PTHREAD_CREATE_DETACHED);
+	while (1) {
+		printf("server: ***** waiting for connection *****\n");
+		l_conn = server_new_conn();
+		if (l_conn == NULL)
+			break;
+		if (outer_shm_accept(g_server_sockfd, &l_conn->chan) < 0) {
+			free(l_conn);
+			if (g_server_shutdown)
+				break;
+			if ((errno != EINTR) && (errno != ECONNABORTED))
+				fprintf(stderr, "server: can't accept: %s\n", strerror(errno));
+			continue;
 		}
-		printf("server: write %d byte encrypted packet back to client.\n", writelen);
-		close(client_sockfd);
+		printf("server: local client attached to shared memory rings\n");
+		server_start_conn(l_conn, &l_attr);
 	}
-	return 0;
+	pthread_attr_destroy(&l_attr);
+	close(g_server_sockfd);
+	server_report_stats();
 }
 
 void mode_server()
 {
+	if ((g_cookie > 0) && (outer_cookie_init(&g_cookies) < 0))
+		exit(EXIT_FAILURE);
+	if (g_workers <= 0)
+		g_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (g_workers > HSQUEUE_MAXWORKERS)
+		g_workers = HSQUEUE_MAXWORKERS;
+	if (hsqueue_init(&g_hsqueue, g_workers, g_hwm, g_debug) < 0) {
+		fprintf(stderr, "server: unable to start handshake workers\n");
+		exit(EXIT_FAILURE);
+	}
+	printf("server: %d handshake workers, up to %d handshakes waiting\n", g_workers, g_hwm);
+	if (g_shm > 0) {
+		mode_server_shm();
+		return;
+	}
+	if (g_udp > 0) {
+		mode_server_udp();
+		return;
+	}
 	printf("establishing a TCP server on port %d\n", g_port);
 
 	// set up variables
 	int res;
-	int server_sockfd, client_sockfd;
+	int client_sockfd;
 	unsigned int server_len, client_len;
 	struct sockaddr_in server_address;
 	struct sockaddr_in client_address;
+	pthread_attr_t l_attr;
+	server_conn_t *l_conn;
 
 	// remove any old sockets and create an unnamed socket for the server
-	server_sockfd = socket(AF_INET, SOCK_STREAM, 0);
+	g_server_sockfd = socket(AF_INET, SOCK_STREAM, 0);
 
 	// name the socket
 	server_address.sin_family = AF_INET;
@@ -642,33 +1142,49 @@ void mode_server()
 	server_address.sin_port = htons(g_port);
 	server_len = sizeof(server_address);
 	int reuse = 1;
-	if (setsockopt(server_sockfd, SOL_SOCKET, SO_REUSEADDR, (char *)&reuse, sizeof(reuse)) < 0) {
+	if (setsockopt(g_server_sockfd, SOL_SOCKET, SO_REUSEADDR, (char *)&reuse, sizeof(reuse)) < 0) {
 		// can't setsockopt, this is a fatal error
 		fprintf(stderr, "server: can't setsockopt: %s\n", strerror(errno));
 		exit(EXIT_FAILURE);
 	}
-	res = bind(server_sockfd, (struct sockaddr *)&server_address, server_len);
+	res = bind(g_server_sockfd, (struct sockaddr *)&server_address, server_len);
 	if (res < 0) {
 		// can't bind, this is a fatal error
 		fprintf(stderr, "server: can't bind: %s\n", strerror(errno));
 		exit(EXIT_FAILURE);
 	}
 	// create a connection queue and wait for clients
-	listen(server_sockfd, 5);
+	listen(g_server_sockfd, 64);
+	server_start_wheel();
+	pthread_attr_init(&l_attr);
+	pthread_attr_setdetachstate(&l_attr, PTHREAD_CREATE_DETACHED);
 	while (1) {
 		printf("server: ***** waiting for connection *****\n");
 		
 		// accept a connection
 		client_len = sizeof(client_address);
-		client_sockfd = accept(server_sockfd, (struct sockaddr *)&client_address, &client_len);
+		client_sockfd = accept(g_server_sockfd, (struct sockaddr *)&client_address, &client_len);
+		if (client_sockfd < 0) {
+			if (g_server_shutdown)
+				break;
+			if (errno != EINTR)
+				fprintf(stderr, "server: can't accept: %s\n", strerror(errno));
+			continue;
+		}
 
 		printf("server: client %s:%d connecting...\n", inet_ntoa(client_address.sin_addr), ntohs(client_address.sin_port));
-		if (server_action(client_sockfd) < 0) {
-			printf("server: gracefully shutting down...\n");
-			close(server_sockfd);
-			return;
+		l_conn = server_new_conn();
+		if (l_conn == NULL) {
+			close(client_sockfd);
+			continue;
 		}
+		outer_channel_init(&l_conn->chan, client_sockfd);
+		l_conn->addr = client_address.sin_addr.s_addr;
+		server_start_conn(l_conn, &l_attr);
 	}
+	pthread_attr_destroy(&l_attr);
+	close(g_server_sockfd);
+	server_report_stats();
 }
 
 void mode_local()
@@ -688,6 +1204,11 @@ void mode_local()
 		fprintf(stderr, "unable to dhm_init_session: %s\n", dhm_strerror(dhm_result));
 		exit(EXIT_FAILURE);
 	}
+	dhm_result = dhm_set_hashalg(l_alice_session, g_hashalg);
+	if (dhm_result != DHM_ERR_NONE) {
+		fprintf(stderr, "unable to dhm_set_hashalg: %s\n", dhm_strerror(dhm_result));
+		exit(EXIT_FAILURE);
+	}
 	
 	dhm_alice_t *l_alice = NULL;
 	l_alice = malloc(sizeof(dhm_alice_t));
@@ -714,6 +1235,7 @@ void mode_local()
 		for (i = 0; i < SHASIZE; ++i) {
 			printf("%02X", l_alice->hash[i]);
 		}
+		printf("\nhashalg: %d", l_alice->hashalg);
 		printf("\nguid: ");
 		for (i = 0; i < GUIDSIZE; ++i) {
 			printf("%02X", l_alice->guid[i]);
@@ -816,7 +1338,11 @@ void mode_local()
 	// Alice has received Bob's reply packet and now will use it to compute her copy of the secret
 	
 	printf("local (Alice): calling dhm_alice_secret\n");
-	dhm_alice_secret(l_alice_session, l_alice, l_bob, l_alice_private, g_debug);
+	dhm_result = dhm_alice_secret(l_alice_session, l_alice, l_bob, l_alice_private, g_debug);
+	if (dhm_result != DHM_ERR_NONE) {
+		fprintf(stderr, "unable to dhm_alice_secret: %s\n", dhm_strerror(dhm_result));
+		exit(EXIT_FAILURE);
+	}
 	if (g_showpacks) {
 		printf("local (Alice): secret key\n");
 		printf("s: ");
@@ -872,7 +1398,7 @@ int main(int argc, char **argv)
 	// set up default greeting in case user doesn't enter one
 	strcpy(g_greeting, "Default greeting");
 	
-	while ((opt = getopt_long(argc, argv, "dp?c:so:g:xe", g_options, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "dp?c:so:g:xea:l:r:k:umt:i:yw:q:", g_options, NULL)) != -1) {
 		switch (opt) {
 			case 'x':
 				{
@@ -886,6 +1412,84 @@ int main(int argc, char **argv)
 					printf("enabling diffie/hellman/merkle and AES encryption on sockets.\n");
 				}
 				break;
+			case 'a':
+				{
+					if (strcmp(optarg, "sha224") == 0) {
+						g_hashalg = DHM_HASH_SHA224;
+					} else if (strcmp(optarg, "sha512-224") == 0) {
+						g_hashalg = DHM_HASH_SHA512_224;
+					} else {
+						fprintf(stderr, "unknown packet hash algorithm %s, use sha224 or sha512-224\n", optarg);
+						exit(EXIT_FAILURE);
+					}
+					printf("using %s for DHM packet hashes.\n", optarg);
+				}
+				break;
+			case 'l':
+				{
+					g_pool = atoi(optarg);
+					if ((g_pool < 1) || (g_pool > DHMPOOL_MAXSIZE)) {
+						fprintf(stderr, "pool size must be between 1 and %d\n", DHMPOOL_MAXSIZE);
+						exit(EXIT_FAILURE);
+					}
+				}
+				break;
+			case 'r':
+				{
+					g_requests = atoi(optarg);
+					if (g_requests < 1) {
+						fprintf(stderr, "number of requests must be at least 1\n");
+						exit(EXIT_FAILURE);
+					}
+				}
+				break;
+			case 'k':
+				{
+					g_rekey = strtoull(optarg, NULL, 10);
+				}
+				break;
+			case 'u':
+				{
+					g_udp = 1;
+					printf("using UDP datagrams instead of TCP connections.\n");
+				}
+				break;
+			case 'm':
+				{
+					g_shm = 1;
+					printf("using shared memory rings instead of TCP connections.\n");
+				}
+				break;
+			case 't':
+				{
+					g_handshake_ms = atoi(optarg);
+				}
+				break;
+			case 'i':
+				{
+					g_idle_ms = atoi(optarg);
+				}
+				break;
+			case 'y':
+				{
+					g_cookie = 1;
+					printf("requiring cookies before DHM exchanges.\n");
+				}
+				break;
+			case 'w':
+				{
+					g_workers = atoi(optarg);
+				}
+				break;
+			case 'q':
+				{
+					g_hwm = atoi(optarg);
+					if (g_hwm < 0) {
+						fprintf(stderr, "--hwm must not be negative\n");
+						exit(EXIT_FAILURE);
+					}
+				}
+				break;
 			case 'd':
 				{
 					g_debug = 1;
@@ -895,6 +1499,7 @@ int main(int argc, char **argv)
 			case 'p':
 				{
 					g_showpacks = 1;
+					outer_showpacks = 1;
 					printf("showing constructed packets.\n");
 				}
 				break;
@@ -934,6 +1539,20 @@ int main(int argc, char **argv)
 					printf("  -c (--connect) <IP> select client mode, specify host in dotted IP format\n");
 					printf("  -x (--reqsd) client mode only: request server shut down gracefully\n");
 					printf("  -e {--encrypt) client mode only: use diffie/hellman/merkle and AES\n");
+					printf("  -a (--hash) <sha224|sha512-224> client/local mode: DHM packet hash algorithm (default sha224)\n");
+					printf("     sha512-224 uses the 64 bit SHA2-512 core and is faster on 64 bit machines\n");
+					printf("  -l (--pool) <n> client mode with -e: keep n secure sessions open and reuse them\n");
+					printf("  -r (--requests) <n> client mode with --pool: number of requests to send (default 100)\n");
+					printf("  -k (--rekey) <bytes> encrypted client or server: ratchet session keys every <bytes> sent\n");
+					printf("  -u (--udp) client or server: one UDP datagram per packet, no TCP connection\n");
+					printf("     --pool and --rekey are TCP only\n");
+					printf("  -m (--shm) client or server on the same host: packets go through shared memory\n");
+					printf("     the rendezvous name comes from --port, and the client's host address is ignored\n");
+					printf("  -t (--hstimeout) <ms> server mode: hang up on a new connection that sends nothing for <ms> (default 10000, 0 for never)\n");
+					printf("  -i (--idle) <ms> server mode: hang up on a connection idle between packets for <ms> (default 300000, 0 for never)\n");
+					printf("  -y (--cookie) server mode: clients must echo a stateless cookie before the server computes Bob\n");
+					printf("  -w (--workers) <n> server mode: threads computing Bob packets (default one per CPU)\n");
+					printf("  -q (--hwm) <n> server mode: handshakes that may wait for a worker before clients are told to retry later (default 32)\n");
 					printf("  -s (--server) select server mode\n");
 					printf("  omit -c and -s flags to run in local mode without socket connection\n");
 					exit(EXIT_SUCCESS);
@@ -942,6 +1561,16 @@ int main(int argc, char **argv)
 		}
 	}
 	
+	if (g_udp && g_shm) {
+		fprintf(stderr, "--udp and --shm can't be used together\n");
+		exit(EXIT_FAILURE);
+	}
+	if (g_pool && (g_udp || g_shm)) {
+		fprintf(stderr, "--pool can't be used with --udp or --shm\n");
+		exit(EXIT_FAILURE);
+	}
+	snprintf(g_shm_name, sizeof(g_shm_name), "diffie-dhmtest-%d", g_port);
+
 	switch (g_mode) {
 		case 0:
 			printf("selecting local mode\n");
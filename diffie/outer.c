@@ -0,0 +1,1100 @@
+/**
+ *
+ * Diffie/Hellman/Merkle Implementation
+ * 2025/Nov/11 - Revision 0.80 alpha
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file outer.c
+ * @brief Outer protocol: framed packets and keyed secure channels
+ *
+ * See outer.h for an overview.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+
+#include "outer.h"
+
+const uint16_t outer_current_version = 0x0102; ///< 0x0102: Alice and Bob carry a hashalg byte
+const uint16_t outer_packtype_dieplease = 0xd4d2;
+const uint16_t outer_packtype_textecho = 0xd4d3;
+const uint16_t outer_packtype_alice = 0xd4d4;
+const uint16_t outer_packtype_bob = 0xd4d5;
+const uint16_t outer_packtype_aes = 0xd4d6;
+const uint16_t outer_packtype_rekey = 0xd4d7;
+const uint16_t outer_packtype_cookie = 0xd4d8;
+const uint16_t outer_packtype_busy = 0xd4d9;
+
+#define REKEY_LABEL "diffie outer rekey" ///< domain separation for the key ratchet
+
+int outer_showpacks = 0;
+
+/**
+ * @brief Write all of a buffer to a file descriptor, retrying short writes
+ *
+ * @return number of bytes written, or -1 on error
+ */
+
+static ssize_t write_full(int a_fd, const uint8_t *a_buff, size_t a_size)
+{
+	size_t l_done = 0;
+	ssize_t res;
+	while (l_done < a_size) {
+		res = write(a_fd, a_buff + l_done, a_size - l_done);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		l_done += res;
+	}
+	return l_done;
+}
+
+/**
+ * @brief Read exactly a_size bytes unless EOF or an error comes first
+ *
+ * @return number of bytes read (less than a_size only at EOF), or -1 on error
+ */
+
+static ssize_t read_full(int a_fd, uint8_t *a_buff, size_t a_size)
+{
+	size_t l_done = 0;
+	ssize_t res;
+	while (l_done < a_size) {
+		res = read(a_fd, a_buff + l_done, a_size - l_done);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (res == 0)
+			break;
+		l_done += res;
+	}
+	return l_done;
+}
+
+/**
+ * @brief Read exactly a_size bytes from whichever transport the channel uses
+ *
+ * @return number of bytes read (less than a_size only at EOF), or -1 on error
+ */
+
+static ssize_t chan_read_full(outer_channel_t *a_chan, uint8_t *a_buff, size_t a_size)
+{
+	if (a_chan->ring != NULL)
+		return shmring_read(a_chan->ring, a_buff, a_size);
+	return read_full(a_chan->fd, a_buff, a_size);
+}
+
+static void show_packet(const char *a_what, int a_fd, const outer_packet_header_t *a_header, const uint8_t *a_data)
+{
+	int i;
+	printf("%s fd %d\n", a_what, a_fd);
+	printf("  version: %04X\n", ntohs(a_header->version));
+	printf("  packtype: %04X\n", ntohs(a_header->packtype));
+	printf("  sequence: %d\n", ntohl(a_header->sequence));
+	printf("  data: (size: %d)", ntohs(a_header->size));
+	for (i = 0; i < ntohs(a_header->size); ++i) {
+		if (i % 32 == 0)
+			printf("\n");
+		printf("%02X ", a_data[i]);
+	}
+	printf("\n");
+}
+
+/**
+ * @brief Initialize a channel around a socket
+ *
+ * @param[in] a_chan Channel to initialize. It is the responsibility of the caller to allocate memory for this structure.
+ * @param[in] a_fd Connected socket, or -1 if it will be filled in later
+ */
+
+void outer_channel_init(outer_channel_t *a_chan, int a_fd)
+{
+	memset(a_chan, 0, sizeof(outer_channel_t));
+	a_chan->fd = a_fd;
+	a_chan->sequence = 1;
+}
+
+/**
+ * @brief Close the channel's socket and wipe its key material
+ *
+ * @param[in] a_chan Channel to close
+ */
+
+void outer_channel_close(outer_channel_t *a_chan)
+{
+	if (a_chan->ring != NULL) {
+		shmring_close(a_chan->ring);
+		free(a_chan->ring);
+	}
+	if (a_chan->fd >= 0)
+		close(a_chan->fd);
+	outer_channel_init(a_chan, -1);
+}
+
+/**
+ * @brief Frame and send a packet
+ *
+ * @param[in] a_chan Channel to write to
+ * @param[in] a_packtype Outer packet type
+ * @param[in] a_data Payload
+ * @param[in] a_size Size of payload, at most 65535 bytes
+ * @return number of bytes written including the header, or -1 on error
+ */
+
+int outer_write_packet(outer_channel_t *a_chan, uint16_t a_packtype, const void *a_data, size_t a_size)
+{
+	if (a_size > 0xffff) {
+		fprintf(stderr, "outer_write_packet: payload of %lu bytes is too large\n", a_size);
+		return -1;
+	}
+	// fill in outer packet header
+	outer_packet_header_t l_header;
+	l_header.size = htons(a_size);
+	l_header.packtype = htons(a_packtype);
+	l_header.version = htons(outer_current_version);
+	l_header.sequence = htonl(a_chan->sequence++);
+
+	if (a_chan->ring != NULL) {
+		// header and payload go straight into the ring, no staging copy
+		struct iovec l_iov[2];
+		l_iov[0].iov_base = &l_header;
+		l_iov[0].iov_len = sizeof(outer_packet_header_t);
+		l_iov[1].iov_base = (void *)a_data;
+		l_iov[1].iov_len = a_size;
+		if (outer_showpacks)
+			show_packet("outer_write_packet: sending packet to", a_chan->fd, &l_header, a_data);
+		return shmring_writev(a_chan->ring, l_iov, 2);
+	}
+
+	// allocate space for packet header + packet data
+	size_t l_pack_size = sizeof(outer_packet_header_t) + a_size;
+	uint8_t *l_pack = malloc(l_pack_size);
+	if (l_pack == NULL) {
+		fprintf(stderr, "outer_write_packet: can't allocate space for packet\n");
+		return -1;
+	}
+
+	// assemble packet so it goes out in one write
+	memcpy(l_pack, &l_header, sizeof(outer_packet_header_t));
+	memcpy(l_pack + sizeof(outer_packet_header_t), a_data, a_size);
+
+	if (outer_showpacks)
+		show_packet("outer_write_packet: sending packet to", a_chan->fd, &l_header, l_pack + sizeof(outer_packet_header_t));
+
+	ssize_t writelen = write_full(a_chan->fd, l_pack, l_pack_size);
+	free(l_pack);
+	return writelen;
+}
+
+/**
+ * @brief Read one packet
+ * Returns a header block and a data packet which the caller is responsible
+ * for freeing. In case of error, returns -1 and frees anything it allocated.
+ * A clean EOF before the header also returns -1, without complaining.
+ *
+ * @param[in] a_chan Channel to read from
+ * @param[out] a_header Receives the header, in network byte order
+ * @param[out] a_data Receives the payload
+ * @return 0 on success, -1 on error or EOF
+ */
+
+int outer_read_packet(outer_channel_t *a_chan, outer_packet_header_t **a_header, uint8_t **a_data)
+{
+	ssize_t readlen;
+
+	outer_packet_header_t *l_header = malloc(sizeof(outer_packet_header_t));
+	if (l_header == NULL) {
+		fprintf(stderr, "outer_read_packet: can't allocate header\n");
+		return -1;
+	}
+	// read in the header
+	readlen = chan_read_full(a_chan, (uint8_t *)l_header, sizeof(outer_packet_header_t));
+	if (readlen != sizeof(outer_packet_header_t)) {
+		if (readlen != 0)
+			fprintf(stderr, "outer_read_packet: failure reading packet header, expected %ld bytes, got %ld\n", sizeof(outer_packet_header_t), readlen);
+		free(l_header);
+		return -1;
+	}
+	// allocate buffer for actual packet based on size field of header, plus one so an empty payload still mallocs
+	uint8_t *l_data = malloc(ntohs(l_header->size) + 1);
+	if (l_data == NULL) {
+		fprintf(stderr, "outer_read_packet: can't allocate space for packet data\n");
+		free(l_header);
+		return -1;
+	}
+	// read in packet data
+	readlen = chan_read_full(a_chan, l_data, ntohs(l_header->size));
+	if (readlen != ntohs(l_header->size)) {
+		fprintf(stderr, "outer_read_packet: failure to read packet data, expected %d bytes, got %ld\n", ntohs(l_header->size), readlen);
+		free(l_header);
+		free(l_data);
+		return -1;
+	}
+	if (outer_showpacks)
+		show_packet("outer_read_packet: read packet from", a_chan->fd, l_header, l_data);
+	// a peer speaking another version lays out its Alice and Bob packets differently
+	if (ntohs(l_header->version) != outer_current_version) {
+		fprintf(stderr, "outer_read_packet: peer speaks protocol version %04X, we speak %04X\n", ntohs(l_header->version), outer_current_version);
+		free(l_header);
+		free(l_data);
+		return -1;
+	}
+
+	*a_header = l_header;
+	*a_data = l_data;
+	return 0;
+}
+
+static void direction_keys(outer_direction_t *a_dir, const uint8_t *a_key, const uint8_t *a_iv, const uint8_t *a_mac_key)
+{
+	memcpy(a_dir->key, a_key, 32);
+	memcpy(a_dir->iv, a_iv, 16);
+	memcpy(a_dir->mac_key, a_mac_key, 32);
+	AES_init_ctx_iv(&a_dir->aes, a_dir->key, a_dir->iv);
+	hmac_sha256_init(&a_dir->hmac, a_dir->mac_key, 32);
+	a_dir->seq = 0;
+	a_dir->ctr = 0;
+	a_dir->epoch = 0;
+	a_dir->epoch_bytes = 0;
+	a_dir->epoch_start = time(NULL);
+}
+
+/**
+ * @brief Advance one direction's keys one step along the ratchet
+ * (key, MAC key) = SHA2-512(label || new epoch || key || MAC key || nonce).
+ * The old keys are overwritten, and the hash can't be run backwards, so
+ * earlier epochs stay protected even if the current keys leak. The nonce
+ * stays the same; the CTR offset starts over because the AES key is new.
+ *
+ * @param[in] a_dir Direction to advance
+ */
+
+static void direction_ratchet(outer_direction_t *a_dir)
+{
+	uint8_t l_out[SHA512_DIGEST_SIZE];
+	uint32_t l_epoch = htonl(a_dir->epoch + 1);
+	sha512_ctx l_ctx;
+
+	sha512_init(&l_ctx);
+	sha512_update(&l_ctx, (const uint8_t *)REKEY_LABEL, strlen(REKEY_LABEL));
+	sha512_update(&l_ctx, (const uint8_t *)&l_epoch, sizeof(l_epoch));
+	sha512_update(&l_ctx, a_dir->key, 32);
+	sha512_update(&l_ctx, a_dir->mac_key, 32);
+	sha512_update(&l_ctx, a_dir->iv, 16);
+	sha512_final(&l_ctx, l_out);
+	memcpy(a_dir->key, l_out, 32);
+	memcpy(a_dir->mac_key, l_out + 32, 32);
+	memset(l_out, 0, sizeof(l_out));
+	memset(&l_ctx, 0, sizeof(l_ctx));
+
+	AES_init_ctx_iv(&a_dir->aes, a_dir->key, a_dir->iv);
+	hmac_sha256_init(&a_dir->hmac, a_dir->mac_key, 32);
+	a_dir->ctr = 0;
+	a_dir->epoch++;
+	a_dir->epoch_bytes = 0;
+	a_dir->epoch_start = time(NULL);
+}
+
+/**
+ * @brief Key a channel from a DHM shared secret
+ * The secret is carved up as AES key s[0..31], server nonce s[32..47],
+ * client nonce s[48..63], client MAC key s[64..95] and server MAC key
+ * s[96..127]. The HMAC midstates are computed here, once per channel.
+ * The channel keeps no copy of the shared key outside the two directions,
+ * so once both have ratcheted it is gone; callers wipe a_secret themselves.
+ *
+ * @param[in] a_chan Channel to key
+ * @param[in] a_secret Shared secret from the DHM session
+ * @param[in] a_server 1 on the server end, 0 on the client end
+ */
+
+void outer_channel_keys(outer_channel_t *a_chan, const uint8_t *a_secret, int a_server)
+{
+	if (a_server) {
+		direction_keys(&a_chan->tx, a_secret, a_secret + 32, a_secret + 96);
+		direction_keys(&a_chan->rx, a_secret, a_secret + 48, a_secret + 64);
+	} else {
+		direction_keys(&a_chan->tx, a_secret, a_secret + 48, a_secret + 64);
+		direction_keys(&a_chan->rx, a_secret, a_secret + 32, a_secret + 96);
+	}
+	a_chan->keyed = 1;
+}
+
+static void aes_packet_mac(hmac_sha256_ctx *a_hmac, uint32_t a_seq, const uint8_t *a_data, size_t a_size, uint8_t *a_mac)
+{
+	// MAC = HMAC-SHA256(direction key, sequence || ciphertext), starting from the cached midstates
+	uint32_t l_seq = htonl(a_seq);
+	hmac_sha256_reinit(a_hmac);
+	hmac_sha256_update(a_hmac, (uint8_t *)&l_seq, sizeof(l_seq));
+	hmac_sha256_update(a_hmac, a_data, a_size);
+	hmac_sha256_final(a_hmac, a_mac, OUTER_MACSIZE);
+}
+
+/**
+ * @brief Encrypt, authenticate and send an AES packet
+ * Encrypt-then-MAC: the payload is the ciphertext followed by the tag. The
+ * keystream continues from where the previous packet in this direction
+ * left off.
+ *
+ * @param[in] a_chan Keyed channel
+ * @param[in] a_data Plaintext, left intact
+ * @param[in] a_size Size of plaintext
+ * @return number of bytes written including the header, or -1 on error
+ */
+
+int outer_write_aes(outer_channel_t *a_chan, const uint8_t *a_data, size_t a_size)
+{
+	// rotate our keys first if this key has carried enough data or is old enough
+	if (((a_chan->rekey_bytes > 0) && (a_chan->tx.epoch_bytes + a_size > a_chan->rekey_bytes) && (a_chan->tx.epoch_bytes > 0))
+		|| ((a_chan->rekey_seconds > 0) && (time(NULL) - a_chan->tx.epoch_start >= a_chan->rekey_seconds))) {
+		if (outer_send_rekey(a_chan) < 0)
+			return -1;
+	}
+	uint8_t *l_payload = malloc(a_size + OUTER_MACSIZE);
+	if (l_payload == NULL) {
+		fprintf(stderr, "outer_write_aes: can't allocate space for packet\n");
+		return -1;
+	}
+	size_t l_sealed = outer_seal_aes(a_chan, a_data, a_size, l_payload);
+	int writelen = outer_write_packet(a_chan, outer_packtype_aes, l_payload, l_sealed);
+	free(l_payload);
+	return writelen;
+}
+
+/**
+ * @brief Encrypt and authenticate an AES packet payload without sending it
+ * Used directly by transports that do their own framing (datagrams). The
+ * sending direction's counters advance as if the packet had been sent.
+ *
+ * @param[in] a_chan Keyed channel
+ * @param[in] a_data Plaintext, left intact
+ * @param[in] a_size Size of plaintext
+ * @param[out] a_out Buffer of at least a_size + OUTER_MACSIZE bytes for ciphertext and tag
+ * @return size of the sealed payload
+ */
+
+size_t outer_seal_aes(outer_channel_t *a_chan, const uint8_t *a_data, size_t a_size, uint8_t *a_out)
+{
+	AES_CTR_xcrypt(&a_chan->tx.aes, a_data, a_out, a_size, a_chan->tx.ctr);
+	aes_packet_mac(&a_chan->tx.hmac, a_chan->tx.seq, a_out, a_size, a_out + a_size);
+	a_chan->tx.seq++;
+	a_chan->tx.ctr += (a_size + AES_BLOCKLEN - 1) / AES_BLOCKLEN;
+	a_chan->tx.epoch_bytes += a_size;
+	return a_size + OUTER_MACSIZE;
+}
+
+/**
+ * @brief Authenticate and decrypt a received AES packet in place
+ * The tag is checked before the ciphertext is touched.
+ *
+ * @param[in] a_chan Keyed channel
+ * @param[in,out] a_data Payload of the AES packet, plaintext on return
+ * @param[in,out] a_size Size of payload on entry, size of plaintext on return
+ * @return 0 on success, -1 if the packet is too short or has been tampered with
+ */
+
+int outer_open_aes(outer_channel_t *a_chan, uint8_t *a_data, size_t *a_size)
+{
+	uint8_t l_mac[OUTER_MACSIZE];
+	uint8_t l_diff = 0;
+	int i;
+
+	if (*a_size < OUTER_MACSIZE)
+		return -1;
+	size_t l_size = *a_size - OUTER_MACSIZE;
+	aes_packet_mac(&a_chan->rx.hmac, a_chan->rx.seq, a_data, l_size, l_mac);
+	for (i = 0; i < OUTER_MACSIZE; ++i)
+		l_diff |= l_mac[i] ^ a_data[l_size + i]; // constant time compare
+	if (l_diff != 0)
+		return -1;
+	AES_CTR_xcrypt(&a_chan->rx.aes, a_data, a_data, l_size, a_chan->rx.ctr);
+	a_chan->rx.seq++;
+	a_chan->rx.ctr += (l_size + AES_BLOCKLEN - 1) / AES_BLOCKLEN;
+	a_chan->rx.epoch_bytes += l_size;
+	*a_size = l_size;
+	return 0;
+}
+
+/**
+ * @brief Set when outer_write_aes rotates keys on its own
+ *
+ * @param[in] a_chan Channel to configure
+ * @param[in] a_bytes Rekey before a key would carry more than this many bytes, 0 for no byte limit
+ * @param[in] a_seconds Rekey once a key has been in use this long, 0 for no time limit
+ */
+
+void outer_set_rekey(outer_channel_t *a_chan, uint64_t a_bytes, unsigned int a_seconds)
+{
+	a_chan->rekey_bytes = a_bytes;
+	a_chan->rekey_seconds = a_seconds;
+}
+
+/**
+ * @brief Advance our sending keys and tell the peer to do the same
+ * The rekey packet carries the new epoch number and is authenticated with
+ * the old MAC key, so it can't be forged or replayed. Our keys move on as
+ * soon as it is written.
+ *
+ * @param[in] a_chan Keyed channel
+ * @return number of bytes written including the header, or -1 on error
+ */
+
+int outer_send_rekey(outer_channel_t *a_chan)
+{
+	uint8_t l_payload[sizeof(uint32_t) + OUTER_MACSIZE];
+	uint32_t l_epoch = htonl(a_chan->tx.epoch + 1);
+
+	memcpy(l_payload, &l_epoch, sizeof(l_epoch));
+	aes_packet_mac(&a_chan->tx.hmac, a_chan->tx.seq, l_payload, sizeof(l_epoch), l_payload + sizeof(l_epoch));
+	int writelen = outer_write_packet(a_chan, outer_packtype_rekey, l_payload, sizeof(l_payload));
+	if (writelen < 0)
+		return -1;
+	a_chan->tx.seq++;
+	direction_ratchet(&a_chan->tx);
+	return writelen;
+}
+
+/**
+ * @brief Handle a rekey packet from the peer
+ * Checks the MAC and that the epoch is exactly one ahead, then advances our
+ * receiving keys. If our sending keys are now behind, they are advanced too
+ * (with a rekey packet of our own) so both directions stay in step.
+ *
+ * @param[in] a_chan Keyed channel
+ * @param[in] a_data Payload of the rekey packet
+ * @param[in] a_size Size of payload
+ * @return 0 on success, -1 if the packet is malformed, forged or out of order
+ */
+
+int outer_recv_rekey(outer_channel_t *a_chan, const uint8_t *a_data, size_t a_size)
+{
+	uint8_t l_mac[OUTER_MACSIZE];
+	uint8_t l_diff = 0;
+	uint32_t l_epoch;
+	int i;
+
+	if (a_size != sizeof(uint32_t) + OUTER_MACSIZE)
+		return -1;
+	aes_packet_mac(&a_chan->rx.hmac, a_chan->rx.seq, a_data, sizeof(uint32_t), l_mac);
+	for (i = 0; i < OUTER_MACSIZE; ++i)
+		l_diff |= l_mac[i] ^ a_data[sizeof(uint32_t) + i]; // constant time compare
+	if (l_diff != 0)
+		return -1;
+	memcpy(&l_epoch, a_data, sizeof(l_epoch));
+	if (ntohl(l_epoch) != a_chan->rx.epoch + 1)
+		return -1;
+	a_chan->rx.seq++;
+	direction_ratchet(&a_chan->rx);
+	if (a_chan->tx.epoch < a_chan->rx.epoch) {
+		if (outer_send_rekey(a_chan) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Start a non-blocking TCP connect
+ * The caller can do other work (like generating an Alice packet) while the
+ * handshake is in flight, then call outer_connect_finish.
+ *
+ * @param[in] a_host Server address in dotted IP format
+ * @param[in] a_port Server port
+ * @param[out] a_fd Receives the socket
+ * @return 0 if the connect is complete or in progress, -1 on error
+ */
+
+int outer_connect_start(const char *a_host, uint16_t a_port, int *a_fd)
+{
+	struct sockaddr_in l_address;
+	int l_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (l_fd < 0) {
+		fprintf(stderr, "outer_connect_start: can't create socket: %s\n", strerror(errno));
+		return -1;
+	}
+	memset(&l_address, 0, sizeof(l_address));
+	l_address.sin_family = AF_INET;
+	l_address.sin_addr.s_addr = inet_addr(a_host);
+	l_address.sin_port = htons(a_port);
+	fcntl(l_fd, F_SETFL, fcntl(l_fd, F_GETFL, 0) | O_NONBLOCK);
+	if ((connect(l_fd, (struct sockaddr *)&l_address, sizeof(l_address)) < 0) && (errno != EINPROGRESS)) {
+		fprintf(stderr, "outer_connect_start: can't connect to %s: %s\n", a_host, strerror(errno));
+		close(l_fd);
+		return -1;
+	}
+	*a_fd = l_fd;
+	return 0;
+}
+
+/**
+ * @brief Wait for a connect started by outer_connect_start and put the socket back in blocking mode
+ *
+ * @param[in] a_fd Socket from outer_connect_start. Closed on failure.
+ * @return 0 once connected, -1 on error
+ */
+
+int outer_connect_finish(int a_fd)
+{
+	struct pollfd l_pfd;
+	int res;
+	int l_soerr = 0;
+	socklen_t l_soerr_len = sizeof(l_soerr);
+
+	l_pfd.fd = a_fd;
+	l_pfd.events = POLLOUT;
+	do {
+		res = poll(&l_pfd, 1, -1);
+	} while ((res < 0) && (errno == EINTR));
+	if ((res < 0) || (getsockopt(a_fd, SOL_SOCKET, SO_ERROR, &l_soerr, &l_soerr_len) < 0) || (l_soerr != 0)) {
+		fprintf(stderr, "outer_connect_finish: can't connect: %s\n", strerror(l_soerr != 0 ? l_soerr : errno));
+		close(a_fd);
+		return -1;
+	}
+	fcntl(a_fd, F_SETFL, fcntl(a_fd, F_GETFL, 0) & ~O_NONBLOCK);
+	return 0;
+}
+
+/**
+ * @brief Open a DHM session and build an Alice packet
+ * The session is left open for outer_client_handshake, which ends it.
+ *
+ * @return 0 on success, -1 on error
+ */
+
+int outer_prepare_alice(dhm_hashalg_t a_hashalg, dhm_session_t *a_session, dhm_alice_t *a_alice, dhm_private_t *a_alice_private, int a_debug)
+{
+	dhm_error_t dhm_result;
+
+	dhm_result = dhm_init_session(a_session, a_debug);
+	if (dhm_result != DHM_ERR_NONE) {
+		fprintf(stderr, "outer_prepare_alice: unable to dhm_init_session: %s\n", dhm_strerror(dhm_result));
+		return -1;
+	}
+	dhm_result = dhm_set_hashalg(a_session, a_hashalg);
+	if (dhm_result == DHM_ERR_NONE)
+		dhm_result = dhm_get_alice(a_session, a_alice, a_alice_private, a_debug);
+	if (dhm_result != DHM_ERR_NONE) {
+		fprintf(stderr, "outer_prepare_alice: unable to build Alice packet: %s\n", dhm_strerror(dhm_result));
+		memset(a_alice_private, 0, sizeof(dhm_private_t));
+		dhm_end_session(a_session, a_debug);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Client side of the DHM exchange
+ * Sends a prepared Alice packet, waits for Bob, computes the secret and keys
+ * the channel. Echoes a cookie or waits out a busy reply if the server asks.
+ * Ends the DHM session whether or not it succeeds.
+ *
+ * @return 0 on success, -1 on error
+ */
+
+int outer_client_handshake(outer_channel_t *a_chan, dhm_session_t *a_session, dhm_alice_t *a_alice, dhm_private_t *a_alice_private, int a_debug)
+{
+	outer_packet_header_t *l_header = NULL;
+	uint8_t *l_packet = NULL;
+	dhm_error_t dhm_result;
+	int l_ret = -1;
+
+	// the server may answer with a cookie to echo, or tell us it is busy, before it sends Bob
+	uint8_t l_alice_cookie[sizeof(dhm_alice_t) + OUTER_COOKIESIZE];
+	size_t l_alice_size = sizeof(dhm_alice_t);
+	int l_round;
+
+	memcpy(l_alice_cookie, a_alice, sizeof(dhm_alice_t));
+	for (l_round = 0; l_round < OUTER_HANDSHAKE_ROUNDS; ++l_round) {
+		if (outer_write_packet(a_chan, outer_packtype_alice, l_alice_cookie, l_alice_size) != (l_alice_size + sizeof(outer_packet_header_t))) {
+			fprintf(stderr, "outer_client_handshake: problems writing Alice packet\n");
+			goto done;
+		}
+		if (outer_read_packet(a_chan, &l_header, &l_packet) < 0) {
+			fprintf(stderr, "outer_client_handshake: error reading reply packet\n");
+			goto done;
+		}
+		uint16_t l_packtype = ntohs(l_header->packtype);
+		if ((l_packtype == outer_packtype_cookie) && (ntohs(l_header->size) == OUTER_COOKIESIZE)) {
+			// server wants proof of our address first: send Alice again with its cookie on the end
+			memcpy(l_alice_cookie + sizeof(dhm_alice_t), l_packet, OUTER_COOKIESIZE);
+			l_alice_size = sizeof(l_alice_cookie);
+		} else if ((l_packtype == outer_packtype_busy) && (ntohs(l_header->size) == sizeof(uint32_t))) {
+			// server is shedding load: wait as long as it asked and try again
+			uint32_t l_retry_ms;
+			memcpy(&l_retry_ms, l_packet, sizeof(l_retry_ms));
+			l_retry_ms = ntohl(l_retry_ms);
+			if (l_retry_ms > OUTER_BUSY_MAX_MS)
+				l_retry_ms = OUTER_BUSY_MAX_MS;
+			if (a_debug)
+				printf("outer_client_handshake: server busy, retrying in %u ms\n", l_retry_ms);
+			usleep(l_retry_ms * 1000);
+		} else {
+			break;
+		}
+		free(l_header);
+		free(l_packet);
+		l_header = NULL;
+		l_packet = NULL;
+	}
+	if (l_header == NULL) {
+		fprintf(stderr, "outer_client_handshake: server still hasn't sent Bob after %d tries\n", OUTER_HANDSHAKE_ROUNDS);
+		goto done;
+	}
+	if ((ntohs(l_header->packtype) != outer_packtype_bob) || (ntohs(l_header->size) != sizeof(dhm_bob_t))) {
+		fprintf(stderr, "outer_client_handshake: expecting Bob packet, got type %04X\n", ntohs(l_header->packtype));
+		goto done;
+	}
+	dhm_result = dhm_alice_secret(a_session, a_alice, (dhm_bob_t *)l_packet, a_alice_private, a_debug);
+	if (dhm_result != DHM_ERR_NONE) {
+		fprintf(stderr, "outer_client_handshake: unable to dhm_alice_secret: %s\n", dhm_strerror(dhm_result));
+		goto done;
+	}
+	outer_channel_keys(a_chan, a_session->s, 0);
+	l_ret = 0;
+
+done:
+	free(l_header);
+	free(l_packet);
+	memset(a_alice_private, 0, sizeof(dhm_private_t));
+	dhm_end_session(a_session, a_debug);
+	memset(a_session->s, 0, sizeof(a_session->s));
+	return l_ret;
+}
+
+/**
+ * @brief Server side of the DHM exchange
+ * Answers a received Alice packet with a Bob packet and keys the channel.
+ *
+ * @param[in] a_chan Channel the Alice packet came in on
+ * @param[in] a_alice Received Alice packet
+ * @param[in] a_debug Set this flag to 1 if you want to print debugging information.
+ * @return 0 on success, -1 on error
+ */
+
+int outer_server_handshake(outer_channel_t *a_chan, dhm_alice_t *a_alice, int a_debug)
+{
+	dhm_bob_t l_bob;
+
+	if (outer_server_bob(a_chan, a_alice, &l_bob, a_debug) < 0)
+		return -1;
+	if (outer_write_packet(a_chan, outer_packtype_bob, &l_bob, sizeof(dhm_bob_t)) != (sizeof(dhm_bob_t) + sizeof(outer_packet_header_t))) {
+		fprintf(stderr, "outer_server_handshake: problems writing Bob packet\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Compute the Bob reply to an Alice packet and key the channel, without sending anything
+ *
+ * @param[in] a_chan Channel to key
+ * @param[in] a_alice Received Alice packet
+ * @param[out] a_bob Receives the Bob packet to send back
+ * @param[in] a_debug Set this flag to 1 if you want to print debugging information.
+ * @return 0 on success, -1 on error
+ */
+
+int outer_server_bob(outer_channel_t *a_chan, dhm_alice_t *a_alice, dhm_bob_t *a_bob, int a_debug)
+{
+	dhm_session_t l_session;
+	dhm_private_t l_bob_private;
+	dhm_error_t dhm_result;
+	int l_ret = -1;
+
+	dhm_result = dhm_init_session(&l_session, a_debug);
+	if (dhm_result != DHM_ERR_NONE) {
+		fprintf(stderr, "outer_server_bob: unable to dhm_init_session: %s\n", dhm_strerror(dhm_result));
+		return -1;
+	}
+	dhm_result = dhm_get_bob(&l_session, a_alice, a_bob, &l_bob_private, a_debug);
+	if (dhm_result != DHM_ERR_NONE) {
+		fprintf(stderr, "outer_server_bob: unable to dhm_get_bob: %s\n", dhm_strerror(dhm_result));
+		goto done;
+	}
+	outer_channel_keys(a_chan, l_session.s, 1);
+	l_ret = 0;
+
+done:
+	memset(&l_bob_private, 0, sizeof(dhm_private_t));
+	dhm_end_session(&l_session, a_debug);
+	memset(&l_session, 0, sizeof(dhm_session_t));
+	return l_ret;
+}
+
+/**
+ * @brief Send one framed packet as a single datagram
+ *
+ * @param[in] a_fd Datagram socket
+ * @param[in] a_to Destination, or NULL if the socket is connected
+ * @param[in] a_sequence Sequence number for the outer header; retransmissions reuse it
+ * @param[in] a_packtype Outer packet type
+ * @param[in] a_data Payload
+ * @param[in] a_size Size of payload, at most OUTER_DATAGRAM_MAX
+ * @return number of bytes sent including the header, or -1 on error
+ */
+
+int outer_send_datagram(int a_fd, const struct sockaddr_in *a_to, uint32_t a_sequence, uint16_t a_packtype, const void *a_data, size_t a_size)
+{
+	outer_packet_header_t l_header;
+	struct iovec l_iov[2];
+	struct msghdr l_msg;
+
+	if (a_size > OUTER_DATAGRAM_MAX)
+		return -1;
+	l_header.size = htons(a_size);
+	l_header.packtype = htons(a_packtype);
+	l_header.version = htons(outer_current_version);
+	l_header.sequence = htonl(a_sequence);
+	l_iov[0].iov_base = &l_header;
+	l_iov[0].iov_len = sizeof(outer_packet_header_t);
+	l_iov[1].iov_base = (void *)a_data;
+	l_iov[1].iov_len = a_size;
+	memset(&l_msg, 0, sizeof(l_msg));
+	l_msg.msg_name = (void *)a_to;
+	l_msg.msg_namelen = (a_to != NULL) ? sizeof(struct sockaddr_in) : 0;
+	l_msg.msg_iov = l_iov;
+	l_msg.msg_iovlen = 2;
+	if (outer_showpacks)
+		show_packet("outer_send_datagram: sending datagram to", a_fd, &l_header, a_data);
+	return sendmsg(a_fd, &l_msg, 0);
+}
+
+/**
+ * @brief Receive one framed datagram
+ * Datagrams that are truncated, too short, or whose header size doesn't
+ * match what arrived are dropped and reported as errors.
+ *
+ * @param[in] a_fd Datagram socket
+ * @param[out] a_from Receives the sender's address, may be NULL
+ * @param[out] a_header Receives the header, in network byte order
+ * @param[out] a_data Buffer for the payload
+ * @param[in] a_size Size of the payload buffer
+ * @return size of the payload, or -1 on error or a malformed datagram
+ */
+
+ssize_t outer_recv_datagram(int a_fd, struct sockaddr_in *a_from, outer_packet_header_t *a_header, uint8_t *a_data, size_t a_size)
+{
+	struct iovec l_iov[2];
+	struct msghdr l_msg;
+	ssize_t res;
+
+	l_iov[0].iov_base = a_header;
+	l_iov[0].iov_len = sizeof(outer_packet_header_t);
+	l_iov[1].iov_base = a_data;
+	l_iov[1].iov_len = a_size;
+	memset(&l_msg, 0, sizeof(l_msg));
+	l_msg.msg_name = a_from;
+	l_msg.msg_namelen = (a_from != NULL) ? sizeof(struct sockaddr_in) : 0;
+	l_msg.msg_iov = l_iov;
+	l_msg.msg_iovlen = 2;
+	res = recvmsg(a_fd, &l_msg, 0);
+	if (res < 0)
+		return -1;
+	if ((l_msg.msg_flags & MSG_TRUNC) || (res < (ssize_t)sizeof(outer_packet_header_t)))
+		return -1;
+	res -= sizeof(outer_packet_header_t);
+	if ((ntohs(a_header->size) != res) || (ntohs(a_header->version) != outer_current_version))
+		return -1;
+	if (outer_showpacks)
+		show_packet("outer_recv_datagram: read datagram from", a_fd, a_header, a_data);
+	return res;
+}
+
+/**
+ * @brief Fill in a Unix socket address in the abstract namespace, so there is no socket file to clean up
+ *
+ * @return length of the address, or 0 if the name is too long
+ */
+
+static socklen_t shm_address(const char *a_name, struct sockaddr_un *a_address)
+{
+	size_t l_len = strlen(a_name);
+	if (l_len + 1 > sizeof(a_address->sun_path))
+		return 0;
+	memset(a_address, 0, sizeof(struct sockaddr_un));
+	a_address->sun_family = AF_UNIX;
+	memcpy(a_address->sun_path + 1, a_name, l_len);
+	return offsetof(struct sockaddr_un, sun_path) + 1 + l_len;
+}
+
+/**
+ * @brief Listen for same-host peers that want a shared memory channel
+ *
+ * @param[in] a_name Rendezvous name both ends agree on
+ * @return listening Unix socket for outer_shm_accept, or -1 on error
+ */
+
+int outer_shm_listen(const char *a_name)
+{
+	struct sockaddr_un l_address;
+	socklen_t l_len = shm_address(a_name, &l_address);
+	if (l_len == 0) {
+		fprintf(stderr, "outer_shm_listen: name %s is too long\n", a_name);
+		return -1;
+	}
+	int l_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (l_fd < 0) {
+		fprintf(stderr, "outer_shm_listen: can't create socket: %s\n", strerror(errno));
+		return -1;
+	}
+	if ((bind(l_fd, (struct sockaddr *)&l_address, l_len) < 0) || (listen(l_fd, 64) < 0)) {
+		fprintf(stderr, "outer_shm_listen: can't listen on %s: %s\n", a_name, strerror(errno));
+		close(l_fd);
+		return -1;
+	}
+	return l_fd;
+}
+
+/**
+ * @brief Accept a same-host peer and give it a shared memory channel
+ * Creates the ring pair, sends the client its memfd and initializes the
+ * channel around the accepted socket and the rings.
+ *
+ * @param[in] a_listen_fd Socket from outer_shm_listen
+ * @param[in] a_chan Channel to initialize. It is the responsibility of the caller to allocate memory for this structure.
+ * @return 0 on success, -1 on error (with errno from accept if that is what failed)
+ */
+
+int outer_shm_accept(int a_listen_fd, outer_channel_t *a_chan)
+{
+	int l_fd = accept(a_listen_fd, NULL, NULL);
+	if (l_fd < 0)
+		return -1;
+	shmring_t *l_ring = malloc(sizeof(shmring_t));
+	if (l_ring == NULL) {
+		fprintf(stderr, "outer_shm_accept: can't allocate ring\n");
+		close(l_fd);
+		return -1;
+	}
+	int l_memfd = shmring_create(l_ring, SHMRING_SIZE);
+	if (l_memfd < 0) {
+		free(l_ring);
+		close(l_fd);
+		return -1;
+	}
+	int res = shmring_send_fd(l_fd, l_memfd);
+	close(l_memfd);
+	if (res < 0) {
+		fprintf(stderr, "outer_shm_accept: can't pass ring to client: %s\n", strerror(errno));
+		shmring_close(l_ring);
+		free(l_ring);
+		close(l_fd);
+		return -1;
+	}
+	l_ring->peer_fd = l_fd;
+	outer_channel_init(a_chan, l_fd);
+	a_chan->ring = l_ring;
+	return 0;
+}
+
+/**
+ * @brief Connect to a same-host server and open a shared memory channel to it
+ *
+ * @param[in] a_name Rendezvous name the server listens on
+ * @param[in] a_chan Channel to initialize. It is the responsibility of the caller to allocate memory for this structure.
+ * @return 0 on success, -1 on error
+ */
+
+int outer_shm_connect(const char *a_name, outer_channel_t *a_chan)
+{
+	struct sockaddr_un l_address;
+	socklen_t l_len = shm_address(a_name, &l_address);
+	if (l_len == 0) {
+		fprintf(stderr, "outer_shm_connect: name %s is too long\n", a_name);
+		return -1;
+	}
+	int l_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (l_fd < 0) {
+		fprintf(stderr, "outer_shm_connect: can't create socket: %s\n", strerror(errno));
+		return -1;
+	}
+	if (connect(l_fd, (struct sockaddr *)&l_address, l_len) < 0) {
+		fprintf(stderr, "outer_shm_connect: can't connect to %s: %s\n", a_name, strerror(errno));
+		close(l_fd);
+		return -1;
+	}
+	int l_memfd = shmring_recv_fd(l_fd);
+	if (l_memfd < 0) {
+		fprintf(stderr, "outer_shm_connect: server didn't send a ring\n");
+		close(l_fd);
+		return -1;
+	}
+	shmring_t *l_ring = malloc(sizeof(shmring_t));
+	if ((l_ring == NULL) || (shmring_attach(l_ring, l_memfd) < 0)) {
+		free(l_ring);
+		close(l_memfd);
+		close(l_fd);
+		return -1;
+	}
+	close(l_memfd);
+	l_ring->peer_fd = l_fd;
+	outer_channel_init(a_chan, l_fd);
+	a_chan->ring = l_ring;
+	return 0;
+}
+
+/**
+ * @brief Pick a new random cookie secret
+ *
+ * @param[in] a_cookie Cookie state to initialize. It is the responsibility of the caller to allocate memory for this structure.
+ * @return 0 on success, -1 if /dev/urandom can't be read
+ */
+
+int outer_cookie_init(outer_cookie_t *a_cookie)
+{
+	uint8_t l_secret[32];
+
+	int l_fd = open("/dev/urandom", O_RDONLY);
+	if (l_fd < 0) {
+		fprintf(stderr, "outer_cookie_init: can't open /dev/urandom: %s\n", strerror(errno));
+		return -1;
+	}
+	ssize_t res = read_full(l_fd, l_secret, sizeof(l_secret));
+	close(l_fd);
+	if (res != sizeof(l_secret)) {
+		fprintf(stderr, "outer_cookie_init: can't read /dev/urandom\n");
+		return -1;
+	}
+	hmac_sha256_init(&a_cookie->hmac, l_secret, sizeof(l_secret));
+	memset(l_secret, 0, sizeof(l_secret));
+	return 0;
+}
+
+/**
+ * @brief Tag = HMAC(secret, issued || address || GUID || Alice hash), truncated
+ */
+
+static void cookie_tag(outer_cookie_t *a_cookie, uint32_t a_issued, uint32_t a_addr, const dhm_alice_t *a_alice, uint8_t *a_tag)
+{
+	hmac_sha256_ctx l_hmac;
+	uint32_t l_issued = htonl(a_issued);
+
+	memcpy(&l_hmac, &a_cookie->hmac, sizeof(hmac_sha256_ctx));
+	hmac_sha256_reinit(&l_hmac);
+	hmac_sha256_update(&l_hmac, (uint8_t *)&l_issued, sizeof(l_issued));
+	hmac_sha256_update(&l_hmac, (uint8_t *)&a_addr, sizeof(a_addr));
+	hmac_sha256_update(&l_hmac, a_alice->guid, GUIDSIZE);
+	hmac_sha256_update(&l_hmac, a_alice->hash, SHASIZE);
+	hmac_sha256_final(&l_hmac, a_tag, OUTER_COOKIESIZE - sizeof(uint32_t));
+}
+
+/**
+ * @brief Issue a cookie for an Alice packet
+ *
+ * @param[in] a_cookie Server's cookie state
+ * @param[in] a_addr Client's IPv4 address, in network byte order
+ * @param[in] a_alice Alice packet the cookie is for
+ * @param[out] a_out Receives OUTER_COOKIESIZE bytes to send back in a cookie packet
+ */
+
+void outer_cookie_make(outer_cookie_t *a_cookie, uint32_t a_addr, const dhm_alice_t *a_alice, uint8_t *a_out)
+{
+	uint32_t l_now = (uint32_t)time(NULL);
+	uint32_t l_issued = htonl(l_now);
+
+	memcpy(a_out, &l_issued, sizeof(l_issued));
+	cookie_tag(a_cookie, l_now, a_addr, a_alice, a_out + sizeof(l_issued));
+}
+
+/**
+ * @brief Check a cookie echoed back with an Alice packet
+ *
+ * @param[in] a_cookie Server's cookie state
+ * @param[in] a_addr Address the Alice packet came from, in network byte order
+ * @param[in] a_alice The Alice packet
+ * @param[in] a_in OUTER_COOKIESIZE bytes that followed it
+ * @return 0 if the cookie was issued by us for this address and packet and hasn't expired, -1 otherwise
+ */
+
+int outer_cookie_check(outer_cookie_t *a_cookie, uint32_t a_addr, const dhm_alice_t *a_alice, const uint8_t *a_in)
+{
+	uint8_t l_tag[OUTER_COOKIESIZE - sizeof(uint32_t)];
+	uint32_t l_issued;
+	uint32_t l_now = (uint32_t)time(NULL);
+	uint8_t l_diff = 0;
+	size_t i;
+
+	memcpy(&l_issued, a_in, sizeof(l_issued));
+	l_issued = ntohl(l_issued);
+	if ((l_now - l_issued) > OUTER_COOKIE_LIFETIME)
+		return -1; // expired, or from the future (wraps around to a huge age)
+	cookie_tag(a_cookie, l_issued, a_addr, a_alice, l_tag);
+	for (i = 0; i < sizeof(l_tag); ++i)
+		l_diff |= l_tag[i] ^ a_in[sizeof(uint32_t) + i]; // constant time compare
+	return (l_diff == 0) ? 0 : -1;
+}
+
+/**
+ * @brief Connect to a server and establish a keyed channel
+ * The Alice packet is generated while the TCP connect is in flight.
+ *
+ * @param[in] a_chan Channel to set up
+ * @param[in] a_host Server address in dotted IP format
+ * @param[in] a_port Server port
+ * @param[in] a_hashalg DHM packet hash algorithm
+ * @param[in] a_debug Set this flag to 1 if you want to print debugging information.
+ * @return 0 on success, -1 on error
+ */
+
+int outer_client_open(outer_channel_t *a_chan, const char *a_host, uint16_t a_port, dhm_hashalg_t a_hashalg, int a_debug)
+{
+	dhm_session_t l_session;
+	dhm_alice_t l_alice;
+	dhm_private_t l_alice_private;
+	int l_fd;
+
+	if (outer_connect_start(a_host, a_port, &l_fd) < 0)
+		return -1;
+	if (outer_prepare_alice(a_hashalg, &l_session, &l_alice, &l_alice_private, a_debug) < 0) {
+		close(l_fd);
+		return -1;
+	}
+	if (outer_connect_finish(l_fd) < 0) {
+		memset(&l_alice_private, 0, sizeof(dhm_private_t));
+		dhm_end_session(&l_session, a_debug);
+		return -1;
+	}
+	outer_channel_init(a_chan, l_fd);
+	if (outer_client_handshake(a_chan, &l_session, &l_alice, &l_alice_private, a_debug) < 0) {
+		outer_channel_close(a_chan);
+		return -1;
+	}
+	return 0;
+}
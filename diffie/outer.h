@@ -0,0 +1,205 @@
+/**
+ *
+ * Diffie/Hellman/Merkle Implementation
+ * 2025/Nov/11 - Revision 0.80 alpha
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file outer.h
+ * @brief Outer protocol: framed packets and keyed secure channels
+ *
+ * The outer protocol wraps DHM and AES payloads in a small header so they can
+ * be sent over a stream socket. An outer_channel_t holds everything one end
+ * of a connection needs: the socket, the outer sequence counter, and once the
+ * Alice/Bob exchange is done, an AES256/CTR context, HMAC-SHA256 midstates,
+ * MAC sequence number and CTR block offset for each direction.
+ *
+ * The CTR block offset advances with every AES packet, so a channel can carry
+ * any number of packets without reusing keystream. That is what lets a
+ * channel be kept open and reused for many requests (see dhmpool.h).
+ *
+ * Keys can be rotated in-band without another DHM exchange. A rekey packet
+ * tells the peer to advance that direction's AES and MAC keys one step
+ * along a one-way SHA2-512 ratchet; the old keys are overwritten, so a
+ * compromised channel does not expose traffic from earlier epochs. A peer
+ * that receives a rekey answers with one of its own, so both directions
+ * move forward together. outer_set_rekey makes outer_write_aes rekey on its
+ * own every so many bytes or seconds.
+ *
+ * The same framing also works one packet per UDP datagram
+ * (outer_send_datagram, outer_recv_datagram). Alice and Bob each fit in one
+ * datagram, so a UDP handshake takes a single round trip; outer_seal_aes and
+ * outer_open_aes protect datagram payloads with a channel's keys.
+ *
+ * A server can make clients prove they receive traffic at their address
+ * before it spends an exponentiation on them. It answers an Alice packet
+ * that has no valid cookie with a cookie packet instead of Bob; the client
+ * sends the same Alice again with the cookie appended. A cookie is an HMAC,
+ * under a key only the server knows, of the issue time, the client's IP
+ * address and the Alice packet's GUID and hash, so the server keeps no
+ * state for clients that never come back. outer_client_handshake handles
+ * the extra round trip on its own.
+ *
+ * A server that already has as many handshakes in hand as it can take can
+ * answer Alice with a busy packet carrying a retry delay in milliseconds
+ * (see hsqueue.h). It keeps nothing for the client, which waits and sends
+ * the same Alice again; outer_client_handshake does this too, up to
+ * OUTER_HANDSHAKE_ROUNDS packets in all.
+ *
+ * Peers on the same host can skip the socket for packet traffic. A channel
+ * set up with outer_shm_accept / outer_shm_connect carries its packets
+ * through a pair of shared memory rings (see shmring.h) instead; the
+ * read/write functions and everything built on them work the same way.
+ *
+ * Channels are not thread safe; one thread uses a channel at a time.
+ */
+
+#ifndef OUTER_H
+#define OUTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "dhm.h"
+#include "aes.h"
+#include "sha2.h"
+#include "shmring.h"
+
+#define OUTER_MACSIZE SHA256_DIGEST_SIZE ///< HMAC-SHA256 tag appended to every AES packet
+#define OUTER_COOKIESIZE 20 ///< issue time plus truncated HMAC-SHA256 tag
+#define OUTER_COOKIE_LIFETIME 30 ///< seconds a cookie stays valid
+#define OUTER_HANDSHAKE_ROUNDS 8 ///< most Alice packets a client sends for one exchange, counting cookie and busy retries
+#define OUTER_BUSY_MAX_MS 5000 ///< longest a client honors a busy packet's retry delay
+#define OUTER_DATAGRAM_MAX (65507 - sizeof(outer_packet_header_t)) ///< largest payload that fits one UDP datagram
+
+extern const uint16_t outer_current_version;
+extern const uint16_t outer_packtype_dieplease; ///< request the server terminate
+extern const uint16_t outer_packtype_textecho;
+extern const uint16_t outer_packtype_alice; ///< packet contains an Alice packet
+extern const uint16_t outer_packtype_bob; ///< packet contains a Bob packet
+extern const uint16_t outer_packtype_aes; ///< packet contains AES256/CTR encrypted data
+extern const uint16_t outer_packtype_rekey; ///< sender has advanced its direction's keys one ratchet step
+extern const uint16_t outer_packtype_cookie; ///< server wants the Alice packet again with this cookie appended
+extern const uint16_t outer_packtype_busy; ///< server is overloaded, send Alice again after the 32 bit number of milliseconds in the payload
+
+extern int outer_showpacks; ///< set to 1 to dump every packet read or written
+
+#pragma pack(push, 1)
+
+/**
+ * @struct outer_packet_header_t
+ * @brief Header in front of every packet on the wire, all fields in network byte order.
+ */
+
+typedef struct {
+	uint16_t version;
+	uint16_t packtype;
+	uint16_t size; ///< size of payload
+	uint32_t sequence; ///< monotonically incrementing packet counter
+} outer_packet_header_t;
+
+#pragma pack(pop)
+
+/**
+ * @struct outer_direction_t
+ * @brief Keys and counters for one direction of a secure channel.
+ */
+
+typedef struct {
+	uint8_t key[32]; ///< AES256 key for this direction, starts as the shared key
+	uint8_t iv[16]; ///< CTR nonce for this direction
+	uint8_t mac_key[32]; ///< HMAC key for this direction
+	struct AES_ctx aes; ///< AES context keyed with this direction's key and nonce
+	hmac_sha256_ctx hmac; ///< keyed HMAC midstates, computed once per key
+	uint32_t seq; ///< AES and rekey packets so far in this direction, bound into the MAC
+	uint64_t ctr; ///< CTR block offset for the next AES packet, restarts at 0 with each new key
+	uint32_t epoch; ///< number of ratchet steps taken, 0 right after the DHM exchange
+	uint64_t epoch_bytes; ///< plaintext bytes sent or received under the current key
+	time_t epoch_start; ///< when the current key came into use
+} outer_direction_t;
+
+/**
+ * @struct outer_cookie_t
+ * @brief Server secret for issuing and checking cookies.
+ */
+
+typedef struct {
+	hmac_sha256_ctx hmac; ///< keyed with a random secret, copied before each use so threads can share it
+} outer_cookie_t;
+
+/**
+ * @struct outer_channel_t
+ * @brief One end of a framed, optionally encrypted connection.
+ */
+
+typedef struct {
+	int fd; ///< connected socket; for a shared memory channel, the Unix socket it was set up over
+	shmring_t *ring; ///< shared memory rings carrying the packets, NULL to use fd
+	uint32_t sequence; ///< outer header sequence number for the next packet we write
+	int keyed; ///< set once outer_channel_keys has been called
+	uint64_t rekey_bytes; ///< outer_write_aes rekeys after this many bytes under one key, 0 for never
+	unsigned int rekey_seconds; ///< outer_write_aes rekeys once a key is this old, 0 for never
+	outer_direction_t tx; ///< what we send
+	outer_direction_t rx; ///< what we receive
+} outer_channel_t;
+
+void outer_channel_init   (outer_channel_t *a_chan, int a_fd);
+void outer_channel_close  (outer_channel_t *a_chan);
+int  outer_write_packet   (outer_channel_t *a_chan, uint16_t a_packtype, const void *a_data, size_t a_size);
+int  outer_read_packet    (outer_channel_t *a_chan, outer_packet_header_t **a_header, uint8_t **a_data);
+void outer_channel_keys   (outer_channel_t *a_chan, const uint8_t *a_secret, int a_server);
+int  outer_write_aes      (outer_channel_t *a_chan, const uint8_t *a_data, size_t a_size);
+int  outer_open_aes       (outer_channel_t *a_chan, uint8_t *a_data, size_t *a_size);
+size_t outer_seal_aes     (outer_channel_t *a_chan, const uint8_t *a_data, size_t a_size, uint8_t *a_out);
+void outer_set_rekey      (outer_channel_t *a_chan, uint64_t a_bytes, unsigned int a_seconds);
+int  outer_send_rekey     (outer_channel_t *a_chan);
+int  outer_recv_rekey     (outer_channel_t *a_chan, const uint8_t *a_data, size_t a_size);
+int  outer_connect_start  (const char *a_host, uint16_t a_port, int *a_fd);
+int  outer_connect_finish (int a_fd);
+int  outer_prepare_alice  (dhm_hashalg_t a_hashalg, dhm_session_t *a_session, dhm_alice_t *a_alice, dhm_private_t *a_alice_private, int a_debug);
+int  outer_client_handshake (outer_channel_t *a_chan, dhm_session_t *a_session, dhm_alice_t *a_alice, dhm_private_t *a_alice_private, int a_debug);
+int  outer_server_handshake (outer_channel_t *a_chan, dhm_alice_t *a_alice, int a_debug);
+int  outer_server_bob     (outer_channel_t *a_chan, dhm_alice_t *a_alice, dhm_bob_t *a_bob, int a_debug);
+int  outer_send_datagram  (int a_fd, const struct sockaddr_in *a_to, uint32_t a_sequence, uint16_t a_packtype, const void *a_data, size_t a_size);
+ssize_t outer_recv_datagram (int a_fd, struct sockaddr_in *a_from, outer_packet_header_t *a_header, uint8_t *a_data, size_t a_size);
+int  outer_shm_listen     (const char *a_name);
+int  outer_shm_accept     (int a_listen_fd, outer_channel_t *a_chan);
+int  outer_shm_connect    (const char *a_name, outer_channel_t *a_chan);
+int  outer_cookie_init    (outer_cookie_t *a_cookie);
+void outer_cookie_make    (outer_cookie_t *a_cookie, uint32_t a_addr, const dhm_alice_t *a_alice, uint8_t *a_out);
+int  outer_cookie_check   (outer_cookie_t *a_cookie, uint32_t a_addr, const dhm_alice_t *a_alice, const uint8_t *a_in);
+int  outer_client_open    (outer_channel_t *a_chan, const char *a_host, uint16_t a_port, dhm_hashalg_t a_hashalg, int a_debug);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OUTER_H
@@ -147,6 +147,18 @@ uint64 sha512_h0[8] =
              0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
              0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL};
 
+uint64 sha512_224_h0[8] =
+            {0x8c3d37c819544da2ULL, 0x73e1996689dcd4d6ULL,
+             0x1dfab7ae32ff9c82ULL, 0x679dd514582f9fcfULL,
+             0x0f6d2b697bd44da8ULL, 0x77e36f7304c48942ULL,
+             0x3f9d85a86a1d36c8ULL, 0x1112e6ad91d692a1ULL};
+
+uint64 sha512_256_h0[8] =
+            {0x22312194fc2bf72cULL, 0x9f555fa3c84c64c2ULL,
+             0x2393b86b6f53b151ULL, 0x963877195940eabdULL,
+             0x96283ee2a88effe3ULL, 0xbe5e1e2553863992ULL,
+             0x2b0199fc2c85b8aaULL, 0x0eb72ddc81c52ca2ULL};
+
 uint32 sha256_k[64] =
             {0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
              0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
@@ -382,14 +394,14 @@ void sha256_update(sha256_ctx *ctx, const unsigned char *message,
            rem_len);
 
     ctx->len = rem_len;
-    ctx->tot_len += (block_nb + 1) << 6;
+    ctx->tot_len += (uint64) (block_nb + 1) << 6;
 }
 
 void sha256_final(sha256_ctx *ctx, unsigned char *digest)
 {
     unsigned int block_nb;
     unsigned int pm_len;
-    unsigned int len_b;
+    uint64 len_b;
 
 #ifndef UNROLL_LOOPS
     int i;
@@ -403,7 +415,7 @@ void sha256_final(sha256_ctx *ctx, unsigned char *digest)
 
     memset(ctx->block + ctx->len, 0, pm_len - ctx->len);
     ctx->block[ctx->len] = 0x80;
-    UNPACK32(len_b, ctx->block + pm_len - 4);
+    UNPACK64(len_b, ctx->block + pm_len - 8);
 
     sha256_transf(ctx, ctx->block, block_nb);
 
@@ -579,14 +591,14 @@ void sha512_update(sha512_ctx *ctx, const unsigned char *message,
            rem_len);
 
     ctx->len = rem_len;
-    ctx->tot_len += (block_nb + 1) << 7;
+    ctx->tot_len += (uint64) (block_nb + 1) << 7;
 }
 
 void sha512_final(sha512_ctx *ctx, unsigned char *digest)
 {
     unsigned int block_nb;
     unsigned int pm_len;
-    unsigned int len_b;
+    uint64 len_b;
 
 #ifndef UNROLL_LOOPS
     int i;
@@ -600,7 +612,7 @@ void sha512_final(sha512_ctx *ctx, unsigned char *digest)
 
     memset(ctx->block + ctx->len, 0, pm_len - ctx->len);
     ctx->block[ctx->len] = 0x80;
-    UNPACK32(len_b, ctx->block + pm_len - 4);
+    UNPACK64(len_b, ctx->block + pm_len - 8);
 
     sha512_transf(ctx, ctx->block, block_nb);
 
@@ -620,6 +632,54 @@ void sha512_final(sha512_ctx *ctx, unsigned char *digest)
 #endif /* !UNROLL_LOOPS */
 }
 
+/* SHA-512 state export/import */
+
+void sha512_export(const sha512_ctx *ctx, unsigned char *buf)
+{
+    int i;
+
+    buf[0] = 'S'; buf[1] = '5'; buf[2] = '1'; buf[3] = '2';
+    UNPACK64(ctx->tot_len, buf + 4);
+    UNPACK32(ctx->len, buf + 12);
+    for (i = 0; i < 8; i++) {
+        UNPACK64(ctx->h[i], buf + 16 + (i << 3));
+    }
+    memset(buf + 80, 0, SHA512_BLOCK_SIZE);
+    memcpy(buf + 80, ctx->block, ctx->len);
+}
+
+/* returns 0 on success, -1 if buf does not hold a valid exported state */
+int sha512_import(sha512_ctx *ctx, const unsigned char *buf)
+{
+    uint64 tot_len;
+    uint32 len;
+    int i;
+
+    if (buf[0] != 'S' || buf[1] != '5' || buf[2] != '1' || buf[3] != '2') {
+        return -1;
+    }
+    PACK64(buf + 4, &tot_len);
+    PACK32(buf + 12, &len);
+    if (len >= SHA512_BLOCK_SIZE || (tot_len % SHA512_BLOCK_SIZE) != 0) {
+        return -1;
+    }
+
+    ctx->tot_len = tot_len;
+    ctx->len = len;
+    for (i = 0; i < 8; i++) {
+        PACK64(buf + 16 + (i << 3), &ctx->h[i]);
+    }
+    memcpy(ctx->block, buf + 80, len);
+
+    return 0;
+}
+
+/* number of message bytes fed into the context so far */
+uint64 sha512_processed(const sha512_ctx *ctx)
+{
+    return ctx->tot_len + ctx->len;
+}
+
 /* SHA-384 functions */
 
 void sha384(const unsigned char *message, unsigned int len,
@@ -681,14 +741,14 @@ void sha384_update(sha384_ctx *ctx, const unsigned char *message,
            rem_len);
 
     ctx->len = rem_len;
-    ctx->tot_len += (block_nb + 1) << 7;
+    ctx->tot_len += (uint64) (block_nb + 1) << 7;
 }
 
 void sha384_final(sha384_ctx *ctx, unsigned char *digest)
 {
     unsigned int block_nb;
     unsigned int pm_len;
-    unsigned int len_b;
+    uint64 len_b;
 
 #ifndef UNROLL_LOOPS
     int i;
@@ -702,7 +762,7 @@ void sha384_final(sha384_ctx *ctx, unsigned char *digest)
 
     memset(ctx->block + ctx->len, 0, pm_len - ctx->len);
     ctx->block[ctx->len] = 0x80;
-    UNPACK32(len_b, ctx->block + pm_len - 4);
+    UNPACK64(len_b, ctx->block + pm_len - 8);
 
     sha512_transf(ctx, ctx->block, block_nb);
 
@@ -720,6 +780,78 @@ void sha384_final(sha384_ctx *ctx, unsigned char *digest)
 #endif /* !UNROLL_LOOPS */
 }
 
+/* SHA-512/224 and SHA-512/256 functions */
+
+static void sha512_t_init(sha512_ctx *ctx, const uint64 *h0)
+{
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        ctx->h[i] = h0[i];
+    }
+
+    ctx->len = 0;
+    ctx->tot_len = 0;
+}
+
+void sha512_224(const unsigned char *message, unsigned int len,
+                unsigned char *digest)
+{
+    sha512_224_ctx ctx;
+
+    sha512_224_init(&ctx);
+    sha512_224_update(&ctx, message, len);
+    sha512_224_final(&ctx, digest);
+}
+
+void sha512_224_init(sha512_224_ctx *ctx)
+{
+    sha512_t_init(ctx, sha512_224_h0);
+}
+
+void sha512_224_update(sha512_224_ctx *ctx, const unsigned char *message,
+                       unsigned int len)
+{
+    sha512_update(ctx, message, len);
+}
+
+void sha512_224_final(sha512_224_ctx *ctx, unsigned char *digest)
+{
+    unsigned char full[SHA512_DIGEST_SIZE];
+
+    sha512_final(ctx, full);
+    memcpy(digest, full, SHA512_224_DIGEST_SIZE);
+}
+
+void sha512_256(const unsigned char *message, unsigned int len,
+                unsigned char *digest)
+{
+    sha512_256_ctx ctx;
+
+    sha512_256_init(&ctx);
+    sha512_256_update(&ctx, message, len);
+    sha512_256_final(&ctx, digest);
+}
+
+void sha512_256_init(sha512_256_ctx *ctx)
+{
+    sha512_t_init(ctx, sha512_256_h0);
+}
+
+void sha512_256_update(sha512_256_ctx *ctx, const unsigned char *message,
+                       unsigned int len)
+{
+    sha512_update(ctx, message, len);
+}
+
+void sha512_256_final(sha512_256_ctx *ctx, unsigned char *digest)
+{
+    unsigned char full[SHA512_DIGEST_SIZE];
+
+    sha512_final(ctx, full);
+    memcpy(digest, full, SHA512_256_DIGEST_SIZE);
+}
+
 /* SHA-224 functions */
 
 void sha224(const unsigned char *message, unsigned int len,
@@ -781,14 +913,14 @@ void sha224_update(sha224_ctx *ctx, const unsigned char *message,
            rem_len);
 
     ctx->len = rem_len;
-    ctx->tot_len += (block_nb + 1) << 6;
+    ctx->tot_len += (uint64) (block_nb + 1) << 6;
 }
 
 void sha224_final(sha224_ctx *ctx, unsigned char *digest)
 {
     unsigned int block_nb;
     unsigned int pm_len;
-    unsigned int len_b;
+    uint64 len_b;
 
 #ifndef UNROLL_LOOPS
     int i;
@@ -802,7 +934,7 @@ void sha224_final(sha224_ctx *ctx, unsigned char *digest)
 
     memset(ctx->block + ctx->len, 0, pm_len - ctx->len);
     ctx->block[ctx->len] = 0x80;
-    UNPACK32(len_b, ctx->block + pm_len - 4);
+    UNPACK64(len_b, ctx->block + pm_len - 8);
 
     sha256_transf(ctx, ctx->block, block_nb);
 
@@ -821,6 +953,184 @@ void sha224_final(sha224_ctx *ctx, unsigned char *digest)
 #endif /* !UNROLL_LOOPS */
 }
 
+/* HMAC-SHA-256 functions */
+
+void hmac_sha256_init(hmac_sha256_ctx *ctx, const unsigned char *key,
+                      unsigned int key_size)
+{
+    unsigned int fill;
+    unsigned int num;
+
+    const unsigned char *key_used;
+    unsigned char key_temp[SHA256_DIGEST_SIZE];
+    unsigned char block_ipad[SHA256_BLOCK_SIZE];
+    unsigned char block_opad[SHA256_BLOCK_SIZE];
+    int i;
+
+    if (key_size == SHA256_BLOCK_SIZE) {
+        key_used = key;
+        num = SHA256_BLOCK_SIZE;
+    } else {
+        if (key_size > SHA256_BLOCK_SIZE){
+            num = SHA256_DIGEST_SIZE;
+            sha256(key, key_size, key_temp);
+            key_used = key_temp;
+        } else { /* key_size < SHA256_BLOCK_SIZE */
+            key_used = key;
+            num = key_size;
+        }
+        fill = SHA256_BLOCK_SIZE - num;
+
+        memset(block_ipad + num, 0x36, fill);
+        memset(block_opad + num, 0x5c, fill);
+    }
+
+    for (i = 0; i < (int) num; i++) {
+        block_ipad[i] = key_used[i] ^ 0x36;
+        block_opad[i] = key_used[i] ^ 0x5c;
+    }
+
+    /* one compression each: these are the cached keyed midstates */
+    sha256_init(&ctx->ctx_inside);
+    sha256_update(&ctx->ctx_inside, block_ipad, SHA256_BLOCK_SIZE);
+
+    sha256_init(&ctx->ctx_outside);
+    sha256_update(&ctx->ctx_outside, block_opad,
+                  SHA256_BLOCK_SIZE);
+
+    /* for hmac_reinit */
+    memcpy(&ctx->ctx_inside_reinit, &ctx->ctx_inside,
+           sizeof(sha256_ctx));
+    memcpy(&ctx->ctx_outside_reinit, &ctx->ctx_outside,
+           sizeof(sha256_ctx));
+}
+
+void hmac_sha256_reinit(hmac_sha256_ctx *ctx)
+{
+    memcpy(&ctx->ctx_inside, &ctx->ctx_inside_reinit,
+           sizeof(sha256_ctx));
+    memcpy(&ctx->ctx_outside, &ctx->ctx_outside_reinit,
+           sizeof(sha256_ctx));
+}
+
+void hmac_sha256_update(hmac_sha256_ctx *ctx, const unsigned char *message,
+                        unsigned int message_len)
+{
+    sha256_update(&ctx->ctx_inside, message, message_len);
+}
+
+void hmac_sha256_final(hmac_sha256_ctx *ctx, unsigned char *mac,
+                       unsigned int mac_size)
+{
+    unsigned char digest_inside[SHA256_DIGEST_SIZE];
+    unsigned char mac_temp[SHA256_DIGEST_SIZE];
+
+    sha256_final(&ctx->ctx_inside, digest_inside);
+    sha256_update(&ctx->ctx_outside, digest_inside, SHA256_DIGEST_SIZE);
+    sha256_final(&ctx->ctx_outside, mac_temp);
+    memcpy(mac, mac_temp, mac_size);
+}
+
+void hmac_sha256(const unsigned char *key, unsigned int key_size,
+          const unsigned char *message, unsigned int message_len,
+          unsigned char *mac, unsigned mac_size)
+{
+    hmac_sha256_ctx ctx;
+
+    hmac_sha256_init(&ctx, key, key_size);
+    hmac_sha256_update(&ctx, message, message_len);
+    hmac_sha256_final(&ctx, mac, mac_size);
+}
+
+/* HMAC-SHA-512 functions */
+
+void hmac_sha512_init(hmac_sha512_ctx *ctx, const unsigned char *key,
+                      unsigned int key_size)
+{
+    unsigned int fill;
+    unsigned int num;
+
+    const unsigned char *key_used;
+    unsigned char key_temp[SHA512_DIGEST_SIZE];
+    unsigned char block_ipad[SHA512_BLOCK_SIZE];
+    unsigned char block_opad[SHA512_BLOCK_SIZE];
+    int i;
+
+    if (key_size == SHA512_BLOCK_SIZE) {
+        key_used = key;
+        num = SHA512_BLOCK_SIZE;
+    } else {
+        if (key_size > SHA512_BLOCK_SIZE){
+            num = SHA512_DIGEST_SIZE;
+            sha512(key, key_size, key_temp);
+            key_used = key_temp;
+        } else { /* key_size < SHA512_BLOCK_SIZE */
+            key_used = key;
+            num = key_size;
+        }
+        fill = SHA512_BLOCK_SIZE - num;
+
+        memset(block_ipad + num, 0x36, fill);
+        memset(block_opad + num, 0x5c, fill);
+    }
+
+    for (i = 0; i < (int) num; i++) {
+        block_ipad[i] = key_used[i] ^ 0x36;
+        block_opad[i] = key_used[i] ^ 0x5c;
+    }
+
+    /* one compression each: these are the cached keyed midstates */
+    sha512_init(&ctx->ctx_inside);
+    sha512_update(&ctx->ctx_inside, block_ipad, SHA512_BLOCK_SIZE);
+
+    sha512_init(&ctx->ctx_outside);
+    sha512_update(&ctx->ctx_outside, block_opad,
+                  SHA512_BLOCK_SIZE);
+
+    /* for hmac_reinit */
+    memcpy(&ctx->ctx_inside_reinit, &ctx->ctx_inside,
+           sizeof(sha512_ctx));
+    memcpy(&ctx->ctx_outside_reinit, &ctx->ctx_outside,
+           sizeof(sha512_ctx));
+}
+
+void hmac_sha512_reinit(hmac_sha512_ctx *ctx)
+{
+    memcpy(&ctx->ctx_inside, &ctx->ctx_inside_reinit,
+           sizeof(sha512_ctx));
+    memcpy(&ctx->ctx_outside, &ctx->ctx_outside_reinit,
+           sizeof(sha512_ctx));
+}
+
+void hmac_sha512_update(hmac_sha512_ctx *ctx, const unsigned char *message,
+                        unsigned int message_len)
+{
+    sha512_update(&ctx->ctx_inside, message, message_len);
+}
+
+void hmac_sha512_final(hmac_sha512_ctx *ctx, unsigned char *mac,
+                       unsigned int mac_size)
+{
+    unsigned char digest_inside[SHA512_DIGEST_SIZE];
+    unsigned char mac_temp[SHA512_DIGEST_SIZE];
+
+    sha512_final(&ctx->ctx_inside, digest_inside);
+    sha512_update(&ctx->ctx_outside, digest_inside, SHA512_DIGEST_SIZE);
+    sha512_final(&ctx->ctx_outside, mac_temp);
+    memcpy(mac, mac_temp, mac_size);
+}
+
+void hmac_sha512(const unsigned char *key, unsigned int key_size,
+          const unsigned char *message, unsigned int message_len,
+          unsigned char *mac, unsigned mac_size)
+{
+    hmac_sha512_ctx ctx;
+
+    hmac_sha512_init(&ctx, key, key_size);
+    hmac_sha512_update(&ctx, message, message_len);
+    hmac_sha512_final(&ctx, mac, mac_size);
+}
+
 #ifdef TEST_VECTORS
 
 /* FIPS 180-2 Validation tests */
@@ -941,6 +1251,82 @@ int main()
     test(vectors[3][2], digest, SHA512_DIGEST_SIZE);
     printf("\n");
 
+    printf("SHA-512/224 and SHA-512/256 Test vectors\n");
+
+    sha512_224(message1, strlen((char *) message1), digest);
+    test((const unsigned char *)
+         "4634270f707b6a54daae7530460842e20e37ed265ceee9a43e8924aa",
+         digest, SHA512_224_DIGEST_SIZE);
+    sha512_224(message2b, strlen((char *) message2b), digest);
+    test((const unsigned char *)
+         "23fec5bb94d60b23308192640b0c453335d664734fe40e7268674af9",
+         digest, SHA512_224_DIGEST_SIZE);
+    sha512_256(message1, strlen((char *) message1), digest);
+    test((const unsigned char *)
+         "53048e2681941ef99b2e29b76b4c7dabe4c2d0c634fc6d46e0e2f13107e7af23",
+         digest, SHA512_256_DIGEST_SIZE);
+    sha512_256(message2b, strlen((char *) message2b), digest);
+    test((const unsigned char *)
+         "3928e184fb8690f840da3988121d31be65cb9d3ef83ee6146feac861e19b563a",
+         digest, SHA512_256_DIGEST_SIZE);
+    printf("\n");
+
+    printf("SHA-512 export/import (resume million a)\n");
+
+    {
+        sha512_ctx ctx_first;
+        sha512_ctx ctx_resumed;
+        unsigned char state[SHA512_EXPORT_SIZE];
+
+        sha512_init(&ctx_first);
+        sha512_update(&ctx_first, message3, 333333);
+        sha512_export(&ctx_first, state);
+        if (sha512_import(&ctx_resumed, state) != 0
+            || sha512_processed(&ctx_resumed) != 333333) {
+            fprintf(stderr, "Test failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        sha512_update(&ctx_resumed, message3 + 333333, message3_len - 333333);
+        sha512_final(&ctx_resumed, digest);
+        test(vectors[3][2], digest, SHA512_DIGEST_SIZE);
+    }
+    printf("\n");
+
+    printf("HMAC-SHA-2 RFC 4231 test case 2\n");
+
+    {
+        static const unsigned char hmac_key[] = "Jefe";
+        static const unsigned char hmac_msg[] = "what do ya want for nothing?";
+        hmac_sha256_ctx hctx256;
+        hmac_sha512_ctx hctx512;
+
+        hmac_sha256_init(&hctx256, hmac_key, 4);
+        hmac_sha256_update(&hctx256, hmac_msg, 28);
+        hmac_sha256_final(&hctx256, digest, SHA256_DIGEST_SIZE);
+        test((const unsigned char *) "5bdcc146bf60754e6a042426089575c7"
+             "5a003f089d2739839dec58b964ec3843", digest, SHA256_DIGEST_SIZE);
+        /* same key, second message through the cached midstates */
+        hmac_sha256_reinit(&hctx256);
+        hmac_sha256_update(&hctx256, hmac_msg, 28);
+        hmac_sha256_final(&hctx256, digest, SHA256_DIGEST_SIZE);
+        test((const unsigned char *) "5bdcc146bf60754e6a042426089575c7"
+             "5a003f089d2739839dec58b964ec3843", digest, SHA256_DIGEST_SIZE);
+
+        hmac_sha512_init(&hctx512, hmac_key, 4);
+        hmac_sha512_update(&hctx512, hmac_msg, 28);
+        hmac_sha512_final(&hctx512, digest, SHA512_DIGEST_SIZE);
+        test((const unsigned char *) "164b7a7bfcf819e2e395fbe73b56e0a3"
+             "87bd64222e831fd610270cd7ea2505549758bf75c05a994a6d034f65f8f0e6fd"
+             "caeab1a34d4a6b4b636e070a38bce737", digest, SHA512_DIGEST_SIZE);
+        hmac_sha512_reinit(&hctx512);
+        hmac_sha512_update(&hctx512, hmac_msg, 28);
+        hmac_sha512_final(&hctx512, digest, SHA512_DIGEST_SIZE);
+        test((const unsigned char *) "164b7a7bfcf819e2e395fbe73b56e0a3"
+             "87bd64222e831fd610270cd7ea2505549758bf75c05a994a6d034f65f8f0e6fd"
+             "caeab1a34d4a6b4b636e070a38bce737", digest, SHA512_DIGEST_SIZE);
+    }
+    printf("\n");
+
     printf("All tests passed.\n");
 
     return 0;
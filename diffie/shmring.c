@@ -0,0 +1,418 @@
+/**
+ *
+ * Diffie/Hellman/Merkle Implementation
+ * 2025/Nov/11 - Revision 0.80 alpha
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file shmring.c
+ * @brief Shared memory transport for peers on the same host
+ *
+ * See shmring.h for an overview.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "shmring.h"
+
+_Static_assert(sizeof(shmring_shared_t) <= SHMRING_HEADER, "ring header outgrew SHMRING_HEADER");
+
+static int futex_wait(_Atomic uint32_t *a_word, uint32_t a_val, int a_ms)
+{
+	struct timespec l_ts;
+	l_ts.tv_sec = a_ms / 1000;
+	l_ts.tv_nsec = (long)(a_ms % 1000) * 1000000;
+	// not FUTEX_PRIVATE_FLAG: the word is shared between processes
+	return syscall(SYS_futex, a_word, FUTEX_WAIT, a_val, &l_ts, NULL, 0);
+}
+
+static void futex_wake(_Atomic uint32_t *a_word)
+{
+	syscall(SYS_futex, a_word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static uint8_t *ring_data(shmring_shared_t *a_shared)
+{
+	return (uint8_t *)a_shared + SHMRING_HEADER;
+}
+
+static size_t ring_used(shmring_shared_t *a_shared)
+{
+	return atomic_load(&a_shared->head) - atomic_load(&a_shared->tail);
+}
+
+/**
+ * @brief Is there data to read (a_need 0) or room for a_need bytes (a_need > 0)?
+ */
+
+static int ring_ready(shmring_t *a_ring, shmring_shared_t *a_shared, size_t a_need)
+{
+	size_t l_used = ring_used(a_shared);
+	// head and tail live where the peer can scribble on them, a ring fuller than full is treated as closed
+	if (l_used > a_ring->size) {
+		atomic_store(&a_shared->closed, 1);
+		return 0;
+	}
+	if (a_need == 0)
+		return l_used > 0;
+	return (a_ring->size - l_used) >= a_need;
+}
+
+/**
+ * @brief Has the peer exited or closed its Unix socket?
+ * The peer never writes to the socket once the ring is set up, so anything
+ * readable on it means end of file.
+ */
+
+static int peer_gone(shmring_t *a_ring)
+{
+	struct pollfd l_pfd;
+
+	if (a_ring->peer_fd < 0)
+		return 0;
+	l_pfd.fd = a_ring->peer_fd;
+	l_pfd.events = POLLIN;
+	return (poll(&l_pfd, 1, 0) > 0) && (l_pfd.revents & (POLLIN | POLLHUP | POLLERR));
+}
+
+/**
+ * @brief Wait until a ring is ready for us
+ * Spins for a while, then flags itself as waiting and sleeps on the ring's
+ * futex word. The flag is set before the final readiness check and the
+ * other end bumps the word before it looks at the flag, so a wakeup can't
+ * slip in between (all of these are sequentially consistent atomics).
+ *
+ * @param[in] a_ring Our end
+ * @param[in] a_shared Ring to wait on
+ * @param[in] a_need 0 to wait for data, otherwise bytes of room to wait for
+ * @return 0 once ready, -1 if the ring was closed or the peer went away first
+ */
+
+static int ring_wait(shmring_t *a_ring, shmring_shared_t *a_shared, size_t a_need)
+{
+	_Atomic uint32_t *l_word = (a_need == 0) ? &a_shared->data_seq : &a_shared->space_seq;
+	_Atomic uint32_t *l_waiting = (a_need == 0) ? &a_shared->reader_waiting : &a_shared->writer_waiting;
+	int i;
+
+	for (i = 0; i < SHMRING_SPIN; ++i) {
+		if (ring_ready(a_ring, a_shared, a_need))
+			return 0;
+		if (atomic_load(&a_shared->closed))
+			return -1;
+	}
+	while (1) {
+		atomic_store(l_waiting, 1);
+		uint32_t l_seq = atomic_load(l_word);
+		if (ring_ready(a_ring, a_shared, a_need))
+			break;
+		if (atomic_load(&a_shared->closed)) {
+			atomic_store(l_waiting, 0);
+			return -1;
+		}
+		if ((futex_wait(l_word, l_seq, SHMRING_CHECK_MS) < 0) && (errno == ETIMEDOUT) && peer_gone(a_ring)) {
+			atomic_store(&a_shared->closed, 1);
+			atomic_store(l_waiting, 0);
+			return -1;
+		}
+	}
+	atomic_store(l_waiting, 0);
+	return 0;
+}
+
+static void ring_init(shmring_shared_t *a_shared, uint32_t a_size)
+{
+	memset(a_shared, 0, SHMRING_HEADER);
+	a_shared->magic = SHMRING_MAGIC;
+	a_shared->size = a_size;
+}
+
+/**
+ * @brief Create a ring pair in a new memfd, as the server end
+ *
+ * @param[in] a_ring Ring structure. It is the responsibility of the caller to allocate memory for this structure.
+ * @param[in] a_size Bytes of data per direction, a power of 2 no smaller than SHMRING_MIN_SIZE (SHMRING_SIZE is a good choice)
+ * @return the memfd, to be passed to the client with shmring_send_fd and then closed, or -1 on error
+ */
+
+int shmring_create(shmring_t *a_ring, uint32_t a_size)
+{
+	if ((a_size < SHMRING_MIN_SIZE) || ((a_size & (a_size - 1)) != 0))
+		return -1;
+	memset(a_ring, 0, sizeof(shmring_t));
+	a_ring->peer_fd = -1;
+	a_ring->size = a_size;
+	a_ring->map_size = 2 * ((size_t)SHMRING_HEADER + a_size);
+	int l_memfd = memfd_create("diffie-shmring", MFD_CLOEXEC);
+	if (l_memfd < 0) {
+		fprintf(stderr, "shmring_create: can't memfd_create: %s\n", strerror(errno));
+		return -1;
+	}
+	if (ftruncate(l_memfd, a_ring->map_size) < 0) {
+		fprintf(stderr, "shmring_create: can't size memfd: %s\n", strerror(errno));
+		close(l_memfd);
+		return -1;
+	}
+	a_ring->map = mmap(NULL, a_ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, l_memfd, 0);
+	if (a_ring->map == MAP_FAILED) {
+		fprintf(stderr, "shmring_create: can't mmap: %s\n", strerror(errno));
+		close(l_memfd);
+		return -1;
+	}
+	// server writes the first ring and reads the second
+	a_ring->tx = (shmring_shared_t *)a_ring->map;
+	a_ring->rx = (shmring_shared_t *)(a_ring->map + SHMRING_HEADER + a_size);
+	ring_init(a_ring->tx, a_size);
+	ring_init(a_ring->rx, a_size);
+	return l_memfd;
+}
+
+/**
+ * @brief Map a ring pair created by the peer, as the client end
+ *
+ * @param[in] a_ring Ring structure. It is the responsibility of the caller to allocate memory for this structure.
+ * @param[in] a_memfd memfd from shmring_recv_fd, can be closed once this returns
+ * @return 0 on success, -1 if the memfd can't be mapped or doesn't hold a ring pair
+ */
+
+int shmring_attach(shmring_t *a_ring, int a_memfd)
+{
+	struct stat l_st;
+
+	memset(a_ring, 0, sizeof(shmring_t));
+	a_ring->peer_fd = -1;
+	if ((fstat(a_memfd, &l_st) < 0) || (l_st.st_size < 2 * SHMRING_HEADER)) {
+		fprintf(stderr, "shmring_attach: memfd is too small to hold a ring pair\n");
+		return -1;
+	}
+	a_ring->map_size = l_st.st_size;
+	a_ring->map = mmap(NULL, a_ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, a_memfd, 0);
+	if (a_ring->map == MAP_FAILED) {
+		fprintf(stderr, "shmring_attach: can't mmap: %s\n", strerror(errno));
+		return -1;
+	}
+	shmring_shared_t *l_first = (shmring_shared_t *)a_ring->map;
+	uint32_t l_size = l_first->size;
+	// anything smaller couldn't carry the biggest packet outer frames, and a writer would block on it forever
+	if ((l_first->magic != SHMRING_MAGIC) || (l_size < SHMRING_MIN_SIZE) || ((l_size & (l_size - 1)) != 0)
+		|| (a_ring->map_size != 2 * ((size_t)SHMRING_HEADER + l_size))) {
+		fprintf(stderr, "shmring_attach: memfd doesn't hold a ring pair\n");
+		munmap(a_ring->map, a_ring->map_size);
+		return -1;
+	}
+	// mirror image of the server, with our own copy of the size so the peer can't change it under us
+	a_ring->size = l_size;
+	a_ring->rx = l_first;
+	a_ring->tx = (shmring_shared_t *)(a_ring->map + SHMRING_HEADER + l_size);
+	return 0;
+}
+
+/**
+ * @brief Write a message into the outgoing ring, gathered from several buffers
+ * Blocks until the whole message fits, then publishes it in one step, so
+ * the reader never wakes up for half a packet.
+ *
+ * @param[in] a_ring Our end
+ * @param[in] a_iov Buffers to write
+ * @param[in] a_count Number of buffers
+ * @return number of bytes written, or -1 with errno EMSGSIZE if the message can never fit or EPIPE if the ring is closed
+ */
+
+ssize_t shmring_writev(shmring_t *a_ring, const struct iovec *a_iov, int a_count)
+{
+	shmring_shared_t *l_shared = a_ring->tx;
+	uint8_t *l_data = ring_data(l_shared);
+	size_t l_total = 0;
+	int i;
+
+	for (i = 0; i < a_count; ++i)
+		l_total += a_iov[i].iov_len;
+	if (l_total > a_ring->size) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+	if (atomic_load(&l_shared->closed) || (!ring_ready(a_ring, l_shared, l_total) && (ring_wait(a_ring, l_shared, l_total) < 0))) {
+		errno = EPIPE;
+		return -1;
+	}
+	uint64_t l_head = atomic_load_explicit(&l_shared->head, memory_order_relaxed);
+	uint64_t l_pos = l_head;
+	for (i = 0; i < a_count; ++i) {
+		size_t l_off = l_pos & (a_ring->size - 1);
+		size_t l_first = a_ring->size - l_off;
+		if (l_first > a_iov[i].iov_len)
+			l_first = a_iov[i].iov_len;
+		memcpy(l_data + l_off, a_iov[i].iov_base, l_first);
+		memcpy(l_data, (uint8_t *)a_iov[i].iov_base + l_first, a_iov[i].iov_len - l_first);
+		l_pos += a_iov[i].iov_len;
+	}
+	atomic_store(&l_shared->head, l_pos);
+	atomic_fetch_add(&l_shared->data_seq, 1);
+	if (atomic_load(&l_shared->reader_waiting))
+		futex_wake(&l_shared->data_seq);
+	return l_total;
+}
+
+/**
+ * @brief Read exactly a_size bytes from the incoming ring unless it is closed first
+ *
+ * @param[in] a_ring Our end
+ * @param[out] a_buff Buffer to fill
+ * @param[in] a_size Bytes to read
+ * @return number of bytes read, less than a_size only if the ring was closed
+ */
+
+ssize_t shmring_read(shmring_t *a_ring, void *a_buff, size_t a_size)
+{
+	shmring_shared_t *l_shared = a_ring->rx;
+	uint8_t *l_data = ring_data(l_shared);
+	size_t l_done = 0;
+
+	while (l_done < a_size) {
+		size_t l_avail = ring_used(l_shared);
+		if (l_avail > a_ring->size) {
+			atomic_store(&l_shared->closed, 1);
+			break;
+		}
+		if (l_avail == 0) {
+			if (ring_wait(a_ring, l_shared, 0) < 0)
+				break;
+			continue;
+		}
+		if (l_avail > a_size - l_done)
+			l_avail = a_size - l_done;
+		uint64_t l_tail = atomic_load_explicit(&l_shared->tail, memory_order_relaxed);
+		size_t l_off = l_tail & (a_ring->size - 1);
+		size_t l_first = a_ring->size - l_off;
+		if (l_first > l_avail)
+			l_first = l_avail;
+		memcpy((uint8_t *)a_buff + l_done, l_data + l_off, l_first);
+		memcpy((uint8_t *)a_buff + l_done + l_first, l_data, l_avail - l_first);
+		atomic_store(&l_shared->tail, l_tail + l_avail);
+		atomic_fetch_add(&l_shared->space_seq, 1);
+		if (atomic_load(&l_shared->writer_waiting))
+			futex_wake(&l_shared->space_seq);
+		l_done += l_avail;
+	}
+	return l_done;
+}
+
+/**
+ * @brief Close our end: the peer's reads drain what is left and then see EOF, its writes fail
+ *
+ * @param[in] a_ring Our end. Does not close peer_fd.
+ */
+
+void shmring_close(shmring_t *a_ring)
+{
+	if (a_ring->map == NULL)
+		return;
+	atomic_store(&a_ring->tx->closed, 1);
+	atomic_store(&a_ring->rx->closed, 1);
+	atomic_fetch_add(&a_ring->tx->data_seq, 1);
+	atomic_fetch_add(&a_ring->rx->space_seq, 1);
+	futex_wake(&a_ring->tx->data_seq);
+	futex_wake(&a_ring->rx->space_seq);
+	munmap(a_ring->map, a_ring->map_size);
+	memset(a_ring, 0, sizeof(shmring_t));
+	a_ring->peer_fd = -1;
+}
+
+/**
+ * @brief Pass a file descriptor to the peer over a Unix domain socket
+ *
+ * @return 0 on success, -1 on error
+ */
+
+int shmring_send_fd(int a_sock, int a_fd)
+{
+	struct msghdr l_msg;
+	struct iovec l_iov;
+	uint8_t l_byte = 'R';
+	union {
+		struct cmsghdr align;
+		uint8_t buf[CMSG_SPACE(sizeof(int))];
+	} l_control;
+
+	memset(&l_msg, 0, sizeof(l_msg));
+	memset(&l_control, 0, sizeof(l_control));
+	l_iov.iov_base = &l_byte;
+	l_iov.iov_len = 1;
+	l_msg.msg_iov = &l_iov;
+	l_msg.msg_iovlen = 1;
+	l_msg.msg_control = l_control.buf;
+	l_msg.msg_controllen = sizeof(l_control.buf);
+	struct cmsghdr *l_cmsg = CMSG_FIRSTHDR(&l_msg);
+	l_cmsg->cmsg_level = SOL_SOCKET;
+	l_cmsg->cmsg_type = SCM_RIGHTS;
+	l_cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(l_cmsg), &a_fd, sizeof(int));
+	return (sendmsg(a_sock, &l_msg, 0) == 1) ? 0 : -1;
+}
+
+/**
+ * @brief Receive a file descriptor sent with shmring_send_fd
+ *
+ * @return the received descriptor, or -1 on error
+ */
+
+int shmring_recv_fd(int a_sock)
+{
+	struct msghdr l_msg;
+	struct iovec l_iov;
+	uint8_t l_byte;
+	int l_fd = -1;
+	union {
+		struct cmsghdr align;
+		uint8_t buf[CMSG_SPACE(sizeof(int))];
+	} l_control;
+
+	memset(&l_msg, 0, sizeof(l_msg));
+	l_iov.iov_base = &l_byte;
+	l_iov.iov_len = 1;
+	l_msg.msg_iov = &l_iov;
+	l_msg.msg_iovlen = 1;
+	l_msg.msg_control = l_control.buf;
+	l_msg.msg_controllen = sizeof(l_control.buf);
+	if (recvmsg(a_sock, &l_msg, MSG_CMSG_CLOEXEC) != 1)
+		return -1;
+	struct cmsghdr *l_cmsg = CMSG_FIRSTHDR(&l_msg);
+	if ((l_cmsg == NULL) || (l_cmsg->cmsg_level != SOL_SOCKET) || (l_cmsg->cmsg_type != SCM_RIGHTS) || (l_cmsg->cmsg_len != CMSG_LEN(sizeof(int))))
+		return -1;
+	memcpy(&l_fd, CMSG_DATA(l_cmsg), sizeof(int));
+	return l_fd;
+}
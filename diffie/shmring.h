@@ -0,0 +1,119 @@
+/**
+ *
+ * Diffie/Hellman/Merkle Implementation
+ * 2025/Nov/11 - Revision 0.80 alpha
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file shmring.h
+ * @brief Shared memory transport for peers on the same host
+ *
+ * Two processes on one machine don't need the kernel's socket buffers to
+ * talk. A shmring_t is a pair of single producer, single consumer byte rings,
+ * one per direction, in a memfd that both processes map. The server creates
+ * the memfd and hands it to the client over a Unix domain socket
+ * (shmring_send_fd, shmring_recv_fd); after that a write is one copy into the
+ * ring and a read is one copy out, with no system calls while the other end
+ * is keeping up.
+ *
+ * A reader that finds its ring empty, or a writer that finds it full, spins
+ * briefly and then sleeps on a futex in the shared mapping. The other end
+ * only calls FUTEX_WAKE when it sees a sleeper flagged, so a busy channel
+ * never enters the kernel. The Unix socket stays open for the life of the
+ * channel so a peer that exits without closing the ring is still noticed.
+ *
+ * Each ring is written by one thread and read by one thread, the same rule
+ * as for a socket-based outer_channel_t.
+ */
+
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define SHMRING_MAGIC 0x44484d52 ///< "DHMR", stamped in each ring header
+#define SHMRING_SIZE (256 * 1024) ///< default bytes of data per direction, a power of 2 larger than any outer packet
+#define SHMRING_MIN_SIZE (128 * 1024) ///< smallest ring accepted, room for an outer packet header and a 64k payload
+#define SHMRING_HEADER 256 ///< bytes reserved in front of each ring's data for its header
+#define SHMRING_SPIN 200 ///< times to recheck a ring before going to sleep on it
+#define SHMRING_CHECK_MS 1000 ///< how often a sleeper wakes up to check that the peer is still there
+
+/**
+ * @struct shmring_shared_t
+ * @brief Header of one direction's ring, lives in shared memory.
+ * head and tail count bytes since the ring was created and never wrap; the
+ * data offset is the count modulo size. They are kept on separate cache
+ * lines so producer and consumer don't bounce one line between them.
+ */
+
+typedef struct {
+	uint32_t magic;
+	uint32_t size; ///< bytes of data, a power of 2
+	uint8_t pad0[56];
+	_Atomic uint64_t head; ///< bytes written so far, stored only by the writer
+	uint8_t pad1[56];
+	_Atomic uint64_t tail; ///< bytes read so far, stored only by the reader
+	uint8_t pad2[56];
+	_Atomic uint32_t data_seq; ///< futex word, bumped whenever head moves
+	_Atomic uint32_t space_seq; ///< futex word, bumped whenever tail moves
+	_Atomic uint32_t reader_waiting; ///< reader is asleep, or about to be, on data_seq
+	_Atomic uint32_t writer_waiting; ///< writer is asleep, or about to be, on space_seq
+	_Atomic uint32_t closed; ///< set by either end on close, wakes and fails everything after
+} shmring_shared_t;
+
+/**
+ * @struct shmring_t
+ * @brief One end's view of a ring pair.
+ */
+
+typedef struct {
+	uint8_t *map; ///< the whole memfd mapping, both rings
+	size_t map_size;
+	uint32_t size; ///< bytes of data per direction, our copy of what the ring headers say
+	shmring_shared_t *tx; ///< ring we write
+	shmring_shared_t *rx; ///< ring we read
+	int peer_fd; ///< Unix socket to the peer, polled while asleep to notice it going away, -1 for none
+} shmring_t;
+
+int     shmring_create  (shmring_t *a_ring, uint32_t a_size);
+int     shmring_attach  (shmring_t *a_ring, int a_memfd);
+ssize_t shmring_writev  (shmring_t *a_ring, const struct iovec *a_iov, int a_count);
+ssize_t shmring_read    (shmring_t *a_ring, void *a_buff, size_t a_size);
+void    shmring_close   (shmring_t *a_ring);
+int     shmring_send_fd (int a_sock, int a_fd);
+int     shmring_recv_fd (int a_sock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHMRING_H
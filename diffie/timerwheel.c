@@ -0,0 +1,257 @@
+/**
+ *
+ * Diffie/Hellman/Merkle Implementation
+ * 2025/Nov/11 - Revision 0.80 alpha
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file timerwheel.c
+ * @brief Hierarchical timer wheel for connection deadlines
+ *
+ * See timerwheel.h for an overview.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "timerwheel.h"
+
+#define SLOT_MASK (TIMERWHEEL_SLOTS - 1)
+#define WHEEL_SPAN ((uint64_t)1 << (TIMERWHEEL_BITS * TIMERWHEEL_LEVELS)) ///< ticks the whole wheel covers
+
+static void timer_unlink(timerwheel_timer_t *a_timer)
+{
+	a_timer->prev->next = a_timer->next;
+	a_timer->next->prev = a_timer->prev;
+	a_timer->next = NULL;
+	a_timer->prev = NULL;
+}
+
+/**
+ * @brief Put a timer in the slot for its expiry, on the lowest level that reaches that far
+ * Call with the wheel locked.
+ */
+
+static void timer_insert(timerwheel_t *a_wheel, timerwheel_timer_t *a_timer)
+{
+	uint64_t l_delta = a_timer->expires - a_wheel->now;
+	int l_level = 0;
+
+	while ((l_level < TIMERWHEEL_LEVELS - 1) && (l_delta >= ((uint64_t)1 << (TIMERWHEEL_BITS * (l_level + 1)))))
+		++l_level;
+	timerwheel_timer_t *l_head = &a_wheel->slots[l_level][(a_timer->expires >> (TIMERWHEEL_BITS * l_level)) & SLOT_MASK];
+	a_timer->next = l_head;
+	a_timer->prev = l_head->prev;
+	l_head->prev->next = a_timer;
+	l_head->prev = a_timer;
+}
+
+/**
+ * @brief Advance one tick: cascade any level that came due, then fire the level 0 slot
+ * Call with the wheel locked.
+ */
+
+static void wheel_tick(timerwheel_t *a_wheel)
+{
+	timerwheel_timer_t l_list;
+	timerwheel_timer_t *l_timer;
+	int l_level;
+
+	a_wheel->now++;
+	for (l_level = 1; l_level < TIMERWHEEL_LEVELS; ++l_level) {
+		if ((a_wheel->now & (((uint64_t)1 << (TIMERWHEEL_BITS * l_level)) - 1)) != 0)
+			break;
+		timerwheel_timer_t *l_cascade = &a_wheel->slots[l_level][(a_wheel->now >> (TIMERWHEEL_BITS * l_level)) & SLOT_MASK];
+		while (l_cascade->next != l_cascade) {
+			l_timer = l_cascade->next;
+			timer_unlink(l_timer);
+			timer_insert(a_wheel, l_timer);
+		}
+	}
+	// move the due slot to a private list first, so a timer that isn't due yet can go back in safely
+	timerwheel_timer_t *l_head = &a_wheel->slots[0][a_wheel->now & SLOT_MASK];
+	if (l_head->next == l_head)
+		return;
+	l_list.next = l_head->next;
+	l_list.prev = l_head->prev;
+	l_list.next->prev = &l_list;
+	l_list.prev->next = &l_list;
+	l_head->next = l_head;
+	l_head->prev = l_head;
+	while (l_list.next != &l_list) {
+		l_timer = l_list.next;
+		timer_unlink(l_timer);
+		if (l_timer->expires > a_wheel->now) {
+			timer_insert(a_wheel, l_timer);
+			continue;
+		}
+		a_wheel->fired++;
+		l_timer->callback(l_timer->arg);
+	}
+}
+
+static void *wheel_tf(void *a_arg)
+{
+	timerwheel_t *l_wheel = (timerwheel_t *)a_arg;
+	struct timespec l_start, l_now, l_until;
+	uint64_t l_due;
+
+	clock_gettime(CLOCK_MONOTONIC, &l_start);
+	pthread_mutex_lock(&l_wheel->lock);
+	while (!l_wheel->stop) {
+		// catch up on every tick that has passed, so a late wakeup doesn't stretch deadlines
+		clock_gettime(CLOCK_MONOTONIC, &l_now);
+		l_due = ((uint64_t)(l_now.tv_sec - l_start.tv_sec) * 1000 + (l_now.tv_nsec - l_start.tv_nsec) / 1000000) / l_wheel->tick_ms;
+		while (l_wheel->now < l_due)
+			wheel_tick(l_wheel);
+		// the condition uses the realtime clock, so sleep for one tick from the realtime now
+		clock_gettime(CLOCK_REALTIME, &l_until);
+		l_until.tv_nsec += (long)l_wheel->tick_ms * 1000000;
+		l_until.tv_sec += l_until.tv_nsec / 1000000000;
+		l_until.tv_nsec %= 1000000000;
+		pthread_cond_timedwait(&l_wheel->wake, &l_wheel->lock, &l_until);
+	}
+	pthread_mutex_unlock(&l_wheel->lock);
+	return NULL;
+}
+
+/**
+ * @brief Set up an empty wheel and start its thread
+ *
+ * @param[in] a_wheel Wheel structure. It is the responsibility of the caller to allocate memory for this structure.
+ * @param[in] a_tick_ms Resolution in milliseconds; deadlines fire up to one tick late
+ * @return 0 on success, -1 if the thread could not be started
+ */
+
+int timerwheel_init(timerwheel_t *a_wheel, unsigned int a_tick_ms)
+{
+	int i, j;
+
+	memset(a_wheel, 0, sizeof(timerwheel_t));
+	a_wheel->tick_ms = (a_tick_ms > 0) ? a_tick_ms : 1;
+	for (i = 0; i < TIMERWHEEL_LEVELS; ++i) {
+		for (j = 0; j < TIMERWHEEL_SLOTS; ++j) {
+			a_wheel->slots[i][j].next = &a_wheel->slots[i][j];
+			a_wheel->slots[i][j].prev = &a_wheel->slots[i][j];
+		}
+	}
+	pthread_mutex_init(&a_wheel->lock, NULL);
+	pthread_cond_init(&a_wheel->wake, NULL);
+	if (pthread_create(&a_wheel->thread, NULL, wheel_tf, a_wheel) != 0) {
+		fprintf(stderr, "timerwheel_init: can't create wheel thread: %s\n", strerror(errno));
+		pthread_mutex_destroy(&a_wheel->lock);
+		pthread_cond_destroy(&a_wheel->wake);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Mark a timer as not armed; call once before its first use
+ *
+ * @param[in] a_timer Timer to initialize. It is the responsibility of the caller to allocate memory for this structure.
+ */
+
+void timerwheel_timer_init(timerwheel_timer_t *a_timer)
+{
+	memset(a_timer, 0, sizeof(timerwheel_timer_t));
+}
+
+/**
+ * @brief Arm a timer, or move its deadline if it is already armed
+ *
+ * @param[in] a_wheel Wheel to arm it on
+ * @param[in] a_timer Timer to arm
+ * @param[in] a_ms Milliseconds from now; fires up to one tick later than that
+ * @param[in] a_callback Called on the wheel thread, with the wheel locked, when the timer expires
+ * @param[in] a_arg Passed to the callback
+ */
+
+void timerwheel_arm(timerwheel_t *a_wheel, timerwheel_timer_t *a_timer, unsigned int a_ms, void (*a_callback)(void *), void *a_arg)
+{
+	uint64_t l_ticks = (a_ms + a_wheel->tick_ms - 1) / a_wheel->tick_ms;
+
+	if (l_ticks == 0)
+		l_ticks = 1;
+	if (l_ticks >= WHEEL_SPAN - 1)
+		l_ticks = WHEEL_SPAN - 2;
+	pthread_mutex_lock(&a_wheel->lock);
+	if (a_timer->next != NULL)
+		timer_unlink(a_timer);
+	// the tick in progress is already partly gone, so count from the next one to never fire early
+	a_timer->expires = a_wheel->now + l_ticks + 1;
+	a_timer->callback = a_callback;
+	a_timer->arg = a_arg;
+	timer_insert(a_wheel, a_timer);
+	pthread_mutex_unlock(&a_wheel->lock);
+}
+
+/**
+ * @brief Disarm a timer; harmless if it isn't armed or has already fired
+ *
+ * @param[in] a_wheel Wheel it was armed on
+ * @param[in] a_timer Timer to cancel
+ */
+
+void timerwheel_cancel(timerwheel_t *a_wheel, timerwheel_timer_t *a_timer)
+{
+	pthread_mutex_lock(&a_wheel->lock);
+	if (a_timer->next != NULL)
+		timer_unlink(a_timer);
+	pthread_mutex_unlock(&a_wheel->lock);
+}
+
+/**
+ * @brief Number of timers that have expired so far
+ */
+
+uint64_t timerwheel_fired(timerwheel_t *a_wheel)
+{
+	uint64_t l_fired;
+
+	pthread_mutex_lock(&a_wheel->lock);
+	l_fired = a_wheel->fired;
+	pthread_mutex_unlock(&a_wheel->lock);
+	return l_fired;
+}
+
+/**
+ * @brief Stop the wheel thread. Timers still armed are dropped without firing.
+ *
+ * @param[in] a_wheel Wheel to stop. It is the responsibility of the caller to free memory for this structure.
+ */
+
+void timerwheel_destroy(timerwheel_t *a_wheel)
+{
+	pthread_mutex_lock(&a_wheel->lock);
+	a_wheel->stop = 1;
+	pthread_cond_signal(&a_wheel->wake);
+	pthread_mutex_unlock(&a_wheel->lock);
+	pthread_join(a_wheel->thread, NULL);
+	pthread_mutex_destroy(&a_wheel->lock);
+	pthread_cond_destroy(&a_wheel->wake);
+}
@@ -0,0 +1,115 @@
+/**
+ *
+ * Diffie/Hellman/Merkle Implementation
+ * 2025/Nov/11 - Revision 0.80 alpha
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file timerwheel.h
+ * @brief Hierarchical timer wheel for connection deadlines
+ *
+ * A server with many connections needs a deadline on each of them, and
+ * nearly every deadline gets pushed back or cancelled before it fires. A
+ * timer wheel makes arming and cancelling O(1): a timer sits on a doubly
+ * linked list in the slot for its expiry tick. There are four levels of 64
+ * slots; level 0 covers the next 64 ticks, each slot of level 1 covers 64
+ * ticks, and so on. Whenever a lower level wraps around, the next slot of
+ * the level above is emptied and its timers are spread out over the levels
+ * below, so each timer is touched at most once per level.
+ *
+ * The wheel runs its own thread, which advances one slot per tick. Callbacks
+ * run on that thread with the wheel locked, so once timerwheel_cancel
+ * returns the callback is not running and will not run. Callbacks should be
+ * short (shutting down a socket is typical) and must not call back into the
+ * wheel.
+ *
+ * Usage:
+ *
+ * timerwheel_t l_wheel;
+ * timerwheel_timer_t l_timer;
+ * timerwheel_init(&l_wheel, 10);
+ * timerwheel_timer_init(&l_timer);
+ * timerwheel_arm(&l_wheel, &l_timer, 5000, my_callback, my_arg);
+ * ... timerwheel_arm again to push the deadline back ...
+ * timerwheel_cancel(&l_wheel, &l_timer);
+ * timerwheel_destroy(&l_wheel);
+ *
+ * Link with -lpthread.
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define TIMERWHEEL_BITS 6 ///< log2 of the slots per level
+#define TIMERWHEEL_SLOTS (1 << TIMERWHEEL_BITS)
+#define TIMERWHEEL_LEVELS 4 ///< 64^4 ticks, about 46 hours at 10 ms; longer timeouts are clamped
+
+/**
+ * @struct timerwheel_timer_t
+ * @brief One timer, embedded in whatever it times. Treat as opaque.
+ */
+
+typedef struct timerwheel_timer_s {
+	struct timerwheel_timer_s *next;
+	struct timerwheel_timer_s *prev;
+	uint64_t expires; ///< tick this timer fires on
+	void (*callback)(void *);
+	void *arg;
+} timerwheel_timer_t;
+
+/**
+ * @struct timerwheel_t
+ * @brief A timer wheel and the thread that turns it. Treat as opaque.
+ */
+
+typedef struct {
+	unsigned int tick_ms;
+	uint64_t now; ///< ticks processed so far
+	uint64_t fired; ///< timers that have expired since init
+	int stop; ///< set by timerwheel_destroy
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake; ///< only used to stop the thread early
+	timerwheel_timer_t slots[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS]; ///< list heads
+} timerwheel_t;
+
+int      timerwheel_init       (timerwheel_t *a_wheel, unsigned int a_tick_ms);
+void     timerwheel_timer_init (timerwheel_timer_t *a_timer);
+void     timerwheel_arm        (timerwheel_t *a_wheel, timerwheel_timer_t *a_timer, unsigned int a_ms, void (*a_callback)(void *), void *a_arg);
+void     timerwheel_cancel     (timerwheel_t *a_wheel, timerwheel_timer_t *a_timer);
+uint64_t timerwheel_fired      (timerwheel_t *a_wheel);
+void     timerwheel_destroy    (timerwheel_t *a_wheel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TIMERWHEEL_H
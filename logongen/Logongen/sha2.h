@@ -38,11 +38,15 @@
 #define SHA256_DIGEST_SIZE ( 256 / 8)
 #define SHA384_DIGEST_SIZE ( 384 / 8)
 #define SHA512_DIGEST_SIZE ( 512 / 8)
+#define SHA512_224_DIGEST_SIZE ( 224 / 8)
+#define SHA512_256_DIGEST_SIZE ( 256 / 8)
 
 #define SHA256_BLOCK_SIZE  ( 512 / 8)
 #define SHA512_BLOCK_SIZE  (1024 / 8)
 #define SHA384_BLOCK_SIZE  SHA512_BLOCK_SIZE
 #define SHA224_BLOCK_SIZE  SHA256_BLOCK_SIZE
+#define SHA512_224_BLOCK_SIZE SHA512_BLOCK_SIZE
+#define SHA512_256_BLOCK_SIZE SHA512_BLOCK_SIZE
 
 #ifndef SHA2_TYPES
 #define SHA2_TYPES
@@ -56,14 +60,14 @@ extern "C" {
 #endif
 
 typedef struct {
-    unsigned int tot_len;
+    uint64 tot_len;
     unsigned int len;
     unsigned char block[2 * SHA256_BLOCK_SIZE];
     uint32 h[8];
 } sha256_ctx;
 
 typedef struct {
-    unsigned int tot_len;
+    uint64 tot_len;
     unsigned int len;
     unsigned char block[2 * SHA512_BLOCK_SIZE];
     uint64 h[8];
@@ -71,6 +75,8 @@ typedef struct {
 
 typedef sha512_ctx sha384_ctx;
 typedef sha256_ctx sha224_ctx;
+typedef sha512_ctx sha512_224_ctx;
+typedef sha512_ctx sha512_256_ctx;
 
 void sha224_init(sha224_ctx *ctx);
 void sha224_update(sha224_ctx *ctx, const unsigned char *message,
@@ -100,6 +106,81 @@ void sha512_final(sha512_ctx *ctx, unsigned char *digest);
 void sha512(const unsigned char *message, unsigned int len,
             unsigned char *digest);
 
+/* SHA-512/t (FIPS 180-4): the SHA-512 core with its own initial values and a
+   truncated output. Same digest sizes as SHA-224/SHA-256, but on 64 bit hosts
+   the 128 byte block costs less per byte than the 32 bit SHA-256 core. */
+
+void sha512_224_init(sha512_224_ctx *ctx);
+void sha512_224_update(sha512_224_ctx *ctx, const unsigned char *message,
+                       unsigned int len);
+void sha512_224_final(sha512_224_ctx *ctx, unsigned char *digest);
+void sha512_224(const unsigned char *message, unsigned int len,
+                unsigned char *digest);
+
+void sha512_256_init(sha512_256_ctx *ctx);
+void sha512_256_update(sha512_256_ctx *ctx, const unsigned char *message,
+                       unsigned int len);
+void sha512_256_final(sha512_256_ctx *ctx, unsigned char *digest);
+void sha512_256(const unsigned char *message, unsigned int len,
+                unsigned char *digest);
+
+/* Portable SHA-512 (and SHA-384) state checkpoint: 4 byte magic "S512",
+   the 64 bit count of hashed bytes, the pending block length and the eight
+   chaining values, all big endian, followed by the pending block padded to
+   SHA512_BLOCK_SIZE. The same bytes can be imported on any host, so a long
+   running hash can be saved and resumed later with only new data. */
+
+#define SHA512_EXPORT_SIZE (4 + 8 + 4 + 8 * 8 + SHA512_BLOCK_SIZE)
+
+void sha512_export(const sha512_ctx *ctx, unsigned char *buf);
+int sha512_import(sha512_ctx *ctx, const unsigned char *buf);
+uint64 sha512_processed(const sha512_ctx *ctx);
+
+/* HMAC (RFC 2104). The keyed inner and outer midstates are computed once by
+   hmac_*_init and kept in *_reinit; hmac_*_reinit clones them for the next
+   message, so a per-message MAC costs only the message blocks plus the two
+   finalization blocks instead of re-hashing the padded key each time. */
+
+typedef struct {
+    sha256_ctx ctx_inside;
+    sha256_ctx ctx_outside;
+
+    /* for hmac_reinit */
+    sha256_ctx ctx_inside_reinit;
+    sha256_ctx ctx_outside_reinit;
+} hmac_sha256_ctx;
+
+typedef struct {
+    sha512_ctx ctx_inside;
+    sha512_ctx ctx_outside;
+
+    /* for hmac_reinit */
+    sha512_ctx ctx_inside_reinit;
+    sha512_ctx ctx_outside_reinit;
+} hmac_sha512_ctx;
+
+void hmac_sha256_init(hmac_sha256_ctx *ctx, const unsigned char *key,
+                      unsigned int key_size);
+void hmac_sha256_reinit(hmac_sha256_ctx *ctx);
+void hmac_sha256_update(hmac_sha256_ctx *ctx, const unsigned char *message,
+                        unsigned int message_len);
+void hmac_sha256_final(hmac_sha256_ctx *ctx, unsigned char *mac,
+                       unsigned int mac_size);
+void hmac_sha256(const unsigned char *key, unsigned int key_size,
+                 const unsigned char *message, unsigned int message_len,
+                 unsigned char *mac, unsigned mac_size);
+
+void hmac_sha512_init(hmac_sha512_ctx *ctx, const unsigned char *key,
+                      unsigned int key_size);
+void hmac_sha512_reinit(hmac_sha512_ctx *ctx);
+void hmac_sha512_update(hmac_sha512_ctx *ctx, const unsigned char *message,
+                        unsigned int message_len);
+void hmac_sha512_final(hmac_sha512_ctx *ctx, unsigned char *mac,
+                       unsigned int mac_size);
+void hmac_sha512(const unsigned char *key, unsigned int key_size,
+                 const unsigned char *message, unsigned int message_len,
+                 unsigned char *mac, unsigned mac_size);
+
 #ifdef __cplusplus
 }
 #endif
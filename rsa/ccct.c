@@ -412,3 +412,65 @@ int ccct_close_urandom()
     pthread_mutex_destroy(&g_urandom_mtx);
     return 0;
 }
+
+static uint64_t ccct_splitmix64(uint64_t *a_x)
+{
+    uint64_t l_z = (*a_x += 0x9e3779b97f4a7c15ULL);
+    l_z = (l_z ^ (l_z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    l_z = (l_z ^ (l_z >> 27)) * 0x94d049bb133111ebULL;
+    return l_z ^ (l_z >> 31);
+}
+
+static uint64_t ccct_rotl64(uint64_t a_x, int a_k)
+{
+    return (a_x << a_k) | (a_x >> (64 - a_k));
+}
+
+/**
+ * @brief Seed a deterministic byte generator
+ * Each (seed, stream) pair gives its own sequence, so threads sharing a seed
+ * can each replay their own candidates regardless of scheduling.
+ *
+ * @param[in] a_drbg Generator state to initialize
+ * @param[in] a_seed Seed value
+ * @param[in] a_stream Stream number, such as a thread id
+ */
+
+void ccct_drbg_seed(ccct_drbg_t *a_drbg, uint64_t a_seed, uint64_t a_stream)
+{
+    int i;
+    uint64_t l_x = a_seed ^ ccct_rotl64(a_stream * 0xd1342543de82ef95ULL, 17);
+
+    for (i = 0; i < 4; ++i)
+        a_drbg->s[i] = ccct_splitmix64(&l_x);
+}
+
+/**
+ * @brief Return a string of deterministic bytes
+ * Bytes are taken from each 64 bit output most significant first, so the
+ * sequence is the same on any host regardless of endianness.
+ *
+ * @param[in] a_drbg Generator seeded with ccct_drbg_seed
+ * @param[in] a_buffer Buffer large enough to hold bytes
+ * @param[in] a_len Number of bytes to write
+ */
+
+void ccct_drbg_generate(ccct_drbg_t *a_drbg, uint8_t *a_buffer, size_t a_len)
+{
+    size_t i;
+    int j;
+    uint64_t *s = a_drbg->s;
+
+    for (i = 0; i < a_len; i += 8) {
+        uint64_t l_out = ccct_rotl64(s[1] * 5, 7) * 9;
+        uint64_t l_t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= l_t;
+        s[3] = ccct_rotl64(s[3], 45);
+        for (j = 0; (j < 8) && (i + j < a_len); ++j)
+            a_buffer[i + j] = (l_out >> (56 - (8 * j))) & 0xff;
+    }
+}
@@ -79,6 +79,17 @@ typedef union {
     char data[4]; ///< Rw byte data for float
 } ccct_reversible_float_t;
 
+/**
+ * @struct ccct_drbg_t
+ * @brief State of a seeded, deterministic byte generator (xoshiro256**).
+ * NOT cryptographically secure: the same seed always gives the same bytes.
+ * Meant for reproducible benchmarks, never for keys anyone will use.
+ */
+
+typedef struct {
+    uint64_t s[4]; ///< generator state
+} ccct_drbg_t;
+
 void ccct_set_debug             (int a_debug);
 void ccct_get_term_size         ();
 void ccct_print_hex             (uint8_t *a_buffer, size_t a_len);
@@ -95,6 +106,8 @@ void ccct_base64_unformat       (const char *a_textin, char *a_textout);
 int  ccct_open_urandom          ();
 void ccct_get_random            (uint8_t *a_buffer, size_t a_len);
 int  ccct_close_urandom         ();
+void ccct_drbg_seed             (ccct_drbg_t *a_drbg, uint64_t a_seed, uint64_t a_stream);
+void ccct_drbg_generate         (ccct_drbg_t *a_drbg, uint8_t *a_buffer, size_t a_len);
 
 #ifdef __cplusplus
 }
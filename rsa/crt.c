@@ -0,0 +1,134 @@
+/**
+ *
+ * Chinese Remainder Private Key Operation
+ * 2025/Nov/18
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file crt.c
+ * @brief RSA private key operation by way of the chinese remainder theorem
+ *
+ */
+
+#include <pthread.h>
+
+#include "crt.h"
+#include "mtmul.h"
+
+/**
+ * @brief Set up an empty key
+ *
+ * @param[in] a_key Key to initialize
+ */
+
+void crt_key_init(crt_key *a_key)
+{
+    mpz_init(a_key->d);
+    mpz_init(a_key->e);
+    mpz_init(a_key->n);
+    mpz_init(a_key->p);
+    mpz_init(a_key->q);
+    mpz_init(a_key->dp);
+    mpz_init(a_key->dq);
+    mpz_init(a_key->qinv);
+    a_key->block_size = 0;
+}
+
+/**
+ * @brief Release a key set up with crt_key_init
+ *
+ * @param[in] a_key Key to clear
+ */
+
+void crt_key_clear(crt_key *a_key)
+{
+    mpz_clear(a_key->d);
+    mpz_clear(a_key->e);
+    mpz_clear(a_key->n);
+    mpz_clear(a_key->p);
+    mpz_clear(a_key->q);
+    mpz_clear(a_key->dp);
+    mpz_clear(a_key->dq);
+    mpz_clear(a_key->qinv);
+}
+
+/**
+ * @struct crt_half
+ * @brief The q half of a split operation, run on a helper thread while the caller does the p half.
+ */
+
+typedef struct {
+    mpz_ptr result;
+    mpz_srcptr base;
+    mpz_srcptr exp;
+    mpz_srcptr mod;
+} crt_half;
+
+static void *crt_half_tf(void *arg)
+{
+    crt_half *a_half = arg;
+
+    mtmul_powm(a_half->result, a_half->base, a_half->exp, a_half->mod);
+    return NULL;
+}
+
+/**
+ * @brief a_out = a_in ^ d mod n, by way of two half size exponentiations
+ *
+ * @param[out] a_out Result, may not be a_in
+ * @param[in] a_in Input block, less than n
+ * @param[in] a_key Private key with p, q, dp, dq and qinv filled in
+ * @param[in] a_split Set to run the two halves concurrently; if no thread can be had they run one after the other
+ */
+
+void crt_powm(mpz_t a_out, mpz_srcptr a_in, crt_key *a_key, int a_split)
+{
+    mpz_t l_m1;
+    mpz_init(l_m1);
+    mpz_t l_m2;
+    mpz_init(l_m2);
+    mpz_t l_h;
+    mpz_init(l_h);
+
+    pthread_t l_thread;
+    crt_half l_half = { l_m2, a_in, a_key->dq, a_key->q };
+    if ((a_split > 0) && (pthread_create(&l_thread, NULL, crt_half_tf, &l_half) != 0))
+        a_split = 0; // no thread to be had, do it ourselves
+    mtmul_powm(l_m1, a_in, a_key->dp, a_key->p);
+    if (a_split > 0)
+        pthread_join(l_thread, NULL);
+    else
+        mtmul_powm(l_m2, a_in, a_key->dq, a_key->q);
+
+    // garner's recombination
+    mpz_sub(l_m1, l_m1, l_m2);
+    mpz_mul(l_h, a_key->qinv, l_m1);
+    mpz_mod(l_h, l_h, a_key->p);
+    mpz_mul(l_h, l_h, a_key->q);
+    mpz_add(a_out, l_m2, l_h);
+
+    mpz_clear(l_m1);
+    mpz_clear(l_m2);
+    mpz_clear(l_h);
+}
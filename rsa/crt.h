@@ -0,0 +1,80 @@
+/**
+ *
+ * Chinese Remainder Private Key Operation
+ * 2025/Nov/18
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file crt.h
+ * @brief RSA private key operation by way of the chinese remainder theorem
+ *
+ * Instead of one exponentiation modulo n with the full private exponent,
+ * crt_powm does one modulo p and one modulo q, each half the size, and puts
+ * the two together with Garner's formula. That is about four times less
+ * work. The two halves don't depend on each other, so they can also run on
+ * two threads at once, which roughly halves the time a single operation
+ * takes. Each half goes through mtmul_powm, so a running mtmul pool is used
+ * for huge keys.
+ *
+ * rsa-util uses it for decryption and signing, and kat checks it against
+ * libcrypto.
+ */
+
+#ifndef CRT_H
+#define CRT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <gmp.h>
+
+/**
+ * @struct crt_key
+ * @brief A private key in the form the chinese remainder theorem needs.
+ * qinv is q^-1 mod p.
+ */
+
+typedef struct {
+    mpz_t d;
+    mpz_t e;
+    mpz_t n;
+    mpz_t p;
+    mpz_t q;
+    mpz_t dp; ///< d mod (p - 1)
+    mpz_t dq; ///< d mod (q - 1)
+    mpz_t qinv;
+    size_t block_size; ///< bytes in the modulus
+} crt_key;
+
+void crt_key_init     (crt_key *a_key);
+void crt_key_clear    (crt_key *a_key);
+void crt_powm         (mpz_t a_out, mpz_srcptr a_in, crt_key *a_key, int a_split);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRT_H */
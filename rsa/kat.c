@@ -0,0 +1,605 @@
+/**
+ *
+ * RSA Implementation
+ * 2025/Nov/16 - Revision 0.80 alpha
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file kat.c
+ * @brief Known answer and speed comparison against the system libcrypto
+ *
+ * Runs the same random inputs through our AES256/CTR, SHA-2, HMAC and
+ * exponentiation code and through OpenSSL's libcrypto, fails if any result
+ * differs, and reports the throughput of each side.
+ *
+ * Usage:
+ *
+ * make kat
+ *
+ * Builds and runs only if the libcrypto headers are installed. It is not
+ * part of the normal build, and none of the tools link against libcrypto.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <gmp.h>
+#include <sys/time.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/bn.h>
+#include <openssl/rsa.h>
+#include <openssl/core_names.h>
+
+#include "ccct.h"
+#include "sha2.h"
+#include "aes.h"
+#include "mtmul.h"
+#include "crt.h"
+#include "color_print.h"
+
+#define KAT_SPEED_BYTES (16 * 1024 * 1024)
+#define KAT_MAXLEN 5000
+#define KAT_PARMUL_REPS 3 // 16384 bit exponentiations timed each way
+#define KAT_CRT_REPS 5 // blocks per generated RSA key
+
+unsigned int g_checks = 0;
+unsigned int g_failed = 0;
+unsigned int g_threads = 2; // threads in the mtmul pool
+
+double now()
+{
+    struct timeval l_tv;
+    gettimeofday(&l_tv, NULL);
+    return l_tv.tv_sec + (l_tv.tv_usec / 1000000.0);
+}
+
+void check(int a_ok, const char *a_what, size_t a_len)
+{
+    g_checks++;
+    if (a_ok == 0) {
+        g_failed++;
+        color_err_printf(0, "kat: MISMATCH: %s, length %lu", a_what, (unsigned long)a_len);
+    }
+}
+
+void report(const char *a_what, double a_ours, double a_theirs, const char *a_unit)
+{
+    color_printf("*akat:*d %-22s ours *h%10.2f*d %s, libcrypto *h%10.2f*d %s (*b%.2fx*d)\n", a_what, a_ours, a_unit, a_theirs, a_unit, a_ours / a_theirs);
+}
+
+void openssl_ctr(const uint8_t *a_key, const uint8_t *a_iv, uint64_t a_block_offset, const uint8_t *a_in, uint8_t *a_out, size_t a_len)
+{
+    // libcrypto's CTR mode counts over the whole 128 bit IV, so start it at iv + block_offset
+    EVP_CIPHER_CTX *l_ctx = EVP_CIPHER_CTX_new();
+    uint8_t l_iv[16];
+    unsigned int l_carry;
+    int l_outlen;
+    int i;
+
+    memcpy(l_iv, a_iv, 16);
+    for (i = 15; i >= 0; --i) {
+        l_carry = l_iv[i] + (a_block_offset & 0xff);
+        l_iv[i] = l_carry & 0xff;
+        a_block_offset = (a_block_offset >> 8) + (l_carry >> 8);
+    }
+    EVP_EncryptInit_ex(l_ctx, EVP_aes_256_ctr(), NULL, a_key, l_iv);
+    EVP_EncryptUpdate(l_ctx, a_out, &l_outlen, a_in, a_len);
+    EVP_EncryptFinal_ex(l_ctx, a_out + l_outlen, &l_outlen);
+    EVP_CIPHER_CTX_free(l_ctx);
+}
+
+void kat_aes(uint8_t *a_buff, uint8_t *a_ours, uint8_t *a_theirs)
+{
+    static const size_t l_lens[] = { 1, 15, 16, 17, 31, 64, 1000, KAT_MAXLEN };
+    static const uint64_t l_offsets[] = { 0, 1, 0xffffffffULL, 0x123456789abcdefULL };
+    struct AES_ctx l_ctx;
+    uint8_t l_key[32];
+    uint8_t l_iv[16];
+    size_t l_done, l_chunk;
+    unsigned int i, j, r;
+    double l_t0, l_t1, l_t2;
+
+    for (r = 0; r < 2; ++r) {
+        ccct_get_random(l_key, 32);
+        ccct_get_random(l_iv, 16);
+        if (r == 1)
+            memset(l_iv + 8, 0xff, 8); // make the counter carry out of its low 64 bits
+        AES_init_ctx_iv(&l_ctx, l_key, l_iv);
+        for (i = 0; i < sizeof(l_lens) / sizeof(size_t); ++i) {
+            for (j = 0; j < sizeof(l_offsets) / sizeof(uint64_t); ++j) {
+                ccct_get_random(a_buff, l_lens[i]);
+                AES_CTR_xcrypt(&l_ctx, a_buff, a_ours, l_lens[i], l_offsets[j]);
+                openssl_ctr(l_key, l_iv, l_offsets[j], a_buff, a_theirs, l_lens[i]);
+                check(memcmp(a_ours, a_theirs, l_lens[i]) == 0, "AES256/CTR", l_lens[i]);
+            }
+        }
+
+        // the stateful version, fed in pieces of varying size, must give the same stream
+        // like upstream tiny-AES, it wants whole blocks on every call but the last
+        ccct_get_random(a_buff, KAT_MAXLEN);
+        memcpy(a_ours, a_buff, KAT_MAXLEN);
+        AES_ctx_set_iv(&l_ctx, l_iv);
+        for (l_done = 0, l_chunk = AES_BLOCKLEN; l_done < KAT_MAXLEN; l_done += l_chunk, l_chunk = ((l_done % 7) + 1) * AES_BLOCKLEN) {
+            if (l_done + l_chunk > KAT_MAXLEN)
+                l_chunk = KAT_MAXLEN - l_done;
+            AES_CTR_xcrypt_buffer(&l_ctx, a_ours + l_done, l_chunk);
+        }
+        openssl_ctr(l_key, l_iv, 0, a_buff, a_theirs, KAT_MAXLEN);
+        check(memcmp(a_ours, a_theirs, KAT_MAXLEN) == 0, "AES256/CTR in pieces", KAT_MAXLEN);
+    }
+
+    // throughput over one big buffer, buffers are KAT_SPEED_BYTES long
+    AES_ctx_set_iv(&l_ctx, l_iv);
+    ccct_get_random(a_buff, KAT_SPEED_BYTES);
+    l_t0 = now();
+    AES_CTR_xcrypt(&l_ctx, a_buff, a_ours, KAT_SPEED_BYTES, 0);
+    l_t1 = now();
+    openssl_ctr(l_key, l_iv, 0, a_buff, a_theirs, KAT_SPEED_BYTES);
+    l_t2 = now();
+    check(memcmp(a_ours, a_theirs, KAT_SPEED_BYTES) == 0, "AES256/CTR", KAT_SPEED_BYTES);
+    report("AES256/CTR", (KAT_SPEED_BYTES / 1048576.0) / (l_t1 - l_t0), (KAT_SPEED_BYTES / 1048576.0) / (l_t2 - l_t1), "MB/s");
+}
+
+typedef struct {
+    const char *name;
+    void (*oneshot)(const unsigned char *, unsigned int, unsigned char *);
+    const char *evp_name;
+    unsigned int digest_size;
+} kat_hash;
+
+void kat_sha(uint8_t *a_buff, uint8_t *a_ours, uint8_t *a_theirs)
+{
+    static const kat_hash l_hashes[] = {
+        { "SHA-224", sha224, "SHA224", SHA224_DIGEST_SIZE },
+        { "SHA-256", sha256, "SHA256", SHA256_DIGEST_SIZE },
+        { "SHA-384", sha384, "SHA384", SHA384_DIGEST_SIZE },
+        { "SHA-512", sha512, "SHA512", SHA512_DIGEST_SIZE },
+    };
+    static const unsigned int l_keylens[] = { 0, 1, 32, 64, 65, 128, 129, 300 };
+    unsigned int i, h, l_len, l_maclen;
+    uint8_t l_key[300];
+    sha512_ctx l_ctx512;
+    sha256_ctx l_ctx256;
+    double l_t0, l_t1, l_t2;
+
+    for (h = 0; h < sizeof(l_hashes) / sizeof(kat_hash); ++h) {
+        // every length across a couple of block boundaries, then a long one
+        for (l_len = 0; l_len <= 300; ++l_len) {
+            ccct_get_random(a_buff, l_len);
+            l_hashes[h].oneshot(a_buff, l_len, a_ours);
+            EVP_Digest(a_buff, l_len, a_theirs, NULL, EVP_get_digestbyname(l_hashes[h].evp_name), NULL);
+            check(memcmp(a_ours, a_theirs, l_hashes[h].digest_size) == 0, l_hashes[h].name, l_len);
+        }
+        ccct_get_random(a_buff, KAT_MAXLEN);
+        l_hashes[h].oneshot(a_buff, KAT_MAXLEN, a_ours);
+        EVP_Digest(a_buff, KAT_MAXLEN, a_theirs, NULL, EVP_get_digestbyname(l_hashes[h].evp_name), NULL);
+        check(memcmp(a_ours, a_theirs, l_hashes[h].digest_size) == 0, l_hashes[h].name, KAT_MAXLEN);
+    }
+
+    // incremental updates in uneven pieces
+    ccct_get_random(a_buff, KAT_MAXLEN);
+    sha256_init(&l_ctx256);
+    sha512_init(&l_ctx512);
+    for (l_len = 0, i = 1; l_len < KAT_MAXLEN; l_len += i, i = (i * 5 + 1) % 200 + 1) {
+        if (l_len + i > KAT_MAXLEN)
+            i = KAT_MAXLEN - l_len;
+        sha256_update(&l_ctx256, a_buff + l_len, i);
+        sha512_update(&l_ctx512, a_buff + l_len, i);
+    }
+    sha256_final(&l_ctx256, a_ours);
+    EVP_Digest(a_buff, KAT_MAXLEN, a_theirs, NULL, EVP_sha256(), NULL);
+    check(memcmp(a_ours, a_theirs, SHA256_DIGEST_SIZE) == 0, "SHA-256 in pieces", KAT_MAXLEN);
+    sha512_final(&l_ctx512, a_ours);
+    EVP_Digest(a_buff, KAT_MAXLEN, a_theirs, NULL, EVP_sha512(), NULL);
+    check(memcmp(a_ours, a_theirs, SHA512_DIGEST_SIZE) == 0, "SHA-512 in pieces", KAT_MAXLEN);
+
+    // HMAC, with keys shorter than, equal to and longer than a block
+    for (i = 0; i < sizeof(l_keylens) / sizeof(unsigned int); ++i) {
+        ccct_get_random(l_key, l_keylens[i]);
+        ccct_get_random(a_buff, 1000);
+        hmac_sha256(l_key, l_keylens[i], a_buff, 1000, a_ours, SHA256_DIGEST_SIZE);
+        HMAC(EVP_sha256(), l_key, l_keylens[i], a_buff, 1000, a_theirs, &l_maclen);
+        check(memcmp(a_ours, a_theirs, SHA256_DIGEST_SIZE) == 0, "HMAC-SHA256 key", l_keylens[i]);
+        hmac_sha512(l_key, l_keylens[i], a_buff, 1000, a_ours, SHA512_DIGEST_SIZE);
+        HMAC(EVP_sha512(), l_key, l_keylens[i], a_buff, 1000, a_theirs, &l_maclen);
+        check(memcmp(a_ours, a_theirs, SHA512_DIGEST_SIZE) == 0, "HMAC-SHA512 key", l_keylens[i]);
+    }
+
+    ccct_get_random(a_buff, KAT_SPEED_BYTES);
+    for (h = 1; h < sizeof(l_hashes) / sizeof(kat_hash); h += 2) { // SHA-256 and SHA-512 do the work for the other two
+        l_t0 = now();
+        l_hashes[h].oneshot(a_buff, KAT_SPEED_BYTES, a_ours);
+        l_t1 = now();
+        EVP_Digest(a_buff, KAT_SPEED_BYTES, a_theirs, NULL, EVP_get_digestbyname(l_hashes[h].evp_name), NULL);
+        l_t2 = now();
+        check(memcmp(a_ours, a_theirs, l_hashes[h].digest_size) == 0, l_hashes[h].name, KAT_SPEED_BYTES);
+        report(l_hashes[h].name, (KAT_SPEED_BYTES / 1048576.0) / (l_t1 - l_t0), (KAT_SPEED_BYTES / 1048576.0) / (l_t2 - l_t1), "MB/s");
+    }
+}
+
+void mpz_to_bn(BIGNUM *a_bn, mpz_t a_val, uint8_t *a_buff)
+{
+    size_t l_len;
+    mpz_export(a_buff, &l_len, 1, sizeof(unsigned char), 0, 0, a_val);
+    BN_bin2bn(a_buff, l_len, a_bn);
+}
+
+void kat_powm(uint8_t *a_buff)
+{
+    // random odd moduli stand in for RSA keys: raw exponentiation doesn't care whether n has two factors
+    static const unsigned int l_bits[] = { 1024, 2048, 4096, 8192, 16384 };
+    gmp_randstate_t l_rand;
+    mpz_t l_n, l_base, l_exp, l_ours, l_theirs, l_pooled;
+    BIGNUM *l_bn_n, *l_bn_base, *l_bn_exp, *l_bn_res;
+    BN_CTX *l_bnctx = BN_CTX_new();
+    unsigned int i, r, l_reps;
+    size_t l_len;
+    double l_t0, l_t1, l_t2, l_ours_time, l_theirs_time;
+    char l_what[64];
+    uint8_t l_seed[32];
+
+    mpz_inits(l_n, l_base, l_exp, l_ours, l_theirs, l_pooled, NULL);
+    l_bn_n = BN_new();
+    l_bn_base = BN_new();
+    l_bn_exp = BN_new();
+    l_bn_res = BN_new();
+    gmp_randinit_default(l_rand);
+    ccct_get_random(l_seed, 32);
+    mpz_import(l_n, 32, 1, sizeof(unsigned char), 0, 0, l_seed);
+    gmp_randseed(l_rand, l_n);
+
+    for (i = 0; i < sizeof(l_bits) / sizeof(unsigned int); ++i) {
+        l_reps = (l_bits[i] <= 2048) ? 20 : ((l_bits[i] <= 4096) ? 5 : 1);
+        l_ours_time = 0.0;
+        l_theirs_time = 0.0;
+        for (r = 0; r < l_reps; ++r) {
+            mpz_urandomb(l_n, l_rand, l_bits[i]);
+            mpz_setbit(l_n, l_bits[i] - 1);
+            mpz_setbit(l_n, 0);
+            mpz_urandomm(l_base, l_rand, l_n);
+            mpz_urandomb(l_exp, l_rand, l_bits[i]); // the size of a private exponent
+            mpz_to_bn(l_bn_n, l_n, a_buff);
+            mpz_to_bn(l_bn_base, l_base, a_buff);
+            mpz_to_bn(l_bn_exp, l_exp, a_buff);
+
+            l_t0 = now();
+            mpz_powm(l_ours, l_base, l_exp, l_n);
+            l_t1 = now();
+            BN_mod_exp(l_bn_res, l_bn_base, l_bn_exp, l_bn_n, l_bnctx);
+            l_t2 = now();
+            l_ours_time += l_t1 - l_t0;
+            l_theirs_time += l_t2 - l_t1;
+            l_len = BN_bn2bin(l_bn_res, a_buff);
+            mpz_import(l_theirs, l_len, 1, sizeof(unsigned char), 0, 0, a_buff);
+            sprintf(l_what, "%u bit powm", l_bits[i]);
+            check(mpz_cmp(l_ours, l_theirs) == 0, l_what, l_bits[i] / 8);
+
+            // the pool only takes on moduli from MTMUL_MIN_BITS up, below that this is mpz_powm again
+            if (l_bits[i] >= MTMUL_MIN_BITS) {
+                mtmul_powm(l_pooled, l_base, l_exp, l_n);
+                sprintf(l_what, "%u bit mtmul_powm", l_bits[i]);
+                check(mpz_cmp(l_pooled, l_theirs) == 0, l_what, l_bits[i] / 8);
+            }
+        }
+        sprintf(l_what, "%u bit powm", l_bits[i]);
+        report(l_what, l_reps / l_ours_time, l_reps / l_theirs_time, "op/s");
+    }
+
+    gmp_randclear(l_rand);
+    mpz_clears(l_n, l_base, l_exp, l_ours, l_theirs, l_pooled, NULL);
+    BN_free(l_bn_n);
+    BN_free(l_bn_base);
+    BN_free(l_bn_exp);
+    BN_free(l_bn_res);
+    BN_CTX_free(l_bnctx);
+}
+
+void kat_param(EVP_PKEY *a_pkey, const char *a_name, mpz_t a_out, uint8_t *a_buff)
+{
+    // one of libcrypto's RSA key components as an mpz
+    BIGNUM *l_bn = NULL;
+    size_t l_len;
+
+    if (EVP_PKEY_get_bn_param(a_pkey, a_name, &l_bn) <= 0) {
+        color_err_printf(0, "kat: libcrypto key has no %s", a_name);
+        exit(EXIT_FAILURE);
+    }
+    l_len = BN_bn2bin(l_bn, a_buff);
+    mpz_import(a_out, l_len, 1, sizeof(unsigned char), 0, 0, a_buff);
+    BN_clear_free(l_bn);
+}
+
+int kat_rsa_raw(EVP_PKEY *a_pkey, int a_decrypt, const uint8_t *a_in, uint8_t *a_out, size_t a_len)
+{
+    // one unpadded RSA operation by libcrypto, public with a_decrypt 0, private otherwise
+    EVP_PKEY_CTX *l_ctx = EVP_PKEY_CTX_new(a_pkey, NULL);
+    size_t l_outlen = a_len;
+    int l_ok;
+
+    if (a_decrypt)
+        l_ok = (EVP_PKEY_decrypt_init(l_ctx) > 0) && (EVP_PKEY_CTX_set_rsa_padding(l_ctx, RSA_NO_PADDING) > 0)
+            && (EVP_PKEY_decrypt(l_ctx, a_out, &l_outlen, a_in, a_len) > 0);
+    else
+        l_ok = (EVP_PKEY_encrypt_init(l_ctx) > 0) && (EVP_PKEY_CTX_set_rsa_padding(l_ctx, RSA_NO_PADDING) > 0)
+            && (EVP_PKEY_encrypt(l_ctx, a_out, &l_outlen, a_in, a_len) > 0);
+    EVP_PKEY_CTX_free(l_ctx);
+    return l_ok && (l_outlen == a_len);
+}
+
+void kat_crt(uint8_t *a_buff)
+{
+    // the private key operation rsa-util does, on keys libcrypto generated, against BN_mod_exp with the full d,
+    // then raw RSA both ways: libcrypto encrypts and we decrypt, we encrypt and libcrypto decrypts
+    static const unsigned int l_bits[] = { 1024, 2048, 4096 };
+    gmp_randstate_t l_rand;
+    EVP_PKEY *l_pkey;
+    crt_key l_key;
+    mpz_t l_base, l_ours, l_theirs;
+    BIGNUM *l_bn_n, *l_bn_d, *l_bn_base, *l_bn_res;
+    BN_CTX *l_bnctx = BN_CTX_new();
+    uint8_t *l_plain = a_buff + 16384; // a_buff itself is scratch for conversions
+    uint8_t *l_cipher = a_buff + 32768;
+    size_t l_len;
+    unsigned int i, r;
+    uint8_t l_seed[32];
+
+    mpz_inits(l_base, l_ours, l_theirs, NULL);
+    l_bn_n = BN_new();
+    l_bn_d = BN_new();
+    l_bn_base = BN_new();
+    l_bn_res = BN_new();
+    gmp_randinit_default(l_rand);
+    ccct_get_random(l_seed, 32);
+    mpz_import(l_base, 32, 1, sizeof(unsigned char), 0, 0, l_seed);
+    gmp_randseed(l_rand, l_base);
+
+    for (i = 0; i < sizeof(l_bits) / sizeof(unsigned int); ++i) {
+        l_pkey = EVP_PKEY_Q_keygen(NULL, NULL, "RSA", (size_t)l_bits[i]);
+        if (l_pkey == NULL) {
+            check(0, "libcrypto RSA key generation", l_bits[i] / 8);
+            continue;
+        }
+        crt_key_init(&l_key);
+        kat_param(l_pkey, OSSL_PKEY_PARAM_RSA_N, l_key.n, a_buff);
+        kat_param(l_pkey, OSSL_PKEY_PARAM_RSA_E, l_key.e, a_buff);
+        kat_param(l_pkey, OSSL_PKEY_PARAM_RSA_D, l_key.d, a_buff);
+        kat_param(l_pkey, OSSL_PKEY_PARAM_RSA_FACTOR1, l_key.p, a_buff);
+        kat_param(l_pkey, OSSL_PKEY_PARAM_RSA_FACTOR2, l_key.q, a_buff);
+        kat_param(l_pkey, OSSL_PKEY_PARAM_RSA_EXPONENT1, l_key.dp, a_buff);
+        kat_param(l_pkey, OSSL_PKEY_PARAM_RSA_EXPONENT2, l_key.dq, a_buff);
+        kat_param(l_pkey, OSSL_PKEY_PARAM_RSA_COEFFICIENT1, l_key.qinv, a_buff); // q^-1 mod p, like ours
+        l_key.block_size = l_bits[i] / 8;
+        mpz_to_bn(l_bn_n, l_key.n, a_buff);
+        mpz_to_bn(l_bn_d, l_key.d, a_buff);
+
+        for (r = 0; r < KAT_CRT_REPS; ++r) {
+            mpz_urandomm(l_base, l_rand, l_key.n);
+            mpz_to_bn(l_bn_base, l_base, a_buff);
+            BN_mod_exp(l_bn_res, l_bn_base, l_bn_d, l_bn_n, l_bnctx);
+            l_len = BN_bn2bin(l_bn_res, a_buff);
+            mpz_import(l_theirs, l_len, 1, sizeof(unsigned char), 0, 0, a_buff);
+
+            crt_powm(l_ours, l_base, &l_key, 0);
+            check(mpz_cmp(l_ours, l_theirs) == 0, "crt_powm", l_key.block_size);
+            crt_powm(l_ours, l_base, &l_key, 1);
+            check(mpz_cmp(l_ours, l_theirs) == 0, "crt_powm split", l_key.block_size);
+            mtmul_powm(l_ours, l_base, l_key.d, l_key.n); // what --nochinese does
+            check(mpz_cmp(l_ours, l_theirs) == 0, "powm with the full d", l_key.block_size);
+
+            // raw RSA, blocks are the size of the modulus
+            memset(l_plain, 0, l_key.block_size);
+            mpz_export(l_plain + l_key.block_size - (mpz_sizeinbase(l_base, 256)), &l_len, 1, sizeof(unsigned char), 0, 0, l_base);
+            if (kat_rsa_raw(l_pkey, 0, l_plain, l_cipher, l_key.block_size)) {
+                mpz_import(l_theirs, l_key.block_size, 1, sizeof(unsigned char), 0, 0, l_cipher);
+                crt_powm(l_ours, l_theirs, &l_key, 1);
+                check(mpz_cmp(l_ours, l_base) == 0, "RSA libcrypto encrypts, crt_powm decrypts", l_key.block_size);
+            } else {
+                check(0, "RSA libcrypto encrypt", l_key.block_size);
+            }
+            mpz_powm(l_ours, l_base, l_key.e, l_key.n);
+            memset(l_cipher, 0, l_key.block_size);
+            mpz_export(l_cipher + l_key.block_size - (mpz_sizeinbase(l_ours, 256)), &l_len, 1, sizeof(unsigned char), 0, 0, l_ours);
+            check(kat_rsa_raw(l_pkey, 1, l_cipher, a_buff, l_key.block_size) && (memcmp(a_buff, l_plain, l_key.block_size) == 0),
+                "RSA we encrypt, libcrypto decrypts", l_key.block_size);
+        }
+        crt_key_clear(&l_key);
+        EVP_PKEY_free(l_pkey);
+    }
+
+    gmp_randclear(l_rand);
+    mpz_clears(l_base, l_ours, l_theirs, NULL);
+    BN_free(l_bn_n);
+    BN_free(l_bn_d);
+    BN_free(l_bn_base);
+    BN_free(l_bn_res);
+    BN_CTX_free(l_bnctx);
+}
+
+void kat_crt_parmul(uint8_t *a_buff)
+{
+    // the pool only takes on halves of MTMUL_MIN_BITS and up, and libcrypto takes far too long to make a key that big,
+    // so this uses random odd "primes" instead. the identity with the full d needs real primes, but the halves and
+    // garner's recombination don't: the reference is the two halves by BN_mod_exp, put together the same way
+    gmp_randstate_t l_rand;
+    crt_key l_key;
+    mpz_t l_base, l_ours, l_ref, l_m1, l_m2;
+    BIGNUM *l_bn_mod, *l_bn_exp, *l_bn_base, *l_bn_res;
+    BN_CTX *l_bnctx = BN_CTX_new();
+    size_t l_len;
+    uint8_t l_seed[32];
+
+    mpz_inits(l_base, l_ours, l_ref, l_m1, l_m2, NULL);
+    l_bn_mod = BN_new();
+    l_bn_exp = BN_new();
+    l_bn_base = BN_new();
+    l_bn_res = BN_new();
+    gmp_randinit_default(l_rand);
+    ccct_get_random(l_seed, 32);
+    mpz_import(l_base, 32, 1, sizeof(unsigned char), 0, 0, l_seed);
+    gmp_randseed(l_rand, l_base);
+
+    crt_key_init(&l_key);
+    do {
+        mpz_urandomb(l_key.p, l_rand, MTMUL_MIN_BITS);
+        mpz_setbit(l_key.p, MTMUL_MIN_BITS - 1);
+        mpz_setbit(l_key.p, 0);
+        mpz_urandomb(l_key.q, l_rand, MTMUL_MIN_BITS);
+        mpz_setbit(l_key.q, MTMUL_MIN_BITS - 1);
+        mpz_setbit(l_key.q, 0);
+    } while (mpz_invert(l_key.qinv, l_key.q, l_key.p) == 0);
+    mpz_mul(l_key.n, l_key.p, l_key.q);
+    mpz_urandomb(l_key.dp, l_rand, MTMUL_MIN_BITS);
+    mpz_urandomb(l_key.dq, l_rand, MTMUL_MIN_BITS);
+    l_key.block_size = MTMUL_MIN_BITS / 4;
+    mpz_urandomm(l_base, l_rand, l_key.n);
+
+    mpz_to_bn(l_bn_base, l_base, a_buff);
+    mpz_to_bn(l_bn_mod, l_key.p, a_buff);
+    mpz_to_bn(l_bn_exp, l_key.dp, a_buff);
+    BN_mod_exp(l_bn_res, l_bn_base, l_bn_exp, l_bn_mod, l_bnctx);
+    l_len = BN_bn2bin(l_bn_res, a_buff);
+    mpz_import(l_m1, l_len, 1, sizeof(unsigned char), 0, 0, a_buff);
+    mpz_to_bn(l_bn_mod, l_key.q, a_buff);
+    mpz_to_bn(l_bn_exp, l_key.dq, a_buff);
+    BN_mod_exp(l_bn_res, l_bn_base, l_bn_exp, l_bn_mod, l_bnctx);
+    l_len = BN_bn2bin(l_bn_res, a_buff);
+    mpz_import(l_m2, l_len, 1, sizeof(unsigned char), 0, 0, a_buff);
+    mpz_sub(l_ref, l_m1, l_m2);
+    mpz_mul(l_ref, l_ref, l_key.qinv);
+    mpz_mod(l_ref, l_ref, l_key.p);
+    mpz_mul(l_ref, l_ref, l_key.q);
+    mpz_add(l_ref, l_ref, l_m2);
+
+    // main started the pool, so this is --parmul
+    crt_powm(l_ours, l_base, &l_key, 0);
+    check(mpz_cmp(l_ours, l_ref) == 0, "crt_powm parmul", l_key.block_size);
+    crt_powm(l_ours, l_base, &l_key, 1);
+    check(mpz_cmp(l_ours, l_ref) == 0, "crt_powm split parmul", l_key.block_size);
+    mtmul_close();
+    crt_powm(l_ours, l_base, &l_key, 1);
+    check(mpz_cmp(l_ours, l_ref) == 0, "crt_powm split", l_key.block_size);
+    mtmul_init(g_threads);
+
+    crt_key_clear(&l_key);
+    gmp_randclear(l_rand);
+    mpz_clears(l_base, l_ours, l_ref, l_m1, l_m2, NULL);
+    BN_free(l_bn_mod);
+    BN_free(l_bn_exp);
+    BN_free(l_bn_base);
+    BN_free(l_bn_res);
+    BN_CTX_free(l_bnctx);
+}
+
+void kat_parmul()
+{
+    // what rsa-util --parmul does to one half of a 32768 bit private key operation, against plain mpz_powm.
+    // mtmul does about twice the arithmetic, so it only wins with enough cores to spread it over
+    gmp_randstate_t l_rand;
+    mpz_t l_n, l_base, l_exp, l_ours, l_pooled;
+    unsigned int r;
+    double l_t0, l_t1, l_t2, l_ours_time = 0.0, l_pooled_time = 0.0;
+    long l_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    uint8_t l_seed[32];
+
+    mpz_inits(l_n, l_base, l_exp, l_ours, l_pooled, NULL);
+    gmp_randinit_default(l_rand);
+    ccct_get_random(l_seed, 32);
+    mpz_import(l_n, 32, 1, sizeof(unsigned char), 0, 0, l_seed);
+    gmp_randseed(l_rand, l_n);
+
+    for (r = 0; r < KAT_PARMUL_REPS; ++r) {
+        mpz_urandomb(l_n, l_rand, MTMUL_MIN_BITS);
+        mpz_setbit(l_n, MTMUL_MIN_BITS - 1);
+        mpz_setbit(l_n, 0);
+        mpz_urandomm(l_base, l_rand, l_n);
+        mpz_urandomb(l_exp, l_rand, MTMUL_MIN_BITS);
+        l_t0 = now();
+        mpz_powm(l_ours, l_base, l_exp, l_n);
+        l_t1 = now();
+        mtmul_powm(l_pooled, l_base, l_exp, l_n);
+        l_t2 = now();
+        l_ours_time += l_t1 - l_t0;
+        l_pooled_time += l_t2 - l_t1;
+        check(mpz_cmp(l_ours, l_pooled) == 0, "parmul powm", MTMUL_MIN_BITS / 8);
+    }
+    l_ours_time /= KAT_PARMUL_REPS;
+    l_pooled_time /= KAT_PARMUL_REPS;
+    color_printf("*akat:*d %u bit powm: mpz_powm *h%.3f*d s, mtmul_powm *h%.3f*d s with *h%u*d threads on *h%ld*d cores\n",
+        MTMUL_MIN_BITS, l_ours_time, l_pooled_time, g_threads, l_cores);
+    if (l_pooled_time < l_ours_time)
+        color_printf("*akat:*d --parmul is *h%.2f*dx faster on this machine\n", l_ours_time / l_pooled_time);
+    else
+        color_printf("*akat:*d --parmul is *h%.2f*dx slower on this machine, leave it off\n", l_pooled_time / l_ours_time);
+
+    gmp_randclear(l_rand);
+    mpz_clears(l_n, l_base, l_exp, l_ours, l_pooled, NULL);
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t *l_buff, *l_ours, *l_theirs;
+
+    color_init(0, 0);
+    color_set_theme(3);
+    ccct_open_urandom();
+    setbuf(stdout, NULL);
+
+    l_buff = malloc(KAT_SPEED_BYTES);
+    l_ours = malloc(KAT_SPEED_BYTES);
+    l_theirs = malloc(KAT_SPEED_BYTES);
+    if ((l_buff == NULL) || (l_ours == NULL) || (l_theirs == NULL)) {
+        color_err_printf(0, "kat: unable to allocate buffers.");
+        exit(EXIT_FAILURE);
+    }
+    // at least two threads, so the pool gets checked even on a single core
+    if (sysconf(_SC_NPROCESSORS_ONLN) > 2)
+        g_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    mtmul_init(g_threads);
+
+    color_printf("*akat:*d comparing against *h%s*d\n", OpenSSL_version(OPENSSL_VERSION));
+    kat_aes(l_buff, l_ours, l_theirs);
+    kat_sha(l_buff, l_ours, l_theirs);
+    kat_powm(l_buff);
+    kat_crt(l_buff);
+    kat_crt_parmul(l_buff);
+    kat_parmul();
+
+    mtmul_close();
+    free(l_buff);
+    free(l_ours);
+    free(l_theirs);
+    ccct_close_urandom();
+
+    if (g_failed > 0) {
+        color_err_printf(0, "kat: %u of %u checks FAILED", g_failed, g_checks);
+        exit(EXIT_FAILURE);
+    }
+    color_printf("*akat:*d all *h%u*d checks passed\n", g_checks);
+    return 0;
+}
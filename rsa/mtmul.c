@@ -0,0 +1,467 @@
+/**
+ *
+ * Multithreaded Big Integer Multiplication
+ * 2025/Nov/16
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file mtmul.c
+ * @brief Multithreaded multiplication and modular exponentiation for very large numbers
+ *
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "mtmul.h"
+
+/**
+ * @struct mtmul_batch
+ * @brief The pieces of one multiplication that are still out with the pool.
+ */
+
+typedef struct {
+    unsigned int pending; ///< pieces not yet multiplied, protected by g_mtx
+} mtmul_batch;
+
+/**
+ * @struct mtmul_node
+ * @brief One product in a Karatsuba split.
+ * A leaf is multiplied by whichever thread picks it up; an inner node
+ * has three children and is put back together by the caller.
+ */
+
+typedef struct mtmul_node {
+    mpz_t x; ///< leaf: left operand
+    mpz_t y; ///< leaf: right operand, unused when squaring
+    mpz_t r; ///< leaf: product
+    int square; ///< set to multiply x by itself
+    mp_bitcnt_t split; ///< inner node: bit position the operands were split at
+    struct mtmul_node *child[3]; ///< inner node: low product, high product, product of sums
+    mtmul_batch *batch; ///< leaf: batch to report to when done
+    struct mtmul_node *next; ///< leaf: link in the work queue
+} mtmul_node;
+
+static pthread_t *g_workers = NULL; ///< pool threads, the caller of each multiplication works too
+static unsigned int g_nworkers = 0; ///< number of pool threads running
+static unsigned int g_depth = 0; ///< levels of splitting, enough to give every thread a piece
+static int g_running = 0; ///< cleared to tell the pool to quit
+static pthread_mutex_t g_mtx = PTHREAD_MUTEX_INITIALIZER; ///< protects the queue and every batch
+static pthread_cond_t g_work_cond = PTHREAD_COND_INITIALIZER; ///< signalled when pieces are queued
+static pthread_cond_t g_done_cond = PTHREAD_COND_INITIALIZER; ///< signalled when a batch is finished
+static mtmul_node *g_queue_head = NULL; ///< pieces waiting for a thread
+
+/**
+ * @brief Multiply one piece and report it to its batch
+ * Called without g_mtx held.
+ *
+ * @param[in] a_leaf The piece to multiply
+ */
+
+static void mtmul_leaf(mtmul_node *a_leaf)
+{
+    if (a_leaf->square)
+        mpz_mul(a_leaf->r, a_leaf->x, a_leaf->x);
+    else
+        mpz_mul(a_leaf->r, a_leaf->x, a_leaf->y);
+    pthread_mutex_lock(&g_mtx);
+    a_leaf->batch->pending--;
+    if (a_leaf->batch->pending == 0)
+        pthread_cond_broadcast(&g_done_cond);
+    pthread_mutex_unlock(&g_mtx);
+}
+
+/**
+ * @brief Take the next piece off the queue
+ * Called with g_mtx held.
+ *
+ * @return the piece, or NULL if the queue is empty
+ */
+
+static mtmul_node *mtmul_pop()
+{
+    mtmul_node *l_leaf = g_queue_head;
+    if (l_leaf != NULL)
+        g_queue_head = l_leaf->next;
+    return l_leaf;
+}
+
+static void *mtmul_worker_tf(void *arg)
+{
+    mtmul_node *l_leaf;
+
+    pthread_mutex_lock(&g_mtx);
+    while (1) {
+        while ((g_queue_head == NULL) && (g_running > 0))
+            pthread_cond_wait(&g_work_cond, &g_mtx);
+        l_leaf = mtmul_pop();
+        if (l_leaf == NULL)
+            break; // queue is empty and we have been told to quit
+        pthread_mutex_unlock(&g_mtx);
+        mtmul_leaf(l_leaf);
+        pthread_mutex_lock(&g_mtx);
+    }
+    pthread_mutex_unlock(&g_mtx);
+    return NULL;
+}
+
+/**
+ * @brief Start the pool
+ * Starts a_threads - 1 workers; the thread calling mtmul_mul makes up the last one.
+ * Asking for fewer than 2 threads leaves the pool off.
+ *
+ * @param[in] a_threads Number of threads to spread each multiplication across
+ * @return 0 on success, -1 if no worker could be started
+ */
+
+int mtmul_init(unsigned int a_threads)
+{
+    unsigned int i;
+    unsigned int l_pieces = 1;
+
+    if ((g_nworkers > 0) || (a_threads < 2))
+        return 0;
+    g_workers = malloc((a_threads - 1) * sizeof(pthread_t));
+    if (g_workers == NULL)
+        return -1;
+    g_running = 1;
+    for (i = 0; i < a_threads - 1; ++i) {
+        if (pthread_create(&g_workers[i], NULL, mtmul_worker_tf, NULL) != 0)
+            break;
+        g_nworkers++;
+    }
+    if (g_nworkers == 0) {
+        free(g_workers);
+        g_workers = NULL;
+        return -1;
+    }
+    // each level of splitting makes three pieces out of one
+    g_depth = 0;
+    while ((l_pieces < g_nworkers + 1) && (g_depth < MTMUL_MAX_DEPTH)) {
+        l_pieces *= 3;
+        g_depth++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Stop the pool and wait for its threads to finish
+ */
+
+void mtmul_close()
+{
+    unsigned int i;
+
+    if (g_nworkers == 0)
+        return;
+    pthread_mutex_lock(&g_mtx);
+    g_running = 0;
+    pthread_cond_broadcast(&g_work_cond);
+    pthread_mutex_unlock(&g_mtx);
+    for (i = 0; i < g_nworkers; ++i)
+        pthread_join(g_workers[i], NULL);
+    free(g_workers);
+    g_workers = NULL;
+    g_nworkers = 0;
+}
+
+/**
+ * @brief Is the pool running?
+ *
+ * @return 1 if multiplications are being spread across threads, 0 if they go straight to GMP
+ */
+
+int mtmul_active()
+{
+    return (g_nworkers > 0) ? 1 : 0;
+}
+
+/**
+ * @brief Split a product of non-negative numbers into pieces
+ * x * y = z2 * 2^2s + (z1 - z2 - z0) * 2^s + z0, where x = x1 * 2^s + x0, y likewise,
+ * z0 = x0 * y0, z2 = x1 * y1 and z1 = (x0 + x1) * (y0 + y1). The leaves end up on a_list.
+ *
+ * @param[in] a_x Left operand
+ * @param[in] a_y Right operand, ignored when squaring
+ * @param[in] a_square Set when the product is a_x squared
+ * @param[in] a_depth Levels of splitting still allowed
+ * @param[in] a_batch Batch the leaves report to
+ * @param[in,out] a_list Head of the list of leaves built so far
+ * @return the new node
+ */
+
+static mtmul_node *mtmul_build(mpz_srcptr a_x, mpz_srcptr a_y, int a_square, unsigned int a_depth, mtmul_batch *a_batch, mtmul_node **a_list)
+{
+    mtmul_node *l_node;
+    mp_bitcnt_t l_bits;
+    mpz_t l_x0, l_x1, l_y0, l_y1;
+
+    l_node = calloc(1, sizeof(mtmul_node));
+    if (l_node == NULL)
+        abort(); // GMP does the same when it runs out of memory
+    l_node->square = a_square;
+    l_bits = mpz_sizeinbase(a_x, 2);
+    if ((a_square == 0) && (mpz_sizeinbase(a_y, 2) > l_bits))
+        l_bits = mpz_sizeinbase(a_y, 2);
+    if ((a_depth == 0) || (l_bits < 2 * MTMUL_LEAF_BITS)) {
+        mpz_init_set(l_node->x, a_x);
+        if (a_square)
+            mpz_init(l_node->y);
+        else
+            mpz_init_set(l_node->y, a_y);
+        mpz_init(l_node->r);
+        l_node->batch = a_batch;
+        l_node->next = *a_list;
+        *a_list = l_node;
+        a_batch->pending++;
+        return l_node;
+    }
+
+    // split on a limb boundary so the halves are cheap to cut out and put back
+    l_node->split = ((l_bits / 2 + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS) * GMP_NUMB_BITS;
+    mpz_inits(l_x0, l_x1, l_y0, l_y1, NULL);
+    mpz_tdiv_r_2exp(l_x0, a_x, l_node->split);
+    mpz_tdiv_q_2exp(l_x1, a_x, l_node->split);
+    if (a_square == 0) {
+        mpz_tdiv_r_2exp(l_y0, a_y, l_node->split);
+        mpz_tdiv_q_2exp(l_y1, a_y, l_node->split);
+    }
+    l_node->child[0] = mtmul_build(l_x0, l_y0, a_square, a_depth - 1, a_batch, a_list);
+    l_node->child[1] = mtmul_build(l_x1, l_y1, a_square, a_depth - 1, a_batch, a_list);
+    mpz_add(l_x0, l_x0, l_x1);
+    if (a_square == 0)
+        mpz_add(l_y0, l_y0, l_y1);
+    l_node->child[2] = mtmul_build(l_x0, l_y0, a_square, a_depth - 1, a_batch, a_list);
+    mpz_clears(l_x0, l_x1, l_y0, l_y1, NULL);
+    return l_node;
+}
+
+/**
+ * @brief Put the pieces of a split product back together and free them
+ *
+ * @param[out] a_out The product
+ * @param[in] a_node Node returned by mtmul_build, once its batch is finished
+ */
+
+static void mtmul_combine(mpz_t a_out, mtmul_node *a_node)
+{
+    mpz_t l_z0, l_z1, l_z2;
+
+    if (a_node->child[0] == NULL) {
+        mpz_swap(a_out, a_node->r);
+        mpz_clears(a_node->x, a_node->y, a_node->r, NULL);
+        free(a_node);
+        return;
+    }
+    mpz_inits(l_z0, l_z1, l_z2, NULL);
+    mtmul_combine(l_z0, a_node->child[0]);
+    mtmul_combine(l_z2, a_node->child[1]);
+    mtmul_combine(l_z1, a_node->child[2]);
+    mpz_sub(l_z1, l_z1, l_z0);
+    mpz_sub(l_z1, l_z1, l_z2);
+    mpz_mul_2exp(a_out, l_z2, a_node->split);
+    mpz_add(a_out, a_out, l_z1);
+    mpz_mul_2exp(a_out, a_out, a_node->split);
+    mpz_add(a_out, a_out, l_z0);
+    mpz_clears(l_z0, l_z1, l_z2, NULL);
+    free(a_node);
+}
+
+/**
+ * @brief a_out = a_x * a_y, spread across the pool
+ * Passing the same variable as a_x and a_y squares it, which is cheaper.
+ * a_out may be the same variable as either operand.
+ *
+ * @param[out] a_out The product
+ * @param[in] a_x Left operand
+ * @param[in] a_y Right operand
+ */
+
+void mtmul_mul(mpz_t a_out, mpz_srcptr a_x, mpz_srcptr a_y)
+{
+    mtmul_batch l_batch = { 0 };
+    mtmul_node *l_list = NULL;
+    mtmul_node *l_root;
+    mtmul_node *l_leaf;
+    mpz_t l_x, l_y;
+    int l_square = (a_x == a_y);
+    int l_sign = mpz_sgn(a_x) * mpz_sgn(a_y);
+
+    if ((g_nworkers == 0) || ((mpz_sizeinbase(a_x, 2) < 2 * MTMUL_LEAF_BITS) && (mpz_sizeinbase(a_y, 2) < 2 * MTMUL_LEAF_BITS))) {
+        mpz_mul(a_out, a_x, a_y);
+        return;
+    }
+
+    // the split assumes non-negative operands, so work with magnitudes and put the sign back after
+    mpz_inits(l_x, l_y, NULL);
+    mpz_abs(l_x, a_x);
+    if (l_square == 0)
+        mpz_abs(l_y, a_y);
+    l_root = mtmul_build(l_x, l_y, l_square, g_depth, &l_batch, &l_list);
+    mpz_clears(l_x, l_y, NULL);
+
+    // queue the pieces, then help multiply them until ours are all done
+    pthread_mutex_lock(&g_mtx);
+    for (l_leaf = l_list; l_leaf->next != NULL; l_leaf = l_leaf->next)
+        ;
+    l_leaf->next = g_queue_head;
+    g_queue_head = l_list;
+    pthread_cond_broadcast(&g_work_cond);
+    while (l_batch.pending > 0) {
+        l_leaf = mtmul_pop();
+        if (l_leaf != NULL) {
+            pthread_mutex_unlock(&g_mtx);
+            mtmul_leaf(l_leaf);
+            pthread_mutex_lock(&g_mtx);
+        } else {
+            pthread_cond_wait(&g_done_cond, &g_mtx);
+        }
+    }
+    pthread_mutex_unlock(&g_mtx);
+
+    mtmul_combine(a_out, l_root);
+    if (l_sign < 0)
+        mpz_neg(a_out, a_out);
+}
+
+/**
+ * @struct mtmul_barrett
+ * @brief Modulus and its precomputed reciprocal for Barrett reduction.
+ */
+
+typedef struct {
+    mpz_t m; ///< the modulus
+    mpz_t mu; ///< floor(2^2k / m)
+    mp_bitcnt_t k; ///< bits in m
+} mtmul_barrett;
+
+/**
+ * @brief a_out = a_x mod m for 0 <= a_x < 2^2k, using two multiplications instead of a division
+ */
+
+static void mtmul_reduce(mpz_t a_out, mpz_srcptr a_x, mtmul_barrett *a_br, mpz_t a_tmp)
+{
+    mpz_tdiv_q_2exp(a_tmp, a_x, a_br->k - 1);
+    mtmul_mul(a_tmp, a_tmp, a_br->mu);
+    mpz_tdiv_q_2exp(a_tmp, a_tmp, a_br->k + 1);
+    mtmul_mul(a_tmp, a_tmp, a_br->m);
+    mpz_sub(a_out, a_x, a_tmp);
+    while (mpz_cmp(a_out, a_br->m) >= 0) // the estimate is at most two short
+        mpz_sub(a_out, a_out, a_br->m);
+}
+
+/**
+ * @brief a_out = a_base ^ a_exp mod a_mod, spreading every product across the pool
+ * Falls back to mpz_powm without a pool, for moduli below MTMUL_MIN_BITS, and for negative exponents.
+ * a_out may be the same variable as any of the inputs.
+ *
+ * @param[out] a_out The result
+ * @param[in] a_base Base
+ * @param[in] a_exp Exponent
+ * @param[in] a_mod Modulus
+ */
+
+void mtmul_powm(mpz_t a_out, mpz_srcptr a_base, mpz_srcptr a_exp, mpz_srcptr a_mod)
+{
+    mtmul_barrett l_br;
+    mpz_t *l_table;
+    mpz_t l_result, l_prod, l_tmp;
+    unsigned int l_window, l_tabsize, l_value, t;
+    long i, j, b, l_ebits;
+    int l_started = 0;
+
+    if ((g_nworkers == 0) || (mpz_sgn(a_exp) < 0) || (mpz_sgn(a_mod) <= 0) || (mpz_sizeinbase(a_mod, 2) < MTMUL_MIN_BITS)) {
+        mpz_powm(a_out, a_base, a_exp, a_mod);
+        return;
+    }
+
+    mpz_init_set(l_br.m, a_mod);
+    mpz_init(l_br.mu);
+    l_br.k = mpz_sizeinbase(a_mod, 2);
+    mpz_setbit(l_br.mu, 2 * l_br.k);
+    mpz_fdiv_q(l_br.mu, l_br.mu, l_br.m);
+    mpz_inits(l_result, l_prod, l_tmp, NULL);
+
+    // odd powers of the base for a sliding window, bigger windows pay off on bigger exponents
+    l_ebits = mpz_sizeinbase(a_exp, 2);
+    if (l_ebits > 10000)
+        l_window = 7;
+    else if (l_ebits > 2000)
+        l_window = 6;
+    else if (l_ebits > 500)
+        l_window = 5;
+    else
+        l_window = 4;
+    l_tabsize = 1 << (l_window - 1);
+    l_table = malloc(l_tabsize * sizeof(mpz_t));
+    if (l_table == NULL)
+        abort();
+    for (t = 0; t < l_tabsize; ++t)
+        mpz_init(l_table[t]);
+    mpz_mod(l_table[0], a_base, a_mod);
+    mtmul_mul(l_prod, l_table[0], l_table[0]);
+    mtmul_reduce(l_result, l_prod, &l_br, l_tmp); // base squared, just for building the table
+    for (t = 1; t < l_tabsize; ++t) {
+        mtmul_mul(l_prod, l_table[t - 1], l_result);
+        mtmul_reduce(l_table[t], l_prod, &l_br, l_tmp);
+    }
+
+    // left to right, squaring for every bit and multiplying in a window of bits at a time
+    mpz_set_ui(l_result, 1);
+    i = l_ebits - 1;
+    while (i >= 0) {
+        if (mpz_tstbit(a_exp, i) == 0) {
+            if (l_started) {
+                mtmul_mul(l_prod, l_result, l_result);
+                mtmul_reduce(l_result, l_prod, &l_br, l_tmp);
+            }
+            i--;
+            continue;
+        }
+        j = (i - (long)l_window + 1 > 0) ? i - (long)l_window + 1 : 0;
+        while (mpz_tstbit(a_exp, j) == 0)
+            j++;
+        l_value = 0;
+        for (b = i; b >= j; --b)
+            l_value = (l_value << 1) | mpz_tstbit(a_exp, b);
+        if (l_started) {
+            for (b = i; b >= j; --b) {
+                mtmul_mul(l_prod, l_result, l_result);
+                mtmul_reduce(l_result, l_prod, &l_br, l_tmp);
+            }
+            mtmul_mul(l_prod, l_result, l_table[l_value >> 1]);
+            mtmul_reduce(l_result, l_prod, &l_br, l_tmp);
+        } else {
+            mpz_set(l_result, l_table[l_value >> 1]);
+            l_started = 1;
+        }
+        i = j - 1;
+    }
+    mpz_mod(a_out, l_result, a_mod); // only matters for a zero exponent and a modulus of 1
+
+    for (t = 0; t < l_tabsize; ++t)
+        mpz_clear(l_table[t]);
+    free(l_table);
+    mpz_clears(l_result, l_prod, l_tmp, l_br.m, l_br.mu, NULL);
+}
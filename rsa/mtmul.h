@@ -0,0 +1,67 @@
+/**
+ *
+ * Multithreaded Big Integer Multiplication
+ * 2025/Nov/16
+ *
+ * Created by: Stephen Sviatko
+ *
+ * (C) 2025 Good Neighbors LLC - All Rights Reserved, except where noted
+ *
+ * This file and any intellectual property (designs, algorithms, formulas,
+ * procedures, trademarks, and related documentation) contained herein are
+ * property of Good Neighbors, an Arizona Limited Liability Company.
+ *
+ * LICENSING INFORMATION
+ *
+ * This file may not be distributed in any modified form without expressed
+ * written permission of Good Neighbors LLC or its regents. Permission is
+ * granted to use this file in any non-commercial, non-governmental capacity
+ * (such as student projects, hobby projects, etc) without an official
+ * licensing agreement as long as the original author(s) are credited in any
+ * derivative work.
+ *
+ * Commercial licensing of this content is available, any agreement must
+ * include consulting services as part of a deployment strategy. For more
+ * information, please contact Stephen Sviatko at the following email address:
+ *
+ * ssviatko@gmail.com
+ *
+ * @file mtmul.h
+ * @brief Multithreaded multiplication and modular exponentiation for very large numbers
+ *
+ * GMP runs each multiplication on one core. For moduli of tens of thousands
+ * of bits and up, one exponentiation takes seconds, and a lone signature
+ * leaves every other core idle. mtmul splits each multiplication Karatsuba
+ * style into three (or nine, or twenty seven) smaller ones, hands those to a
+ * pool of worker threads, and puts the pieces back together.
+ * mtmul_powm builds a sliding window exponentiation with Barrett reduction on
+ * top of that, so every product in it is spread across the pool.
+ *
+ * Below MTMUL_MIN_BITS, or without a pool, everything goes straight to GMP.
+ * Several threads may call in at once; they share the pool.
+ */
+
+#ifndef MTMUL_H
+#define MTMUL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <gmp.h>
+
+#define MTMUL_MIN_BITS  16384   ///< smallest modulus mtmul_powm takes on, half of a 32768 bit key
+#define MTMUL_LEAF_BITS 4096    ///< pieces are not split below this size
+#define MTMUL_MAX_DEPTH 3       ///< at most 27 pieces per multiplication
+
+int  mtmul_init       (unsigned int a_threads);
+void mtmul_close      ();
+int  mtmul_active     ();
+void mtmul_mul        (mpz_t a_out, mpz_srcptr a_x, mpz_srcptr a_y);
+void mtmul_powm       (mpz_t a_out, mpz_srcptr a_base, mpz_srcptr a_exp, mpz_srcptr a_mod);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MTMUL_H */
@@ -56,7 +56,9 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <math.h>
 #include <gmp.h>
+#include <time.h>
 #include <sys/time.h>
 #include <getopt.h>
 #include <pthread.h>
@@ -64,6 +66,7 @@
 #include <sys/stat.h>
 
 #include "ccct.h"
+#include "sha2.h"
 #include "color_print.h"
 
 #pragma pack(1)
@@ -79,6 +82,14 @@ struct timeval g_start_time, g_end_time;
 typedef struct {
 	pthread_t thread;
 	unsigned int id;
+	unsigned int attempts; // times this thread has started on a new p, nearly always just the one
+	uint64_t tested; // candidates that got past the sieve to a primality test, for p and q together
+	ccct_drbg_t drbg; // candidate source in --seed mode
+	int resume; // set when the fields below were loaded from a checkpoint
+	int phase; // 0 while searching for p, 1 once p is found and the search is on for q
+	unsigned char cand[MAXBYTEBUFF / 2]; // resume: next number for the sieve to look at
+	unsigned char found_p[MAXBYTEBUFF / 2]; // p once found, for the checkpoint
+	time_t ckpt_last; // when this thread last saved its position
 	unsigned char p[MAXBYTEBUFF];
 	unsigned char q[MAXBYTEBUFF];
 	unsigned char buff[MAXBYTEBUFF];
@@ -87,7 +98,72 @@ typedef struct {
 thread_work_area twa[MAXTHREADS];
 
 pthread_mutex_t g_bell_mtx;
-int g_bell = 0;
+pthread_cond_t g_bell_cond;
+int g_bell = 0; // set by the first thread to find a key pair, the others give up
+
+// the key pair found by whichever thread got there first
+typedef struct {
+	mpz_t n;
+	mpz_t e;
+	mpz_t d;
+	mpz_t p;
+	mpz_t q;
+	mpz_t dp;
+	mpz_t dq;
+	mpz_t qinv;
+} key_pair;
+
+key_pair g_key;
+unsigned char g_buff[MAXBYTEBUFF];
+
+int g_seeded = 0; // set by --seed: candidates come from a deterministic generator instead of /dev/urandom
+uint64_t g_seed = 1;
+unsigned int g_bench = 0; // number of seeded searches to time with --bench
+
+unsigned long g_exponent = 65537; // public exponent e, fixed before the search so candidates can be sieved against it
+
+#define KGCKPT_MAGIC "RSAKGCK2"
+#define KGCKPT_DEFAULT_INTERVAL 300
+
+// checkpoint of a long key search, written every g_ckpt_interval seconds to <out>.kgckpt
+// layout: keygen_ckpt_header, then for each thread its keygen_ckpt_slot followed by the
+// sieve position and found p (g_pqbits / 8 bytes each), then a sha2-512 seal over all of that
+// all integers are stored big endian
+typedef struct {
+	char magic[8];
+	uint8_t bits[4];
+	uint8_t exponent[4];
+	uint8_t threads[4];
+	uint8_t seeded;
+	uint8_t seed[8];
+} keygen_ckpt_header;
+
+typedef struct {
+	uint8_t valid; // set once the thread has saved its position
+	uint8_t phase;
+	uint8_t attempts[4];
+	uint8_t tested[8];
+	uint8_t drbg[32]; // generator state, so a seeded search replays the same candidates after resuming
+} keygen_ckpt_slot;
+
+// latest saved position of each thread, copied under g_ckpt_mtx
+typedef struct {
+	keygen_ckpt_slot slot;
+	unsigned char cand[MAXBYTEBUFF / 2];
+	unsigned char p[MAXBYTEBUFF / 2];
+} keygen_ckpt_entry;
+
+keygen_ckpt_entry g_ckpt[MAXTHREADS];
+pthread_mutex_t g_ckpt_mtx;
+unsigned int g_ckpt_interval = 0; // seconds between checkpoints, 0 for none
+int g_ckpt_done = 0; // set once the key is written, so no thread puts the file back
+int g_resume = 0;
+char g_ckptfile[BUFFLEN + 16];
+
+#define SIEVE_LIMIT 8192 // candidates with a prime factor below this are skipped without a primality test
+#define SIEVE_PM1_LIMIT 101 // and so are those whose p - 1 has a prime factor up to this
+unsigned int g_sieve_primes[SIEVE_LIMIT / 2];
+unsigned int g_sieve_count = 0;
 
 struct option g_options[] = {
 	{ "bits", required_argument, NULL, 'b' },
@@ -97,6 +173,11 @@ struct option g_options[] = {
 	{ "out", required_argument, NULL, 'o' },
 	{ "pem", no_argument, NULL, 1001 },
 	{ "nocolor", no_argument, NULL, 1002 },
+	{ "seed", required_argument, NULL, 1003 },
+	{ "bench", required_argument, NULL, 1004 },
+	{ "exponent", required_argument, NULL, 1005 },
+	{ "checkpoint", required_argument, NULL, 1006 },
+	{ "resume", no_argument, NULL, 1007 },
 	{ NULL, 0, NULL, 0 }
 };
 
@@ -150,6 +231,268 @@ void color_gmp_printf(const char *format, ...)
 	va_end(args);
 }
 
+void get_candidate_bytes(thread_work_area *a_twa, unsigned char *a_buff, size_t a_len)
+{
+	if (g_seeded)
+		ccct_drbg_generate(&a_twa->drbg, a_buff, a_len);
+	else
+		ccct_get_random(a_buff, a_len);
+}
+
+void sieve_init()
+{
+	// odd primes below SIEVE_LIMIT
+	unsigned char l_composite[SIEVE_LIMIT];
+	unsigned int i, j;
+
+	memset(l_composite, 0, sizeof(l_composite));
+	for (i = 3; i < SIEVE_LIMIT; i += 2) {
+		if (l_composite[i])
+			continue;
+		g_sieve_primes[g_sieve_count++] = i;
+		for (j = i * i; j < SIEVE_LIMIT; j += 2 * i)
+			l_composite[j] = 1;
+	}
+}
+
+void put_be64(uint8_t *a_buff, uint64_t a_val)
+{
+	int i;
+	for (i = 7; i >= 0; --i) {
+		a_buff[i] = a_val & 0xff;
+		a_val >>= 8;
+	}
+}
+
+uint64_t get_be64(const uint8_t *a_buff)
+{
+	int i;
+	uint64_t l_val = 0;
+	for (i = 0; i < 8; ++i)
+		l_val = (l_val << 8) | a_buff[i];
+	return l_val;
+}
+
+void checkpoint_save()
+{
+	// write every thread's last saved position; called with g_ckpt_mtx held
+	size_t l_pq = g_pqbits / 8;
+	size_t l_len = sizeof(keygen_ckpt_header) + g_threads * (sizeof(keygen_ckpt_slot) + 2 * l_pq) + 64;
+	char l_tmpfile[BUFFLEN + 32];
+	keygen_ckpt_header l_hdr;
+	uint8_t *l_rec;
+	uint8_t *l_ptr;
+	unsigned int i;
+	int l_fd;
+	ssize_t res;
+
+	l_rec = malloc(l_len);
+	if (l_rec == NULL) {
+		color_err_printf(0, "rsa-keygen: unable to allocate checkpoint buffer.");
+		return;
+	}
+	memcpy(l_hdr.magic, KGCKPT_MAGIC, 8);
+	*(uint32_t *)l_hdr.bits = htonl(g_bits);
+	*(uint32_t *)l_hdr.exponent = htonl(g_exponent);
+	*(uint32_t *)l_hdr.threads = htonl(g_threads);
+	l_hdr.seeded = g_seeded;
+	put_be64(l_hdr.seed, g_seed);
+	memcpy(l_rec, &l_hdr, sizeof(keygen_ckpt_header));
+	l_ptr = l_rec + sizeof(keygen_ckpt_header);
+	for (i = 0; i < g_threads; ++i) {
+		memcpy(l_ptr, &g_ckpt[i].slot, sizeof(keygen_ckpt_slot));
+		l_ptr += sizeof(keygen_ckpt_slot);
+		memcpy(l_ptr, g_ckpt[i].cand, l_pq);
+		l_ptr += l_pq;
+		memcpy(l_ptr, g_ckpt[i].p, l_pq);
+		l_ptr += l_pq;
+	}
+	sha512(l_rec, l_len - 64, l_ptr);
+
+	// temp file and rename, so a node going away mid-write leaves the previous checkpoint intact
+	// it holds a prime factor of the key being made, so only the owner may read it
+	sprintf(l_tmpfile, "%s.tmp", g_ckptfile);
+	l_fd = open(l_tmpfile, O_WRONLY | O_TRUNC | O_CREAT, (S_IRUSR | S_IWUSR));
+	if (l_fd < 0) {
+		color_err_printf(1, "rsa-keygen: unable to create checkpoint file");
+		free(l_rec);
+		return;
+	}
+	res = write(l_fd, l_rec, l_len);
+	if ((res != l_len) || (fsync(l_fd) < 0) || (close(l_fd) < 0) || (rename(l_tmpfile, g_ckptfile) < 0)) {
+		color_err_printf(1, "rsa-keygen: unable to write checkpoint file");
+		unlink(l_tmpfile);
+	}
+	memset(l_rec, 0, l_len);
+	free(l_rec);
+}
+
+void checkpoint_note(thread_work_area *a_twa, mpz_t a_next)
+{
+	// called by the sieve between primality tests: every g_ckpt_interval seconds, record where this thread is and save
+	time_t l_now;
+	size_t l_written;
+	size_t l_pq = g_pqbits / 8;
+	keygen_ckpt_entry *l_entry = &g_ckpt[a_twa->id];
+	int i;
+
+	if (g_ckpt_interval == 0)
+		return;
+	l_now = time(NULL);
+	if (l_now - a_twa->ckpt_last < g_ckpt_interval)
+		return;
+	a_twa->ckpt_last = l_now;
+
+	pthread_mutex_lock(&g_ckpt_mtx);
+	if (g_ckpt_done == 0) {
+		l_entry->slot.valid = 1;
+		l_entry->slot.phase = a_twa->phase;
+		*(uint32_t *)l_entry->slot.attempts = htonl(a_twa->attempts);
+		put_be64(l_entry->slot.tested, a_twa->tested);
+		for (i = 0; i < 4; ++i)
+			put_be64(l_entry->slot.drbg + (8 * i), a_twa->drbg.s[i]);
+		mpz_export(l_entry->cand, &l_written, 1, sizeof(unsigned char), 0, 0, a_next);
+		if (l_written != l_pq)
+			ccct_right_justify(l_written, l_pq - l_written, (char *)l_entry->cand);
+		if (a_twa->phase > 0)
+			memcpy(l_entry->p, a_twa->found_p, l_pq);
+		checkpoint_save();
+		color_debug("tid %d: checkpoint saved\n", a_twa->id);
+	}
+	pthread_mutex_unlock(&g_ckpt_mtx);
+}
+
+void checkpoint_load()
+{
+	// set up each thread to carry on from g_ckptfile
+	size_t l_pq = g_pqbits / 8;
+	struct stat l_stat;
+	keygen_ckpt_header l_hdr;
+	uint8_t l_digest[64];
+	uint8_t *l_rec;
+	uint8_t *l_ptr;
+	unsigned int l_threads;
+	unsigned int i;
+	int j;
+	int l_fd;
+	ssize_t res;
+
+	l_fd = open(g_ckptfile, O_RDONLY);
+	if ((l_fd < 0) || (fstat(l_fd, &l_stat) < 0)) {
+		color_err_printf(1, "rsa-keygen: unable to open checkpoint file %s", g_ckptfile);
+		exit(EXIT_FAILURE);
+	}
+	l_rec = malloc(l_stat.st_size + 1);
+	if (l_rec == NULL) {
+		color_err_printf(0, "rsa-keygen: unable to allocate checkpoint buffer.");
+		exit(EXIT_FAILURE);
+	}
+	res = read(l_fd, l_rec, l_stat.st_size);
+	close(l_fd);
+	if ((res != l_stat.st_size) || (res < sizeof(keygen_ckpt_header) + 64))
+		goto checkpoint_load_damaged;
+	sha512(l_rec, res - 64, l_digest);
+	if (memcmp(l_digest, l_rec + res - 64, 64) != 0)
+		goto checkpoint_load_damaged;
+	memcpy(&l_hdr, l_rec, sizeof(keygen_ckpt_header));
+	if (memcmp(l_hdr.magic, KGCKPT_MAGIC, 8) != 0)
+		goto checkpoint_load_damaged;
+	if ((ntohl(*(uint32_t *)l_hdr.bits) != g_bits) || (ntohl(*(uint32_t *)l_hdr.exponent) != g_exponent)) {
+		color_err_printf(0, "rsa-keygen: checkpoint is for a %u bit key with exponent %u; use the same -b and --exponent to resume it.",
+			ntohl(*(uint32_t *)l_hdr.bits), ntohl(*(uint32_t *)l_hdr.exponent));
+		exit(EXIT_FAILURE);
+	}
+	l_threads = ntohl(*(uint32_t *)l_hdr.threads);
+	if ((l_threads < 1) || (l_threads > MAXTHREADS) || (res != sizeof(keygen_ckpt_header) + l_threads * (sizeof(keygen_ckpt_slot) + 2 * l_pq) + 64))
+		goto checkpoint_load_damaged;
+
+	// the saved search carries on as it was: same threads, and in --seed mode the same seed
+	if (l_threads != g_threads)
+		color_printf("*arsa-keygen:*d checkpoint was made with *h%u*d threads, using that many.\n", l_threads);
+	g_threads = l_threads;
+	g_seeded = l_hdr.seeded;
+	g_seed = get_be64(l_hdr.seed);
+	l_ptr = l_rec + sizeof(keygen_ckpt_header);
+	for (i = 0; i < g_threads; ++i) {
+		memcpy(&g_ckpt[i].slot, l_ptr, sizeof(keygen_ckpt_slot));
+		l_ptr += sizeof(keygen_ckpt_slot);
+		memcpy(g_ckpt[i].cand, l_ptr, l_pq);
+		l_ptr += l_pq;
+		memcpy(g_ckpt[i].p, l_ptr, l_pq);
+		l_ptr += l_pq;
+		if (g_ckpt[i].slot.valid == 0)
+			continue; // never got as far as a checkpoint, starts afresh
+		twa[i].resume = 1;
+		twa[i].phase = g_ckpt[i].slot.phase;
+		twa[i].attempts = ntohl(*(uint32_t *)g_ckpt[i].slot.attempts);
+		twa[i].tested = get_be64(g_ckpt[i].slot.tested);
+		for (j = 0; j < 4; ++j)
+			twa[i].drbg.s[j] = get_be64(g_ckpt[i].slot.drbg + (8 * j));
+		memcpy(twa[i].cand, g_ckpt[i].cand, l_pq);
+		memcpy(twa[i].found_p, g_ckpt[i].p, l_pq);
+		color_printf("*arsa-keygen:*d thread *h%u*d resumes the search for *h%s*d after testing *h%llu*d candidates\n", i, (twa[i].phase > 0) ? "q" : "p", (unsigned long long)twa[i].tested);
+	}
+	memset(l_rec, 0, l_stat.st_size);
+	free(l_rec);
+	return;
+
+checkpoint_load_damaged:
+	color_err_printf(0, "rsa-keygen: checkpoint file %s is damaged.", g_ckptfile);
+	exit(EXIT_FAILURE);
+}
+
+int sieve_search(thread_work_area *a_twa, mpz_t a_cand)
+{
+	// step the odd number a_cand forward by 2 until it is a probable prime that is usable as p or q:
+	// p - 1 has no prime factor up to SIEVE_PM1_LIMIT and none in common with e, which for a prime e means p mod e != 1.
+	// all of that is decided from residues updated with small additions, so only survivors get a primality test.
+	// returns 0 with the prime in a_cand, or -1 if another thread rang the bell first
+	unsigned int l_res[SIEVE_LIMIT / 2];
+	unsigned long l_eres;
+	unsigned long l_step = 0;
+	unsigned int i;
+	int l_pass;
+	int l_stop = 0;
+
+	mpz_t l_try;
+	mpz_init(l_try);
+
+	for (i = 0; i < g_sieve_count; ++i)
+		l_res[i] = mpz_fdiv_ui(a_cand, g_sieve_primes[i]);
+	l_eres = mpz_fdiv_ui(a_cand, g_exponent);
+	while (1) {
+		l_pass = (l_eres != 1);
+		for (i = 0; (i < g_sieve_count) && (l_pass); ++i) {
+			if ((l_res[i] == 0) || ((l_res[i] == 1) && (g_sieve_primes[i] <= SIEVE_PM1_LIMIT)))
+				l_pass = 0;
+		}
+		if (l_pass) {
+			pthread_mutex_lock(&g_bell_mtx);
+			l_stop = g_bell;
+			pthread_mutex_unlock(&g_bell_mtx);
+			if (l_stop > 0)
+				break; // someone else has the key, don't start another test
+			mpz_add_ui(l_try, a_cand, l_step);
+			a_twa->tested++;
+			if (mpz_probab_prime_p(l_try, 50) > 0)
+				break;
+			mpz_add_ui(l_try, l_try, 2);
+			checkpoint_note(a_twa, l_try);
+		}
+		l_step += 2;
+		for (i = 0; i < g_sieve_count; ++i) {
+			l_res[i] += 2;
+			if (l_res[i] >= g_sieve_primes[i])
+				l_res[i] -= g_sieve_primes[i];
+		}
+		l_eres = (l_eres + 2) % g_exponent;
+	}
+	if (l_stop == 0)
+		mpz_set(a_cand, l_try);
+	mpz_clear(l_try);
+	return (l_stop > 0) ? -1 : 0;
+}
+
 void *gen_tf(void *arg)
 {
 	thread_work_area *a_twa;
@@ -169,14 +512,10 @@ void *gen_tf(void *arg)
 	mpz_init(l_ct);
 	mpz_t l_e;
 	mpz_init(l_e);
-	mpz_t l_tmp;
-	mpz_init(l_tmp);
 	mpz_t l_d;
 	mpz_init(l_d);
 	mpz_t l_q2;
 	mpz_init(l_q2);
-	mpz_t l_counter;
-	mpz_init(l_counter);
 
 	// chinese remainder stuff
 	mpz_t l_dp;
@@ -193,62 +532,73 @@ void *gen_tf(void *arg)
 	mpz_init(l_h);
 
 	int l_success = 0;
-	unsigned int l_attempt = 1;
-	int res;
+	int l_stop = 0;
+	int l_resumed;
 
 	while (l_success == 0) {
 		pthread_mutex_lock(&g_bell_mtx);
-		if (g_bell > 0) {
-			// we didn't make it, so terminate
-			pthread_mutex_unlock(&g_bell_mtx);
-			pthread_exit(NULL);
-			// if we made it here there was a problem
-			return NULL;
-		}
+		l_stop = g_bell;
 		pthread_mutex_unlock(&g_bell_mtx);
-
-		color_debug("tid %d: attempt %d to generate key...\n", a_twa->id, l_attempt++);
+		if (l_stop > 0)
+			break; // we didn't make it
+
+		// a resumed thread picks up its first attempt at the sieve position it saved
+		l_resumed = a_twa->resume;
+		a_twa->resume = 0;
+		if (l_resumed == 0) {
+			a_twa->attempts++;
+			a_twa->phase = 0;
+		}
+		color_debug("tid %d: attempt %d to generate key...\n", a_twa->id, a_twa->attempts);
 		printf(".");
 
-		// prepare random n-bit odd number for p factor
-		ccct_get_random(a_twa->p, (g_pqbits / 8));
-		a_twa->p[0] |= 0xc0; // make it between (2^n - 1) + (2^n - 2) and 2^(n-1)
-		a_twa->p[(g_pqbits / 8) - 1] |= 0x01; // make it odd
+		if (a_twa->phase == 0) {
+			if (l_resumed) {
+				mpz_import(l_p_import, (g_pqbits / 8), 1, sizeof(unsigned char), 0, 0, a_twa->cand);
+			} else {
+				// prepare random n-bit odd number for p factor
+				get_candidate_bytes(a_twa, a_twa->p, (g_pqbits / 8));
+				a_twa->p[0] |= 0xc0; // make it between (2^n - 1) + (2^n - 2) and 2^(n-1)
+				a_twa->p[(g_pqbits / 8) - 1] |= 0x01; // make it odd
 
-		mpz_import(l_p_import, (g_pqbits / 8), 1, sizeof(unsigned char), 0, 0, a_twa->p);
-		int l_pp = mpz_probab_prime_p(l_p_import, 50);
-		if (l_pp == 0) {
-			mpz_nextprime(l_p_import, l_p_import);
+				mpz_import(l_p_import, (g_pqbits / 8), 1, sizeof(unsigned char), 0, 0, a_twa->p);
+			}
+			if (sieve_search(a_twa, l_p_import) < 0)
+				break;
+			mpz_export(a_twa->found_p, NULL, 1, sizeof(unsigned char), 0, 0, l_p_import);
+			a_twa->phase = 1;
+			l_resumed = 0;
+		} else {
+			mpz_import(l_p_import, (g_pqbits / 8), 1, sizeof(unsigned char), 0, 0, a_twa->found_p);
 		}
 
 		color_gmp_printf("tid %d: p       = %Zx\n", a_twa->id, l_p_import);
 
-		l_pp = mpz_probab_prime_p(l_p_import, 50);
-
-		// prepare random n-bit odd number for q factor
-		ccct_get_random(a_twa->q, (g_pqbits / 8));
-//		a_twa->q[0] &= 0x7f; // set up q to hopefully be < p/2
-//		a_twa->q[0] |= 0x40; // but not too little, please.. enforce first byte between 0x40 and 0x7f
-		a_twa->q[0] |= 0xc0; // make it just just like p... instead of the old way commented out above
-		a_twa->q[(g_pqbits / 8) - 1] |= 0x01; // make it odd
-
-		// top 4 bits of p equal to top 4 bits of q? if so, invert bits 4-5 to make it different
-		if ((a_twa->q[0] & 0xf0) == (a_twa->p[0] & 0xf0)) {
-			color_debug("tid %d: inversion: p[0]=%02X q[0]=%02X, inverting bits 4-5 of top byte of q: ", a_twa->id, a_twa->p[0], a_twa->q[0]);
-			a_twa->q[0] ^= 0x30;
-			color_debug("%02X\n", a_twa->q[0]);
-		}
+		if (l_resumed) {
+			mpz_import(l_q_import, (g_pqbits / 8), 1, sizeof(unsigned char), 0, 0, a_twa->cand);
+		} else {
+			// prepare random n-bit odd number for q factor
+			get_candidate_bytes(a_twa, a_twa->q, (g_pqbits / 8));
+//			a_twa->q[0] &= 0x7f; // set up q to hopefully be < p/2
+//			a_twa->q[0] |= 0x40; // but not too little, please.. enforce first byte between 0x40 and 0x7f
+			a_twa->q[0] |= 0xc0; // make it just just like p... instead of the old way commented out above
+			a_twa->q[(g_pqbits / 8) - 1] |= 0x01; // make it odd
+
+			// top 4 bits of p equal to top 4 bits of q? if so, invert bits 4-5 to make it different
+			mpz_export(a_twa->buff, NULL, 1, sizeof(unsigned char), 0, 0, l_p_import);
+			if ((a_twa->q[0] & 0xf0) == (a_twa->buff[0] & 0xf0)) {
+				color_debug("tid %d: inversion: p[0]=%02X q[0]=%02X, inverting bits 4-5 of top byte of q: ", a_twa->id, a_twa->buff[0], a_twa->q[0]);
+				a_twa->q[0] ^= 0x30;
+				color_debug("%02X\n", a_twa->q[0]);
+			}
 
-		mpz_import(l_q_import, (g_pqbits / 8), 1, sizeof(unsigned char), 0, 0, a_twa->q);
-		l_pp = mpz_probab_prime_p(l_q_import, 50);
-		if (l_pp == 0) {
-			mpz_nextprime(l_q_import, l_q_import);
+			mpz_import(l_q_import, (g_pqbits / 8), 1, sizeof(unsigned char), 0, 0, a_twa->q);
 		}
+		if (sieve_search(a_twa, l_q_import) < 0)
+			break;
 
 		color_gmp_printf("tid %d: q       = %Zx\n",a_twa->id, l_q_import);
 
-		l_pp = mpz_probab_prime_p(l_q_import, 50);
-
 		// p and q will never be identical courtesy of our inversion scheme above
 //		// p and q should not be identical
 //		if (mpz_cmp(l_p_import, l_q_import) == 0) {
@@ -270,38 +620,7 @@ void *gen_tf(void *arg)
 		color_gmp_printf("tid %d: (p - 1) = %Zx\n", a_twa->id, l_p1);
 		color_gmp_printf("tid %d: (q - 1) = %Zx\n", a_twa->id, l_q1);
 
-		// p-1 and q-1 should not have small prime factors. Check both of them for all primes <100
-		mpz_set_ui(l_counter, 2); // start with 3 as all even numbers are divisible by 2
-		int l_bailout = 0;
-		do {
-			mpz_nextprime(l_counter, l_counter);
-			//			gmp_printf("testing %Zd against P - 1...\n", l_counter);
-			mpz_gcd(l_tmp, l_counter, l_p1);
-			if (mpz_cmp(l_tmp, l_counter) == 0) {
-				l_bailout = 1;
-				break;
-			}
-		} while (mpz_cmp_ui(l_counter, 100) <= 0);
-		if (l_bailout == 1) {
-			color_gmp_printf("tid %d: error: (p - 1) value has small prime factor of %Zd.\n", a_twa->id, l_counter);
-			continue;
-		}
-
-		mpz_set_ui(l_counter, 2); // start with 3 as all even numbers are divisible by 2
-		l_bailout = 0;
-		do {
-			mpz_nextprime(l_counter, l_counter);
-			//			gmp_printf("testing %Zd against Q - 1...\n", l_counter);
-			mpz_gcd(l_tmp, l_counter, l_q1);
-			if (mpz_cmp(l_tmp, l_counter) == 0) {
-				l_bailout = 1;
-				break;
-			}
-		} while (mpz_cmp_ui(l_counter, 100) <= 0);
-		if (l_bailout == 1) {
-			color_gmp_printf("tid %d: error: (q - 1) value has small prime factor of %Zd.\n", a_twa->id, l_counter);
-			continue;
-		}
+		// p-1 and q-1 have no prime factors up to SIEVE_PM1_LIMIT and are coprime with e, courtesy of sieve_search
 
 		// prepare n = p * q
 		mpz_mul(l_n, l_p_import, l_q_import);
@@ -311,13 +630,14 @@ void *gen_tf(void *arg)
 		mpz_lcm(l_ct, l_p1, l_q1);
 		color_gmp_printf("tid %d: ct      = %Zx\n", a_twa->id, l_ct);
 
-		// choose e, so that e is coprime with ct
-		mpz_set_ui(l_e, 65536); // start at 65537 after nextprime is called
-		do {
-			mpz_nextprime(l_e, l_e);
-			color_gmp_printf("tid %d: testing e = %Zd...\n", a_twa->id, l_e);
-			mpz_gcd(l_tmp, l_e, l_ct);
-		} while (mpz_cmp_ui(l_tmp, 1) != 0);
+		// d < ct, so a totient this short can't give a big enough d; don't bother inverting
+		if (mpz_sizeinbase(l_ct, 2) < (g_bits - 4)) {
+			color_debug("tid %d: error: totient too short for d: %d bits.\n", a_twa->id, (int)mpz_sizeinbase(l_ct, 2));
+			continue;
+		}
+
+		// e was fixed up front and the sieve kept it coprime with p - 1 and q - 1, so it is coprime with ct
+		mpz_set_ui(l_e, g_exponent);
 
 		// choose d
 		if (mpz_invert(l_d, l_e, l_ct) == 0) {
@@ -349,23 +669,47 @@ void *gen_tf(void *arg)
 	}
 
 	pthread_mutex_lock(&g_bell_mtx);
-	if (g_bell > 0) {
-		// we didn't make it, so terminate
-		pthread_mutex_unlock(&g_bell_mtx);
-		pthread_exit(NULL);
-		// if we made it here there was a problem
-		return NULL;
+	if ((l_success > 0) && (g_bell == 0)) {
+		// first one here, so the key pair is ours to hand over
+		g_bell = 1;
+		gettimeofday(&g_end_time, NULL);
+		mpz_set(g_key.n, l_n);
+		mpz_set(g_key.e, l_e);
+		mpz_set(g_key.d, l_d);
+		mpz_set(g_key.p, l_p_import);
+		mpz_set(g_key.q, l_q_import);
+		mpz_set(g_key.dp, l_dp);
+		mpz_set(g_key.dq, l_dq);
+		mpz_set(g_key.qinv, l_qinv);
+		pthread_cond_signal(&g_bell_cond);
 	}
-	g_bell = 1;
 	pthread_mutex_unlock(&g_bell_mtx);
-	//printf("\ntid %d: Done.\n", a_twa->id);
-	color_printf("\n*arsa-keygen:*d done.\n");
-	gettimeofday(&g_end_time, NULL);
-	color_printf("*arsa-keygen:*d found key in *h%ld*d seconds *h%ld*d usecs.\n", g_end_time.tv_sec - g_start_time.tv_sec - ((g_end_time.tv_usec - g_start_time.tv_usec < 0) ? 1 : 0),
-		g_end_time.tv_usec - g_start_time.tv_usec + ((g_end_time.tv_usec - g_start_time.tv_usec < 0) ? 1000000 : 0));
-
-	// export
-	
+
+	// clean up
+	mpz_clear(l_p_import);
+	mpz_clear(l_q_import);
+	mpz_clear(l_p1);
+	mpz_clear(l_q1);
+	mpz_clear(l_n);
+	mpz_clear(l_ct);
+	mpz_clear(l_e);
+	mpz_clear(l_d);
+	mpz_clear(l_q2);
+	mpz_clear(l_m1);
+	mpz_clear(l_m2);
+	mpz_clear(l_h);
+	mpz_clear(l_dp);
+	mpz_clear(l_dq);
+	mpz_clear(l_qinv);
+
+	return NULL;
+}
+
+void write_keys()
+{
+	// export g_key, printing it and writing it to the key files
+	int res;
+
 	int privkey_fd, pubkey_fd;
 	int privkey_pem_fd, pubkey_pem_fd;
 
@@ -413,12 +757,12 @@ void *gen_tf(void *arg)
 	}
 	size_t l_written = 0;
 
-	mpz_export(a_twa->buff, &l_written, 1, sizeof(unsigned char), 0, 0, l_n);
+	mpz_export(g_buff, &l_written, 1, sizeof(unsigned char), 0, 0, g_key.n);
 	if (l_written != (g_bits / 8)) {
-		ccct_right_justify(l_written, (g_bits / 8) - l_written, (char *)a_twa->buff);
+		ccct_right_justify(l_written, (g_bits / 8) - l_written, (char *)g_buff);
 	}
 	color_printf("*amodulus n (*b%d*a bits):*d", g_bits);
-	ccct_print_hex(a_twa->buff, (g_bits / 8));
+	ccct_print_hex(g_buff, (g_bits / 8));
 	if (g_filename_specified) {
 		key_item_header l_kih;
 		l_kih.type = KIHT_MODULUS;
@@ -428,7 +772,7 @@ void *gen_tf(void *arg)
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
-		res = write(privkey_fd, a_twa->buff, (g_bits / 8));
+		res = write(privkey_fd, g_buff, (g_bits / 8));
 		if (res != (g_bits / 8)) {
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
@@ -439,19 +783,19 @@ void *gen_tf(void *arg)
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
-		res = write(pubkey_fd, a_twa->buff, (g_bits / 8));
+		res = write(pubkey_fd, g_buff, (g_bits / 8));
 		if (res != (g_bits / 8)) {
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
 	}
 
-	mpz_export(a_twa->buff, &l_written, 1, sizeof(unsigned char), 0, 0, l_e);
+	mpz_export(g_buff, &l_written, 1, sizeof(unsigned char), 0, 0, g_key.e);
 	if (l_written != 4) { // save e as a 32 bit value, big endian
-		ccct_right_justify(l_written, 4 - l_written, (char *)a_twa->buff);
+		ccct_right_justify(l_written, 4 - l_written, (char *)g_buff);
 	}
 	color_printf("*apublic exponent e:*d");
-	ccct_print_hex(a_twa->buff, 4);
+	ccct_print_hex(g_buff, 4);
 	if (g_filename_specified) {
 		key_item_header l_kih;
 		l_kih.type = KIHT_PUBEXP;
@@ -461,7 +805,7 @@ void *gen_tf(void *arg)
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
-		res = write(privkey_fd, a_twa->buff, 4);
+		res = write(privkey_fd, g_buff, 4);
 		if (res != 4) {
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
@@ -472,19 +816,19 @@ void *gen_tf(void *arg)
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
-		res = write(pubkey_fd, a_twa->buff, 4);
+		res = write(pubkey_fd, g_buff, 4);
 		if (res != 4) {
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
 	}
 
-	mpz_export(a_twa->buff, &l_written, 1, sizeof(unsigned char), 0, 0, l_d);
+	mpz_export(g_buff, &l_written, 1, sizeof(unsigned char), 0, 0, g_key.d);
 	if (l_written != (g_bits / 8)) {
-		ccct_right_justify(l_written, (g_bits / 8) - l_written, (char *)a_twa->buff);
+		ccct_right_justify(l_written, (g_bits / 8) - l_written, (char *)g_buff);
 	}
 	color_printf("*aprivate exponent d:*d");
-	ccct_print_hex(a_twa->buff, (g_bits / 8));
+	ccct_print_hex(g_buff, (g_bits / 8));
 	if (g_filename_specified) {
 		key_item_header l_kih;
 		l_kih.type = KIHT_PRIVEXP;
@@ -494,19 +838,19 @@ void *gen_tf(void *arg)
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
-		res = write(privkey_fd, a_twa->buff, (g_bits / 8));
+		res = write(privkey_fd, g_buff, (g_bits / 8));
 		if (res != (g_bits / 8)) {
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
 	}
 
-	mpz_export(a_twa->buff, &l_written, 1, sizeof(unsigned char), 0, 0, l_p_import);
+	mpz_export(g_buff, &l_written, 1, sizeof(unsigned char), 0, 0, g_key.p);
 	if (l_written != (g_pqbits / 8)) {
-		ccct_right_justify(l_written, (g_pqbits / 8) - l_written, (char *)a_twa->buff);
+		ccct_right_justify(l_written, (g_pqbits / 8) - l_written, (char *)g_buff);
 	}
 	color_printf("*aprime p:*d");
-	ccct_print_hex(a_twa->buff, (g_pqbits / 8));
+	ccct_print_hex(g_buff, (g_pqbits / 8));
 	if (g_filename_specified) {
 		key_item_header l_kih;
 		l_kih.type = KIHT_P;
@@ -516,19 +860,19 @@ void *gen_tf(void *arg)
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
-		res = write(privkey_fd, a_twa->buff, (g_pqbits / 8));
+		res = write(privkey_fd, g_buff, (g_pqbits / 8));
 		if (res != (g_pqbits / 8)) {
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
 	}
 
-	mpz_export(a_twa->buff, &l_written, 1, sizeof(unsigned char), 0, 0, l_q_import);
+	mpz_export(g_buff, &l_written, 1, sizeof(unsigned char), 0, 0, g_key.q);
 	if (l_written != (g_pqbits / 8)) {
-		ccct_right_justify(l_written, (g_pqbits / 8) - l_written, (char *)a_twa->buff);
+		ccct_right_justify(l_written, (g_pqbits / 8) - l_written, (char *)g_buff);
 	}
 	color_printf("*aprime q:*d");
-	ccct_print_hex(a_twa->buff, (g_pqbits / 8));
+	ccct_print_hex(g_buff, (g_pqbits / 8));
 	if (g_filename_specified) {
 		key_item_header l_kih;
 		l_kih.type = KIHT_Q;
@@ -538,19 +882,19 @@ void *gen_tf(void *arg)
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
-		res = write(privkey_fd, a_twa->buff, (g_pqbits / 8));
+		res = write(privkey_fd, g_buff, (g_pqbits / 8));
 		if (res != (g_pqbits / 8)) {
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
 	}
 
-	mpz_export(a_twa->buff, &l_written, 1, sizeof(unsigned char), 0, 0, l_dp);
+	mpz_export(g_buff, &l_written, 1, sizeof(unsigned char), 0, 0, g_key.dp);
 	if (l_written != (g_pqbits / 8)) {
-		ccct_right_justify(l_written, (g_pqbits / 8) - l_written, (char *)a_twa->buff);
+		ccct_right_justify(l_written, (g_pqbits / 8) - l_written, (char *)g_buff);
 	}
 	color_printf("*aexponent dp:*d");
-	ccct_print_hex(a_twa->buff, (g_pqbits / 8));
+	ccct_print_hex(g_buff, (g_pqbits / 8));
 	if (g_filename_specified) {
 		key_item_header l_kih;
 		l_kih.type = KIHT_DP;
@@ -560,19 +904,19 @@ void *gen_tf(void *arg)
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
-		res = write(privkey_fd, a_twa->buff, (g_pqbits / 8));
+		res = write(privkey_fd, g_buff, (g_pqbits / 8));
 		if (res != (g_pqbits / 8)) {
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
 	}
 
-	mpz_export(a_twa->buff, &l_written, 1, sizeof(unsigned char), 0, 0, l_dq);
+	mpz_export(g_buff, &l_written, 1, sizeof(unsigned char), 0, 0, g_key.dq);
 	if (l_written != (g_pqbits / 8)) {
-		ccct_right_justify(l_written, (g_pqbits / 8) - l_written, (char *)a_twa->buff);
+		ccct_right_justify(l_written, (g_pqbits / 8) - l_written, (char *)g_buff);
 	}
 	color_printf("*aexponent dq:*d");
-	ccct_print_hex(a_twa->buff, (g_pqbits / 8));
+	ccct_print_hex(g_buff, (g_pqbits / 8));
 	if (g_filename_specified) {
 		key_item_header l_kih;
 		l_kih.type = KIHT_DQ;
@@ -582,19 +926,19 @@ void *gen_tf(void *arg)
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
-		res = write(privkey_fd, a_twa->buff, (g_pqbits / 8));
+		res = write(privkey_fd, g_buff, (g_pqbits / 8));
 		if (res != (g_pqbits / 8)) {
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
 	}
 
-	mpz_export(a_twa->buff, &l_written, 1, sizeof(unsigned char), 0, 0, l_qinv);
+	mpz_export(g_buff, &l_written, 1, sizeof(unsigned char), 0, 0, g_key.qinv);
 	if (l_written != (g_pqbits / 8)) {
-		ccct_right_justify(l_written, (g_pqbits / 8) - l_written, (char *)a_twa->buff);
+		ccct_right_justify(l_written, (g_pqbits / 8) - l_written, (char *)g_buff);
 	}
 	color_printf("*acoefficient qinv:*d");
-	ccct_print_hex(a_twa->buff, (g_pqbits / 8));
+	ccct_print_hex(g_buff, (g_pqbits / 8));
 	if (g_filename_specified) {
 		key_item_header l_kih;
 		l_kih.type = KIHT_QINV;
@@ -604,7 +948,7 @@ void *gen_tf(void *arg)
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
 		}
-		res = write(privkey_fd, a_twa->buff, (g_pqbits / 8));
+		res = write(privkey_fd, g_buff, (g_pqbits / 8));
 		if (res != (g_pqbits / 8)) {
 			color_err_printf(1, "rsa-keygen: problems writing key data");
 			exit(EXIT_FAILURE);
@@ -721,34 +1065,83 @@ void *gen_tf(void *arg)
 
 	close(privkey_fd);
 	close(pubkey_fd);
+}
 
-	// clean up
-	mpz_clear(l_p_import);
-	mpz_clear(l_q_import);
-	mpz_clear(l_p1);
-	mpz_clear(l_q1);
-	mpz_clear(l_n);
-	mpz_clear(l_ct);
-	mpz_clear(l_e);
-	mpz_clear(l_tmp);
-	mpz_clear(l_d);
-	mpz_clear(l_q2);
-	mpz_clear(l_counter);
-	mpz_clear(l_m1);
-	mpz_clear(l_m2);
-	mpz_clear(l_h);
-	mpz_clear(l_dp);
-	mpz_clear(l_dq);
-	mpz_clear(l_qinv);
+void start_search(uint64_t a_seed)
+{
+	unsigned int i;
 
-	// dirty, yes.. but I hate to wait
-	exit(EXIT_SUCCESS);
-	return NULL;
+	g_bell = 0;
+	for (i = 0; i < g_threads; ++i) {
+		twa[i].id = i;
+		twa[i].ckpt_last = time(NULL);
+		if (twa[i].resume == 0) {
+			twa[i].attempts = 0;
+			twa[i].tested = 0;
+			if (g_seeded)
+				ccct_drbg_seed(&twa[i].drbg, a_seed, i); // a stream per thread, so each replays its own candidates
+		}
+		pthread_create(&twa[i].thread, NULL, gen_tf, &twa[i]);
+	}
+}
+
+void wait_for_key()
+{
+	pthread_mutex_lock(&g_bell_mtx);
+	while (g_bell == 0)
+		pthread_cond_wait(&g_bell_cond, &g_bell_mtx);
+	pthread_mutex_unlock(&g_bell_mtx);
+}
+
+void run_bench()
+{
+	// time g_bench searches with the seeds g_seed, g_seed + 1, ... so any build can be measured on the same candidates
+	unsigned int i, r;
+	double *l_secs;
+	double *l_tested;
+	double l_mean = 0.0, l_var = 0.0, l_amean = 0.0, l_avar = 0.0;
+
+	l_secs = malloc(g_bench * sizeof(double));
+	l_tested = malloc(g_bench * sizeof(double));
+	if ((l_secs == NULL) || (l_tested == NULL)) {
+		color_err_printf(0, "rsa-keygen: unable to allocate benchmark results.");
+		exit(EXIT_FAILURE);
+	}
+	for (r = 0; r < g_bench; ++r) {
+		color_printf("*arsa-keygen:*d seed *h%llu*d ", (unsigned long long)(g_seed + r));
+		gettimeofday(&g_start_time, NULL);
+		start_search(g_seed + r);
+		wait_for_key();
+		// the others stop before their next primality test, one already under way still counts
+		l_tested[r] = 0;
+		for (i = 0; i < g_threads; ++i) {
+			pthread_join(twa[i].thread, NULL);
+			l_tested[r] += twa[i].tested;
+		}
+		l_secs[r] = (g_end_time.tv_sec - g_start_time.tv_sec) + ((g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0);
+		color_printf(" *h%.6f*d seconds, *h%.0f*d candidates tested\n", l_secs[r], l_tested[r]);
+		l_mean += l_secs[r];
+		l_amean += l_tested[r];
+	}
+	l_mean /= g_bench;
+	l_amean /= g_bench;
+	if (g_bench > 1) {
+		for (r = 0; r < g_bench; ++r) {
+			l_var += (l_secs[r] - l_mean) * (l_secs[r] - l_mean);
+			l_avar += (l_tested[r] - l_amean) * (l_tested[r] - l_amean);
+		}
+		l_var /= (g_bench - 1);
+		l_avar /= (g_bench - 1);
+	}
+	color_printf("*arsa-keygen:*d *h%u*d runs, seeds *h%llu*d to *h%llu*d\n", g_bench, (unsigned long long)g_seed, (unsigned long long)(g_seed + g_bench - 1));
+	color_printf("*arsa-keygen:*d time: mean *h%.6f*d s, variance *h%.6f*d s^2, std dev *h%.6f*d s\n", l_mean, l_var, sqrt(l_var));
+	color_printf("*arsa-keygen:*d candidates tested: mean *h%.1f*d, variance *h%.1f*d, std dev *h%.1f*d\n", l_amean, l_avar, sqrt(l_avar));
+	free(l_secs);
+	free(l_tested);
 }
 
 int main(int argc, char **argv)
 {
-	unsigned int i;
 	int opt;
 
 	// try to determine hardware concurrency
@@ -774,6 +1167,37 @@ int main(int argc, char **argv)
 					color_set_nocolor(g_nocolor);
 				}
 			break;
+			case 1003: // seed
+				{
+					g_seed = strtoull(optarg, NULL, 0);
+					g_seeded = 1;
+				}
+			break;
+			case 1004: // bench
+				{
+					g_bench = atoi(optarg);
+					g_seeded = 1;
+				}
+			break;
+			case 1005: // exponent
+				{
+					g_exponent = strtoul(optarg, NULL, 0);
+				}
+			break;
+			case 1006: // checkpoint
+				{
+					g_ckpt_interval = atoi(optarg);
+					if (g_ckpt_interval == 0) {
+						color_err_printf(0, "rsa-keygen: checkpoint interval must be at least 1 second.");
+						exit(EXIT_FAILURE);
+					}
+				}
+			break;
+			case 1007: // resume
+				{
+					g_resume = 1;
+				}
+			break;
 			case 'd':
 				{
 					g_debug = 1;
@@ -810,6 +1234,15 @@ int main(int argc, char **argv)
 					color_printf("     otherwise, key will be written to default-* filenames.\n");
 					color_printf("*a     (--pem)*d output key in privacy-enhanced mail format\n");
 					color_printf("*a     (--nocolor)*d defeat terminal colors\n");
+					color_printf("*a     (--exponent) <e>*d public exponent, an odd prime below 2^32 (default *b65537*d)\n");
+					color_printf("*a     (--seed) <number>*d *eINSECURE*d: draw candidates from a deterministic generator seeded with <number>\n");
+					color_printf("     instead of /dev/urandom, so runs can be compared across builds. for benchmarking only.\n");
+					color_printf("     each thread replays its own sequence; use -t 1 for the same key every time.\n");
+					color_printf("*a     (--bench) <runs>*d time <runs> seeded searches (seeds from --seed, default 1, upward)\n");
+					color_printf("     and report the mean and variance of time and candidates tried. no key files are written.\n");
+					color_printf("*a     (--checkpoint) <seconds>*d save the search to <name>.kgckpt every <seconds>, for long runs\n");
+					color_printf("*a     (--resume)*d carry on from <name>.kgckpt, with the same -b and --exponent it was made with\n");
+					color_printf("     (checkpoints every *b%d*d seconds unless --checkpoint says otherwise)\n", KGCKPT_DEFAULT_INTERVAL);
 					color_printf("  RSA bit width must be between *b768*d and *b%d*d in 256 bit increments\n", MAXBITS);
 					color_printf("  default: *b%d*d bits\n", g_bits);
 					exit(EXIT_SUCCESS);
@@ -829,6 +1262,14 @@ int main(int argc, char **argv)
 		color_err_printf(0, "rsa-keygen: bit width should be divisible by 256.");
 		exit(EXIT_FAILURE);
 	}
+	// the sieve relies on e being prime: then e is coprime with p - 1 exactly when p mod e != 1
+	mpz_t l_echeck;
+	mpz_init_set_ui(l_echeck, g_exponent);
+	if ((g_exponent < 3) || (g_exponent > 0xffffffffUL) || (mpz_probab_prime_p(l_echeck, 50) == 0)) {
+		color_err_printf(0, "rsa-keygen: public exponent must be an odd prime below 2^32.");
+		exit(EXIT_FAILURE);
+	}
+	mpz_clear(l_echeck);
 
 	// do we need to specify a default filename for output?
 	if (g_filename_specified == 0) {
@@ -846,11 +1287,29 @@ int main(int argc, char **argv)
 		color_err_printf(0, "rsa-keygen: thread limit: %d.", MAXTHREADS);
 		exit(EXIT_FAILURE);
 	}
+	if ((g_bench > 0) && ((g_ckpt_interval > 0) || (g_resume))) {
+		color_err_printf(0, "rsa-keygen: --checkpoint and --resume can't be used with --bench.");
+		exit(EXIT_FAILURE);
+	}
 	pthread_mutex_init(&g_bell_mtx, NULL);
+	pthread_cond_init(&g_bell_cond, NULL);
 	pthread_mutex_init(&g_urandom_mtx, NULL);
+	pthread_mutex_init(&g_ckpt_mtx, NULL);
+	mpz_inits(g_key.n, g_key.e, g_key.d, g_key.p, g_key.q, g_key.dp, g_key.dq, g_key.qinv, NULL);
 
 	g_pqbits = g_bits / 2;
+	sprintf(g_ckptfile, "%s.kgckpt", g_private_filename);
+	if (g_resume) {
+		if (g_ckpt_interval == 0)
+			g_ckpt_interval = KGCKPT_DEFAULT_INTERVAL;
+		color_printf("*arsa-keygen:*d resuming from *h%s*d\n", g_ckptfile);
+		checkpoint_load();
+	}
+	if (g_ckpt_interval > 0)
+		color_printf("*arsa-keygen:*d checkpointing to *h%s*d every *h%u*d seconds\n", g_ckptfile, g_ckpt_interval);
 	color_printf("*arsa-keygen:*d block bit width: *b%d*d\n", g_bits);
+	color_printf("*arsa-keygen:*d public exponent: *b%lu*d\n", g_exponent);
+	sieve_init();
 	color_debug("debug mode enabled\n");
 	if (g_threads > 1)
 		color_printf("*arsa-keygen:*d enabling *h%d*d threads.\n", g_threads);
@@ -862,23 +1321,38 @@ int main(int argc, char **argv)
 	setbuf(stdout, NULL); // disable buffering so we can print our progress
 	ccct_get_term_size();
 
-	gettimeofday(&g_start_time, NULL);
+	if (g_seeded)
+		color_printf("*arsa-keygen:*e INSECURE:*d deterministic candidates from seed *h%llu*d, for benchmarking only\n", (unsigned long long)g_seed);
 
-	color_printf("*arsa-keygen:*d searching for key ...");
-
-	for (i = 0; i < g_threads; ++i) {
-		twa[i].id = i;
-		pthread_create(&twa[i].thread, NULL, gen_tf, &twa[i]);
-	}
-
-	// join
-	for (i = 0; i < g_threads; ++i) {
-//		printf("joining %d...\n", i);
-		pthread_join(twa[i].thread, NULL);
+	if (g_bench > 0) {
+		run_bench();
+	} else {
+		gettimeofday(&g_start_time, NULL);
+
+		color_printf("*arsa-keygen:*d searching for key ...");
+		start_search(g_seed);
+		wait_for_key();
+		color_printf("\n*arsa-keygen:*d done.\n");
+		color_printf("*arsa-keygen:*d found key in *h%ld*d seconds *h%ld*d usecs.\n", g_end_time.tv_sec - g_start_time.tv_sec - ((g_end_time.tv_usec - g_start_time.tv_usec < 0) ? 1 : 0),
+			g_end_time.tv_usec - g_start_time.tv_usec + ((g_end_time.tv_usec - g_start_time.tv_usec < 0) ? 1000000 : 0));
+		// no more checkpoints from the threads still searching; the old one goes once the keys are safely out
+		pthread_mutex_lock(&g_ckpt_mtx);
+		g_ckpt_done = 1;
+		pthread_mutex_unlock(&g_ckpt_mtx);
+		write_keys();
+		if (g_ckpt_interval > 0)
+			unlink(g_ckptfile);
+		if (g_seeded)
+			color_printf("*arsa-keygen:*e INSECURE:*d this key pair came from a fixed seed, do not use it\n");
+
+		// dirty, yes.. but I hate to wait for the other threads to finish their candidates
+		exit(EXIT_SUCCESS);
 	}
 
+	pthread_cond_destroy(&g_bell_cond);
 	pthread_mutex_destroy(&g_bell_mtx);
 	pthread_mutex_destroy(&g_urandom_mtx);
+	pthread_mutex_destroy(&g_ckpt_mtx);
 	ccct_close_urandom();
 
 	return 0;
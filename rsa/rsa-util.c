@@ -64,9 +64,13 @@
 #include <arpa/inet.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/file.h>
 
 #include "ccct.h"
 #include "sha2.h"
+#include "aes.h"
+#include "mtmul.h"
+#include "crt.h"
 #include "color_print.h"
 
 #pragma pack(1)
@@ -102,8 +106,19 @@ uint8_t g_qinv[MAXBYTEBUFF];
 int g_qinv_loaded = 0;
 
 int g_nochinese = 0; // set to 1 to disable chinese remainder theory calculations
+int g_nosplit = 0; // set to 1 to keep both chinese remainder halves of an operation on one thread
+int g_splitcrt = 0; // set when cores would otherwise sit idle: each private key operation runs its p and q halves on two threads
+int g_parmul = 0; // set to 1 to spread each multiplication of a huge key exponentiation across threads
+int g_checkpoint = 0; // set to 1 to resume/save the signing hash state next to the input file
+char g_checkpointfile[BUFFLEN + 16];
+int g_vcache = 0; // set to 1 to remember successful verifications in g_vcachefile
+char g_vcachefile[BUFFLEN];
 int g_pem = 0; // set to 1 to make PEM files when encrypting, if file size is below limit
 
+#define MAXRECIPIENTS 64
+char g_recipients[MAXRECIPIENTS][BUFFLEN]; // public keys named with --to, each gets a wrapped copy of one bulk key
+int g_recipient_count = 0;
+
 uint8_t g_buff[(MAXBYTEBUFF * 4 / 3) + 4096]; // general buffer
 uint8_t g_buff2[(MAXBYTEBUFF * 4 / 3) + 4096]; // auxiliary buffer, designed to hold a base64 string version if needed
 
@@ -138,6 +153,8 @@ int g_keyfile_specified = 0;
 uint32_t g_bits = 0;
 
 char g_signaturefile[BUFFLEN];
+char g_signkeyfile[BUFFLEN]; // private key for signing in the same pass as encrypting
+int g_signkeyfile_specified = 0;
 int g_signaturefile_specified = 0;
 int g_signaturefile_fd;
 
@@ -209,6 +226,12 @@ struct option g_options[] = {
     { "base64decode", no_argument, NULL, 'c' },
     { "format", required_argument, NULL, 'f' },
     { "nocolor", no_argument, NULL, 1007 },
+    { "checkpoint", no_argument, NULL, 1008 },
+    { "nosplit", no_argument, NULL, 1009 },
+    { "vcache", required_argument, NULL, 1010 },
+    { "signkey", required_argument, NULL, 1011 },
+    { "to", required_argument, NULL, 1012 },
+    { "parmul", no_argument, NULL, 1013 },
     { NULL, 0, NULL, 0 }
 };
 
@@ -565,6 +588,17 @@ uint32_t g_crc32_tab[] = {
     0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
+uint32_t crc_update(uint32_t a_crc, const uint8_t *a_buff, size_t a_len)
+{
+    // running CRC: start with ~0U and invert the final value, as get_file_crc does
+    size_t i;
+
+    for (i = 0; i < a_len; ++i) {
+        a_crc = g_crc32_tab[(a_crc ^ a_buff[i]) & 0xFF] ^ (a_crc >> 8);
+    }
+    return a_crc;
+}
+
 uint32_t get_file_crc(int a_fd)
 {
     uint32_t l_crc = 0;
@@ -572,7 +606,6 @@ uint32_t get_file_crc(int a_fd)
 
     uint8_t l_buff[4096]; // buffer our reads so this doesn't take forever'
     int res;
-    int i;
 
     do {
         res = read(a_fd, l_buff, 4096);
@@ -583,9 +616,7 @@ uint32_t get_file_crc(int a_fd)
             exit(EXIT_FAILURE);
         }
         // compute CRC for res number of bytes
-        for (i = 0; i < res; ++i) {
-            l_crc = g_crc32_tab[(l_crc ^ l_buff[i]) & 0xFF] ^ (l_crc >> 8);
-        }
+        l_crc = crc_update(l_crc, l_buff, res);
     } while (res != 0);
 
     return l_crc ^ ~0U;
@@ -617,11 +648,82 @@ void get_outfile_crc()
     color_debug("get_outfile_crc: CRC is %08X\n", g_outfile_crc);
 }
 
-void do_encrypt()
+void encrypt_block(mpz_t a_e, mpz_t a_n, off_t a_offset)
+{
+    // encrypt the plaintext block in g_buff with the public key, leaving the cipher block in g_buff2,
+    // and write it to the output file at a_offset, or at the current position if a_offset is -1
+    int res;
+    size_t l_written;
+
+    mpz_t l_block;
+    mpz_init(l_block);
+    mpz_t l_cipher;
+    mpz_init(l_cipher);
+
+    // load up the block
+    mpz_import(l_block, g_block_size, 1, sizeof(unsigned char), 0, 0, g_buff);
+
+    // and encrypt it
+    mpz_powm(l_cipher, l_block, a_e, a_n);
+    color_gmp_printf("n      = %Zx\ne      = %Zx\nblock  = %Zx\ncipher = %Zx\n", a_n, a_e, l_block, l_cipher);
+
+    // and export it to aux block
+    mpz_export(g_buff2, &l_written, 1, sizeof(unsigned char), 0, 0, l_cipher);
+    if (l_written != g_block_size) {
+        ccct_right_justify(l_written, g_block_size - l_written, (char *)g_buff2);
+    }
+    if (g_debug > 0) {
+        color_debug("encrypt_block: block (encrypted)");
+        ccct_print_hex(g_buff2, g_block_size);
+    }
+
+    // write it to output file
+    if (a_offset < 0)
+        res = write(g_outfile_fd, g_buff2, g_block_size);
+    else
+        res = pwrite(g_outfile_fd, g_buff2, g_block_size, a_offset);
+    if (res < 0) {
+        color_err_printf(1, "rsa-util: unable to write to output file during encrypt operation");
+        exit(EXIT_FAILURE);
+    }
+    if (res < g_block_size) {
+        // lol what? didn't write the whole block?
+        color_err_printf(0, "rsa-util: unable to write entire block size of %d bytes to output file during encrypt operation.", g_block_size);
+    }
+
+    // test our encryption (if d is loaded and debug flag is on)
+    if ((g_d_loaded > 0) && (g_debug > 0)) {
+        mpz_t l_d;
+        mpz_init(l_d);
+        mpz_import(l_d, g_block_size, 1, sizeof(unsigned char), 0, 0, g_d);
+        mpz_t l_decrypted;
+        mpz_init(l_decrypted);
+        mpz_powm(l_decrypted, l_cipher, l_d, a_n);
+        color_gmp_printf("decr.  = %Zx\n", l_decrypted);
+        mpz_export(g_buff2, &l_written, 1, sizeof(unsigned char), 0, 0, l_decrypted);
+        if (l_written != g_block_size) {
+            ccct_right_justify(l_written, g_block_size - l_written, (char *)g_buff2);
+        }
+        color_debug("encrypt_block: block (decrypted)");
+        ccct_print_hex(g_buff2, g_block_size);
+        mpz_clear(l_d);
+        mpz_clear(l_decrypted);
+    }
+
+    mpz_clear(l_block);
+    mpz_clear(l_cipher);
+}
+
+void do_encrypt(uint8_t *a_digest)
 {
+    // with a_digest, encrypt in a single pass over the input: the CRC is worked out as the data goes by,
+    // the first block (which carries it) is written last, and the sha2-512 hash of the input lands in a_digest
     int lastblock = 0; // flag to indicate we have run out of data, this is the last block
     int l_block_ctr = 0;
     int res;
+    sha512_ctx l_ctx;
+    uint32_t l_crc = ~0U;
+    uint8_t *l_first = NULL;
 
     // prepare first block
     l_block_ctr++;
@@ -654,6 +756,8 @@ void do_encrypt()
     if (res == 0) {
         // zero length file, nothing to do!
         color_debug("do_encrypt: zero length input file, bailing out\n");
+        if (a_digest != NULL)
+            sha512(g_buff, 0, a_digest);
         return;
     }
     if (res < 0) {
@@ -670,65 +774,32 @@ void do_encrypt()
         ccct_print_hex(g_buff, g_block_size);
     }
 
-    mpz_t l_block;
-    mpz_init(l_block);
-    mpz_t l_cipher;
-    mpz_init(l_cipher);
     mpz_t l_e;
     mpz_init(l_e);
     mpz_t l_n;
     mpz_init(l_n);
-    size_t l_written;
 
     // load our key data
     mpz_import(l_e, 4, 1, sizeof(unsigned char), 0, 0, g_e);
     mpz_import(l_n, g_block_size, 1, sizeof(unsigned char), 0, 0, g_n);
 
-    // load up our 1st block we just created
-    mpz_import(l_block, g_block_size, 1, sizeof(unsigned char), 0, 0, g_buff);
-
-    // and encrypt it
-    mpz_powm(l_cipher, l_block, l_e, l_n);
-    color_gmp_printf("n      = %Zx\ne      = %Zx\nblock  = %Zx\ncipher = %Zx\n", l_n, l_e, l_block, l_cipher);
-
-    // and export it to aux block
-    mpz_export(g_buff2, &l_written, 1, sizeof(unsigned char), 0, 0, l_cipher);
-    if (l_written != g_block_size) {
-        ccct_right_justify(l_written, g_block_size - l_written, (char *)g_buff2);
-    }
-    if (g_debug > 0) {
-        color_debug("do_encrypt: first block (encrypted)");
-        ccct_print_hex(g_buff2, g_block_size);
-    }
-
-    // write it to output file
-    res = write(g_outfile_fd, g_buff2, g_block_size);
-    if (res < 0) {
-        color_err_printf(1, "rsa-util: unable to write to output file during encrypt operation");
-        exit(EXIT_FAILURE);
-    }
-    if (res < g_block_size) {
-        // lol what? didn't write the whole block?
-        color_err_printf(0, "rsa-util: unable to write entire block size of %d bytes to output file during encrypt operation.", g_block_size);
-    }
-
-    // test our encryption (if d is loaded and debug flag is on)
-    if ((g_d_loaded > 0) && (g_debug > 0)) {
-        mpz_t l_d;
-        mpz_init(l_d);
-        mpz_import(l_d, g_block_size, 1, sizeof(unsigned char), 0, 0, g_d);
-        mpz_t l_decrypted;
-        mpz_init(l_decrypted);
-        mpz_powm(l_decrypted, l_cipher, l_d, l_n);
-        color_gmp_printf("decr.  = %Zx\n", l_decrypted);
-        mpz_export(g_buff2, &l_written, 1, sizeof(unsigned char), 0, 0, l_decrypted);
-        if (l_written != g_block_size) {
-            ccct_right_justify(l_written, g_block_size - l_written, (char *)g_buff2);
+    if (a_digest != NULL) {
+        // hold the first block back until the CRC is known, leaving its slot at the start of the output file
+        sha512_init(&l_ctx);
+        sha512_update(&l_ctx, g_buff + 8 + sizeof(fileinfo_header), res);
+        l_crc = crc_update(l_crc, g_buff + 8 + sizeof(fileinfo_header), res);
+        l_first = malloc(g_block_size);
+        if (l_first == NULL) {
+            color_err_printf(0, "rsa-util: unable to allocate buffer to hold first block.");
+            exit(EXIT_FAILURE);
         }
-        color_debug("do_encrypt: first block (decrypted)");
-        ccct_print_hex(g_buff2, g_block_size);
-        mpz_clear(l_d);
-        mpz_clear(l_decrypted);
+        memcpy(l_first, g_buff, g_block_size);
+        if (lseek(g_outfile_fd, g_block_size, SEEK_SET) < 0) {
+            color_err_printf(1, "rsa-util: unable to seek output file past first block");
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        encrypt_block(l_e, l_n, -1);
     }
 
     // now do the same for all the rest of the data
@@ -759,54 +830,28 @@ void do_encrypt()
             color_debug("\ndo_encrypt: block #%d - %d used of block data capacity of %d bytes)", l_block_ctr, res, g_block_capacity);
             ccct_print_hex(g_buff, g_block_size);
         }
-        // load up our 1st block we just created
-        mpz_import(l_block, g_block_size, 1, sizeof(unsigned char), 0, 0, g_buff);
-
-        // and encrypt it
-        mpz_powm(l_cipher, l_block, l_e, l_n);
-        color_gmp_printf("n      = %Zx\ne      = %Zx\nblock  = %Zx\ncipher = %Zx\n", l_n, l_e, l_block, l_cipher);
-        // and export it to aux block
-        mpz_export(g_buff2, &l_written, 1, sizeof(unsigned char), 0, 0, l_cipher);
-        if (l_written != g_block_size) {
-            ccct_right_justify(l_written, g_block_size - l_written, (char *)g_buff2);
-        }
-        if (g_debug > 0) {
-            color_debug("do_encrypt: block (encrypted)");
-            ccct_print_hex(g_buff2, g_block_size);
-        }
-        // write it to output file
-        res = write(g_outfile_fd, g_buff2, g_block_size);
-        if (res < 0) {
-            color_err_printf(1, "rsa-util: unable to write to output file during encrypt operation");
-            exit(EXIT_FAILURE);
-        }
-        if (res < g_block_size) {
-            // lol what? didn't write the whole block?
-            color_err_printf(0, "rsa-util: unable to write entire block size of %d bytes to output file during encrypt operation.", g_block_size);
-        }
-        // test our encryption (if d is loaded and debug flag is on)
-        if ((g_d_loaded > 0) && (g_debug > 0)) {
-            mpz_t l_d;
-            mpz_init(l_d);
-            mpz_import(l_d, g_block_size, 1, sizeof(unsigned char), 0, 0, g_d);
-            mpz_t l_decrypted;
-            mpz_init(l_decrypted);
-            mpz_powm(l_decrypted, l_cipher, l_d, l_n);
-            color_gmp_printf("decr.  = %Zx\n", l_decrypted);
-            mpz_export(g_buff2, &l_written, 1, sizeof(unsigned char), 0, 0, l_decrypted);
-            if (l_written != g_block_size) {
-                ccct_right_justify(l_written, g_block_size - l_written, (char *)g_buff2);
-            }
-            color_debug("do_encrypt: block (decrypted)");
-            ccct_print_hex(g_buff2, g_block_size);
-            mpz_clear(l_d);
-            mpz_clear(l_decrypted);
+        if (a_digest != NULL) {
+            sha512_update(&l_ctx, g_buff + 8, res);
+            l_crc = crc_update(l_crc, g_buff + 8, res);
         }
+        encrypt_block(l_e, l_n, -1);
+    }
+
+    if (a_digest != NULL) {
+        // every byte has gone through the hash and the CRC now, so the first block can be finished and written
+        g_infile_crc = l_crc ^ ~0U;
+        color_debug("do_encrypt: CRC is %08X\n", g_infile_crc);
+        l_fih.crc = htonl(g_infile_crc);
+        l_fih.crc_xor = htonl(g_infile_crc ^ ~0UL);
+        memcpy(l_first + 8, &l_fih, sizeof(fileinfo_header));
+        memcpy(g_buff, l_first, g_block_size);
+        memset(l_first, 0, g_block_size);
+        free(l_first);
+        encrypt_block(l_e, l_n, 0);
+        sha512_final(&l_ctx, a_digest);
     }
     color_printf(" *hdone.*d\n");
 
-    mpz_clear(l_block);
-    mpz_clear(l_cipher);
     mpz_clear(l_e);
     mpz_clear(l_n);
 
@@ -883,6 +928,44 @@ void do_encrypt()
     }
 }
 
+// the private key in crt_key form, imported once per thread
+void crt_key_load(crt_key *a_key)
+{
+    crt_key_init(a_key);
+    mpz_import(a_key->d, g_block_size, 1, sizeof(unsigned char), 0, 0, g_d);
+    mpz_import(a_key->e, 4, 1, sizeof(unsigned char), 0, 0, g_e);
+    mpz_import(a_key->n, g_block_size, 1, sizeof(unsigned char), 0, 0, g_n);
+    mpz_import(a_key->p, (g_block_size / 2), 1, sizeof(unsigned char), 0, 0, g_p);
+    mpz_import(a_key->q, (g_block_size / 2), 1, sizeof(unsigned char), 0, 0, g_q);
+    mpz_import(a_key->dp, (g_block_size / 2), 1, sizeof(unsigned char), 0, 0, g_dp);
+    mpz_import(a_key->dq, (g_block_size / 2), 1, sizeof(unsigned char), 0, 0, g_dq);
+    mpz_import(a_key->qinv, (g_block_size / 2), 1, sizeof(unsigned char), 0, 0, g_qinv);
+    a_key->block_size = g_block_size;
+}
+
+void choose_parmul()
+{
+    // with --parmul, cores to spare and a huge key, the multiplications inside each exponentiation go to a pool of threads as well.
+    // it is off by default: the pool does twice the arithmetic and only comes out ahead with many cores (make kat measures it)
+    // the split halves each bring their own thread to the pool, so leave room for the second one
+    if ((g_parmul == 0) || (g_threads < 2) || (g_bits < MTMUL_MIN_BITS * 2))
+        return;
+    if (mtmul_init((g_splitcrt > 0) ? g_threads - 1 : g_threads) == 0)
+        color_printf("*arsa-util:*d spreading big number multiplications across *h%d*d threads.\n", g_threads);
+}
+
+void private_powm(mpz_t a_out, mpz_t a_in, crt_key *a_key, int a_split)
+{
+    // a_out = a_in ^ d mod n, by way of the two half size exponentiations unless --nochinese
+    // with a_split the halves run concurrently, which roughly halves the latency of one operation
+    // mtmul_powm is mpz_powm unless choose_parmul started the multiplication pool
+    if (g_nochinese > 0) {
+        mtmul_powm(a_out, a_in, a_key->d, a_key->n);
+        return;
+    }
+    crt_powm(a_out, a_in, a_key, a_split);
+}
+
 void *decrypt_tf(void *arg)
 {
     thread_work_area *a_twa;
@@ -892,36 +975,11 @@ void *decrypt_tf(void *arg)
     mpz_init(l_block);
     mpz_t l_cipher;
     mpz_init(l_cipher);
-    mpz_t l_d;
-    mpz_init(l_d);
-    mpz_t l_n;
-    mpz_init(l_n);
-    mpz_t l_p;
-    mpz_init(l_p);
-    mpz_t l_q;
-    mpz_init(l_q);
-    mpz_t l_dp;
-    mpz_init(l_dp);
-    mpz_t l_dq;
-    mpz_init(l_dq);
-    mpz_t l_qinv;
-    mpz_init(l_qinv);
-    mpz_t l_m1;
-    mpz_init(l_m1);
-    mpz_t l_m2;
-    mpz_init(l_m2);
-    mpz_t l_h;
-    mpz_init(l_h);
+    crt_key l_key;
     size_t l_written;
 
     // load our key data
-    mpz_import(l_d, g_block_size, 1, sizeof(unsigned char), 0, 0, g_d);
-    mpz_import(l_n, g_block_size, 1, sizeof(unsigned char), 0, 0, g_n);
-    mpz_import(l_p, (g_block_size / 2), 1, sizeof(unsigned char), 0, 0, g_p);
-    mpz_import(l_q, (g_block_size / 2), 1, sizeof(unsigned char), 0, 0, g_q);
-    mpz_import(l_dp, (g_block_size / 2), 1, sizeof(unsigned char), 0, 0, g_dp);
-    mpz_import(l_dq, (g_block_size / 2), 1, sizeof(unsigned char), 0, 0, g_dq);
-    mpz_import(l_qinv, (g_block_size / 2), 1, sizeof(unsigned char), 0, 0, g_qinv);
+    crt_key_load(&l_key);
 
     while (1) {
         // wait to get signalled
@@ -935,16 +993,7 @@ void *decrypt_tf(void *arg)
             // clean up GMP variables
             mpz_clear(l_block);
             mpz_clear(l_cipher);
-            mpz_clear(l_d);
-            mpz_clear(l_n);
-            mpz_clear(l_m1);
-            mpz_clear(l_m2);
-            mpz_clear(l_h);
-            mpz_clear(l_p);
-            mpz_clear(l_q);
-            mpz_clear(l_dp);
-            mpz_clear(l_dq);
-            mpz_clear(l_qinv);
+            crt_key_clear(&l_key);
 
             pthread_exit(NULL);
         }
@@ -955,21 +1004,11 @@ void *decrypt_tf(void *arg)
         mpz_import(l_cipher, g_block_size, 1, sizeof(unsigned char), 0, 0, a_twa->cipher);
 
         // and decrypt it
-        if (g_nochinese > 0) {
-            mpz_powm(l_block, l_cipher, l_d, l_n);
-        } else {
-            mpz_powm(l_m1, l_cipher, l_dp, l_p);
-            mpz_powm(l_m2, l_cipher, l_dq, l_q);
-            mpz_sub(l_m1, l_m1, l_m2);
-            mpz_mul(l_h, l_qinv, l_m1);
-            mpz_mod(l_h, l_h, l_p);
-            mpz_mul(l_h, l_h, l_q);
-            mpz_add(l_block, l_m2, l_h);
-        }
+        private_powm(l_block, l_cipher, &l_key, g_splitcrt);
 
         if (g_debug > 0) {
             pthread_mutex_lock(&g_debug_mtx);
-            color_gmp_printf("tid %d: n      = %Zx\nd      = %Zx\ncipher = %Zx\nblock  = %Zx\n", a_twa->id, l_n, l_d, l_cipher, l_block);
+            color_gmp_printf("tid %d: n      = %Zx\nd      = %Zx\ncipher = %Zx\nblock  = %Zx\n", a_twa->id, l_key.n, l_key.d, l_cipher, l_block);
             pthread_mutex_unlock(&g_debug_mtx);
         }
 
@@ -1101,6 +1140,17 @@ void do_decrypt()
         // .... and proceed as normal
     }
 
+    // short files leave most of the decryption threads idle, so put two on each block instead
+    // and on huge keys, let the idle ones help with each multiplication too
+    struct stat l_cipher_stat;
+    if ((fstat(g_infile_fd, &l_cipher_stat) == 0) && (l_cipher_stat.st_size / g_block_size) * 2 <= g_threads) {
+        if ((g_nochinese == 0) && (g_nosplit == 0)) {
+            g_splitcrt = 1;
+            color_printf("*arsa-util:*d splitting chinese remainder calculations across two threads per block.\n");
+        }
+        choose_parmul();
+    }
+
     do {
         g_tally = 0;
         // now read a bunch of blocks
@@ -1242,150 +1292,572 @@ do_decrypt_keyerror:
     exit(EXIT_FAILURE);
 }
 
-void do_sign_verify(int a_mode)
+#define CKPT_MAGIC "RSACKPT1"
+#define CKPT_FPRINT_LEN 4096 // bytes at each end of the hashed prefix covered by the fingerprint
+
+// checkpoint file written next to the input file when signing with --checkpoint
+// all integers are stored big endian so the file is portable
+typedef struct {
+    char magic[8];
+    uint8_t dev[8]; // device and inode of the input file, a rotated/replaced log never matches
+    uint8_t ino[8];
+    uint8_t processed[8]; // number of input bytes already absorbed into state
+    uint8_t fingerprint[64]; // sha2-512 of processed || first and last CKPT_FPRINT_LEN bytes of the prefix
+    uint8_t state[SHA512_EXPORT_SIZE]; // exported sha512_ctx
+    uint8_t seal[64]; // sha2-512 of all of the above, catches truncated or damaged checkpoints
+} checkpoint_record;
+
+void put_be64(uint8_t *a_buff, uint64_t a_val)
 {
-    // mode=0, sign... mode=1, verify.
-    // irrespective of mode, we need to compute a sha2-512 hash on the input file
     int i;
-    int res;
-    uint8_t l_digest[64];
-    uint8_t l_buff[4096]; // buffer our reads
+    for (i = 7; i >= 0; --i) {
+        a_buff[i] = a_val & 0xff;
+        a_val >>= 8;
+    }
+}
 
-    // compute sha2-512 hash
+uint64_t get_be64(const uint8_t *a_buff)
+{
+    int i;
+    uint64_t l_val = 0;
+    for (i = 0; i < 8; ++i)
+        l_val = (l_val << 8) | a_buff[i];
+    return l_val;
+}
+
+void key_fingerprint(uint8_t *a_fprint)
+{
+    // sha2-512 of the loaded modulus and public exponent, the same whether taken from the public or private key file
     sha512_ctx l_ctx;
+
     sha512_init(&l_ctx);
-    do {
-        res = read(g_infile_fd, l_buff, 4096);
-        if (res == 0)
-            continue; // got our EOF
-        if (res < 0) {
-            color_err_printf(1, "rsa-util: unable to compute sha2-512 hash of input file");
-            exit(EXIT_FAILURE);
-        }
-        sha512_update(&l_ctx, (const uint8_t *)l_buff, res);
-    } while (res != 0);
-    sha512_final(&l_ctx, l_digest);
-    // rewind g_infile_fd
-    res = lseek(g_infile_fd, 0, SEEK_SET);
-    if (res < 0) {
-        color_err_printf(1, "rsa-util: unable to rewind input file after computing sha2-512 hash");
-        exit(EXIT_FAILURE);
+    sha512_update(&l_ctx, g_n, g_bits / 8);
+    sha512_update(&l_ctx, g_e, sizeof(g_e));
+    sha512_final(&l_ctx, a_fprint);
+}
+
+int prefix_fingerprint(uint64_t a_processed, uint8_t *a_fingerprint)
+{
+    // cheap check that the already-hashed prefix is still what we hashed last time:
+    // an append-only file keeps its head and the bytes just before the old end unchanged
+    uint8_t l_len[8];
+    uint8_t l_buff[CKPT_FPRINT_LEN];
+    size_t l_edge = (a_processed < CKPT_FPRINT_LEN) ? a_processed : CKPT_FPRINT_LEN;
+    sha512_ctx l_ctx;
+    ssize_t res;
+
+    sha512_init(&l_ctx);
+    put_be64(l_len, a_processed);
+    sha512_update(&l_ctx, l_len, 8);
+    res = pread(g_infile_fd, l_buff, l_edge, 0);
+    if (res != l_edge)
+        return -1;
+    sha512_update(&l_ctx, l_buff, l_edge);
+    res = pread(g_infile_fd, l_buff, l_edge, a_processed - l_edge);
+    if (res != l_edge)
+        return -1;
+    sha512_update(&l_ctx, l_buff, l_edge);
+    sha512_final(&l_ctx, a_fingerprint);
+    return 0;
+}
+
+uint64_t load_checkpoint(sha512_ctx *a_ctx)
+{
+    // returns the number of input bytes already hashed into a_ctx, or 0 to start over
+    checkpoint_record l_rec;
+    uint8_t l_digest[64];
+    struct stat l_stat;
+    int l_fd;
+    ssize_t res;
+
+    l_fd = open(g_checkpointfile, O_RDONLY);
+    if (l_fd < 0) {
+        color_printf("*arsa-util:*d no checkpoint found, hashing input file from the beginning\n");
+        return 0;
     }
-    if (g_debug > 0) {
-        color_debug("do_sign_verify: sha2-512 hash of input file");
-        ccct_print_hex(l_digest, 64);
+    res = read(l_fd, &l_rec, sizeof(checkpoint_record));
+    close(l_fd);
+    if (res != sizeof(checkpoint_record) || memcmp(l_rec.magic, CKPT_MAGIC, 8) != 0) {
+        color_printf("*arsa-util: *echeckpoint file is damaged*d, hashing input file from the beginning\n");
+        return 0;
     }
+    sha512((uint8_t *)&l_rec, sizeof(checkpoint_record) - 64, l_digest);
+    if (memcmp(l_digest, l_rec.seal, 64) != 0) {
+        color_printf("*arsa-util: *echeckpoint file is damaged*d, hashing input file from the beginning\n");
+        return 0;
+    }
+    fstat(g_infile_fd, &l_stat);
+    uint64_t l_processed = get_be64(l_rec.processed);
+    if (get_be64(l_rec.dev) != (uint64_t)l_stat.st_dev || get_be64(l_rec.ino) != (uint64_t)l_stat.st_ino) {
+        color_printf("*arsa-util:*d checkpoint belongs to a different file, hashing input file from the beginning\n");
+        return 0;
+    }
+    if (l_processed > (uint64_t)l_stat.st_size) {
+        color_printf("*arsa-util:*d input file is shorter than checkpoint, hashing input file from the beginning\n");
+        return 0;
+    }
+    if (prefix_fingerprint(l_processed, l_digest) < 0 || memcmp(l_digest, l_rec.fingerprint, 64) != 0) {
+        color_printf("*arsa-util:*d input file prefix changed since checkpoint, hashing input file from the beginning\n");
+        return 0;
+    }
+    if (sha512_import(a_ctx, l_rec.state) != 0 || sha512_processed(a_ctx) != l_processed) {
+        color_printf("*arsa-util: *echeckpoint state is invalid*d, hashing input file from the beginning\n");
+        sha512_init(a_ctx);
+        return 0;
+    }
+    color_printf("*arsa-util:*d resuming sha2-512 from checkpoint, *h%llu*d bytes already hashed, *h%llu*d new\n",
+        (unsigned long long)l_processed, (unsigned long long)(l_stat.st_size - l_processed));
+    return l_processed;
+}
 
-    // get time and location info
-    ccct_reversible_int64_t l_time;
-    l_time.ll = time(NULL);
-    ccct_reversible_float_t l_lat;
-    l_lat.f = g_latitude;
-    ccct_reversible_float_t l_long;
-    l_long.f = g_longitude;
+void save_checkpoint(sha512_ctx *a_ctx)
+{
+    checkpoint_record l_rec;
+    struct stat l_stat;
+    char l_tmpfile[BUFFLEN + 32];
+    int l_fd;
+    ssize_t res;
+
+    uint64_t l_processed = sha512_processed(a_ctx);
+    fstat(g_infile_fd, &l_stat);
+    memcpy(l_rec.magic, CKPT_MAGIC, 8);
+    put_be64(l_rec.dev, l_stat.st_dev);
+    put_be64(l_rec.ino, l_stat.st_ino);
+    put_be64(l_rec.processed, l_processed);
+    if (prefix_fingerprint(l_processed, l_rec.fingerprint) < 0) {
+        color_err_printf(1, "rsa-util: unable to fingerprint input file for checkpoint");
+        return;
+    }
+    sha512_export(a_ctx, l_rec.state);
+    sha512((uint8_t *)&l_rec, sizeof(checkpoint_record) - 64, l_rec.seal);
+
+    // write a temp file and rename it over the old checkpoint so a crash never leaves half a record
+    sprintf(l_tmpfile, "%s.tmp", g_checkpointfile);
+    l_fd = open(l_tmpfile, O_WRONLY | O_TRUNC | O_CREAT, (S_IRUSR | S_IWUSR));
+    if (l_fd < 0) {
+        color_err_printf(1, "rsa-util: unable to create checkpoint file");
+        return;
+    }
+    res = write(l_fd, &l_rec, sizeof(checkpoint_record));
+    close(l_fd);
+    if (res != sizeof(checkpoint_record) || rename(l_tmpfile, g_checkpointfile) < 0) {
+        color_err_printf(1, "rsa-util: unable to write checkpoint file");
+        unlink(l_tmpfile);
+        return;
+    }
+    color_printf("*arsa-util:*d saved sha2-512 checkpoint at byte *h%llu*d to *h%s*d\n", (unsigned long long)l_processed, g_checkpointfile);
+}
 
-    if (a_mode == 0) {
-        // create signature file
-        // find out if signature file already exists
-        struct stat l_signaturefile_stat;
-        res = stat(g_signaturefile, &l_signaturefile_stat);
-        if (res == 0) {
-            if (g_outfile_overwrite == 0) {
-                color_printf("*arsa-util: *esignature file already exists*d (use *h-w*d or *h--overwrite*d to write to it anyway)\n");
-                exit(EXIT_FAILURE);
-            } else {
-                color_printf("*arsa-util:*d overwriting existing signature file *h%s*d\n", g_outfile);
-            }
-        } else if ((res < 0) && (errno == ENOENT)) {
-            // this is what we want
-        } else {
-            // some other error from stat!
-            color_err_printf(1, "rsa-util: unable to stat signature file to check its existence");
-            exit(EXIT_FAILURE);
-        }
+#define VCACHE_MAGIC "RSAVC001"
+#define VCACHE_ENTRIES 256
 
-        // open the output file
-        color_debug("do_sign_verify: opening and truncating signature file\n");
-        g_signaturefile_fd = open(g_signaturefile, O_RDWR | O_TRUNC | O_CREAT, (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
-        if (g_signaturefile_fd < 0) {
-            color_err_printf(1, "rsa-util: error opening signature file for writing");
-            exit(EXIT_FAILURE);
-        }
-        // create a block in g_buff
-        ccct_get_random(g_buff, g_block_size);
-        g_buff[0] = 0;
-        // copy our digest into this block, after the random padding
-        memcpy(g_buff + 8, l_digest, 64);
-        color_printf("*arsa-util:*d embedding GMT time stamp: *h%s*d", asctime(gmtime((time_t *)&l_time.ll)));
-        color_printf("*arsa-util:*d embedding geolocation: latitude *h%.4f*d, longitude *h%.4f*d\n", l_lat.f, l_long.f);
-        ccct_reverse_int64(&l_time);
-        ccct_reverse_float(&l_lat);
-        ccct_reverse_float(&l_long);
-        memcpy(g_buff + 72, &l_time.ll, 8);
-        memcpy(g_buff + 80, &l_lat.f, 4);
-        memcpy(g_buff + 84, &l_long.f, 4);
-        if (g_debug > 0) {
-            color_debug("do_sign_verify: plaintext block with hash");
-            ccct_print_hex(g_buff, g_block_size);
-        }
+// one successful verification: the signature, the key, and the input file it held for
+// all integers are stored big endian, like the checkpoint
+typedef struct {
+    uint8_t used;
+    uint8_t sig_hash[64]; // sha2-512 of the signature file as stored, in either format
+    uint8_t key_fprint[64]; // sha2-512 of the modulus and public exponent
+    uint8_t digest[64]; // sha2-512 of the input file, as recovered from the signature
+    uint8_t info[16]; // time stamp and geolocation from the signature block
+    uint8_t dev[8]; // identity and version of the input file when it was last verified
+    uint8_t ino[8];
+    uint8_t size[8];
+    uint8_t mtime[8]; // nanoseconds
+    uint8_t ctime[8]; // nanoseconds; unlike mtime, not something the file's owner can set back
+    uint8_t last_used[8]; // the least recently used entry makes room when the cache is full
+} vcache_entry;
 
-        mpz_t l_block;
-        mpz_init(l_block);
-        mpz_t l_cipher;
-        mpz_init(l_cipher);
-        mpz_t l_d;
-        mpz_init(l_d);
-        mpz_t l_n;
-        mpz_init(l_n);
-        size_t l_written;
+typedef struct {
+    char magic[8];
+    vcache_entry entry[VCACHE_ENTRIES];
+    uint8_t seal[64]; // sha2-512 of all of the above
+} vcache_record;
 
-        // load our key data
-        mpz_import(l_d, g_block_size, 1, sizeof(unsigned char), 0, 0, g_d);
-        mpz_import(l_n, g_block_size, 1, sizeof(unsigned char), 0, 0, g_n);
+vcache_record g_vcache_rec;
+uint8_t g_vcache_sighash[64];
+uint8_t g_vcache_keyfprint[64];
 
-        // load up our cipher block
-        mpz_import(l_block, g_block_size, 1, sizeof(unsigned char), 0, 0, g_buff);
+void vcache_stamp(vcache_entry *a_entry, int a_compare, int *a_same)
+{
+    // record the input file's metadata in a_entry, or with a_compare just check it against a_entry
+    struct stat l_stat;
+    uint8_t l_meta[40];
+
+    fstat(g_infile_fd, &l_stat);
+    put_be64(l_meta, l_stat.st_dev);
+    put_be64(l_meta + 8, l_stat.st_ino);
+    put_be64(l_meta + 16, l_stat.st_size);
+    put_be64(l_meta + 24, (uint64_t)l_stat.st_mtim.tv_sec * 1000000000ULL + l_stat.st_mtim.tv_nsec);
+    put_be64(l_meta + 32, (uint64_t)l_stat.st_ctim.tv_sec * 1000000000ULL + l_stat.st_ctim.tv_nsec);
+    if (a_compare) {
+        *a_same = (memcmp(a_entry->dev, l_meta, 40) == 0);
+        return;
+    }
+    memcpy(a_entry->dev, l_meta, 40); // dev through ctime are contiguous
+}
 
-        // and encrypt it with the private exponent
-        mpz_powm(l_cipher, l_block, l_d, l_n);
-        color_gmp_printf("n      = %Zx\nd      = %Zx\ncipher = %Zx\nblock  = %Zx\n", l_n, l_d, l_cipher, l_block);
+void vcache_load(vcache_record *a_rec)
+{
+    // read the cache file into a_rec, or start a_rec empty if there isn't one or it is damaged
+    uint8_t l_digest[64];
+    int l_fd;
+    ssize_t res;
 
-        // and export it to aux block
-        mpz_export(g_buff2, &l_written, 1, sizeof(unsigned char), 0, 0, l_cipher);
-        if (l_written != g_block_size) {
-            ccct_right_justify(l_written, g_block_size - l_written, (char *)g_buff2);
-        }
-        if (g_debug > 0) {
-            color_debug("do_sign_verify: encrypted hash");
-            ccct_print_hex(g_buff2, g_block_size);
-        }
+    memset(a_rec, 0, sizeof(vcache_record));
+    memcpy(a_rec->magic, VCACHE_MAGIC, 8);
+    l_fd = open(g_vcachefile, O_RDONLY);
+    if (l_fd < 0)
+        return;
+    res = read(l_fd, a_rec, sizeof(vcache_record));
+    close(l_fd);
+    sha512((uint8_t *)a_rec, sizeof(vcache_record) - 64, l_digest);
+    if (res != sizeof(vcache_record) || memcmp(a_rec->magic, VCACHE_MAGIC, 8) != 0 || memcmp(l_digest, a_rec->seal, 64) != 0) {
+        color_printf("*arsa-util: *everification cache is damaged*d, starting a new one\n");
+        memset(a_rec, 0, sizeof(vcache_record));
+        memcpy(a_rec->magic, VCACHE_MAGIC, 8);
+    }
+}
 
-        size_t l_sig_write_size;
-        if (g_pem) {
-            color_printf("*arsa-util:*d converting signature to *hprivacy-enhanced mail*d format...\n");
-            memcpy(g_buff, g_buff2, g_block_size);
-            ccct_base64_encode((uint8_t *)g_buff, g_block_size, (char *)g_buff2);
-            memcpy(g_buff, g_buff2, strlen((char *)g_buff2));
-            ccct_base64_format((char *)g_buff, (char *)g_buff2, "BEGIN SIGNATURE", "END SIGNATURE");
-            l_sig_write_size = strlen((char *)g_buff2);
-        } else {
-            color_printf("*arsa-util:*d creating signature as *hnative binary*d format...\n");
-            l_sig_write_size = g_block_size;
+vcache_entry *vcache_find(vcache_record *a_rec)
+{
+    // the entry in a_rec for this signature and key, or NULL if there isn't one
+    int i;
+
+    for (i = 0; i < VCACHE_ENTRIES; ++i) {
+        vcache_entry *l_entry = &a_rec->entry[i];
+        if (l_entry->used && memcmp(l_entry->sig_hash, g_vcache_sighash, 64) == 0 && memcmp(l_entry->key_fprint, g_vcache_keyfprint, 64) == 0)
+            return l_entry;
+    }
+    return NULL;
+}
+
+vcache_entry *vcache_lookup()
+{
+    // load the cache and find the entry for this signature and key, or NULL if there isn't one
+    uint8_t l_buff[4096];
+    sha512_ctx l_ctx;
+    int l_fd;
+    ssize_t res;
+
+    vcache_load(&g_vcache_rec);
+
+    // the signature is identified by its bytes, the key by what verification actually uses
+    sha512_init(&l_ctx);
+    l_fd = open(g_signaturefile, O_RDONLY);
+    if (l_fd < 0) {
+        color_err_printf(1, "rsa-util: problems opening signature file");
+        exit(EXIT_FAILURE);
+    }
+    while ((res = read(l_fd, l_buff, 4096)) > 0)
+        sha512_update(&l_ctx, l_buff, res);
+    close(l_fd);
+    sha512_final(&l_ctx, g_vcache_sighash);
+    key_fingerprint(g_vcache_keyfprint);
+
+    return vcache_find(&g_vcache_rec);
+}
+
+void vcache_save(const vcache_entry *a_entry)
+{
+    // merge a_entry into the cache as it is on disk now, not as it was when we looked it up:
+    // CI jobs may share a cache, and another one may have saved entries of its own while we were verifying
+    static vcache_record l_rec; // 64k, kept off the stack
+    char l_lockfile[BUFFLEN + 32];
+    char l_tmpfile[BUFFLEN + 32];
+    int l_lock_fd;
+    int l_fd;
+    ssize_t res;
+    int i;
+
+    // the cache itself is replaced by rename, so the lock lives in a file of its own
+    sprintf(l_lockfile, "%s.lock", g_vcachefile);
+    l_lock_fd = open(l_lockfile, O_RDWR | O_CREAT, (S_IRUSR | S_IWUSR));
+    if ((l_lock_fd < 0) || (flock(l_lock_fd, LOCK_EX) < 0)) {
+        color_err_printf(1, "rsa-util: unable to lock verification cache file");
+        if (l_lock_fd >= 0)
+            close(l_lock_fd);
+        return;
+    }
+
+    vcache_load(&l_rec);
+    vcache_entry *l_slot = vcache_find(&l_rec);
+    if (l_slot == NULL) {
+        // a free entry, or else the least recently used one
+        l_slot = &l_rec.entry[0];
+        for (i = 0; i < VCACHE_ENTRIES; ++i) {
+            vcache_entry *l_entry = &l_rec.entry[i];
+            if (!l_entry->used) {
+                l_slot = l_entry;
+                break;
+            }
+            if (get_be64(l_entry->last_used) < get_be64(l_slot->last_used))
+                l_slot = l_entry;
         }
-        color_printf("*arsa-util:*d writing signature file...\n");
-        res = write(g_signaturefile_fd, g_buff2, l_sig_write_size);
-        if (res < 0) {
-            color_err_printf(1, "rsa-util: problems writing to signature file");
+    }
+    memcpy(l_slot, a_entry, sizeof(vcache_entry));
+    sha512((uint8_t *)&l_rec, sizeof(vcache_record) - 64, l_rec.seal);
+
+    // temp file and rename like the checkpoint, so a reader that doesn't lock never sees half a cache
+    sprintf(l_tmpfile, "%s.%d.tmp", g_vcachefile, (int)getpid());
+    l_fd = open(l_tmpfile, O_WRONLY | O_TRUNC | O_CREAT, (S_IRUSR | S_IWUSR));
+    if (l_fd < 0) {
+        color_err_printf(1, "rsa-util: unable to create verification cache file");
+    } else {
+        res = write(l_fd, &l_rec, sizeof(vcache_record));
+        close(l_fd);
+        if (res != sizeof(vcache_record) || rename(l_tmpfile, g_vcachefile) < 0) {
+            color_err_printf(1, "rsa-util: unable to write verification cache file");
+            unlink(l_tmpfile);
+        }
+    }
+    flock(l_lock_fd, LOCK_UN);
+    close(l_lock_fd);
+}
+
+void vcache_store(vcache_entry *a_entry, const uint8_t *a_digest, const uint8_t *a_info)
+{
+    // remember a successful verification, updating a_entry if the signature already has one
+    vcache_entry l_new;
+
+    if (a_entry == NULL) {
+        memset(&l_new, 0, sizeof(vcache_entry));
+        a_entry = &l_new;
+    }
+    a_entry->used = 1;
+    memcpy(a_entry->sig_hash, g_vcache_sighash, 64);
+    memcpy(a_entry->key_fprint, g_vcache_keyfprint, 64);
+    memcpy(a_entry->digest, a_digest, 64);
+    memcpy(a_entry->info, a_info, 16);
+    vcache_stamp(a_entry, 0, NULL);
+    put_be64(a_entry->last_used, time(NULL));
+    vcache_save(a_entry);
+}
+
+void print_signature_info(const uint8_t *a_info)
+{
+    // a_info points at the time stamp and geolocation in a decrypted signature block
+    ccct_reversible_int64_t l_time;
+    ccct_reversible_float_t l_lat;
+    ccct_reversible_float_t l_long;
+
+    memcpy(&l_time.ll, a_info, 8);
+    ccct_reverse_int64(&l_time);
+    color_printf("*arsa-util:*d GMT timestamp of signature: *h%s*d", asctime(gmtime((time_t *)&l_time.ll)));
+    memcpy(&l_lat.f, a_info + 8, 4);
+    memcpy(&l_long.f, a_info + 12, 4);
+    ccct_reverse_float(&l_lat);
+    ccct_reverse_float(&l_long);
+    color_printf("*arsa-util:*d geolocation: latitude *h%.4f*d, longitude *h%.4f*d\n", l_lat.f, l_long.f);
+}
+
+void choose_signing_crt()
+{
+    // a signature, like unwrapping a multi-recipient key, is one private key operation, so split it if there is a core to spare
+    if ((g_p_loaded == 0) || (g_q_loaded == 0) || (g_dp_loaded == 0) || (g_dq_loaded == 0) || (g_qinv_loaded == 0))
+        g_nochinese = 1; // nothing to do the halves with, so use d directly
+    if (g_nochinese > 0) {
+        color_printf("*arsa-util:*d defeating chinese remainder theory calculations.\n");
+    } else if ((g_nosplit == 0) && (g_threads > 1)) {
+        g_splitcrt = 1;
+        color_printf("*arsa-util:*d splitting chinese remainder calculations across two threads.\n");
+    }
+    choose_parmul();
+}
+
+void write_signature(const uint8_t *a_digest, crt_key *a_key)
+{
+    // embed a_digest, the sha2-512 hash of the input file, in a block, encrypt it with the private key
+    // and write it to the signature file
+    int res;
+
+    // get time and location info
+    ccct_reversible_int64_t l_time;
+    l_time.ll = time(NULL);
+    ccct_reversible_float_t l_lat;
+    l_lat.f = g_latitude;
+    ccct_reversible_float_t l_long;
+    l_long.f = g_longitude;
+
+    // create signature file
+    // find out if signature file already exists
+    struct stat l_signaturefile_stat;
+    res = stat(g_signaturefile, &l_signaturefile_stat);
+    if (res == 0) {
+        if (g_outfile_overwrite == 0) {
+            color_printf("*arsa-util: *esignature file already exists*d (use *h-w*d or *h--overwrite*d to write to it anyway)\n");
             exit(EXIT_FAILURE);
+        } else {
+            color_printf("*arsa-util:*d overwriting existing signature file *h%s*d\n", g_outfile);
         }
+    } else if ((res < 0) && (errno == ENOENT)) {
+        // this is what we want
+    } else {
+        // some other error from stat!
+        color_err_printf(1, "rsa-util: unable to stat signature file to check its existence");
+        exit(EXIT_FAILURE);
+    }
+
+    // open the output file
+    color_debug("do_sign_verify: opening and truncating signature file\n");
+    g_signaturefile_fd = open(g_signaturefile, O_RDWR | O_TRUNC | O_CREAT, (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
+    if (g_signaturefile_fd < 0) {
+        color_err_printf(1, "rsa-util: error opening signature file for writing");
+        exit(EXIT_FAILURE);
+    }
+    // create a block in g_buff
+    ccct_get_random(g_buff, a_key->block_size);
+    g_buff[0] = 0;
+    // copy our digest into this block, after the random padding
+    memcpy(g_buff + 8, a_digest, 64);
+    color_printf("*arsa-util:*d embedding GMT time stamp: *h%s*d", asctime(gmtime((time_t *)&l_time.ll)));
+    color_printf("*arsa-util:*d embedding geolocation: latitude *h%.4f*d, longitude *h%.4f*d\n", l_lat.f, l_long.f);
+    ccct_reverse_int64(&l_time);
+    ccct_reverse_float(&l_lat);
+    ccct_reverse_float(&l_long);
+    memcpy(g_buff + 72, &l_time.ll, 8);
+    memcpy(g_buff + 80, &l_lat.f, 4);
+    memcpy(g_buff + 84, &l_long.f, 4);
+    if (g_debug > 0) {
+        color_debug("do_sign_verify: plaintext block with hash");
+        ccct_print_hex(g_buff, a_key->block_size);
+    }
+
+    mpz_t l_block;
+    mpz_init(l_block);
+    mpz_t l_cipher;
+    mpz_init(l_cipher);
+    size_t l_written;
+
+    // load up our cipher block
+    mpz_import(l_block, a_key->block_size, 1, sizeof(unsigned char), 0, 0, g_buff);
+
+    // and encrypt it with the private exponent
+    // a signature is a single operation, so the only way to make it faster is to split it
+    private_powm(l_cipher, l_block, a_key, g_splitcrt);
+    color_gmp_printf("n      = %Zx\nd      = %Zx\ncipher = %Zx\nblock  = %Zx\n", a_key->n, a_key->d, l_cipher, l_block);
+
+    // a fault in either chinese remainder half gives a signature that hands out a factor of n (the bellcore attack),
+    // so undo it with the public exponent and make sure we get our block back before it goes anywhere
+    mpz_t l_check;
+    mpz_init(l_check);
+    mpz_powm(l_check, l_cipher, a_key->e, a_key->n);
+    if (mpz_cmp(l_check, l_block) != 0) {
         close(g_signaturefile_fd);
+        unlink(g_signaturefile);
+        color_err_printf(0, "rsa-util: signature failed its check against the public exponent, nothing written.");
+        exit(EXIT_FAILURE);
+    }
+    mpz_clear(l_check);
 
-        mpz_clear(l_block);
-        mpz_clear(l_cipher);
-        mpz_clear(l_d);
-        mpz_clear(l_n);
+    // and export it to aux block
+    mpz_export(g_buff2, &l_written, 1, sizeof(unsigned char), 0, 0, l_cipher);
+    if (l_written != a_key->block_size) {
+        ccct_right_justify(l_written, a_key->block_size - l_written, (char *)g_buff2);
+    }
+    if (g_debug > 0) {
+        color_debug("do_sign_verify: encrypted hash");
+        ccct_print_hex(g_buff2, a_key->block_size);
+    }
+
+    size_t l_sig_write_size;
+    if (g_pem) {
+        color_printf("*arsa-util:*d converting signature to *hprivacy-enhanced mail*d format...\n");
+        memcpy(g_buff, g_buff2, a_key->block_size);
+        ccct_base64_encode((uint8_t *)g_buff, a_key->block_size, (char *)g_buff2);
+        memcpy(g_buff, g_buff2, strlen((char *)g_buff2));
+        ccct_base64_format((char *)g_buff, (char *)g_buff2, "BEGIN SIGNATURE", "END SIGNATURE");
+        l_sig_write_size = strlen((char *)g_buff2);
+    } else {
+        color_printf("*arsa-util:*d creating signature as *hnative binary*d format...\n");
+        l_sig_write_size = a_key->block_size;
+    }
+    color_printf("*arsa-util:*d writing signature file...\n");
+    res = write(g_signaturefile_fd, g_buff2, l_sig_write_size);
+    if (res < 0) {
+        color_err_printf(1, "rsa-util: problems writing to signature file");
+        exit(EXIT_FAILURE);
+    }
+    close(g_signaturefile_fd);
+
+    mpz_clear(l_block);
+    mpz_clear(l_cipher);
+
+}
+
+void do_sign_verify(int a_mode)
+{
+    // mode=0, sign... mode=1, verify.
+    // irrespective of mode, we need to compute a sha2-512 hash on the input file
+    int i;
+    int res;
+    uint8_t l_digest[64];
+    uint8_t l_buff[4096]; // buffer our reads
+
+    // an unchanged file verified against this signature and key before needs no work at all
+    vcache_entry *l_cached = NULL;
+    if ((a_mode == 1) && (g_vcache > 0)) {
+        int l_same = 0;
+        l_cached = vcache_lookup();
+        if (l_cached != NULL)
+            vcache_stamp(l_cached, 1, &l_same);
+        if (l_same) {
+            color_printf("*arsa-util:*d verify *bOK*d (cached)\n");
+            print_signature_info(l_cached->info);
+            put_be64(l_cached->last_used, time(NULL));
+            vcache_save(l_cached);
+            return;
+        }
+    }
+
+    // compute sha2-512 hash
+    sha512_ctx l_ctx;
+    sha512_init(&l_ctx);
+    if (g_checkpoint) {
+        // only the signer trusts its own checkpoint; verification always hashes everything
+        uint64_t l_resume = load_checkpoint(&l_ctx);
+        if (lseek(g_infile_fd, l_resume, SEEK_SET) < 0) {
+            color_err_printf(1, "rsa-util: unable to seek input file to checkpoint");
+            exit(EXIT_FAILURE);
+        }
+    }
+    do {
+        res = read(g_infile_fd, l_buff, 4096);
+        if (res == 0)
+            continue; // got our EOF
+        if (res < 0) {
+            color_err_printf(1, "rsa-util: unable to compute sha2-512 hash of input file");
+            exit(EXIT_FAILURE);
+        }
+        sha512_update(&l_ctx, (const uint8_t *)l_buff, res);
+    } while (res != 0);
+    if (g_checkpoint)
+        save_checkpoint(&l_ctx);
+    sha512_final(&l_ctx, l_digest);
+    // rewind g_infile_fd
+    res = lseek(g_infile_fd, 0, SEEK_SET);
+    if (res < 0) {
+        color_err_printf(1, "rsa-util: unable to rewind input file after computing sha2-512 hash");
+        exit(EXIT_FAILURE);
+    }
+    if (g_debug > 0) {
+        color_debug("do_sign_verify: sha2-512 hash of input file");
+        ccct_print_hex(l_digest, 64);
+    }
 
+    if (a_mode == 0) {
+        crt_key l_key;
+        crt_key_load(&l_key);
+        write_signature(l_digest, &l_key);
+        crt_key_clear(&l_key);
     } else {
+        // the file was touched since it was cached, but if its hash still matches, the signature still holds
+        if ((l_cached != NULL) && (memcmp(l_cached->digest, l_digest, 64) == 0)) {
+            color_printf("*arsa-util:*d verify *bOK*d (cached signature, file rehashed)\n");
+            print_signature_info(l_cached->info);
+            vcache_store(l_cached, l_digest, l_cached->info);
+            return;
+        }
+
         // read in and decrypt signature file
         g_signaturefile_fd = open(g_signaturefile, O_RDONLY);
         if (g_signaturefile_fd < 0) {
@@ -1488,14 +1960,9 @@ void do_sign_verify(int a_mode)
         }
         if (memcmp(l_digest_dec, l_digest, 64) == 0) {
             color_printf("*arsa-util:*d verify *bOK*d\n");
-            memcpy(&l_time.ll, g_buff2 + 72, 8);
-            ccct_reverse_int64(&l_time);
-            color_printf("*arsa-util:*d GMT timestamp of signature: *h%s*d", asctime(gmtime((time_t *)&l_time.ll)));
-            memcpy(&l_lat.f, g_buff2 + 80, 4);
-            memcpy(&l_long.f, g_buff2 + 84, 4);
-            ccct_reverse_float(&l_lat);
-            ccct_reverse_float(&l_long);
-            color_printf("*arsa-util:*d geolocation: latitude *h%.4f*d, longitude *h%.4f*d\n", l_lat.f, l_long.f);
+            print_signature_info(g_buff2 + 72);
+            if (g_vcache > 0)
+                vcache_store(l_cached, l_digest, g_buff2 + 72);
         } else {
             color_printf("*arsa-util:*d verify *eFAILED*d\n");
         }
@@ -1507,6 +1974,373 @@ void do_sign_verify(int a_mode)
     }
 }
 
+#define MULTI_MAGIC "RSAMULT1"
+#define MULTI_CHUNK 4096 // payload is read in chunks of this size, a multiple of AES_BLOCKLEN so CTR offsets stay on block boundaries
+
+// multi-recipient file, written with --to: the data is encrypted once with a random AES256/CTR key
+// and only that key is encrypted with each recipient's public key
+// layout: multi_header, then per recipient a multi_slot and its wrapped key block, then the AES payload
+// (multi_fileinfo followed by the data), then an HMAC-SHA256 tag over everything before it
+typedef struct {
+    char magic[8];
+    uint32_t count; // number of recipient slots that follow
+} multi_header;
+
+typedef struct {
+    uint8_t key_fprint[64]; // key_fingerprint() of the recipient's key, so a decryptor can find its slot
+    uint32_t block_size; // size of the wrapped key block that follows, the recipient's modulus size
+} multi_slot;
+
+// what a wrapped key block carries at offset 8, padded like a data block
+typedef struct {
+    uint8_t aes_key[AES_KEYLEN];
+    uint8_t iv[AES_BLOCKLEN];
+    uint8_t mac_key[32];
+} multi_keys;
+
+typedef struct {
+    uint8_t size[8]; // big endian, like the checkpoint
+    ccct_reversible_int64_t time;
+    ccct_reversible_float_t latitude;
+    ccct_reversible_float_t longitude;
+    uint8_t reserved[8];
+} multi_fileinfo;
+
+ssize_t read_full(int a_fd, uint8_t *a_buff, size_t a_len)
+{
+    // read a_len bytes unless the file ends first, so only the last chunk of a payload can be short
+    size_t l_got = 0;
+    ssize_t res;
+
+    while (l_got < a_len) {
+        res = read(a_fd, a_buff + l_got, a_len - l_got);
+        if (res < 0)
+            return -1;
+        if (res == 0)
+            break;
+        l_got += res;
+    }
+    return l_got;
+}
+
+void multi_write(hmac_sha256_ctx *a_mac, const uint8_t *a_buff, size_t a_len)
+{
+    // everything in a multi-recipient file up to the tag goes through the MAC on its way out
+    ssize_t res;
+
+    hmac_sha256_update(a_mac, a_buff, a_len);
+    res = write(g_outfile_fd, a_buff, a_len);
+    if (res < 0) {
+        color_err_printf(1, "rsa-util: unable to write to output file during encrypt operation");
+        exit(EXIT_FAILURE);
+    }
+    if (res != a_len) {
+        color_err_printf(0, "rsa-util: unable to write entire contents of buffer: wrote %d expected %d.", (int)res, (int)a_len);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void multi_wrap(const multi_keys *a_keys, uint8_t *a_out)
+{
+    // encrypt a_keys with the loaded public key, leaving a g_block_size block in a_out
+    size_t l_written;
+
+    mpz_t l_e;
+    mpz_init(l_e);
+    mpz_t l_n;
+    mpz_init(l_n);
+    mpz_t l_block;
+    mpz_init(l_block);
+    mpz_t l_cipher;
+    mpz_init(l_cipher);
+
+    ccct_get_random(g_buff, g_block_size);
+    g_buff[0] = 0;
+    memcpy(g_buff + 8, a_keys, sizeof(multi_keys));
+    mpz_import(l_e, 4, 1, sizeof(unsigned char), 0, 0, g_e);
+    mpz_import(l_n, g_block_size, 1, sizeof(unsigned char), 0, 0, g_n);
+    mpz_import(l_block, g_block_size, 1, sizeof(unsigned char), 0, 0, g_buff);
+    memset(g_buff, 0, g_block_size);
+    mpz_powm(l_cipher, l_block, l_e, l_n);
+    mpz_export(a_out, &l_written, 1, sizeof(unsigned char), 0, 0, l_cipher);
+    if (l_written != g_block_size) {
+        ccct_right_justify(l_written, g_block_size - l_written, (char *)a_out);
+    }
+
+    mpz_clear(l_e);
+    mpz_clear(l_n);
+    mpz_clear(l_block);
+    mpz_clear(l_cipher);
+}
+
+void do_encrypt_multi(uint8_t *a_digest)
+{
+    // one AES256/CTR pass over the input however many recipients there are, plus one public key operation each
+    // with a_digest, the sha2-512 hash of the input is worked out along the way as in do_encrypt
+    multi_header l_mh;
+    multi_slot l_slot;
+    multi_keys l_keys;
+    multi_fileinfo l_mfi;
+    struct AES_ctx l_aes;
+    hmac_sha256_ctx l_mac;
+    sha512_ctx l_ctx;
+    uint8_t l_buff[MULTI_CHUNK];
+    uint8_t l_tag[SHA256_DIGEST_SIZE];
+    uint64_t l_offset; // payload bytes so far
+    ssize_t res;
+    int i;
+
+    ccct_get_random((uint8_t *)&l_keys, sizeof(multi_keys));
+    AES_init_ctx_iv(&l_aes, l_keys.aes_key, l_keys.iv);
+    hmac_sha256_init(&l_mac, l_keys.mac_key, sizeof(l_keys.mac_key));
+
+    memcpy(l_mh.magic, MULTI_MAGIC, 8);
+    l_mh.count = htonl(g_recipient_count);
+    multi_write(&l_mac, (uint8_t *)&l_mh, sizeof(multi_header));
+
+    // a slot for each recipient, loading their keys in turn
+    for (i = 0; i < g_recipient_count; ++i) {
+        g_n_loaded = g_e_loaded = g_d_loaded = g_p_loaded = g_q_loaded = g_dp_loaded = g_dq_loaded = g_qinv_loaded = 0;
+        strcpy(g_keyfile, g_recipients[i]);
+        g_keyfile_specified = 1;
+        color_printf("*arsa-util:*d recipient *h%d*d: *h%s*d\n", i + 1, g_keyfile);
+        load_key();
+        if ((g_n_loaded == 0) || (g_e_loaded == 0)) {
+            color_err_printf(0, "rsa-util: recipient key file %s must contain a modulus and a public exponent.", g_keyfile);
+            exit(EXIT_FAILURE);
+        }
+        g_block_size = (g_bits / 8);
+        key_fingerprint(l_slot.key_fprint);
+        l_slot.block_size = htonl(g_block_size);
+        multi_write(&l_mac, (uint8_t *)&l_slot, sizeof(multi_slot));
+        multi_wrap(&l_keys, g_buff2);
+        multi_write(&l_mac, g_buff2, g_block_size);
+    }
+
+    // the payload starts with the file info
+    memset(&l_mfi, 0, sizeof(multi_fileinfo));
+    put_be64(l_mfi.size, g_infile_length);
+    l_mfi.time.ll = time(NULL);
+    color_debug("embedding GMT time stamp: %s", asctime(gmtime((time_t *)&l_mfi.time.ll)));
+    ccct_reverse_int64(&l_mfi.time);
+    l_mfi.latitude.f = g_latitude;
+    ccct_reverse_float(&l_mfi.latitude);
+    l_mfi.longitude.f = g_longitude;
+    ccct_reverse_float(&l_mfi.longitude);
+    color_debug("embedding geolocation: latitude %.4f, longitude %.4f\n", g_latitude, g_longitude);
+    AES_CTR_xcrypt(&l_aes, (uint8_t *)&l_mfi, l_buff, sizeof(multi_fileinfo), 0);
+    multi_write(&l_mac, l_buff, sizeof(multi_fileinfo));
+    l_offset = sizeof(multi_fileinfo);
+
+    color_printf("*arsa-util:*d encrypting ...");
+    if (a_digest != NULL)
+        sha512_init(&l_ctx);
+    while ((res = read_full(g_infile_fd, l_buff, MULTI_CHUNK)) > 0) {
+        if (a_digest != NULL)
+            sha512_update(&l_ctx, l_buff, res);
+        AES_CTR_xcrypt(&l_aes, l_buff, l_buff, res, l_offset / AES_BLOCKLEN);
+        multi_write(&l_mac, l_buff, res);
+        l_offset += res;
+    }
+    if (res < 0) {
+        color_err_printf(1, "rsa-util: unable to read from input file (fd %d) during encrypt operation", g_infile_fd);
+        exit(EXIT_FAILURE);
+    }
+
+    hmac_sha256_final(&l_mac, l_tag, SHA256_DIGEST_SIZE);
+    res = write(g_outfile_fd, l_tag, SHA256_DIGEST_SIZE);
+    if (res != SHA256_DIGEST_SIZE) {
+        color_err_printf(1, "rsa-util: unable to write authentication tag to output file");
+        exit(EXIT_FAILURE);
+    }
+    if (a_digest != NULL)
+        sha512_final(&l_ctx, a_digest);
+    memset(&l_keys, 0, sizeof(multi_keys));
+    memset(&l_aes, 0, sizeof(struct AES_ctx));
+    memset(&l_mac, 0, sizeof(hmac_sha256_ctx));
+    color_printf(" *hdone.*d\n");
+}
+
+void do_decrypt_multi()
+{
+    // find our slot by key fingerprint, unwrap the bulk key with one private key operation,
+    // check the tag over the whole file, and only then decrypt the payload into the output
+    multi_header l_mh;
+    multi_slot l_slot;
+    multi_keys l_keys;
+    multi_fileinfo l_mfi;
+    struct AES_ctx l_aes;
+    hmac_sha256_ctx l_mac0; // keyed but unused, each pass starts from a copy
+    hmac_sha256_ctx l_mac;
+    crt_key l_key;
+    uint8_t l_buff[MULTI_CHUNK];
+    uint8_t l_fprint[64];
+    uint8_t l_tag[SHA256_DIGEST_SIZE];
+    uint8_t l_expected[SHA256_DIGEST_SIZE];
+    uint8_t l_diff;
+    off_t l_header_len = sizeof(multi_header);
+    off_t l_slot_offset = -1; // where our wrapped key block starts
+    uint64_t l_offset;
+    uint64_t l_size;
+    uint64_t l_done;
+    uint32_t l_count;
+    uint32_t l_bs;
+    size_t l_exported;
+    ssize_t res;
+    uint32_t i;
+    int l_pass;
+
+    memset(&l_aes, 0, sizeof(struct AES_ctx));
+    memset(&l_mac0, 0, sizeof(hmac_sha256_ctx));
+    memset(&l_mac, 0, sizeof(hmac_sha256_ctx));
+    color_printf("*arsa-util:*d decryption mode: *hmulti-recipient*d format\n");
+    res = read(g_infile_fd, &l_mh, sizeof(multi_header));
+    l_count = ntohl(l_mh.count);
+    if ((res != sizeof(multi_header)) || (l_count == 0) || (l_count > MAXRECIPIENTS))
+        goto do_decrypt_multi_damaged;
+
+    // walk the slots
+    key_fingerprint(l_fprint);
+    for (i = 0; i < l_count; ++i) {
+        res = pread(g_infile_fd, &l_slot, sizeof(multi_slot), l_header_len);
+        if (res != sizeof(multi_slot))
+            goto do_decrypt_multi_damaged;
+        l_bs = ntohl(l_slot.block_size);
+        if ((l_bs < (768 / 8)) || (l_bs > MAXBYTEBUFF))
+            goto do_decrypt_multi_damaged;
+        l_header_len += sizeof(multi_slot);
+        if ((memcmp(l_slot.key_fprint, l_fprint, 64) == 0) && (l_bs == g_block_size))
+            l_slot_offset = l_header_len;
+        l_header_len += l_bs;
+    }
+    if (l_slot_offset < 0) {
+        color_printf("*arsa-util:*d none of the *h%u*d recipient slots is for this key, *ewrong key file.*d\n", l_count);
+        goto do_decrypt_multi_fail;
+    }
+    if (g_infile_length < l_header_len + sizeof(multi_fileinfo) + SHA256_DIGEST_SIZE)
+        goto do_decrypt_multi_damaged;
+    color_printf("*arsa-util:*d found the slot for this key among *h%u*d recipients.\n", l_count);
+
+    // unwrap the bulk key
+    res = pread(g_infile_fd, g_buff, g_block_size, l_slot_offset);
+    if (res != g_block_size)
+        goto do_decrypt_multi_damaged;
+    mpz_t l_block;
+    mpz_init(l_block);
+    mpz_t l_cipher;
+    mpz_init(l_cipher);
+    crt_key_load(&l_key);
+    mpz_import(l_cipher, g_block_size, 1, sizeof(unsigned char), 0, 0, g_buff);
+    private_powm(l_block, l_cipher, &l_key, g_splitcrt);
+    mpz_export(g_buff2, &l_exported, 1, sizeof(unsigned char), 0, 0, l_block);
+    if (l_exported != g_block_size) {
+        ccct_right_justify(l_exported, g_block_size - l_exported, (char *)g_buff2);
+    }
+    mpz_clear(l_block);
+    mpz_clear(l_cipher);
+    crt_key_clear(&l_key);
+    memcpy(&l_keys, g_buff2 + 8, sizeof(multi_keys));
+    memset(g_buff2, 0, g_block_size);
+    AES_init_ctx_iv(&l_aes, l_keys.aes_key, l_keys.iv);
+    hmac_sha256_init(&l_mac0, l_keys.mac_key, sizeof(l_keys.mac_key));
+    memset(&l_keys, 0, sizeof(multi_keys));
+
+    // pass 0 only checks the tag, so nothing unauthenticated ever reaches the output file;
+    // pass 1 decrypts and checks the tag again, in case the input changed in between
+    // the header is covered by the tag too, so no slot can be swapped or added
+    l_size = g_infile_length - l_header_len - sizeof(multi_fileinfo) - SHA256_DIGEST_SIZE;
+    for (l_pass = 0; l_pass < 2; ++l_pass) {
+        memcpy(&l_mac, &l_mac0, sizeof(hmac_sha256_ctx));
+        if (lseek(g_infile_fd, 0, SEEK_SET) < 0) {
+            color_err_printf(1, "rsa-util: can't rewind input file");
+            goto do_decrypt_multi_fail;
+        }
+        for (l_offset = 0; l_offset < l_header_len; l_offset += res) {
+            res = read_full(g_infile_fd, l_buff, ((l_header_len - l_offset) < MULTI_CHUNK) ? (l_header_len - l_offset) : MULTI_CHUNK);
+            if (res <= 0)
+                goto do_decrypt_multi_damaged;
+            hmac_sha256_update(&l_mac, l_buff, res);
+        }
+
+        // file info
+        res = read_full(g_infile_fd, l_buff, sizeof(multi_fileinfo));
+        if (res != sizeof(multi_fileinfo))
+            goto do_decrypt_multi_damaged;
+        hmac_sha256_update(&l_mac, l_buff, sizeof(multi_fileinfo));
+        if (l_pass == 1) {
+            AES_CTR_xcrypt(&l_aes, l_buff, (uint8_t *)&l_mfi, sizeof(multi_fileinfo), 0);
+            if (get_be64(l_mfi.size) != l_size) {
+                color_printf("*arsa-util:*d error decrypting file info, *ewrong key file or damaged input file.*d\n");
+                goto do_decrypt_multi_fail;
+            }
+            ccct_reverse_int64(&l_mfi.time);
+            ccct_reverse_float(&l_mfi.latitude);
+            ccct_reverse_float(&l_mfi.longitude);
+            color_printf("*arsa-util:*d data length in input file is *h%llu*d bytes.\n", (unsigned long long)l_size);
+            color_printf("*arsa-util:*d GMT time stamp: *h%s*d", asctime(gmtime((time_t *)&l_mfi.time.ll)));
+            color_printf("*arsa-util:*d geolocation: latitude *h%.4f*d, longitude *h%.4f*d\n", l_mfi.latitude.f, l_mfi.longitude.f);
+            color_printf("*arsa-util:*d decrypting ...");
+        }
+
+        // and the data
+        l_offset = sizeof(multi_fileinfo);
+        for (l_done = 0; l_done < l_size; l_done += res) {
+            size_t l_want = ((l_size - l_done) < MULTI_CHUNK) ? (l_size - l_done) : MULTI_CHUNK;
+            res = read_full(g_infile_fd, l_buff, l_want);
+            if (res != l_want) {
+                color_err_printf(1, "rsa-util: unable to read from input file during decrypt operation");
+                goto do_decrypt_multi_fail;
+            }
+            hmac_sha256_update(&l_mac, l_buff, res);
+            if (l_pass == 0)
+                continue;
+            AES_CTR_xcrypt(&l_aes, l_buff, l_buff, res, l_offset / AES_BLOCKLEN);
+            res = write(g_outfile_fd, l_buff, l_want);
+            if (res < 0) {
+                color_err_printf(1, "rsa-util: unable to write to output file during decrypt operation");
+                goto do_decrypt_multi_fail;
+            }
+            if (res < l_want) {
+                color_err_printf(0, "rsa-util: problems writing to output file, wrote %d bytes, expected %d", (int)res, (int)l_want);
+                goto do_decrypt_multi_fail;
+            }
+            l_offset += l_want;
+        }
+
+        // check the tag without bailing out at the first differing byte
+        res = read_full(g_infile_fd, l_tag, SHA256_DIGEST_SIZE);
+        hmac_sha256_final(&l_mac, l_expected, SHA256_DIGEST_SIZE);
+        l_diff = 0;
+        for (i = 0; i < SHA256_DIGEST_SIZE; ++i)
+            l_diff |= l_tag[i] ^ l_expected[i];
+        if ((res != SHA256_DIGEST_SIZE) || (l_diff != 0)) {
+            if (l_pass == 0)
+                color_printf("*arsa-util:*d authentication *eFAILED*d, input file was altered or damaged; nothing decrypted.\n");
+            else
+                color_printf("\n*arsa-util:*d authentication *eFAILED*d, input file changed while it was being decrypted; removing output file.\n");
+            goto do_decrypt_multi_fail;
+        }
+        if (l_pass == 0)
+            color_printf("*arsa-util:*d authentication *bOK*d\n");
+    }
+    color_printf(" *hdone.*d\n");
+    memset(&l_aes, 0, sizeof(struct AES_ctx));
+    memset(&l_mac0, 0, sizeof(hmac_sha256_ctx));
+    memset(&l_mac, 0, sizeof(hmac_sha256_ctx));
+    return;
+
+do_decrypt_multi_damaged:
+    color_printf("*arsa-util:*d error reading multi-recipient header, *edamaged input file.*d\n");
+do_decrypt_multi_fail:
+    // every way out short of success leaves no output file behind, not even an empty one
+    memset(&l_aes, 0, sizeof(struct AES_ctx));
+    memset(&l_mac0, 0, sizeof(hmac_sha256_ctx));
+    memset(&l_mac, 0, sizeof(hmac_sha256_ctx));
+    close(g_outfile_fd);
+    unlink(g_outfile);
+    exit(EXIT_FAILURE);
+}
+
 int main(int argc, char **argv)
 {
     unsigned int i;
@@ -1562,6 +2396,42 @@ int main(int argc, char **argv)
                 color_set_nocolor(g_nocolor);
             }
             break;
+            case 1008: // checkpoint
+            {
+                g_checkpoint = 1;
+            }
+            break;
+            case 1009: // nosplit
+            {
+                g_nosplit = 1;
+            }
+            break;
+            case 1010: // vcache
+            {
+                strcpy(g_vcachefile, optarg);
+                g_vcache = 1;
+            }
+            break;
+            case 1011: // signkey
+            {
+                strcpy(g_signkeyfile, optarg);
+                g_signkeyfile_specified = 1;
+            }
+            break;
+            case 1012: // to
+            {
+                if (g_recipient_count >= MAXRECIPIENTS) {
+                    color_err_printf(0, "rsa-util: recipient limit: %d.", MAXRECIPIENTS);
+                    exit(EXIT_FAILURE);
+                }
+                strcpy(g_recipients[g_recipient_count++], optarg);
+            }
+            break;
+            case 1013: // parmul
+            {
+                g_parmul = 1;
+            }
+            break;
             case 'i':
             {
                 strcpy(g_infile, optarg);
@@ -1694,8 +2564,22 @@ int main(int argc, char **argv)
                 color_printf("       latitude and longitude are specified as floating point numbers\n");
                 color_printf("       will be rounded to 4 decimal places (accuracy of 11.1 meters/36.4 feet)\n");
                 color_printf("*a     (--threads) <count>*d specify number of threads to use during decryption process\n");
-                color_printf("*a     (--nochinese)*d defeat chinese remainder theorem calculations during decryption\n");
+                color_printf("*a     (--nochinese)*d defeat chinese remainder theorem calculations during decryption and signing\n");
+                color_printf("*a     (--nosplit)*d don't run the two chinese remainder halves of a block on separate threads\n");
+                color_printf("       by default they are split when signing, or when decrypting a file with fewer blocks than half the threads\n");
+                color_printf("*a     (--parmul)*d spread the multiplications of one exponentiation across threads (keys of *b%d*d bits and up)\n", MTMUL_MIN_BITS * 2);
+                color_printf("       it does twice the work, so only use it where make kat shows it coming out ahead\n");
                 color_printf("*a     (--pem)*d save encrypted files and signatures in privacy-enhanced mail format\n");
+                color_printf("*a     (--checkpoint)*d sign mode: resume the sha2-512 hash from <in>.sha512ckpt and save a new one\n");
+                color_printf("       for append-only files (logs), only data appended since the last signature is hashed\n");
+                color_printf("       the prefix is trusted from the checkpoint, so only use it on files that are never rewritten\n");
+                color_printf("*a     (--signkey) <name>*d encrypt mode: also sign the input with this private key, writing the signature to -g\n");
+                color_printf("       reads the input once instead of three times for rsa-util -s followed by rsa-util -e\n");
+                color_printf("*a     (--to) <name>*d encrypt mode: encrypt for this public key, repeat for each recipient (up to %d) instead of -k\n", MAXRECIPIENTS);
+                color_printf("       the file is encrypted once with AES256/CTR and only its key is encrypted for each recipient\n");
+                color_printf("*a     (--vcache) <name>*d verify mode: remember successful verifications in this cache file\n");
+                color_printf("       an unchanged file (same inode, size, mtime and ctime) with the same signature and key is not checked again\n");
+                color_printf("       the cache is trusted like a key, so keep it where only you can write it\n");
                 color_printf("*a  -f (--format) <priv, pub, message, sig, raw, none>*d choose format when using -b or --base64encode\n");
                 color_printf("*a     (--debug)*d use debug mode\n");
                 color_printf("*a     (--nocolor)*d defeat terminal colors\n");
@@ -1771,21 +2655,78 @@ int main(int argc, char **argv)
         case MODE_ENCRYPT:
         {
             color_printf("*arsa-util:*d selected *hencryption*d mode.\n");
-            load_key();
-            if (g_n_loaded == 0) {
-                color_err_printf(0, "rsa-util: this function requires the key file to contain a modulus.");
-                exit(EXIT_FAILURE);
-            }
-            if (g_e_loaded == 0) {
-                color_err_printf(0, "rsa-util: this function requires the key file to contain a public exponent.");
-                exit(EXIT_FAILURE);
+            crt_key l_signkey;
+            if (g_signkeyfile_specified > 0) {
+                // load the signer's key up front, so a bad one is caught before any encrypting is done
+                if (g_signaturefile_specified == 0) {
+                    color_err_printf(0, "rsa-util: signing while encrypting requires that you specify a signature file.");
+                    exit(EXIT_FAILURE);
+                }
+                color_printf("*arsa-util:*d signing with *h%s*d in the same pass.\n", g_signkeyfile);
+                char l_keyfile[BUFFLEN];
+                int l_keyfile_specified = g_keyfile_specified;
+                strcpy(l_keyfile, g_keyfile);
+                strcpy(g_keyfile, g_signkeyfile);
+                g_keyfile_specified = 1;
+                load_key();
+                if ((g_n_loaded == 0) || (g_e_loaded == 0) || (g_d_loaded == 0)) {
+                    color_err_printf(0, "rsa-util: the signing key file must contain a modulus and both exponents.");
+                    exit(EXIT_FAILURE);
+                }
+                g_block_size = (g_bits / 8);
+                choose_signing_crt();
+                crt_key_load(&l_signkey);
+                if (g_nochinese == 0) {
+                    mpz_t l_pq;
+                    mpz_init(l_pq);
+                    mpz_mul(l_pq, l_signkey.p, l_signkey.q);
+                    if (mpz_cmp(l_pq, l_signkey.n) != 0) {
+                        color_err_printf(0, "rsa-util: the signing key file is damaged, its primes don't multiply to its modulus.");
+                        exit(EXIT_FAILURE);
+                    }
+                    mpz_clear(l_pq);
+                }
+                // the signer's key is in l_signkey now; the globals go back to holding the recipient's
+                memset(g_d, 0, sizeof(g_d));
+                memset(g_p, 0, sizeof(g_p));
+                memset(g_q, 0, sizeof(g_q));
+                memset(g_dp, 0, sizeof(g_dp));
+                memset(g_dq, 0, sizeof(g_dq));
+                memset(g_qinv, 0, sizeof(g_qinv));
+                strcpy(g_keyfile, l_keyfile);
+                g_keyfile_specified = l_keyfile_specified;
+                g_n_loaded = g_e_loaded = g_d_loaded = g_p_loaded = g_q_loaded = g_dp_loaded = g_dq_loaded = g_qinv_loaded = 0;
+            }
+            if (g_recipient_count > 0) {
+                // recipient keys are loaded one at a time as their slots are written
+                if (g_keyfile_specified > 0) {
+                    color_err_printf(0, "rsa-util: name every recipient with --to when encrypting for several, instead of -k.");
+                    exit(EXIT_FAILURE);
+                }
+                if (g_pem == 1) {
+                    color_err_printf(0, "rsa-util: multi-recipient files are native binary only.");
+                    exit(EXIT_FAILURE);
+                }
+                // set g_bits to something to satisfy prepare_infile: otherwise there will be errors
+                g_bits = 4096;
+            } else {
+                load_key();
+                if (g_n_loaded == 0) {
+                    color_err_printf(0, "rsa-util: this function requires the key file to contain a modulus.");
+                    exit(EXIT_FAILURE);
+                }
+                if (g_e_loaded == 0) {
+                    color_err_printf(0, "rsa-util: this function requires the key file to contain a public exponent.");
+                    exit(EXIT_FAILURE);
+                }
             }
             if (g_infile_specified == 0) {
                 color_err_printf(0, "rsa-util: this function requires that you specify an input file.");
                 exit(EXIT_FAILURE);
             }
             prepare_infile();
-            get_infile_crc();
+            if ((g_signkeyfile_specified == 0) && (g_recipient_count == 0))
+                get_infile_crc(); // otherwise worked out along the way, or not needed
             if (g_pem == 1) {
                 color_printf("*arsa-util:*d selecting *hprivacy-enhanced mail*d format for encrypted message.\n");
                 if (g_infile_length > PEMLIMIT) {
@@ -1800,7 +2741,21 @@ int main(int argc, char **argv)
                 exit(EXIT_FAILURE);
             }
             prepare_outfile();
-            do_encrypt();
+            if ((g_signkeyfile_specified == 0) && (g_recipient_count > 0)) {
+                do_encrypt_multi(NULL);
+            } else if (g_signkeyfile_specified == 0) {
+                do_encrypt(NULL);
+            } else {
+                // one read of the input feeds the encryptor, the CRC and the signature hash
+                uint8_t l_digest[64];
+                if (g_recipient_count > 0)
+                    do_encrypt_multi(l_digest);
+                else
+                    do_encrypt(l_digest);
+
+                write_signature(l_digest, &l_signkey);
+                crt_key_clear(&l_signkey);
+            }
         }
         break;
         case MODE_DECRYPT:
@@ -1829,6 +2784,13 @@ int main(int argc, char **argv)
                 exit(EXIT_FAILURE);
             }
             prepare_outfile();
+            char l_magic[8];
+            if ((pread(g_infile_fd, l_magic, 8, 0) == 8) && (memcmp(l_magic, MULTI_MAGIC, 8) == 0)) {
+                // one private key operation for the bulk key, then AES: no blocks to hand out to threads
+                choose_signing_crt();
+                do_decrypt_multi();
+                break;
+            }
             // initialize threaded environment
             pthread_mutex_init(&g_debug_mtx, NULL);
             pthread_mutex_init(&g_tally_mtx, NULL);
@@ -1872,6 +2834,11 @@ int main(int argc, char **argv)
                 color_err_printf(0, "rsa-util: this function requires the key file to contain a private exponent.");
                 exit(EXIT_FAILURE);
             }
+            if (g_e_loaded == 0) {
+                color_err_printf(0, "rsa-util: this function requires the key file to contain a public exponent.");
+                exit(EXIT_FAILURE);
+            }
+            choose_signing_crt();
             if (g_infile_specified == 0) {
                 color_err_printf(0, "rsa-util: this function requires that you specify an input file.");
                 exit(EXIT_FAILURE);
@@ -1886,6 +2853,10 @@ int main(int argc, char **argv)
             } else {
                 color_printf("*arsa-util:*d selecting *hnative binary*d format for digital signature.\n");
             }
+            if (g_checkpoint) {
+                sprintf(g_checkpointfile, "%s.sha512ckpt", g_infile);
+                color_printf("*arsa-util:*d using hash checkpoint *h%s*d\n", g_checkpointfile);
+            }
             do_sign_verify(0);
         }
         break;
@@ -1910,6 +2881,9 @@ int main(int argc, char **argv)
                 color_err_printf(0, "rsa-util: this function requires that you specify a signature file.");
                 exit(EXIT_FAILURE);
             }
+            g_checkpoint = 0; // a verifier must hash the whole file
+            if (g_vcache > 0)
+                color_printf("*arsa-util:*d using verification cache *h%s*d\n", g_vcachefile);
             do_sign_verify(1);
         }
         break;
@@ -2085,6 +3059,7 @@ int main(int argc, char **argv)
 
     close(g_infile_fd);
     close(g_outfile_fd);
+    mtmul_close();
     ccct_close_urandom();
 
     return 0;
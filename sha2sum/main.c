@@ -0,0 +1,742 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "sha2.h"
+
+#define BUFFLEN 4096
+#define READSIZE (1024 * 1024) // bytes per sequential read
+#define MAXTHREADS 256
+#define DEFAULT_CHUNK_MB 64 // tree mode leaf size
+
+int g_debug = 0;
+int g_bits = 512;
+unsigned int g_threads = 0; // 0 = one per online CPU
+int g_tree = 0;
+uint64_t g_chunk = (uint64_t)DEFAULT_CHUNK_MB * 1024 * 1024;
+int g_quiet = 0;
+
+char g_check[BUFFLEN];
+int g_check_specified = 0;
+char g_listfile[BUFFLEN];
+int g_listfile_specified = 0;
+
+/*
+ * One entry per file named on the command line, in a list file or in a
+ * manifest. Files bigger than the tree chunk size are split into several
+ * jobs when tree mode is on; the last job to finish computes the root.
+ */
+typedef struct {
+    char *name;
+    int bits;
+    uint64_t chunk; // 0 = plain digest, otherwise tree leaf size
+    uint64_t size;
+    uint32_t jobs;
+    uint32_t remaining;
+    int done;
+    int error; // errno of a failed open or read
+    uint8_t *leaves; // jobs * digest size, tree mode only
+    uint8_t digest[SHA512_DIGEST_SIZE];
+    char *expected; // hex digest from a manifest, check mode only
+} file_entry;
+
+typedef struct {
+    size_t file;
+    uint32_t index;
+    uint64_t offset;
+    uint64_t len;
+} job_entry;
+
+/*
+ * Work stealing: every worker owns a range of job indexes and takes jobs
+ * from the low end. An idle worker steals the upper half of another
+ * worker's remaining range, so a few huge files can't leave threads idle.
+ */
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t mtx;
+    unsigned int id;
+    size_t lo;
+    size_t hi;
+    uint8_t *buff;
+} worker_t;
+
+file_entry *g_files = NULL;
+size_t g_file_count = 0;
+size_t g_file_capacity = 0;
+
+job_entry *g_jobs = NULL;
+size_t g_job_count = 0;
+
+worker_t g_workers[MAXTHREADS];
+
+pthread_mutex_t g_done_mtx = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t g_done_cond = PTHREAD_COND_INITIALIZER;
+
+struct option g_options[] = {
+    { "help", no_argument, NULL, '?' },
+    { "debug", no_argument, NULL, 1001 },
+    { "algorithm", required_argument, NULL, 'a' },
+    { "threads", required_argument, NULL, 't' },
+    { "check", required_argument, NULL, 'c' },
+    { "files", required_argument, NULL, 'f' },
+    { "quiet", no_argument, NULL, 'q' },
+    { "tree", no_argument, NULL, 1002 },
+    { "chunk", required_argument, NULL, 1003 },
+    { NULL, 0, NULL, 0 }
+};
+
+/* generic wrappers so the workers don't care which SHA-2 flavor is in use */
+
+typedef union {
+    sha256_ctx s256;
+    sha512_ctx s512;
+} digest_ctx;
+
+size_t digest_size(int a_bits)
+{
+    return a_bits / 8;
+}
+
+void digest_init(digest_ctx *a_ctx, int a_bits)
+{
+    switch (a_bits) {
+        case 224: sha224_init(&a_ctx->s256); break;
+        case 256: sha256_init(&a_ctx->s256); break;
+        case 384: sha384_init(&a_ctx->s512); break;
+        default: sha512_init(&a_ctx->s512); break;
+    }
+}
+
+void digest_update(digest_ctx *a_ctx, int a_bits, const uint8_t *a_data, size_t a_len)
+{
+    switch (a_bits) {
+        case 224: sha224_update(&a_ctx->s256, a_data, a_len); break;
+        case 256: sha256_update(&a_ctx->s256, a_data, a_len); break;
+        case 384: sha384_update(&a_ctx->s512, a_data, a_len); break;
+        default: sha512_update(&a_ctx->s512, a_data, a_len); break;
+    }
+}
+
+void digest_final(digest_ctx *a_ctx, int a_bits, uint8_t *a_digest)
+{
+    switch (a_bits) {
+        case 224: sha224_final(&a_ctx->s256, a_digest); break;
+        case 256: sha256_final(&a_ctx->s256, a_digest); break;
+        case 384: sha384_final(&a_ctx->s512, a_digest); break;
+        default: sha512_final(&a_ctx->s512, a_digest); break;
+    }
+}
+
+void to_hex(const uint8_t *a_digest, size_t a_len, char *a_hex)
+{
+    size_t i;
+    for (i = 0; i < a_len; ++i)
+        sprintf(a_hex + i * 2, "%02x", a_digest[i]);
+}
+
+void add_file(const char *a_name, int a_bits, uint64_t a_chunk, const char *a_expected)
+{
+    if (g_file_count == g_file_capacity) {
+        g_file_capacity = (g_file_capacity == 0) ? 1024 : g_file_capacity * 2;
+        g_files = realloc(g_files, g_file_capacity * sizeof(file_entry));
+        if (g_files == NULL) {
+            fprintf(stderr, "sha2sum: unable to allocate file list\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    file_entry *l_file = &g_files[g_file_count++];
+    memset(l_file, 0, sizeof(file_entry));
+    l_file->name = strdup(a_name);
+    l_file->bits = a_bits;
+    l_file->chunk = a_chunk;
+    if (a_expected != NULL)
+        l_file->expected = strdup(a_expected);
+}
+
+/* coreutils escapes names containing a backslash or newline and flags the line with a leading backslash */
+
+void print_name(FILE *a_stream, const char *a_name)
+{
+    for (; *a_name != 0; ++a_name) {
+        if (*a_name == '\\')
+            fputs("\\\\", a_stream);
+        else if (*a_name == '\n')
+            fputs("\\n", a_stream);
+        else
+            fputc(*a_name, a_stream);
+    }
+}
+
+int needs_escape(const char *a_name)
+{
+    return (strchr(a_name, '\\') != NULL) || (strchr(a_name, '\n') != NULL);
+}
+
+void unescape_name(char *a_name)
+{
+    char *l_out = a_name;
+    for (; *a_name != 0; ++a_name) {
+        if ((*a_name == '\\') && (a_name[1] == 'n')) {
+            *l_out++ = '\n';
+            ++a_name;
+        } else if ((*a_name == '\\') && (a_name[1] == '\\')) {
+            *l_out++ = '\\';
+            ++a_name;
+        } else {
+            *l_out++ = *a_name;
+        }
+    }
+    *l_out = 0;
+}
+
+FILE *open_list(const char *a_name)
+{
+    if (strcmp(a_name, "-") == 0)
+        return stdin;
+    FILE *l_fp = fopen(a_name, "r");
+    if (l_fp == NULL) {
+        fprintf(stderr, "sha2sum: unable to open %s: %s\n", a_name, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    return l_fp;
+}
+
+void load_list(const char *a_listfile)
+{
+    char *l_line = NULL;
+    size_t l_cap = 0;
+    ssize_t l_len;
+    FILE *l_fp = open_list(a_listfile);
+
+    while ((l_len = getline(&l_line, &l_cap, l_fp)) > 0) {
+        if (l_line[l_len - 1] == '\n')
+            l_line[--l_len] = 0;
+        if (l_len > 0)
+            add_file(l_line, g_bits, g_tree ? g_chunk : 0, NULL);
+    }
+    free(l_line);
+    if (l_fp != stdin)
+        fclose(l_fp);
+}
+
+int bits_from_hex_len(size_t a_len)
+{
+    switch (a_len) {
+        case 56: return 224;
+        case 64: return 256;
+        case 96: return 384;
+        case 128: return 512;
+    }
+    return 0;
+}
+
+/*
+ * Manifest lines are either the standard "<hex>  <name>" (or "<hex> *<name>")
+ * written by sha*sum, with the algorithm implied by the digest length, or the
+ * BSD tagged form "SHA512 (<name>) = <hex>". Tree digests use the tag
+ * "SHA512-TREE-<MiB>M" so the leaf size travels with the manifest.
+ */
+int parse_manifest_line(char *a_line)
+{
+    int l_escaped = 0;
+    int l_bits;
+    uint64_t l_chunk = 0;
+    char *l_name;
+    char *l_hex;
+
+    if (a_line[0] == '\\') {
+        l_escaped = 1;
+        ++a_line;
+    }
+
+    if (strncmp(a_line, "SHA", 3) == 0) {
+        unsigned int l_tag_bits = 0;
+        unsigned int l_tag_mb = 0;
+        int l_consumed = 0;
+        if ((sscanf(a_line, "SHA%u-TREE-%uM (%n", &l_tag_bits, &l_tag_mb, &l_consumed) == 2) && (l_consumed > 0)) {
+            l_chunk = (uint64_t)l_tag_mb * 1024 * 1024;
+        } else if ((sscanf(a_line, "SHA%u (%n", &l_tag_bits, &l_consumed) == 1) && (l_consumed > 0)) {
+            l_chunk = 0;
+        } else {
+            return -1;
+        }
+        l_name = a_line + l_consumed;
+        l_hex = strstr(l_name, ") = ");
+        if (l_hex == NULL)
+            return -1;
+        // the name may itself contain ") = ", the digest is always the last one
+        char *l_next;
+        while ((l_next = strstr(l_hex + 1, ") = ")) != NULL)
+            l_hex = l_next;
+        *l_hex = 0;
+        l_hex += 4;
+        l_bits = l_tag_bits;
+        if ((l_bits != 224) && (l_bits != 256) && (l_bits != 384) && (l_bits != 512))
+            return -1;
+        if (strlen(l_hex) != digest_size(l_bits) * 2)
+            return -1;
+    } else {
+        l_hex = a_line;
+        l_name = strchr(a_line, ' ');
+        if (l_name == NULL)
+            return -1;
+        *l_name++ = 0;
+        if ((*l_name != ' ') && (*l_name != '*'))
+            return -1;
+        ++l_name;
+        l_bits = bits_from_hex_len(strlen(l_hex));
+        if (l_bits == 0)
+            return -1;
+    }
+    if (strspn(l_hex, "0123456789abcdefABCDEF") != strlen(l_hex))
+        return -1;
+    if (l_escaped)
+        unescape_name(l_name);
+    add_file(l_name, l_bits, l_chunk, l_hex);
+    return 0;
+}
+
+void load_manifest(const char *a_manifest)
+{
+    char *l_line = NULL;
+    size_t l_cap = 0;
+    ssize_t l_len;
+    long l_lineno = 0;
+    FILE *l_fp = open_list(a_manifest);
+
+    while ((l_len = getline(&l_line, &l_cap, l_fp)) > 0) {
+        ++l_lineno;
+        if (l_line[l_len - 1] == '\n')
+            l_line[--l_len] = 0;
+        if ((l_len > 0) && (l_line[l_len - 1] == '\r'))
+            l_line[--l_len] = 0;
+        if ((l_len == 0) || (l_line[0] == '#'))
+            continue;
+        if (parse_manifest_line(l_line) < 0)
+            fprintf(stderr, "sha2sum: %s: %ld: improperly formatted checksum line\n", a_manifest, l_lineno);
+    }
+    free(l_line);
+    if (l_fp != stdin)
+        fclose(l_fp);
+}
+
+void build_jobs()
+{
+    size_t i;
+    uint32_t j;
+    struct stat l_stat;
+
+    // size every file first so huge ones can be cut into tree leaves
+    for (i = 0; i < g_file_count; ++i) {
+        file_entry *l_file = &g_files[i];
+        l_file->jobs = 1;
+        if ((l_file->chunk > 0) && (strcmp(l_file->name, "-") != 0)) {
+            if (stat(l_file->name, &l_stat) == 0) {
+                l_file->size = l_stat.st_size;
+                if (l_file->size > l_file->chunk)
+                    l_file->jobs = (l_file->size + l_file->chunk - 1) / l_file->chunk;
+            }
+        }
+        // a file that fits in one leaf is hashed the standard way
+        if (l_file->jobs == 1)
+            l_file->chunk = 0;
+        l_file->remaining = l_file->jobs;
+        g_job_count += l_file->jobs;
+    }
+
+    g_jobs = malloc(g_job_count * sizeof(job_entry));
+    if (g_jobs == NULL) {
+        fprintf(stderr, "sha2sum: unable to allocate job list\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t l_job = 0;
+    for (i = 0; i < g_file_count; ++i) {
+        file_entry *l_file = &g_files[i];
+        if (l_file->jobs > 1) {
+            l_file->leaves = malloc((size_t)l_file->jobs * digest_size(l_file->bits));
+            if (l_file->leaves == NULL) {
+                fprintf(stderr, "sha2sum: unable to allocate tree leaves\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (j = 0; j < l_file->jobs; ++j) {
+            g_jobs[l_job].file = i;
+            g_jobs[l_job].index = j;
+            g_jobs[l_job].offset = (uint64_t)j * l_file->chunk;
+            g_jobs[l_job].len = (l_file->jobs > 1) ? l_file->chunk : 0; // 0 = read to EOF
+            ++l_job;
+        }
+    }
+}
+
+int take_job(worker_t *a_worker, size_t *a_job)
+{
+    unsigned int i;
+
+    pthread_mutex_lock(&a_worker->mtx);
+    if (a_worker->lo < a_worker->hi) {
+        *a_job = a_worker->lo++;
+        pthread_mutex_unlock(&a_worker->mtx);
+        return 1;
+    }
+    pthread_mutex_unlock(&a_worker->mtx);
+
+    // our range is empty, go steal half of someone else's
+    for (i = 1; i < g_threads; ++i) {
+        worker_t *l_victim = &g_workers[(a_worker->id + i) % g_threads];
+        pthread_mutex_lock(&l_victim->mtx);
+        size_t l_left = l_victim->hi - l_victim->lo;
+        if (l_left > 0) {
+            size_t l_take = (l_left + 1) / 2;
+            size_t l_start = l_victim->hi - l_take;
+            l_victim->hi = l_start;
+            pthread_mutex_unlock(&l_victim->mtx);
+
+            pthread_mutex_lock(&a_worker->mtx);
+            a_worker->lo = l_start + 1;
+            a_worker->hi = l_start + l_take;
+            pthread_mutex_unlock(&a_worker->mtx);
+            *a_job = l_start;
+            if (g_debug)
+                fprintf(stderr, "sha2sum: worker %u stole %zu jobs from worker %u\n", a_worker->id, l_take, l_victim->id);
+            return 1;
+        }
+        pthread_mutex_unlock(&l_victim->mtx);
+    }
+    return 0;
+}
+
+int hash_range(file_entry *a_file, job_entry *a_job, uint8_t *a_buff, uint8_t *a_digest)
+{
+    digest_ctx l_ctx;
+    int l_fd;
+    ssize_t res;
+    uint64_t l_pos = a_job->offset;
+    uint64_t l_left = a_job->len;
+    int l_to_eof = (a_job->len == 0);
+
+    if (strcmp(a_file->name, "-") == 0) {
+        l_fd = 0;
+    } else {
+        l_fd = open(a_file->name, O_RDONLY);
+        if (l_fd < 0)
+            return errno;
+        posix_fadvise(l_fd, a_job->offset, a_job->len, POSIX_FADV_SEQUENTIAL);
+    }
+
+    digest_init(&l_ctx, a_file->bits);
+    while (l_to_eof || (l_left > 0)) {
+        size_t l_want = (l_to_eof || (l_left > READSIZE)) ? READSIZE : l_left;
+        if (l_fd == 0)
+            res = read(l_fd, a_buff, l_want);
+        else
+            res = pread(l_fd, a_buff, l_want, l_pos);
+        if (res < 0) {
+            int l_err = errno;
+            if (l_fd != 0)
+                close(l_fd);
+            return l_err;
+        }
+        if (res == 0)
+            break;
+        digest_update(&l_ctx, a_file->bits, a_buff, res);
+        l_pos += res;
+        if (!l_to_eof)
+            l_left -= res;
+    }
+    digest_final(&l_ctx, a_file->bits, a_digest);
+    if (l_fd != 0)
+        close(l_fd);
+    return 0;
+}
+
+void finish_tree(file_entry *a_file)
+{
+    // root = H(leaf 0 || leaf 1 || ... || leaf n-1)
+    digest_ctx l_ctx;
+    digest_init(&l_ctx, a_file->bits);
+    digest_update(&l_ctx, a_file->bits, a_file->leaves, (size_t)a_file->jobs * digest_size(a_file->bits));
+    digest_final(&l_ctx, a_file->bits, a_file->digest);
+    free(a_file->leaves);
+    a_file->leaves = NULL;
+}
+
+void *hash_tf(void *a_arg)
+{
+    worker_t *a_worker = (worker_t *)a_arg;
+    size_t l_jobno;
+    uint8_t l_digest[SHA512_DIGEST_SIZE];
+
+    while (take_job(a_worker, &l_jobno)) {
+        job_entry *l_job = &g_jobs[l_jobno];
+        file_entry *l_file = &g_files[l_job->file];
+        int l_err = hash_range(l_file, l_job, a_worker->buff, l_digest);
+        size_t l_dsize = digest_size(l_file->bits);
+
+        pthread_mutex_lock(&g_done_mtx);
+        if (l_err != 0)
+            l_file->error = l_err;
+        else if (l_file->jobs > 1)
+            memcpy(l_file->leaves + (size_t)l_job->index * l_dsize, l_digest, l_dsize);
+        else
+            memcpy(l_file->digest, l_digest, l_dsize);
+        int l_last = (--l_file->remaining == 0);
+        pthread_mutex_unlock(&g_done_mtx);
+
+        if (l_last) {
+            if ((l_file->jobs > 1) && (l_file->error == 0))
+                finish_tree(l_file);
+            pthread_mutex_lock(&g_done_mtx);
+            l_file->done = 1;
+            pthread_cond_broadcast(&g_done_cond);
+            pthread_mutex_unlock(&g_done_mtx);
+        }
+    }
+    return NULL;
+}
+
+void start_workers()
+{
+    unsigned int i;
+    int res;
+
+    if (g_threads > g_job_count)
+        g_threads = (g_job_count > 0) ? g_job_count : 1;
+    size_t l_share = g_job_count / g_threads;
+    size_t l_next = 0;
+    for (i = 0; i < g_threads; ++i) {
+        g_workers[i].id = i;
+        pthread_mutex_init(&g_workers[i].mtx, NULL);
+        g_workers[i].lo = l_next;
+        g_workers[i].hi = (i == g_threads - 1) ? g_job_count : l_next + l_share;
+        l_next = g_workers[i].hi;
+        g_workers[i].buff = malloc(READSIZE);
+        if (g_workers[i].buff == NULL) {
+            fprintf(stderr, "sha2sum: unable to allocate read buffer\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    // ranges must all be in place before anybody starts stealing
+    for (i = 0; i < g_threads; ++i) {
+        res = pthread_create(&g_workers[i].thread, NULL, hash_tf, &g_workers[i]);
+        if (res != 0) {
+            fprintf(stderr, "sha2sum: problems creating thread: %s\n", strerror(res));
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void join_workers()
+{
+    unsigned int i;
+    for (i = 0; i < g_threads; ++i) {
+        pthread_join(g_workers[i].thread, NULL);
+        free(g_workers[i].buff);
+    }
+}
+
+void wait_for_file(file_entry *a_file)
+{
+    pthread_mutex_lock(&g_done_mtx);
+    while (a_file->done == 0)
+        pthread_cond_wait(&g_done_cond, &g_done_mtx);
+    pthread_mutex_unlock(&g_done_mtx);
+}
+
+int print_digests()
+{
+    size_t i;
+    int l_failures = 0;
+    char l_hex[SHA512_DIGEST_SIZE * 2 + 1];
+
+    // results are printed in input order as soon as each file completes
+    for (i = 0; i < g_file_count; ++i) {
+        file_entry *l_file = &g_files[i];
+        wait_for_file(l_file);
+        if (l_file->error != 0) {
+            fprintf(stderr, "sha2sum: %s: %s\n", l_file->name, strerror(l_file->error));
+            ++l_failures;
+            continue;
+        }
+        to_hex(l_file->digest, digest_size(l_file->bits), l_hex);
+        if (needs_escape(l_file->name))
+            fputc('\\', stdout);
+        if (l_file->chunk > 0) {
+            printf("SHA%d-TREE-%lluM (", l_file->bits, (unsigned long long)(l_file->chunk / (1024 * 1024)));
+            print_name(stdout, l_file->name);
+            printf(") = %s\n", l_hex);
+        } else {
+            printf("%s  ", l_hex);
+            print_name(stdout, l_file->name);
+            printf("\n");
+        }
+    }
+    return l_failures;
+}
+
+int check_digests()
+{
+    size_t i;
+    long l_mismatch = 0;
+    long l_unreadable = 0;
+    char l_hex[SHA512_DIGEST_SIZE * 2 + 1];
+
+    for (i = 0; i < g_file_count; ++i) {
+        file_entry *l_file = &g_files[i];
+        wait_for_file(l_file);
+        if (l_file->error != 0) {
+            fprintf(stderr, "sha2sum: %s: %s\n", l_file->name, strerror(l_file->error));
+            printf("%s: FAILED open or read\n", l_file->name);
+            ++l_unreadable;
+            continue;
+        }
+        to_hex(l_file->digest, digest_size(l_file->bits), l_hex);
+        if (strcasecmp(l_hex, l_file->expected) == 0) {
+            if (g_quiet == 0)
+                printf("%s: OK\n", l_file->name);
+        } else {
+            printf("%s: FAILED\n", l_file->name);
+            ++l_mismatch;
+        }
+    }
+    fflush(stdout);
+    if (l_unreadable > 0)
+        fprintf(stderr, "sha2sum: WARNING: %ld listed file%s could not be read\n", l_unreadable, (l_unreadable == 1) ? "" : "s");
+    if (l_mismatch > 0)
+        fprintf(stderr, "sha2sum: WARNING: %ld computed checksum%s did NOT match\n", l_mismatch, (l_mismatch == 1) ? "" : "s");
+    return l_mismatch + l_unreadable;
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    int l_failures;
+    while ((opt = getopt_long(argc, argv, "a:t:c:f:q?", g_options, NULL)) != -1) {
+        switch (opt) {
+            case 1001:
+            {
+                g_debug = 1;
+            }
+            break;
+            case 'a':
+            {
+                g_bits = atoi(optarg);
+                if ((g_bits != 224) && (g_bits != 256) && (g_bits != 384) && (g_bits != 512)) {
+                    fprintf(stderr, "sha2sum: algorithm must be 224, 256, 384 or 512.\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            break;
+            case 't':
+            {
+                g_threads = atoi(optarg);
+                if ((g_threads < 1) || (g_threads > MAXTHREADS)) {
+                    fprintf(stderr, "sha2sum: threads must be between 1 and %d.\n", MAXTHREADS);
+                    exit(EXIT_FAILURE);
+                }
+            }
+            break;
+            case 'c':
+            {
+                strcpy(g_check, optarg);
+                g_check_specified = 1;
+            }
+            break;
+            case 'f':
+            {
+                strcpy(g_listfile, optarg);
+                g_listfile_specified = 1;
+            }
+            break;
+            case 'q':
+            {
+                g_quiet = 1;
+            }
+            break;
+            case 1002:
+            {
+                g_tree = 1;
+            }
+            break;
+            case 1003:
+            {
+                long l_mb = atol(optarg);
+                if (l_mb < 1) {
+                    fprintf(stderr, "sha2sum: chunk size must be at least 1 MiB.\n");
+                    exit(EXIT_FAILURE);
+                }
+                g_chunk = (uint64_t)l_mb * 1024 * 1024;
+            }
+            break;
+            case '?':
+            {
+                printf("Multithreaded SHA-2 file digest tool\n");
+                printf("usage: sha2sum <options> [file...]\n");
+                printf("  -a (--algorithm) <224/256/384/512> SHA-2 variant, default 512\n");
+                printf("  -t (--threads) <n> number of worker threads, default one per CPU\n");
+                printf("  -f (--files) <name> read file names from <name>, one per line (- for stdin)\n");
+                printf("  -c (--check) <manifest> verify files listed in a sha*sum style manifest (- for stdin)\n");
+                printf("  -q (--quiet) with -c, don't print OK for files that verify\n");
+                printf("     (--tree) split files larger than the chunk size across threads\n");
+                printf("       leaf digests are combined into a root digest, tagged SHA<n>-TREE-<MiB>M\n");
+                printf("       in the output; this is NOT the same value as a plain digest of the file\n");
+                printf("     (--chunk) <MiB> tree mode leaf size, default %d\n", DEFAULT_CHUNK_MB);
+                printf("     (--debug) use debug mode\n");
+                printf("  -? (--help) this screen\n");
+                printf("with no files, standard input is hashed\n");
+                printf("examples\n");
+                printf("  sha2sum -t 16 *.iso > SHA512SUMS  Hash files, output is compatible with sha512sum -c\n");
+                printf("  find . -type f | sha2sum -f - > SHA512SUMS\n");
+                printf("  sha2sum -c SHA512SUMS -q  Verify a manifest, printing only failures\n");
+                printf("  sha2sum --tree --chunk 256 disk.img  Hash a huge file on all CPUs\n");
+                exit(EXIT_SUCCESS);
+            }
+            break;
+            default:
+            {
+                exit(EXIT_FAILURE);
+            }
+            break;
+        }
+    }
+
+    if (g_threads == 0) {
+        long l_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        g_threads = (l_cpus < 1) ? 1 : ((l_cpus > MAXTHREADS) ? MAXTHREADS : l_cpus);
+    }
+    if (g_debug > 0)
+        fprintf(stderr, "sha2sum: debug mode enabled, %u threads.\n", g_threads);
+
+    if (g_check_specified) {
+        load_manifest(g_check);
+        if (g_file_count == 0) {
+            fprintf(stderr, "sha2sum: %s: no properly formatted checksum lines found\n", g_check);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        if (g_listfile_specified)
+            load_list(g_listfile);
+        for (; optind < argc; ++optind)
+            add_file(argv[optind], g_bits, g_tree ? g_chunk : 0, NULL);
+        if (g_file_count == 0)
+            add_file("-", g_bits, 0, NULL);
+    }
+
+    build_jobs();
+    start_workers();
+    if (g_check_specified)
+        l_failures = check_digests();
+    else
+        l_failures = print_digests();
+    join_workers();
+
+    return (l_failures > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}